@@ -0,0 +1,45 @@
+!include( ../sicak.pri ) {
+  error( "Couldn't find the sicak.pri file!" )
+}
+
+#
+# OpenMP library is a dependency
+#
+
+win32 {
+    QMAKE_CXXFLAGS_RELEASE += /openmp
+}
+unix { 
+    QMAKE_CXXFLAGS_RELEASE += -fopenmp
+    QMAKE_LFLAGS_RELEASE += -fopenmp
+    
+    # the same optimization as the measured plug-in modules
+    QMAKE_CXXFLAGS_RELEASE -= -O2
+    QMAKE_LFLAGS_RELEASE -= -O2
+    
+    QMAKE_CXXFLAGS_RELEASE += -O3
+    QMAKE_LFLAGS_RELEASE += -O3
+}
+
+INCLUDEPATH    += ./include \
+                  ../plugins/common \
+                  ../plugins/cpaengine/common \
+                  ../plugins/ttestengine/common
+CONFIG += console
+QT -= gui
+
+HEADERS += include/bench.h \
+           include/kernelmodels.hpp
+SOURCES    = src/main.cpp \
+             src/bench.cpp
+
+TARGET     = bench
+QMAKE_PROJECT_NAME = bench
+
+DESTDIR    = ./bin
+
+# install
+target.path = ../INSTALL
+INSTALLS += target
+
+CONFIG += install_ok  # Do not cargo-cult this!
@@ -0,0 +1,124 @@
+/*
+*  SICAK - SIde-Channel Analysis toolKit
+*  Copyright (C) 2018-2019 Petr Socha, FIT, CTU in Prague
+*
+*  This program is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation, either version 3 of the License, or
+*  (at your option) any later version.
+*
+*  This program is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/**
+* \file bench.h
+*
+* \brief SICAK BENCHmark of the statistical kernels text-based UI
+*
+*
+* \author Petr Socha
+* \version 1.0
+*/
+
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <QObject>
+#include <QCommandLineParser>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <functional>
+#include <vector>
+#include "perfcounters.hpp"
+#include "kernelmodels.hpp"
+
+/**
+* \class Bench
+* \ingroup Sicak
+*
+* \brief Class providing text-based UI to the micro-benchmark of the statistical kernels: runs the CPA and t-test kernels of the plug-in modules (ompcpa.hpp, ompttest.hpp)
+* and the power predictions plug-in modules on synthetic data, over a grid of the numbers of traces, samples, candidates, orders and threads, and saves the throughputs
+* into a json file, to be compared between the builds
+*
+*/
+class Bench: public QObject {
+
+Q_OBJECT
+
+public:
+
+    enum CommandLineParseResult {
+        CommandLineTaskPlanned,
+        CommandLineNOP,
+        CommandLineError,
+        CommandLineVersionRequested,
+        CommandLineHelpRequested
+    };
+
+    Bench(QObject *parent = 0) : QObject(parent), m_id(""), m_repeats(3), m_perf(false) {
+        for(size_t i = 0; i < PerfCounters::Count; i++) m_bestCounters[i] = 0;
+    }
+
+    /// Parse parameters from the command line and configuration files and plan tasks for event loop accordingly
+    CommandLineParseResult parseCommandLineParams(QCommandLineParser & parser);
+
+protected:
+
+    /// Parses a comma separated list of positive integers, returns false when the list is empty or invalid
+    static bool parseList(const QString & list, std::vector<size_t> & values);
+
+    /// Runs 'prepare' and then the measured 'kernel' m_repeats times, returns the shortest and the median time of the kernel in seconds. Keeps the hardware performance counters of the fastest run in m_bestCounters
+    void measure(const std::function<void()> & prepare, const std::function<void()> & kernel, double & best, double & median);
+
+    /// Saves the result of a kernel along with its throughputs: traces/s (when traces are given), GB/s and GFLOP/s according to the cost, and prints it.
+    /// The elements (e.g. trace x sample x candidate cells) give the cycles per element, when counting the hardware performance counters
+    void report(const QString & kernel, QJsonObject result, const KernelCost & cost, size_t traces, double elements, double best, double median);
+
+    /// First-order CPA kernels: add, merge and finalize
+    void benchCpa(size_t traces, size_t samples, size_t candidates);
+    /// Higher-order CPA kernels of the given order: add, merge and finalize
+    void benchHoCpa(size_t traces, size_t samples, size_t candidates, size_t order);
+    /// First-order t-test kernels: add, merge and finalize
+    void benchTTest(size_t traces, size_t samples);
+    /// Higher-order t-test kernels of the given order: add, merge and finalize
+    void benchHoTTest(size_t traces, size_t samples, size_t order);
+    /// Power predictions plug-in modules found in plugins/blockprocess
+    void benchPredictions(size_t traces);
+
+    QString m_id;
+    QStringList m_kernels;
+
+    /// Grid of the parameters
+    std::vector<size_t> m_traces;
+    std::vector<size_t> m_samples;
+    std::vector<size_t> m_candidates;
+    std::vector<size_t> m_orders;
+    std::vector<size_t> m_threads;
+
+    size_t m_repeats;
+
+    QJsonArray m_results;
+
+    /// Hardware performance counters, when available and requested
+    bool m_perf;
+    PerfCounters m_counters;
+    uint64_t m_bestCounters[PerfCounters::Count];
+
+public slots:
+
+    /// Run the benchmark over the grid and save the results
+    void run();
+
+signals:
+
+    void finished();
+
+};
+
+#endif /* BENCH_H */
@@ -0,0 +1,278 @@
+/*
+*  SICAK - SIde-Channel Analysis toolKit
+*  Copyright (C) 2018-2019 Petr Socha, FIT, CTU in Prague
+*
+*  This program is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation, either version 3 of the License, or
+*  (at your option) any later version.
+*
+*  This program is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/**
+* \file kernelmodels.hpp
+*
+* \brief Analytical costs of the statistical kernels, used by the SICAK BENCHmark
+*
+* The costs count the loops over the samples and the candidates only, as written in ompcpa.hpp and ompttest.hpp: every arithmetic operation,
+* std::pow and std::sqrt included, is a single flop, and every element of the power traces, the power predictions and the contexts accessed
+* by a loop is a memory access (a read, or a read and a write), even when it would hit the cache. The costs are meant for comparing
+* the runs of the same kernel, not as absolute figures.
+*
+*
+* \author Petr Socha
+* \version 1.0
+*/
+
+#ifndef KERNELMODELS_H
+#define KERNELMODELS_H
+
+#include <cstddef>
+
+/// Size of the context elements, the plug-in modules compute in doubles
+#define KERNELMODELS_CONTEXT_SIZE 8.0
+
+/// Bytes accessed and floating point operations of a kernel call
+struct KernelCost {
+    double bytes;
+    double flops;
+};
+
+/// Adds the cost of 'count' runs of a loop doing 'flops' operations and accessing 'bytes' bytes
+inline void addLoopCost(KernelCost & cost, double count, double flops, double bytes) {
+    cost.flops += count * flops;
+    cost.bytes += count * bytes;
+}
+
+/// UniFoCpaAddTraces: per trace, the candidates x samples covariance update, then the samples and the candidates moments update
+inline KernelCost foCpaAddCost(size_t traces, size_t samples, size_t candidates, size_t sampleSize, size_t predictionSize) {
+
+    const double c = KERNELMODELS_CONTEXT_SIZE;
+    KernelCost cost = { 0, 0 };
+
+    addLoopCost(cost, (double) traces * candidates * samples, 3, sampleSize + 3 * c);
+    addLoopCost(cost, (double) traces * samples, 6, sampleSize + 4 * c);
+    addLoopCost(cost, (double) traces * candidates, 6, predictionSize + 4 * c);
+
+    return cost;
+
+}
+
+/// UniFoCpaMergeContexts
+inline KernelCost foCpaMergeCost(size_t samples, size_t candidates) {
+
+    const double c = KERNELMODELS_CONTEXT_SIZE;
+    KernelCost cost = { 0, 0 };
+
+    addLoopCost(cost, (double) candidates * samples, 6, 3 * c);
+    addLoopCost(cost, (double) samples + candidates, 12, 8 * c);
+
+    return cost;
+
+}
+
+/// UniFoCpaComputeCorrelationMatrix
+inline KernelCost foCpaFinalizeCost(size_t samples, size_t candidates) {
+
+    const double c = KERNELMODELS_CONTEXT_SIZE;
+    KernelCost cost = { 0, 0 };
+
+    addLoopCost(cost, (double) candidates * samples, 2, 2 * c);
+    addLoopCost(cost, (double) samples + candidates, 1, 2 * c);
+
+    return cost;
+
+}
+
+/// Per trace update of the central sums of the samples upto 2*order, along with the powers of the deltas, see UniHoCpaAddTraces and UniHoTTestAddTraces
+inline KernelCost hoCentralSumsAddCost(size_t traces, size_t samples, size_t order, size_t sampleSize) {
+
+    const double c = KERNELMODELS_CONTEXT_SIZE;
+    const double n = (double) traces * samples;
+    KernelCost cost = { 0, 0 };
+
+    // deltas and their powers
+    addLoopCost(cost, n, 1, sampleSize + 2 * c);
+    addLoopCost(cost, n * (2 * order - 1), 1, 3 * c);
+
+    // central sums
+    for(size_t deg = 2; deg <= 2 * order; deg++){
+        addLoopCost(cost, n, 2, 3 * c);
+        addLoopCost(cost, n * (deg - 2), 3, 4 * c);
+    }
+
+    // means
+    addLoopCost(cost, n, 3, sampleSize + 3 * c);
+
+    return cost;
+
+}
+
+/// Merge of the central sums of the samples upto 2*order, see UniHoCpaMergeContexts and UniHoTTestMergeContexts
+inline KernelCost hoCentralSumsMergeCost(size_t samples, size_t order) {
+
+    const double c = KERNELMODELS_CONTEXT_SIZE;
+    KernelCost cost = { 0, 0 };
+
+    // deltas
+    addLoopCost(cost, samples, 1, 3 * c);
+
+    for(size_t deg = 2; deg <= 2 * order; deg++){
+        addLoopCost(cost, samples, 5, 4 * c);
+        for(size_t p = 1; p + 2 <= deg; p++) addLoopCost(cost, samples, (deg - p >= 2) ? 11 : 7, (deg - p >= 2) ? 6 * c : 4 * c);
+    }
+
+    // means
+    addLoopCost(cost, samples, 4, 3 * c);
+
+    return cost;
+
+}
+
+/// UniHoCpaAddTraces: per trace, the candidates x samples adjusted central sums update upto order, then the samples and the candidates moments update
+inline KernelCost hoCpaAddCost(size_t traces, size_t samples, size_t candidates, size_t order, size_t sampleSize, size_t predictionSize) {
+
+    const double c = KERNELMODELS_CONTEXT_SIZE;
+    const double n = (double) traces * candidates * samples;
+    KernelCost cost = hoCentralSumsAddCost(traces, samples, order, sampleSize);
+
+    for(size_t deg = 1; deg <= order; deg++){
+        addLoopCost(cost, n, (deg >= 2) ? 4 : 2, (deg >= 2) ? 4 * c : 3 * c);
+        for(size_t p = 1; p < deg; p++) addLoopCost(cost, n, (deg - p >= 2) ? 5 : 3, (deg - p >= 2) ? 5 * c : 4 * c);
+    }
+
+    addLoopCost(cost, (double) traces * candidates, 9, 2 * predictionSize + 6 * c);
+
+    return cost;
+
+}
+
+/// UniHoCpaMergeContexts
+inline KernelCost hoCpaMergeCost(size_t samples, size_t candidates, size_t order) {
+
+    const double c = KERNELMODELS_CONTEXT_SIZE;
+    const double n = (double) candidates * samples;
+    KernelCost cost = hoCentralSumsMergeCost(samples, order);
+
+    for(size_t deg = 1; deg <= order; deg++){
+        addLoopCost(cost, n, (deg > 1) ? 10 : 5, (deg > 1) ? 6 * c : 4 * c);
+        for(size_t p = 1; p < deg; p++) addLoopCost(cost, n, (deg - p >= 2) ? 15 : 10, (deg - p >= 2) ? 8 * c : 6 * c);
+    }
+
+    addLoopCost(cost, candidates, 10, 8 * c);
+
+    return cost;
+
+}
+
+/// UniHoCpaComputeCorrelationMatrix
+inline KernelCost hoCpaFinalizeCost(size_t samples, size_t candidates) {
+
+    const double c = KERNELMODELS_CONTEXT_SIZE;
+    KernelCost cost = { 0, 0 };
+
+    addLoopCost(cost, (double) candidates * samples, 4, 2 * c);
+    addLoopCost(cost, samples, 4, 3 * c);
+    addLoopCost(cost, candidates, 3, 2 * c);
+
+    return cost;
+
+}
+
+/// UniFoTTestAddTraces, traces of both the populations
+inline KernelCost foTTestAddCost(size_t traces, size_t samples, size_t sampleSize) {
+
+    const double c = KERNELMODELS_CONTEXT_SIZE;
+    KernelCost cost = { 0, 0 };
+
+    addLoopCost(cost, (double) traces * samples, 6, sampleSize + 4 * c);
+
+    return cost;
+
+}
+
+/// UniFoTTestMergeContexts
+inline KernelCost foTTestMergeCost(size_t samples) {
+
+    const double c = KERNELMODELS_CONTEXT_SIZE;
+    KernelCost cost = { 0, 0 };
+
+    addLoopCost(cost, 2.0 * samples, 12, 8 * c);
+
+    return cost;
+
+}
+
+/// UniFoTTestComputeTValsDegs
+inline KernelCost foTTestFinalizeCost(size_t samples) {
+
+    const double c = KERNELMODELS_CONTEXT_SIZE;
+    KernelCost cost = { 0, 0 };
+
+    addLoopCost(cost, samples, 35, 6 * c);
+
+    return cost;
+
+}
+
+/// UniHoTTestAddTraces, traces of both the populations
+inline KernelCost hoTTestAddCost(size_t traces, size_t samples, size_t order, size_t sampleSize) {
+
+    return hoCentralSumsAddCost(traces, samples, order, sampleSize);
+
+}
+
+/// UniHoTTestMergeContexts, both the populations
+inline KernelCost hoTTestMergeCost(size_t samples, size_t order) {
+
+    KernelCost cost = hoCentralSumsMergeCost(samples, order);
+
+    cost.bytes *= 2;
+    cost.flops *= 2;
+
+    return cost;
+
+}
+
+/// UniHoTTestComputeTValsDegs
+inline KernelCost hoTTestFinalizeCost(size_t samples) {
+
+    const double c = KERNELMODELS_CONTEXT_SIZE;
+    KernelCost cost = { 0, 0 };
+
+    addLoopCost(cost, samples, 30, 8 * c);
+
+    return cost;
+
+}
+
+/// Power predictions of 'sets' bytes of 16-byte blocks: the blocks are read, the predictions written, no floating point operations
+inline KernelCost predictionsCost(size_t traces, size_t sets, size_t candidates) {
+
+    KernelCost cost = { 0, 0 };
+
+    addLoopCost(cost, traces, 0, 16 + (double) sets * candidates);
+
+    return cost;
+
+}
+
+/// Saving the power predictions of 'sets' bytes into a file: the predictions are read and written once, no floating point operations
+inline KernelCost predictionsOutputCost(size_t traces, size_t sets, size_t candidates) {
+
+    KernelCost cost = { 0, 0 };
+
+    addLoopCost(cost, traces, 0, 2.0 * sets * candidates);
+
+    return cost;
+
+}
+
+#endif /* KERNELMODELS_H */
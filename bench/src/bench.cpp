@@ -0,0 +1,584 @@
+/*
+*  SICAK - SIde-Channel Analysis toolKit
+*  Copyright (C) 2018-2019 Petr Socha, FIT, CTU in Prague
+*
+*  This program is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation, either version 3 of the License, or
+*  (at your option) any later version.
+*
+*  This program is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/**
+* \file bench.cpp
+*
+* \brief SICAK BENCHmark of the statistical kernels text-based UI
+*
+*
+* \author Petr Socha
+* \version 1.0
+*/
+
+#include <QtGlobal>
+#include <QCoreApplication>
+#include <QTextStream>
+#include <QCommandLineParser>
+#include <QJsonDocument>
+#include <QSaveFile>
+#include <QDateTime>
+#include <QTimer>
+#include <QDir>
+#include <QPluginLoader>
+#include <QTemporaryDir>
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <thread>
+
+#include <omp.h>
+
+#include "configloader.hpp"
+#include "global_calls.hpp"
+#include "filehandling.hpp"
+#include "blockprocess.h"
+#include "types_power.hpp"
+#include "types_stat.hpp"
+#include "ompcpa.hpp"
+#include "ompttest.hpp"
+#include "bench.h"
+
+/// Seed of the synthetic data, the same for every run, so that the runs are comparable
+#define BENCH_SEED 0
+
+
+/// Fills the power traces with Gaussian samples, as a measured power trace with its offset removed
+static void fillTraces(PowerTraces<int16_t> & traces, std::mt19937 & generator) {
+
+    std::normal_distribution<double> noise(0.0, 1000.0);
+
+    for(size_t trace = 0; trace < traces.noOfTraces(); trace++){
+        for(size_t sample = 0; sample < traces.samplesPerTrace(); sample++){
+            traces(sample, trace) = (int16_t) std::max(-32768.0, std::min(32767.0, std::round(noise(generator))));
+        }
+    }
+
+}
+
+/// Fills the power predictions with Hamming weights of random bytes
+static void fillPredictions(PowerPredictions<uint8_t> & predictions, std::mt19937 & generator) {
+
+    std::uniform_int_distribution<int> byte(0, 255);
+
+    for(size_t trace = 0; trace < predictions.noOfTraces(); trace++){
+        for(size_t candidate = 0; candidate < predictions.noOfCandidates(); candidate++){
+            uint8_t hammingWeight = 0;
+            for(int value = byte(generator); value; value >>= 1) hammingWeight += (value & 1);
+            predictions(candidate, trace) = hammingWeight;
+        }
+    }
+
+}
+
+Bench::CommandLineParseResult Bench::parseCommandLineParams(QCommandLineParser & parser) {
+
+    QTextStream cout(stdout);
+    QTextStream cerr(stderr);
+
+    const QCommandLineOption idOption({"I", "id"}, "The ID string will be used in output file's filename. Default value is current datetime.", "string");
+    parser.addOption(idOption);
+
+    const QCommandLineOption kernelsOption({"K", "kernels"}, "Comma separated kernels to run: 'cpa' first-order CPA, 'hocpa' higher-order CPA, 'ttest' first-order t-test, 'hottest' higher-order t-test, 'predict' power predictions plug-in modules. Default is all of them.", "list");
+    parser.addOption(kernelsOption);
+
+    // Grid options
+
+    const QCommandLineOption tracesNOption({"n", "traces-count"}, "Comma separated numbers of power traces added to a context at once. Default is 1000.", "list");
+    parser.addOption(tracesNOption);
+
+    const QCommandLineOption samplesOption({"s", "samples-per-trace"}, "Comma separated numbers of samples per trace. Default is 1000.", "list");
+    parser.addOption(samplesOption);
+
+    const QCommandLineOption candidatesOption({"k", "candidates-count"}, "Comma separated numbers of key candidates, CPA only. Default is 256.", "list");
+    parser.addOption(candidatesOption);
+
+    const QCommandLineOption orderOption("order", "Comma separated orders of the higher-order kernels. Default is 1,2.", "list");
+    parser.addOption(orderOption);
+
+    const QCommandLineOption threadsOption("threads", "Comma separated numbers of OpenMP threads of the parallel kernels. Default is the number of CPU cores.", "list");
+    parser.addOption(threadsOption);
+
+    const QCommandLineOption repeatsOption({"R", "repeats"}, "Number of runs of every kernel, the shortest and the median time is reported. Default is 3.", "positive integer");
+    parser.addOption(repeatsOption);
+
+    const QCommandLineOption perfCountersOption("perf-counters", "Count the hardware performance counters of the CPU (cycles, instructions, last level cache misses, stalled cycles) in the fastest run of every kernel. Linux only.");
+    parser.addOption(perfCountersOption);
+
+    parser.addPositionalArgument("config", "JSON configuration file(s).");
+
+    const QCommandLineOption helpOption = parser.addHelpOption();
+    const QCommandLineOption versionOption = parser.addVersionOption();
+
+    if (!parser.parse(QCoreApplication::arguments()))
+        return CommandLineError;
+
+    if (parser.isSet(versionOption)) return CommandLineVersionRequested;
+    if (parser.isSet(helpOption)) return CommandLineHelpRequested;
+
+    ConfigLoader cfg(parser);
+
+    m_id = (cfg.isSet(idOption)) ? (cfg.getParam(idOption)) : ((QDateTime::currentDateTime()).toString("ddMMyy-HHmmss"));
+
+    m_kernels = ((cfg.isSet(kernelsOption)) ? cfg.getParam(kernelsOption) : "cpa,hocpa,ttest,hottest,predict").split(",");
+
+    foreach (const QString & kernel, m_kernels) {
+        if(kernel != "cpa" && kernel != "hocpa" && kernel != "ttest" && kernel != "hottest" && kernel != "predict"){
+            cerr << "Invalid kernel: -K, use cpa, hocpa, ttest, hottest or predict\n";
+            return CommandLineError;
+        }
+    }
+
+    const QString hardwareThreads = QString::number(std::max(1u, std::thread::hardware_concurrency()));
+
+    if(!parseList(cfg.isSet(tracesNOption) ? cfg.getParam(tracesNOption) : "1000", m_traces)
+    || !parseList(cfg.isSet(samplesOption) ? cfg.getParam(samplesOption) : "1000", m_samples)
+    || !parseList(cfg.isSet(candidatesOption) ? cfg.getParam(candidatesOption) : "256", m_candidates)
+    || !parseList(cfg.isSet(orderOption) ? cfg.getParam(orderOption) : "1,2", m_orders)
+    || !parseList(cfg.isSet(threadsOption) ? cfg.getParam(threadsOption) : hardwareThreads, m_threads)){
+        cerr << "Invalid grid: -n, -s, -k, --order and --threads must be comma separated positive integers\n";
+        return CommandLineError;
+    }
+
+    std::vector<size_t> repeats;
+
+    if(!parseList(cfg.isSet(repeatsOption) ? cfg.getParam(repeatsOption) : "3", repeats) || repeats.size() != 1){
+        cerr << "Invalid number of runs: -R\n";
+        return CommandLineError;
+    }
+
+    m_repeats = repeats.front();
+
+    // Before any OpenMP threads are started, so that the counters count them too
+    if(cfg.isSet(perfCountersOption)){
+        m_perf = (m_counters.open() > 0);
+        if(!m_perf) cerr << "Hardware performance counters are not available (see /proc/sys/kernel/perf_event_paranoid), the results will not contain them\n";
+    }
+
+    QTimer::singleShot(0, this, SLOT(run()));
+        return CommandLineTaskPlanned;
+
+}
+
+bool Bench::parseList(const QString & list, std::vector<size_t> & values) {
+
+    values.clear();
+
+    foreach (const QString & item, list.split(",")) {
+
+        bool ok;
+        const size_t value = item.trimmed().toULongLong(&ok);
+
+        if(!ok || !value) return false;
+
+        values.push_back(value);
+
+    }
+
+    return !values.empty();
+
+}
+
+void Bench::run() {
+
+    QTextStream cout(stdout);
+    QTextStream cerr(stderr);
+
+    cout << "Running the benchmark...\n";
+    cout.flush();
+
+    // The power predictions plug-in modules write their files into the working directory
+    const QString resultsFilename = QDir::current().absoluteFilePath(QString("bench-%1.json").arg(m_id));
+
+    try {
+
+        for(size_t samples : m_samples){
+            for(size_t traces : m_traces){
+
+                if(m_kernels.contains("cpa") || m_kernels.contains("hocpa")){
+                    for(size_t candidates : m_candidates){
+                        if(m_kernels.contains("cpa")) benchCpa(traces, samples, candidates);
+                        if(m_kernels.contains("hocpa")) for(size_t order : m_orders) benchHoCpa(traces, samples, candidates, order);
+                    }
+                }
+
+                if(m_kernels.contains("ttest")) benchTTest(traces, samples);
+                if(m_kernels.contains("hottest")) for(size_t order : m_orders) benchHoTTest(traces, samples, order);
+
+            }
+        }
+
+        if(m_kernels.contains("predict")) for(size_t traces : m_traces) benchPredictions(traces);
+
+    } catch (std::exception & e) {
+        cerr << "Benchmark failed: " << e.what() << "\n";
+        emit finished();
+        return;
+    }
+
+    QJsonObject results;
+    results["id"] = m_id;
+    results["date"] = QDateTime::currentDateTime().toString(Qt::ISODate);
+    results["hardware-threads"] = (double) std::thread::hardware_concurrency();
+    results["repeats"] = (double) m_repeats;
+    results["results"] = m_results;
+
+    QSaveFile resultsFile(resultsFilename);
+    if(resultsFile.open(QIODevice::WriteOnly)){
+        resultsFile.write(QJsonDocument(results).toJson());
+        resultsFile.commit();
+        cout << QString("Results were saved to '%1'.\n").arg(resultsFilename);
+    } else {
+        cerr << QString("Failed to save the results to '%1'.\n").arg(resultsFilename);
+    }
+
+    emit finished();
+
+}
+
+void Bench::measure(const std::function<void()> & prepare, const std::function<void()> & kernel, double & best, double & median) {
+
+    std::vector<double> times;
+    uint64_t before[PerfCounters::Count];
+    uint64_t after[PerfCounters::Count];
+
+    for(size_t run = 0; run < m_repeats; run++){
+
+        prepare();
+
+        if(m_perf) m_counters.read(before);
+
+        const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        kernel();
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+        // Counters of the fastest run
+        if(m_perf && (times.empty() || elapsed.count() < *std::min_element(times.begin(), times.end()))){
+            m_counters.read(after);
+            for(size_t i = 0; i < PerfCounters::Count; i++) m_bestCounters[i] = after[i] - before[i];
+        }
+
+        times.push_back(elapsed.count());
+
+    }
+
+    std::sort(times.begin(), times.end());
+    best = times.front();
+    median = times[times.size() / 2];
+
+}
+
+void Bench::report(const QString & kernel, QJsonObject result, const KernelCost & cost, size_t traces, double elements, double best, double median) {
+
+    QTextStream cout(stdout);
+
+    result["kernel"] = kernel;
+    result["seconds"] = best;
+    result["seconds-median"] = median;
+
+    QString line = QString("%1 %2 s").arg(kernel, -36).arg(best, 0, 'g', 4);
+
+    if(traces){
+        result["traces-per-second"] = traces / best;
+        line.append(QString(", %1 traces/s").arg(traces / best, 0, 'g', 4));
+    }
+
+    result["gb-per-second"] = cost.bytes / best / 1e9;
+    result["gflops"] = cost.flops / best / 1e9;
+    line.append(QString(", %1 GB/s, %2 GFLOP/s").arg(cost.bytes / best / 1e9, 0, 'g', 4).arg(cost.flops / best / 1e9, 0, 'g', 4));
+
+    result["elements"] = elements;
+
+    // Hardware performance counters of the fastest run
+    if(m_perf){
+
+        QJsonObject counters;
+        for(size_t i = 0; i < PerfCounters::Count; i++){
+            if(m_counters.isAvailable(i)) counters[PerfCounters::name(i)] = (double) m_bestCounters[i];
+        }
+        result["counters"] = counters;
+
+        const double cycles = (double) m_bestCounters[PerfCounters::Cycles];
+        if(m_counters.isAvailable(PerfCounters::Cycles) && cycles > 0){
+            if(m_counters.isAvailable(PerfCounters::Instructions)) result["instructions-per-cycle"] = m_bestCounters[PerfCounters::Instructions] / cycles;
+            if(traces) result["cycles-per-trace"] = cycles / traces;
+            result["cycles-per-element"] = cycles / elements;
+            line.append(QString(", %1 cycles/element").arg(cycles / elements, 0, 'g', 4));
+        }
+        if(m_counters.isAvailable(PerfCounters::LlcMisses)) result["llc-misses-per-element"] = m_bestCounters[PerfCounters::LlcMisses] / elements;
+
+    }
+
+    foreach (const QString & key, QStringList({"traces", "samples", "candidates", "order", "threads"})) {
+        if(result.contains(key)) line.append(QString(", %1=%2").arg(key).arg(result[key].toDouble()));
+    }
+
+    cout << line << "\n";
+    cout.flush();
+
+    m_results.append(result);
+
+}
+
+void Bench::benchCpa(size_t traces, size_t samples, size_t candidates) {
+
+    std::mt19937 generator(BENCH_SEED);
+
+    PowerTraces<int16_t> pt(samples, traces);
+    PowerPredictions<uint8_t> pp(candidates, traces);
+    fillTraces(pt, generator);
+    fillPredictions(pp, generator);
+
+    Moments2DContext<double> context(samples, candidates, 1, 1, 2, 2, 1);
+    Moments2DContext<double> second(samples, candidates, 1, 1, 2, 2, 1);
+    double best, median;
+
+    QJsonObject grid;
+    grid["traces"] = (double) traces;
+    grid["samples"] = (double) samples;
+    grid["candidates"] = (double) candidates;
+    grid["order"] = 1.0;
+
+    // The only parallel kernel
+    for(size_t threads : m_threads){
+
+        omp_set_num_threads((int) threads);
+        grid["threads"] = (double) threads;
+
+        measure([&](){ context.reset(); }, [&](){ UniFoCpaAddTraces(context, pt, pp); }, best, median);
+        report("UniFoCpaAddTraces", grid, foCpaAddCost(traces, samples, candidates, sizeof(int16_t), sizeof(uint8_t)), traces, (double) traces * samples * candidates, best, median);
+
+    }
+
+    grid["threads"] = 1.0;
+
+    // Contexts are merged repeatedly into the same context, the cost doesn't depend on the cardinalities
+    second.reset();
+    UniFoCpaAddTraces(second, pt, pp);
+
+    measure([](){}, [&](){ UniFoCpaMergeContexts(context, second); }, best, median);
+    report("UniFoCpaMergeContexts", grid, foCpaMergeCost(samples, candidates), 0, (double) samples * candidates, best, median);
+
+    Matrix<double> correlations;
+
+    measure([](){}, [&](){ UniFoCpaComputeCorrelationMatrix(context, correlations); }, best, median);
+    report("UniFoCpaComputeCorrelationMatrix", grid, foCpaFinalizeCost(samples, candidates), 0, (double) samples * candidates, best, median);
+
+}
+
+void Bench::benchHoCpa(size_t traces, size_t samples, size_t candidates, size_t order) {
+
+    std::mt19937 generator(BENCH_SEED);
+
+    PowerTraces<int16_t> pt(samples, traces);
+    PowerPredictions<uint8_t> pp(candidates, traces);
+    fillTraces(pt, generator);
+    fillPredictions(pp, generator);
+
+    Moments2DContext<double> context(samples, candidates, 1, 1, 2 * order, 2, order);
+    Moments2DContext<double> second(samples, candidates, 1, 1, 2 * order, 2, order);
+    double best, median;
+
+    QJsonObject grid;
+    grid["traces"] = (double) traces;
+    grid["samples"] = (double) samples;
+    grid["candidates"] = (double) candidates;
+    grid["order"] = (double) order;
+
+    // The only parallel kernel
+    for(size_t threads : m_threads){
+
+        omp_set_num_threads((int) threads);
+        grid["threads"] = (double) threads;
+
+        measure([&](){ context.reset(); }, [&](){ UniHoCpaAddTraces(context, pt, pp, order); }, best, median);
+        report("UniHoCpaAddTraces", grid, hoCpaAddCost(traces, samples, candidates, order, sizeof(int16_t), sizeof(uint8_t)), traces, (double) traces * samples * candidates, best, median);
+
+    }
+
+    grid["threads"] = 1.0;
+
+    // Contexts are merged repeatedly into the same context, the cost doesn't depend on the cardinalities
+    second.reset();
+    UniHoCpaAddTraces(second, pt, pp, order);
+
+    measure([](){}, [&](){ UniHoCpaMergeContexts(context, second); }, best, median);
+    report("UniHoCpaMergeContexts", grid, hoCpaMergeCost(samples, candidates, order), 0, (double) samples * candidates, best, median);
+
+    Matrix<double> correlations;
+
+    measure([](){}, [&](){ UniHoCpaComputeCorrelationMatrix(context, correlations, order); }, best, median);
+    report("UniHoCpaComputeCorrelationMatrix", grid, hoCpaFinalizeCost(samples, candidates), 0, (double) samples * candidates, best, median);
+
+}
+
+void Bench::benchTTest(size_t traces, size_t samples) {
+
+    // Half of the traces of each population
+    if(traces < 2) return;
+
+    std::mt19937 generator(BENCH_SEED);
+
+    PowerTraces<int16_t> randTraces(samples, traces - traces / 2);
+    PowerTraces<int16_t> constTraces(samples, traces / 2);
+    fillTraces(randTraces, generator);
+    fillTraces(constTraces, generator);
+
+    Moments2DContext<double> context(samples, samples, 1, 1, 2, 2, 0);
+    Moments2DContext<double> second(samples, samples, 1, 1, 2, 2, 0);
+    double best, median;
+
+    // The t-test kernels run in a single thread
+    QJsonObject grid;
+    grid["traces"] = (double) traces;
+    grid["samples"] = (double) samples;
+    grid["order"] = 1.0;
+    grid["threads"] = 1.0;
+
+    measure([&](){ context.reset(); }, [&](){ UniFoTTestAddTraces(context, randTraces, constTraces); }, best, median);
+    report("UniFoTTestAddTraces", grid, foTTestAddCost(traces, samples, sizeof(int16_t)), traces, (double) traces * samples, best, median);
+
+    second.reset();
+    UniFoTTestAddTraces(second, randTraces, constTraces);
+
+    measure([](){}, [&](){ UniFoTTestMergeContexts(context, second); }, best, median);
+    report("UniFoTTestMergeContexts", grid, foTTestMergeCost(samples), 0, (double) samples, best, median);
+
+    Matrix<double> tValsDegs;
+
+    measure([](){}, [&](){ UniFoTTestComputeTValsDegs(context, tValsDegs); }, best, median);
+    report("UniFoTTestComputeTValsDegs", grid, foTTestFinalizeCost(samples), 0, (double) samples, best, median);
+
+}
+
+void Bench::benchHoTTest(size_t traces, size_t samples, size_t order) {
+
+    // Half of the traces of each population
+    if(traces < 2) return;
+
+    std::mt19937 generator(BENCH_SEED);
+
+    PowerTraces<int16_t> randTraces(samples, traces - traces / 2);
+    PowerTraces<int16_t> constTraces(samples, traces / 2);
+    fillTraces(randTraces, generator);
+    fillTraces(constTraces, generator);
+
+    Moments2DContext<double> context(samples, samples, 1, 1, 2 * order, 2 * order, 0);
+    Moments2DContext<double> second(samples, samples, 1, 1, 2 * order, 2 * order, 0);
+    double best, median;
+
+    // The t-test kernels run in a single thread
+    QJsonObject grid;
+    grid["traces"] = (double) traces;
+    grid["samples"] = (double) samples;
+    grid["order"] = (double) order;
+    grid["threads"] = 1.0;
+
+    measure([&](){ context.reset(); }, [&](){ UniHoTTestAddTraces(context, randTraces, constTraces, order); }, best, median);
+    report("UniHoTTestAddTraces", grid, hoTTestAddCost(traces, samples, order, sizeof(int16_t)), traces, (double) traces * samples, best, median);
+
+    second.reset();
+    UniHoTTestAddTraces(second, randTraces, constTraces, order);
+
+    measure([](){}, [&](){ UniHoTTestMergeContexts(context, second); }, best, median);
+    report("UniHoTTestMergeContexts", grid, hoTTestMergeCost(samples, order), 0, (double) samples, best, median);
+
+    Matrix<double> tValsDegs;
+
+    measure([](){}, [&](){ UniHoTTestComputeTValsDegs(context, tValsDegs, order); }, best, median);
+    report("UniHoTTestComputeTValsDegs", grid, hoTTestFinalizeCost(samples), 0, (double) samples, best, median);
+
+}
+
+void Bench::benchPredictions(size_t traces) {
+
+    QDir pluginsDir(QCoreApplication::instance()->applicationDirPath());
+    pluginsDir.cd("plugins");
+    pluginsDir.cd("blockprocess");
+
+    // Random plaintext blocks
+    std::mt19937 generator(BENCH_SEED);
+    std::uniform_int_distribution<int> byte(0, 255);
+
+    Matrix<uint8_t> blocks(16, traces);
+    for(size_t block = 0; block < traces; block++){
+        for(size_t i = 0; i < 16; i++) blocks(i, block) = (uint8_t) byte(generator);
+    }
+
+    // The modules write the power predictions files into a temporary working directory
+    QTemporaryDir workDir;
+    if(!workDir.isValid()) throw RuntimeException("Could not create a temporary directory for the power predictions");
+
+    const QString currentDir = QDir::currentPath();
+    QDir::setCurrent(workDir.path());
+
+    QJsonObject grid;
+    grid["traces"] = (double) traces;
+    grid["threads"] = 1.0;
+
+    try {
+
+        // The modules save the predictions into a file: writing the same predictions is measured on its own and left out of the times of the modules
+        PowerPredictions<uint8_t> predictions(256, traces);
+        fillPredictions(predictions, generator);
+
+        double outputBest, outputMedian;
+        uint64_t outputCounters[PerfCounters::Count];
+
+        measure([](){}, [&](){
+            std::fstream outFile = openOutFile("bench.16prd");
+            for(size_t set = 0; set < 16; set++) writeArrayToFile(outFile, predictions);
+            closeFile(outFile);
+        }, outputBest, outputMedian);
+
+        for(size_t i = 0; i < PerfCounters::Count; i++) outputCounters[i] = m_bestCounters[i];
+
+        report("PowerPredictions output", grid, predictionsOutputCost(traces, 16, 256), traces, (double) traces * 16 * 256, outputBest, outputMedian);
+
+        foreach (QString fileName, pluginsDir.entryList(QDir::Files)) {
+
+            QPluginLoader pluginLoader(pluginsDir.absoluteFilePath(fileName));
+            QObject * plugin = pluginLoader.instance();
+            BlockProcess * engine = (plugin) ? qobject_cast<BlockProcess *>(plugin) : nullptr;
+
+            if(!engine) continue;
+
+            double best, median;
+
+            engine->init("");
+            measure([](){}, [&](){ engine->processBlockData(blocks, "bench"); }, best, median);
+            engine->deInit();
+
+            for(size_t i = 0; i < PerfCounters::Count; i++) m_bestCounters[i] -= (outputCounters[i] < m_bestCounters[i]) ? outputCounters[i] : m_bestCounters[i];
+
+            QJsonObject result = grid;
+            result["module"] = engine->getPluginName();
+            result["seconds-with-output"] = best;
+            report("BlockProcess::processBlockData", result, predictionsCost(traces, 16, 256), traces, (double) traces * 16 * 256, std::max(best - outputBest, 0.0), std::max(median - outputMedian, 0.0));
+
+        }
+
+    } catch (...) {
+        QDir::setCurrent(currentDir);
+        throw;
+    }
+
+    QDir::setCurrent(currentDir);
+
+}
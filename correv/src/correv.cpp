@@ -39,6 +39,7 @@
 
 #include "configloader.hpp"
 #include "global_calls.hpp"
+#include "instrumentation.hpp"
 #include "filehandling.hpp"
 #include "correv.h"
 
@@ -74,6 +75,9 @@ CorrEv::CommandLineParseResult CorrEv::parseCommandLineParams(QCommandLineParser
     const QCommandLineOption paramOption("param", "Optional plug-in module parameters. Module specific option.", "param");
     parser.addOption(paramOption);
         
+    const QCommandLineOption statsJsonOption("stats-json", "Save the per-phase statistics of the run (wall and CPU time, bytes, traces and peak memory of e.g. reading the files or running the plug-in module) into a JSON file.", "filepath");
+    parser.addOption(statsJsonOption);
+        
     parser.addPositionalArgument("config", "JSON configuration file(s).");
     
     const QCommandLineOption helpOption = parser.addHelpOption();
@@ -88,6 +92,10 @@ CorrEv::CommandLineParseResult CorrEv::parseCommandLineParams(QCommandLineParser
     
     ConfigLoader cfg(parser);                
     
+    if(cfg.isSet(statsJsonOption)){
+        PhaseStats::get().enable(cfg.getParam(statsJsonOption));
+    }
+    
     m_param = (cfg.isSet(paramOption)) ? (cfg.getParam(paramOption)) : "";
     
     if(cfg.isSet(corrModuleOption) != cfg.isSet(keyguessModuleOption)){
@@ -268,6 +276,7 @@ void CorrEv::evaluate() {
     QByteArray ba = m_param.toLocal8Bit();
     try {
                         
+        PhaseTimer timer("init-module");
         m_cpaCorrEvalPlugin->init(ba.data());
         
     } catch(std::exception & e){
@@ -278,6 +287,7 @@ void CorrEv::evaluate() {
     
     try {
                 
+        PhaseTimer timer("init-module");
         m_cpaKeyEvalPlugin->init(ba.data());
         
     } catch(std::exception & e){
@@ -291,6 +301,7 @@ void CorrEv::evaluate() {
     // Open correlations file
     try {
         
+        PhaseTimer timer("open-files");
         ba = m_correlations.toLocal8Bit();
         correlationsFile = openInFile(ba.data());
         
@@ -310,7 +321,9 @@ void CorrEv::evaluate() {
         // Load correlation matrix
         try {
         
+            PhaseTimer timer("read-correlations");
             fillArrayFromFile(correlationsFile, correlationMatrix);                            
+            timer.addBytes(correlationMatrix.size());
             
         } catch (std::exception & e) {
             cerr << "Failed to read correlation matrix from file: " << e.what() << "\n";
@@ -322,6 +335,8 @@ void CorrEv::evaluate() {
         
         try {
             
+            PhaseTimer timer("evaluate-correlations");
+            timer.addBytes(correlationMatrix.size());
             m_cpaCorrEvalPlugin->evaluateCorrelations(correlationMatrix, sample, keyGuess(i));
             
         } catch (std::exception & e) {            
@@ -340,6 +355,7 @@ void CorrEv::evaluate() {
     // When the full keyguess is obtained, evaluate it to obtain a cipher key
     try {
         
+        PhaseTimer timer("evaluate-keyguess");
         cipherKey = m_cpaKeyEvalPlugin->evaluateKeyCandidates(keyGuess);
         
     } catch (std::exception & e){
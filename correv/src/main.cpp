@@ -31,6 +31,7 @@
 #include <QCommandLineParser>
 #include <QtCore>
 #include "correv.h"
+#include "instrumentation.hpp"
 
 int main(int argv, char *args[])
 {
@@ -49,10 +50,13 @@ int main(int argv, char *args[])
     QObject::connect(corrEv, SIGNAL(finished()), &app, SLOT(quit()));
      
     switch(corrEv->parseCommandLineParams(parser)) {
-        case CorrEv::CommandLineTaskPlanned:
+        case CorrEv::CommandLineTaskPlanned: {
             cout << qPrintable(QCoreApplication::applicationName()) << " " << qPrintable(QCoreApplication::applicationVersion()) << "\n";
             cout.flush();                      
-            return app.exec();                  
+            const int result = app.exec();
+            PhaseStats::get().saveAndReport();
+            return result;
+        }
         case CorrEv::CommandLineError:
             cerr << "Error parsing command line options.\n";
             return 1;
@@ -0,0 +1,112 @@
+/*
+*  SICAK - SIde-Channel Analysis toolKit
+*  Copyright (C) 2018-2019 Petr Socha, FIT, CTU in Prague
+*
+*  This program is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation, either version 3 of the License, or
+*  (at your option) any later version.
+*
+*  This program is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/**
+* \file boundedqueue.hpp
+*
+* \brief Thread safe FIFO queue with a limited capacity, connecting producer and consumer threads
+*
+*
+* \author Petr Socha
+* \version 1.0
+*/
+
+#ifndef BOUNDEDQUEUE_H
+#define BOUNDEDQUEUE_H
+
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include "exceptions.hpp"
+
+/**
+* \class BoundedQueue
+* \ingroup SicakData
+*
+* \brief Thread safe FIFO queue with a limited capacity: push blocks while the queue is full, pop blocks while the queue is empty. Once closed, the remaining items can still be popped.
+*
+*/
+template <class T>
+class BoundedQueue {
+
+public:
+
+    /// Constructs a queue holding at most 'capacity' items
+    BoundedQueue(size_t capacity) : m_capacity(capacity), m_closed(false) {
+        if(!capacity) throw InvalidInputException("Bounded queue needs a non-zero capacity");
+    }
+
+    /// Appends the item, waits while the queue is full. Returns false when the queue was closed, the item is dropped then
+    bool push(T item){
+
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_notFull.wait(lock, [this]{ return m_closed || m_items.size() < m_capacity; });
+
+        if(m_closed) return false;
+
+        m_items.push_back(std::move(item));
+        m_notEmpty.notify_one();
+
+        return true;
+
+    }
+
+    /// Removes the oldest item, waits while the queue is empty. Returns false when the queue is closed and empty
+    bool pop(T & item){
+
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_notEmpty.wait(lock, [this]{ return m_closed || !m_items.empty(); });
+
+        if(m_items.empty()) return false;
+
+        item = std::move(m_items.front());
+        m_items.pop_front();
+        m_notFull.notify_one();
+
+        return true;
+
+    }
+
+    /// Closes the queue: no more items are accepted, waiting threads are woken up
+    void close(){
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_closed = true;
+        m_notFull.notify_all();
+        m_notEmpty.notify_all();
+
+    }
+
+    /// Returns the number of items in the queue
+    size_t size(){
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_items.size();
+    }
+
+protected:
+
+    size_t m_capacity;
+    bool m_closed;
+    std::deque<T> m_items;
+    std::mutex m_mutex;
+    std::condition_variable m_notFull;
+    std::condition_variable m_notEmpty;
+
+};
+
+#endif /* BOUNDEDQUEUE_H */
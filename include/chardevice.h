@@ -23,7 +23,7 @@
 *
 *
 * \author Petr Socha
-* \version 1.0
+* \version 1.1
 */
 
 #ifndef CHARDEVICE_H
@@ -76,9 +76,12 @@ public:
     /// Receives the specified amount of data into the buffer
     virtual size_t receive(uint8_t * buffer, size_t len) = 0;
     
+    /// Returns human readable communication statistics (e.g. transaction latencies) gathered since init, or an empty string when not supported
+    virtual QString getStatistics() = 0;
+    
 };        
 
-#define CharDevice_iid "cz.cvut.fit.Sicak.CharDeviceInterface/1.0"
+#define CharDevice_iid "cz.cvut.fit.Sicak.CharDeviceInterface/1.1"
 
 Q_DECLARE_INTERFACE(CharDevice, CharDevice_iid)
 
@@ -0,0 +1,592 @@
+/*
+*  SICAK - SIde-Channel Analysis toolKit
+*  Copyright (C) 2018-2019 Petr Socha, FIT, CTU in Prague
+*
+*  This program is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation, either version 3 of the License, or
+*  (at your option) any later version.
+*
+*  This program is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/**
+* \file compressedtraces.hpp
+*
+* \brief This header file contains a chunked, indexed and losslessly compressed power traces container
+*
+* Container layout: 256 byte ID signature, followed by 6 uint64 attributes (sample size in bytes, samples per trace,
+* traces per chunk, number of traces, number of chunks, offset of the chunk index). Then a sequence of chunks follows,
+* each starting with 3 uint64 attributes (chunk marker, number of traces in the chunk, payload size in bytes).
+* The container ends with the chunk index (uint64 offsets of the chunks). When the index is missing (e.g. the writer
+* did not finish), the chunks are found by scanning the file.
+*
+* Every power trace in a chunk is encoded separately: samples are split into blocks of 64, differences of the consecutive
+* samples are zigzag encoded, and every block is bit-packed using the bit width of its largest value (one byte per block).
+*
+*
+* \author Petr Socha
+* \version 1.1
+*/
+
+#ifndef COMPRESSEDTRACES_HPP
+#define COMPRESSEDTRACES_HPP
+
+#include <fstream>
+#include <vector>
+#include <future>
+#include <thread>
+#include <cstring>
+#include <cstdint>
+#include <type_traits>
+#include "types_basic.hpp"
+#include "exceptions.hpp"
+
+/// ID signature of the compressed power traces container
+#define COMPRESSED_TRACES_ID "cz.cvut.fit.Sicak.CompressedTraces/1.0"
+/// Marker preceding every chunk of the compressed power traces container
+#define COMPRESSED_TRACES_CHUNK_MARKER 0x6b6e756863746373ULL
+/// Number of samples sharing a bit width
+#define COMPRESSED_TRACES_BLOCK 64
+/// Number of padding bytes behind the payload, allowing the decoder to load whole 64-bit words
+#define COMPRESSED_TRACES_PADDING 8
+
+
+/**
+*
+* \brief Returns the upper bound of the encoded size of 'noOfTraces' power traces, 'samplesPerTrace' samples each
+* \ingroup SicakData
+*
+*/
+template <class T>
+size_t compressedTracesBound(size_t samplesPerTrace, size_t noOfTraces){
+
+    size_t blocks = (samplesPerTrace + COMPRESSED_TRACES_BLOCK - 1) / COMPRESSED_TRACES_BLOCK;
+    size_t maxBits = sizeof(T) * 8 + 1;
+
+    return noOfTraces * (blocks + (samplesPerTrace * maxBits + 7) / 8 + blocks);
+
+}
+
+/**
+*
+* \brief Encodes 'noOfTraces' power traces, 'samplesPerTrace' samples each, into 'out'. Returns the number of bytes written.
+* \ingroup SicakData
+*
+*/
+template <class T>
+size_t encodeCompressedTraces(const T * traces, size_t samplesPerTrace, size_t noOfTraces, uint8_t * out){
+
+    static_assert(std::is_integral<T>::value && std::is_signed<T>::value && sizeof(T) <= 2, "Only signed 8 and 16 bit samples are supported");
+
+    uint8_t * outStart = out;
+    uint32_t zz[COMPRESSED_TRACES_BLOCK];
+
+    for(size_t trace = 0; trace < noOfTraces; trace++){
+
+        const T * samples = traces + trace * samplesPerTrace;
+        int32_t prev = 0;
+
+        for(size_t blockStart = 0; blockStart < samplesPerTrace; blockStart += COMPRESSED_TRACES_BLOCK){
+
+            size_t blockLen = (samplesPerTrace - blockStart < COMPRESSED_TRACES_BLOCK) ? (samplesPerTrace - blockStart) : COMPRESSED_TRACES_BLOCK;
+            uint32_t acc = 0;
+
+            // Zigzag encoded differences
+            for(size_t i = 0; i < blockLen; i++){
+                int32_t cur = samples[blockStart + i];
+                int32_t d = cur - prev;
+                prev = cur;
+                zz[i] = ((uint32_t) d << 1) ^ (uint32_t)(d >> 31);
+                acc |= zz[i];
+            }
+
+            unsigned width = 0;
+            while(acc >> width) width++;
+
+            *out++ = (uint8_t) width;
+
+            if(!width) continue;
+
+            // Bit-pack the block
+            uint64_t bitBuf = 0;
+            unsigned bitCount = 0;
+
+            for(size_t i = 0; i < blockLen; i++){
+                bitBuf |= (uint64_t) zz[i] << bitCount;
+                bitCount += width;
+                while(bitCount >= 8){
+                    *out++ = (uint8_t) bitBuf;
+                    bitBuf >>= 8;
+                    bitCount -= 8;
+                }
+            }
+
+            if(bitCount) *out++ = (uint8_t) bitBuf;
+
+        }
+
+    }
+
+    return out - outStart;
+
+}
+
+/**
+*
+* \brief Decodes 'noOfTraces' power traces, 'samplesPerTrace' samples each, from 'in' of 'len' bytes. 'in' must be followed by COMPRESSED_TRACES_PADDING readable bytes.
+* \ingroup SicakData
+*
+*/
+template <class T>
+void decodeCompressedTraces(const uint8_t * in, size_t len, size_t samplesPerTrace, size_t noOfTraces, T * traces){
+
+    static_assert(std::is_integral<T>::value && std::is_signed<T>::value && sizeof(T) <= 2, "Only signed 8 and 16 bit samples are supported");
+
+    const uint8_t * inEnd = in + len;
+    const unsigned maxWidth = sizeof(T) * 8 + 1;
+
+    for(size_t trace = 0; trace < noOfTraces; trace++){
+
+        T * samples = traces + trace * samplesPerTrace;
+        int32_t prev = 0;
+
+        for(size_t blockStart = 0; blockStart < samplesPerTrace; blockStart += COMPRESSED_TRACES_BLOCK){
+
+            size_t blockLen = (samplesPerTrace - blockStart < COMPRESSED_TRACES_BLOCK) ? (samplesPerTrace - blockStart) : COMPRESSED_TRACES_BLOCK;
+
+            if(in >= inEnd) throw RuntimeException("Corrupted compressed power traces: unexpected end of chunk");
+
+            unsigned width = *in++;
+
+            if(!width){
+                for(size_t i = 0; i < blockLen; i++) samples[blockStart + i] = (T) prev;
+                continue;
+            }
+
+            size_t blockBytes = (blockLen * width + 7) / 8;
+            if(width > maxWidth || in + blockBytes > inEnd) throw RuntimeException("Corrupted compressed power traces: invalid block");
+
+            const uint64_t mask = (1ULL << width) - 1;
+            size_t bitPos = 0;
+
+            for(size_t i = 0; i < blockLen; i++){
+                uint64_t word;
+                std::memcpy(&word, in + (bitPos >> 3), sizeof(word));
+                uint32_t z = (uint32_t)((word >> (bitPos & 7)) & mask);
+                bitPos += width;
+                prev += (int32_t)(z >> 1) ^ -(int32_t)(z & 1);
+                samples[blockStart + i] = (T) prev;
+            }
+
+            in += blockBytes;
+
+        }
+
+    }
+
+}
+
+
+/**
+* \class CompressedTracesWriter
+* \ingroup SicakData
+*
+* \brief A class writing power traces into the compressed container. Power traces are buffered into chunks, which are encoded in parallel.
+*
+*/
+template <class T>
+class CompressedTracesWriter {
+
+public:
+
+    /// Starts a new container at the current position of the output filestream 'fs'
+    CompressedTracesWriter(std::fstream & fs, size_t samplesPerTrace, size_t tracesPerChunk = 256) : m_fs(fs), m_samplesPerTrace(samplesPerTrace), m_tracesPerChunk(tracesPerChunk), m_noOfTraces(0), m_pendingTraces(0), m_closed(false) {
+
+        if(!samplesPerTrace || !tracesPerChunk) throw InvalidInputException("Compressed power traces container needs non-zero number of samples per trace and traces per chunk");
+
+        m_threads = std::thread::hardware_concurrency();
+        if(!m_threads) m_threads = 1;
+
+        m_pending.init(m_samplesPerTrace * m_tracesPerChunk * m_threads);
+
+        m_start = m_fs.tellp();
+        writeHeader(0);
+
+    }
+
+    /// Finishes the container, unless closed already
+    ~CompressedTracesWriter() {
+        try {
+            close();
+        } catch (std::exception & e) {
+            (void)e;
+        }
+    }
+
+    /// Appends 'noOfTraces' power traces to the container
+    void writeTraces(const T * traces, size_t noOfTraces){
+
+        if(m_closed) throw RuntimeException("Compressed power traces container was already closed");
+
+        size_t capacity = m_pending.length() / m_samplesPerTrace;
+
+        while(noOfTraces){
+
+            size_t n = (capacity - m_pendingTraces < noOfTraces) ? (capacity - m_pendingTraces) : noOfTraces;
+            std::memcpy(m_pending.data() + m_pendingTraces * m_samplesPerTrace, traces, n * m_samplesPerTrace * sizeof(T));
+
+            m_pendingTraces += n;
+            traces += n * m_samplesPerTrace;
+            noOfTraces -= n;
+
+            if(m_pendingTraces == capacity) flushChunks();
+
+        }
+
+    }
+
+    /// Writes the remaining power traces and the chunk index, and updates the container header
+    void close(){
+
+        if(m_closed) return;
+        m_closed = true;
+
+        flushChunks();
+
+        std::streamoff indexOffset = (std::streamoff) m_fs.tellp() - m_start;
+        if(!m_chunkOffsets.empty()){
+            m_fs.write(reinterpret_cast<const char *>(m_chunkOffsets.data()), m_chunkOffsets.size() * sizeof(uint64_t));
+        }
+
+        writeHeader((uint64_t) indexOffset);
+
+        if(m_fs.fail()) throw RuntimeException("Could not write the compressed power traces container. Not enough space?");
+
+    }
+
+    /// Updates the container header and flushes the filestream, so that all the complete chunks can be recovered, even when the container does not get closed
+    void flush(){
+
+        if(m_closed) return;
+
+        writeHeader(0);
+        m_fs.flush();
+
+        if(m_fs.fail()) throw RuntimeException("Could not write the compressed power traces container. Not enough space?");
+
+    }
+
+    /// Returns the number of power traces written so far
+    size_t noOfTraces() const { return m_noOfTraces + m_pendingTraces; }
+    /// Returns the number of power traces already encoded into the chunks, i.e. recoverable after flush
+    size_t encodedTraces() const { return m_noOfTraces; }
+
+protected:
+
+    void writeHeader(uint64_t indexOffset){
+
+        std::streampos pos = m_fs.tellp();
+        m_fs.seekp(m_start);
+
+        char id[256] = {0};
+        std::strncpy(id, COMPRESSED_TRACES_ID, 255);
+        m_fs.write(id, 256);
+
+        uint64_t attrs[6] = { sizeof(T), m_samplesPerTrace, m_tracesPerChunk, m_noOfTraces, m_chunkOffsets.size(), indexOffset };
+        m_fs.write(reinterpret_cast<const char *>(attrs), sizeof(attrs));
+
+        if(pos > m_start) m_fs.seekp(pos);
+
+        if(m_fs.fail()) throw RuntimeException("Could not write the compressed power traces container header. Not enough space?");
+
+    }
+
+    /// Encodes pending traces into chunks in parallel, keeps the last incomplete chunk pending unless the writer is closing
+    void flushChunks(){
+
+        size_t chunks = m_closed ? (m_pendingTraces + m_tracesPerChunk - 1) / m_tracesPerChunk : m_pendingTraces / m_tracesPerChunk;
+        if(!chunks) return;
+
+        std::vector<std::vector<uint8_t>> encoded(chunks);
+        std::vector<size_t> encodedLen(chunks);
+        std::vector<std::future<void>> workers;
+
+        for(size_t t = 0; t < m_threads && t < chunks; t++){
+            workers.push_back(std::async(std::launch::async, [&, t](){
+                for(size_t chunk = t; chunk < chunks; chunk += m_threads){
+                    size_t first = chunk * m_tracesPerChunk;
+                    size_t n = (m_pendingTraces - first < m_tracesPerChunk) ? (m_pendingTraces - first) : m_tracesPerChunk;
+                    encoded[chunk].resize(compressedTracesBound<T>(m_samplesPerTrace, n));
+                    encodedLen[chunk] = encodeCompressedTraces<T>(m_pending.data() + first * m_samplesPerTrace, m_samplesPerTrace, n, encoded[chunk].data());
+                }
+            }));
+        }
+
+        for(auto & worker : workers) worker.get();
+
+        for(size_t chunk = 0; chunk < chunks; chunk++){
+
+            size_t first = chunk * m_tracesPerChunk;
+            size_t n = (m_pendingTraces - first < m_tracesPerChunk) ? (m_pendingTraces - first) : m_tracesPerChunk;
+
+            m_chunkOffsets.push_back((uint64_t)((std::streamoff) m_fs.tellp() - m_start));
+
+            uint64_t chunkAttrs[3] = { COMPRESSED_TRACES_CHUNK_MARKER, n, encodedLen[chunk] };
+            m_fs.write(reinterpret_cast<const char *>(chunkAttrs), sizeof(chunkAttrs));
+            m_fs.write(reinterpret_cast<const char *>(encoded[chunk].data()), encodedLen[chunk]);
+
+            m_noOfTraces += n;
+
+        }
+
+        if(m_fs.fail()) throw RuntimeException("Could not write the compressed power traces. Not enough space?");
+
+        // Move the incomplete chunk to the front
+        size_t done = (chunks * m_tracesPerChunk < m_pendingTraces) ? chunks * m_tracesPerChunk : m_pendingTraces;
+        std::memmove(m_pending.data(), m_pending.data() + done * m_samplesPerTrace, (m_pendingTraces - done) * m_samplesPerTrace * sizeof(T));
+        m_pendingTraces -= done;
+
+    }
+
+    std::fstream & m_fs;
+    std::streampos m_start;
+    size_t m_samplesPerTrace;
+    size_t m_tracesPerChunk;
+    size_t m_noOfTraces;
+    size_t m_threads;
+    Vector<T> m_pending;
+    size_t m_pendingTraces;
+    std::vector<uint64_t> m_chunkOffsets;
+    bool m_closed;
+
+};
+
+
+/**
+* \class CompressedTracesReader
+* \ingroup SicakData
+*
+* \brief A class reading power traces from the compressed container. Chunks are decoded in parallel, while the next batch of chunks is being read.
+*
+*/
+template <class T>
+class CompressedTracesReader {
+
+public:
+
+    /// Opens a container starting at the current position of the input filestream 'fs'
+    CompressedTracesReader(std::fstream & fs) : m_fs(fs) {
+
+        m_start = m_fs.tellg();
+
+        char id[256];
+        m_fs.read(id, 256);
+        id[255] = 0;
+
+        if(m_fs.fail() || strcmp(id, COMPRESSED_TRACES_ID)) throw RuntimeException("Error reading compressed power traces: invalid ID signature. Maybe incompatible version?");
+
+        uint64_t attrs[6];
+        m_fs.read(reinterpret_cast<char *>(attrs), sizeof(attrs));
+        if(m_fs.fail()) throw RuntimeException("Error reading compressed power traces: truncated header");
+
+        if(attrs[0] != sizeof(T)) throw RuntimeException("Error reading compressed power traces: sample type mismatch");
+
+        m_samplesPerTrace = attrs[1];
+        m_tracesPerChunk = attrs[2];
+        m_noOfTraces = attrs[3];
+        size_t noOfChunks = attrs[4];
+        uint64_t indexOffset = attrs[5];
+
+        if(!m_samplesPerTrace || !m_tracesPerChunk) throw RuntimeException("Error reading compressed power traces: invalid header");
+
+        if(indexOffset){
+
+            // Use the chunk index
+            m_chunkOffsets.resize(noOfChunks + 1);
+            m_fs.seekg(m_start + (std::streamoff) indexOffset);
+            if(noOfChunks) m_fs.read(reinterpret_cast<char *>(m_chunkOffsets.data()), noOfChunks * sizeof(uint64_t));
+            if(m_fs.fail()) throw RuntimeException("Error reading compressed power traces: truncated chunk index");
+            m_chunkOffsets[noOfChunks] = indexOffset;
+
+        } else {
+
+            // The container was not closed properly, scan the chunks
+            scanChunks();
+
+        }
+
+        m_threads = std::thread::hardware_concurrency();
+        if(!m_threads) m_threads = 1;
+
+    }
+
+    /// Returns the number of samples per power trace
+    size_t samplesPerTrace() const { return m_samplesPerTrace; }
+    /// Returns the number of power traces in the container
+    size_t noOfTraces() const { return m_noOfTraces; }
+    /// Returns the number of power traces per chunk, the unit of decoding
+    size_t tracesPerChunk() const { return m_tracesPerChunk; }
+
+    /// Decodes 'noOfTraces' power traces starting with 'firstTrace' into 'buffer'
+    void readTraces(size_t firstTrace, size_t noOfTraces, T * buffer){
+
+        if(!noOfTraces) return;
+        if(firstTrace + noOfTraces > m_noOfTraces) throw RuntimeException("Could not read the compressed power traces. Not enough data?");
+
+        size_t firstChunk = firstTrace / m_tracesPerChunk;
+        size_t lastChunk = (firstTrace + noOfTraces - 1) / m_tracesPerChunk;
+        size_t batch = 4 * m_threads;
+
+        std::vector<std::vector<uint8_t>> payloads[2];
+        std::future<void> decoding;
+        int cur = 0;
+
+        for(size_t batchStart = firstChunk; batchStart <= lastChunk; batchStart += batch){
+
+            size_t batchEnd = (batchStart + batch - 1 < lastChunk) ? batchStart + batch - 1 : lastChunk;
+
+            // Read the next batch, while the previous one is being decoded
+            readPayloads(batchStart, batchEnd, payloads[cur]);
+
+            if(decoding.valid()) decoding.get();
+
+            std::vector<std::vector<uint8_t>> * batchPayloads = &payloads[cur];
+            decoding = std::async(std::launch::async, [=](){
+                decodeBatch(*batchPayloads, batchStart, firstTrace, noOfTraces, buffer);
+            });
+
+            cur ^= 1;
+
+        }
+
+        if(decoding.valid()) decoding.get();
+
+    }
+
+protected:
+
+    void scanChunks(){
+
+        m_chunkOffsets.clear();
+        m_noOfTraces = 0;
+
+        uint64_t offset = 256 + 6 * sizeof(uint64_t);
+
+        for(;;){
+
+            uint64_t chunkAttrs[3];
+            m_fs.seekg(m_start + (std::streamoff) offset);
+            m_fs.read(reinterpret_cast<char *>(chunkAttrs), sizeof(chunkAttrs));
+
+            if(m_fs.fail() || chunkAttrs[0] != COMPRESSED_TRACES_CHUNK_MARKER || chunkAttrs[1] > m_tracesPerChunk) break;
+
+            // Check the payload is complete
+            m_fs.seekg(m_start + (std::streamoff)(offset + sizeof(chunkAttrs) + chunkAttrs[2] - 1));
+            char last;
+            m_fs.read(&last, 1);
+            if(m_fs.fail()) break;
+
+            m_chunkOffsets.push_back(offset);
+            m_noOfTraces += chunkAttrs[1];
+            offset += sizeof(chunkAttrs) + chunkAttrs[2];
+
+            if(chunkAttrs[1] < m_tracesPerChunk) break; // only the last chunk may be incomplete
+
+        }
+
+        m_fs.clear();
+        m_chunkOffsets.push_back(offset);
+
+    }
+
+    void readPayloads(size_t firstChunk, size_t lastChunk, std::vector<std::vector<uint8_t>> & payloads){
+
+        payloads.resize(lastChunk - firstChunk + 1);
+
+        for(size_t chunk = firstChunk; chunk <= lastChunk; chunk++){
+
+            size_t len = m_chunkOffsets[chunk + 1] - m_chunkOffsets[chunk];
+            std::vector<uint8_t> & payload = payloads[chunk - firstChunk];
+
+            payload.resize(len + COMPRESSED_TRACES_PADDING);
+
+            m_fs.seekg(m_start + (std::streamoff) m_chunkOffsets[chunk]);
+            m_fs.read(reinterpret_cast<char *>(payload.data()), len);
+
+            if(m_fs.fail()) throw RuntimeException("Could not read the compressed power traces. Not enough data?");
+
+            std::memset(payload.data() + len, 0, COMPRESSED_TRACES_PADDING);
+
+        }
+
+    }
+
+    void decodeBatch(std::vector<std::vector<uint8_t>> & payloads, size_t batchStart, size_t firstTrace, size_t noOfTraces, T * buffer){
+
+        std::vector<std::future<void>> workers;
+        size_t chunks = payloads.size();
+
+        for(size_t t = 0; t < m_threads && t < chunks; t++){
+            workers.push_back(std::async(std::launch::async, [&, t](){
+
+                Vector<T> tmp;
+
+                for(size_t i = t; i < chunks; i += m_threads){
+
+                    size_t chunk = batchStart + i;
+                    const uint8_t * payload = payloads[i].data();
+
+                    uint64_t chunkAttrs[3];
+                    std::memcpy(chunkAttrs, payload, sizeof(chunkAttrs));
+                    size_t len = payloads[i].size() - COMPRESSED_TRACES_PADDING;
+
+                    if(chunkAttrs[0] != COMPRESSED_TRACES_CHUNK_MARKER || chunkAttrs[1] > m_tracesPerChunk || sizeof(chunkAttrs) + chunkAttrs[2] > len)
+                        throw RuntimeException("Corrupted compressed power traces: invalid chunk");
+
+                    size_t chunkFirst = chunk * m_tracesPerChunk;
+                    size_t chunkTraces = chunkAttrs[1];
+                    size_t from = (firstTrace > chunkFirst) ? firstTrace : chunkFirst;
+                    size_t to = (firstTrace + noOfTraces < chunkFirst + chunkTraces) ? firstTrace + noOfTraces : chunkFirst + chunkTraces;
+
+                    if(from == chunkFirst && to == chunkFirst + chunkTraces){
+
+                        // Whole chunk is requested, decode directly into the buffer
+                        decodeCompressedTraces<T>(payload + sizeof(chunkAttrs), chunkAttrs[2], m_samplesPerTrace, chunkTraces, buffer + (chunkFirst - firstTrace) * m_samplesPerTrace);
+
+                    } else {
+
+                        tmp.init(chunkTraces * m_samplesPerTrace);
+                        decodeCompressedTraces<T>(payload + sizeof(chunkAttrs), chunkAttrs[2], m_samplesPerTrace, chunkTraces, tmp.data());
+                        std::memcpy(buffer + (from - firstTrace) * m_samplesPerTrace, tmp.data() + (from - chunkFirst) * m_samplesPerTrace, (to - from) * m_samplesPerTrace * sizeof(T));
+
+                    }
+
+                }
+
+            }));
+        }
+
+        for(auto & worker : workers) worker.get();
+
+    }
+
+    std::fstream & m_fs;
+    std::streampos m_start;
+    size_t m_samplesPerTrace;
+    size_t m_tracesPerChunk;
+    size_t m_noOfTraces;
+    size_t m_threads;
+    /// Offsets of the chunks, followed by the end offset of the last chunk
+    std::vector<uint64_t> m_chunkOffsets;
+
+};
+
+
+#endif /* COMPRESSEDTRACES_HPP */
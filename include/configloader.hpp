@@ -33,6 +33,8 @@
 #include <QCommandLineParser>
 #include <QJsonObject>
 #include <QJsonDocument>
+#include <QStringList>
+#include <vector>
 
 /**
 * \class ConfigLoader
@@ -88,6 +90,26 @@ public:
         
     }
 
+    /// Returns a comma separated list of non-negative integers, e.g. "sample-indices"; ok is false when the list is empty or any of the values is invalid
+    std::vector<size_t> getIndicesParam(const QCommandLineOption & option, bool & ok) const {
+        
+        std::vector<size_t> indices;
+        const QStringList values = getParam(option).split(",");
+        
+        ok = true;
+        
+        foreach (const QString &value, values) {
+            
+            bool valueOk;
+            indices.push_back(value.trimmed().toULongLong(&valueOk));
+            ok = ok && valueOk;
+            
+        }
+        
+        return indices;
+        
+    }
+
     /// Returns true when parameter is set, either on command line, on in a json config file
     bool isSet(const QCommandLineOption & option) const {
         
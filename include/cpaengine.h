@@ -23,7 +23,7 @@
 *
 *
 * \author Petr Socha
-* \version 1.1
+* \version 1.2
 */
 
 #ifndef CPAENGINE_H
@@ -64,6 +64,8 @@ public:
     
     /// Create a CPA computation context based on given power traces and power predictions
     virtual Moments2DContext<double> createContext(const PowerTraces<int16_t> & powerTraces, const PowerPredictions<uint8_t> & powerPredictions) = 0;    
+    /// Create a CPA computation context based on given 8-bit power traces and power predictions
+    virtual Moments2DContext<double> createContext(const PowerTraces<int8_t> & powerTraces, const PowerPredictions<uint8_t> & powerPredictions) = 0;    
     /// Merge the two CPA contexts, stores the result in the first of the contexts
     virtual void mergeContexts(Moments2DContext<double> & firstAndOut, const Moments2DContext<double> & second) = 0;
     /// Compute correlation matrix based on given context
@@ -71,7 +73,7 @@ public:
     
 };        
 
-#define CpaEngine_iid "cz.cvut.fit.Sicak.CpaEngineInterface/1.1"
+#define CpaEngine_iid "cz.cvut.fit.Sicak.CpaEngineInterface/1.2"
 
 Q_DECLARE_INTERFACE(CpaEngine, CpaEngine_iid)
 
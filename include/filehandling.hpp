@@ -23,7 +23,7 @@
 *
 *
 * \author Petr Socha
-* \version 1.1
+* \version 1.3
 */
 
 
@@ -33,12 +33,20 @@
 #include <fstream>
 #include <string>
 #include <cstring>
+#include <vector>
+#include <future>
+#include <thread>
+#include <utility>
 #include "types_basic.hpp"
 #include "types_power.hpp"
 #include "types_stat.hpp"
 #include "exceptions.hpp"
+#include "compressedtraces.hpp"
 #include <iostream>
 
+/// Maximum number of bytes read at once by a thread of the batched loaders
+#define FILEHANDLING_READ_BYTES (4 * 1024 * 1024)
+
 /**
 *
 * \brief Opens filestream for writing
@@ -108,13 +116,104 @@ void fillArrayFromFile(std::fstream & fs, ArrayType<T> & arr){
 
 /**
 *
-* \brief Loads a power trace from file, based on parameters given
+* \brief Returns true when the file contains the compressed power traces container, keeps the file position
+* \ingroup SicakData
+*
+*/
+bool isCompressedTracesFile(std::fstream & fs){
+    
+    std::streampos pos = fs.tellg();
+    
+    char id[sizeof(COMPRESSED_TRACES_ID)];
+    fs.read(id, sizeof(id));
+    
+    bool ret = !fs.fail() && !memcmp(id, COMPRESSED_TRACES_ID, sizeof(id));
+    
+    fs.clear();
+    fs.seekg(pos);
+    
+    return ret;
+    
+}
+
+/**
+*
+* \brief Returns the size of a sample in bytes declared by the power traces file, or 0 when the file does not declare it (raw power traces), keeps the file position
+* \ingroup SicakData
+*
+*/
+size_t getDeclaredSampleSize(std::fstream & fs){
+    
+    if(!isCompressedTracesFile(fs)) return 0;
+    
+    std::streampos pos = fs.tellg();
+    
+    uint64_t sampleSize = 0;
+    fs.seekg(pos + (std::streamoff) 256);
+    fs.read(reinterpret_cast<char *>(&sampleSize), sizeof(sampleSize));
+    
+    if(fs.fail()) sampleSize = 0;
+    
+    fs.clear();
+    fs.seekg(pos);
+    
+    return sampleSize;
+    
+}
+
+/**
+*
+* \brief Fills power traces from file, based on the given PowerTraces' size. Reads both raw and compressed power traces files.
+* \ingroup SicakData
+*
+*/
+template<class T>
+void fillTracesFromFile(std::fstream & fs, PowerTraces<T> & traces){
+    
+    if(isCompressedTracesFile(fs)){
+        
+        CompressedTracesReader<T> reader(fs);
+        
+        if(reader.samplesPerTrace() != traces.samplesPerTrace())
+            throw RuntimeException("Could not read the power traces from the file. Number of samples per trace mismatch.");
+        
+        reader.readTraces(0, traces.noOfTraces(), traces.data());
+        
+    } else {
+        
+        fillArrayFromFile(fs, traces);
+        
+    }
+    
+}
+
+/**
+*
+* \brief Loads a power trace from file, based on parameters given. Reads both raw and compressed power traces files.
 * \ingroup SicakData
 *
 */
 template<class T>
 Vector<T> loadPowerTraceFromFile(std::fstream & fs, size_t samplesPerTrace, size_t trace){     
     
+    fs.seekg(0);
+    
+    if(isCompressedTracesFile(fs)){
+        
+        CompressedTracesReader<T> reader(fs);
+        
+        if(reader.samplesPerTrace() != samplesPerTrace)
+            throw RuntimeException("Could not read the power trace from the file. Number of samples per trace mismatch.");
+        
+        Vector<T> arr;
+        arr.init(samplesPerTrace);
+        
+        reader.readTraces(trace, 1, arr.data());
+        
+        return arr;
+        
+    }
+    
     fs.seekg(sizeof(T) * samplesPerTrace * trace); 
 
     if(fs.fail())
@@ -175,6 +274,150 @@ Vector<T> loadTValuesFromFile(std::fstream & fs, size_t samplesPerTrace){
     
 }
 
+/**
+*
+* \brief Loads the rows of 'rowLength' values (power traces, correlation traces) from a raw file into 'buffer', row after row in the order of 'rows', without any allocation per row.
+* Consecutive rows are read at once, so sort the rows to get the reads coalesced. The reads are issued by multiple threads, each with its own filestream, zero threads means the number of hardware threads.
+* \ingroup SicakData
+*
+*/
+template<class T>
+void loadRowsFromFile(const char * filename, size_t rowLength, const std::vector<size_t> & rows, T * buffer, size_t threads = 0){
+    
+    if(rows.empty()) return;
+    if(!rowLength) throw InvalidInputException("Invalid row length, must be positive");
+    
+    // Runs of consecutive rows, split into reads of at most FILEHANDLING_READ_BYTES (but at least a row), so that the threads share long runs
+    const size_t maxRows = (FILEHANDLING_READ_BYTES / (sizeof(T) * rowLength)) ? FILEHANDLING_READ_BYTES / (sizeof(T) * rowLength) : 1;
+    std::vector<std::pair<size_t, size_t>> reads; //< first position in 'rows', number of rows
+    
+    for(size_t i = 0; i < rows.size(); ){
+        
+        size_t n = 1;
+        while(i + n < rows.size() && n < maxRows && rows[i + n] == rows[i] + n) n++;
+        
+        reads.push_back(std::make_pair(i, n));
+        i += n;
+        
+    }
+    
+    if(!threads) threads = std::thread::hardware_concurrency();
+    if(!threads) threads = 1;
+    if(threads > reads.size()) threads = reads.size();
+    
+    std::vector<std::future<void>> workers;
+    
+    for(size_t t = 0; t < threads; t++){
+        workers.push_back(std::async(std::launch::async, [&, t](){
+            
+            std::fstream fs = openInFile(filename);
+            
+            for(size_t r = t; r < reads.size(); r += threads){
+                
+                fs.seekg(sizeof(T) * rowLength * rows[reads[r].first]);
+                
+                if(fs.fail())
+                    throw RuntimeException("Could not skip offset. Not enough data?");
+                
+                fs.read(reinterpret_cast<char *>(buffer + rowLength * reads[r].first), sizeof(T) * rowLength * reads[r].second);
+                
+                if(fs.fail())
+                    throw RuntimeException("Could not read the data from the file. Not enough data?");
+                
+            }
+            
+        }));
+    }
+    
+    for(auto & worker : workers) worker.get();
+    
+}
+
+/**
+*
+* \brief Loads the power traces from file into 'buffer', power trace after power trace in the order of 'traces', see loadRowsFromFile. Reads both raw and compressed power traces files.
+* \ingroup SicakData
+*
+*/
+template<class T>
+void loadPowerTracesFromFile(const char * filename, size_t samplesPerTrace, const std::vector<size_t> & traces, T * buffer, size_t threads = 0){
+    
+    std::fstream fs = openInFile(filename);
+    
+    if(isCompressedTracesFile(fs)){
+        
+        // Chunks are the unit of decoding: ascending power traces in the same or the neighbouring chunks are decoded at once as a span,
+        // so that every chunk gets decoded once, and the reader decodes the chunks of a span in parallel
+        CompressedTracesReader<T> reader(fs);
+        
+        if(reader.samplesPerTrace() != samplesPerTrace)
+            throw RuntimeException("Could not read the power traces from the file. Number of samples per trace mismatch.");
+        
+        const size_t tracesPerChunk = reader.tracesPerChunk();
+        const size_t maxSpan = (16 * FILEHANDLING_READ_BYTES / (sizeof(T) * samplesPerTrace) > 2 * tracesPerChunk) ? 16 * FILEHANDLING_READ_BYTES / (sizeof(T) * samplesPerTrace) : 2 * tracesPerChunk;
+        std::vector<T> span;
+        
+        for(size_t i = 0; i < traces.size(); ){
+            
+            size_t n = 1;
+            while(i + n < traces.size() && traces[i + n] > traces[i + n - 1] && traces[i + n] / tracesPerChunk <= traces[i + n - 1] / tracesPerChunk + 1 && traces[i + n] - traces[i] < maxSpan) n++;
+            
+            const size_t spanTraces = traces[i + n - 1] - traces[i] + 1;
+            
+            if(spanTraces == n){
+                
+                // Consecutive power traces
+                reader.readTraces(traces[i], n, buffer + samplesPerTrace * i);
+                
+            } else {
+                
+                span.resize(spanTraces * samplesPerTrace);
+                reader.readTraces(traces[i], spanTraces, span.data());
+                
+                for(size_t j = 0; j < n; j++){
+                    std::memcpy(buffer + samplesPerTrace * (i + j), span.data() + samplesPerTrace * (traces[i + j] - traces[i]), samplesPerTrace * sizeof(T));
+                }
+                
+            }
+            
+            i += n;
+            
+        }
+        
+        return;
+        
+    }
+    
+    fs.close();
+    
+    loadRowsFromFile(filename, samplesPerTrace, traces, buffer, threads);
+    
+}
+
+/**
+*
+* \brief Loads the correlation traces, given by (matrix, candidate) pairs, from file into 'buffer', correlation trace after correlation trace in the order of 'traces', see loadRowsFromFile
+* \ingroup SicakData
+*
+*/
+template<class T>
+void loadCorrelationTracesFromFile(const char * filename, size_t samplesPerTrace, size_t noOfCandidates, const std::vector<std::pair<size_t, size_t>> & traces, T * buffer, size_t threads = 0){
+    
+    std::vector<size_t> rows(traces.size());
+    
+    for(size_t i = 0; i < traces.size(); i++){
+        
+        if(traces[i].second >= noOfCandidates)
+            throw InvalidInputException("Key candidate out of range");
+        
+        rows[i] = traces[i].first * noOfCandidates + traces[i].second;
+        
+    }
+    
+    loadRowsFromFile(filename, samplesPerTrace, rows, buffer, threads);
+    
+}
+
 /**
 *
 * \brief Writes array to file
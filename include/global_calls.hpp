@@ -31,6 +31,8 @@
 
 #include <QElapsedTimer>
 #include <iostream>
+#include <mutex>
+#include <string>
 
 /**
 * \class CoutProgress
@@ -51,28 +53,50 @@ public:
     
     /// Start displaying the progress bar and define the amout of work that's left to be done
     void start(size_t workSize){
+        std::lock_guard<std::mutex> lock(m_mutex);
         m_workSize = workSize > 1 ? workSize : 1;
         m_workProgress = 0;
         m_lastPercentage = 0;
+        m_status.clear();
+        m_statusChanged = false;
         m_startTime.start();
         std::cout << '\r' << "0% done... remaining time not yet available" << std::flush;
     }
     
     /// Update the progress bar, 0 <= workProgress <= workSize
     void update(size_t workProgress){
+        std::lock_guard<std::mutex> lock(m_mutex);
         m_workProgress = workProgress;
         int percentage = ((float)m_workProgress / (float)m_workSize) * 100.0;
         if(percentage >= 100) percentage = 99;
-        if(percentage > m_lastPercentage){
-            m_lastPercentage = percentage;
-            std::cout << '\r' << percentage << "% done... approx. ";
-            printFormattedTime((((float)m_startTime.elapsed() / (float)m_workProgress) * (float)(m_workSize - m_workProgress)) / 1000.0);
-            std::cout << " remaining                                                 " << std::flush;
+        if(percentage > m_lastPercentage || m_statusChanged){
+            if(percentage > m_lastPercentage) m_lastPercentage = percentage;
+            m_statusChanged = false;
+            std::cout << '\r' << m_lastPercentage << "% done... ";
+            if(m_workProgress){
+                std::cout << "approx. ";
+                printFormattedTime((((float)m_startTime.elapsed() / (float)m_workProgress) * (float)(m_workSize - m_workProgress)) / 1000.0);
+                std::cout << " remaining";
+            } else {
+                std::cout << "remaining time not yet available";
+            }
+            if(!m_status.empty()) std::cout << ", " << m_status;
+            std::cout << "                                                 " << std::flush;
         }
     }
     
+    /// Set a status shown along with the progress bar, e.g. an intermediate result. May be called from any thread, the status gets displayed by the next update
+    void setStatus(const std::string & status){
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_status = status;
+        m_statusChanged = true;
+    }
+    
     /// Call when the work is done to stop the progress bar
     void finish(){
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_status.clear();
+        m_statusChanged = false;
         m_lastPercentage = 100;
         std::cout << '\r' << "100% done... ";
         printFormattedTime((float)m_startTime.elapsed() / 1000.0);
@@ -101,11 +125,14 @@ protected:
     size_t m_workSize;
     size_t m_workProgress;
     int m_lastPercentage;
+    std::string m_status;
+    bool m_statusChanged;
+    std::mutex m_mutex;
     QElapsedTimer m_startTime;        
 
 private:   
     
-    CoutProgress(): m_workSize(1), m_workProgress(0), m_lastPercentage(0) {}
+    CoutProgress(): m_workSize(1), m_workProgress(0), m_lastPercentage(0), m_statusChanged(false) {}
     CoutProgress(CoutProgress const&);
     void operator=(CoutProgress const&);    
     
@@ -0,0 +1,465 @@
+/*
+*  SICAK - SIde-Channel Analysis toolKit
+*  Copyright (C) 2018-2019 Petr Socha, FIT, CTU in Prague
+*
+*  This program is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation, either version 3 of the License, or
+*  (at your option) any later version.
+*
+*  This program is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/**
+* \file instrumentation.hpp
+*
+* \brief This header file contains per-phase timing and throughput instrumentation of the utilities
+*
+*
+* \author Petr Socha
+* \version 1.0
+*/
+
+#ifndef INSTRUMENTATION_HPP
+#define INSTRUMENTATION_HPP
+
+#include <QString>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QSaveFile>
+#include <QDateTime>
+#include <QTextStream>
+#include <QCoreApplication>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "perfcounters.hpp"
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#include <time.h>
+#endif
+
+/**
+* \class PhaseStats
+*
+* \brief A singleton class collecting the wall and CPU time, bytes, traces and peak memory of the named phases of a run (e.g. reading the power traces, creating a context),
+* see PhaseTimer. Disabled by default, when disabled the phases are not recorded at all. The phases of the same name are summed up, the phases may be recorded from any thread.
+*
+* CPU time of a phase is the CPU time of the whole process while the phase ran, i.e. including the other threads. Peak memory is the peak resident set size of the process
+* at the end of the phase. Phases run by several threads at once, such as the stages of a pipeline, are recorded by ConcurrentPhase instead: once per run, with the wall time
+* of the whole run and the CPU time of their own threads.
+*
+* Optionally, the hardware performance counters of the process are counted in every phase too (see PerfCounters), along with the derived metrics, such as the cycles
+* per element, an element being e.g. a (trace, sample, candidate) cell of a CPA context update. The counters count the whole process too, so they are not recorded
+* for the concurrent phases, see the phase enclosing them.
+*
+*/
+class PhaseStats {
+
+public:
+
+    /// Singleton instance getter
+    static PhaseStats & get(){
+        static PhaseStats instance;
+        return instance;
+    }
+
+    /// Start recording the phases, to be saved into the JSON file 'filename' by saveAndReport, the total time is measured from now on
+    void enable(const QString & filename){
+        m_filename = filename;
+        m_startWall = wallTime();
+        m_startCpu = cpuTime();
+        m_enabled.store(true, std::memory_order_relaxed);
+    }
+
+    /// Whether the phases are being recorded
+    bool isEnabled() const {
+        return m_enabled.load(std::memory_order_relaxed);
+    }
+
+    /// Count the hardware performance counters in the phases too, to be called before any worker threads are started. Returns the number of available counters
+    size_t enableCounters(){
+        const size_t available = m_counters.open();
+        m_countersEnabled = (available > 0);
+        return available;
+    }
+
+    /// Whether the hardware performance counters are counted
+    bool countersEnabled() const {
+        return m_countersEnabled;
+    }
+
+    /// Reads the hardware performance counters into values[PerfCounters::Count]
+    void readCounters(uint64_t * values) const {
+        m_counters.read(values);
+    }
+
+    /// Add a run of the phase 'name', along with its hardware performance counters, if counted
+    void record(const char * name, double wall, double cpu, uint64_t bytes, uint64_t traces, uint64_t elements, const uint64_t * counters){
+
+        const uint64_t peakRss = peakResidentSetSize();
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        for(Phase & phase : m_phases){
+            if(phase.name == name){
+                phase.count++;
+                phase.wall += wall;
+                phase.cpu += cpu;
+                phase.bytes += bytes;
+                phase.traces += traces;
+                phase.elements += elements;
+                for(size_t i = 0; i < PerfCounters::Count; i++) phase.counters[i] += (counters) ? counters[i] : 0;
+                phase.peakRss = (peakRss > phase.peakRss) ? peakRss : phase.peakRss;
+                return;
+            }
+        }
+
+        Phase phase = { name, 1, wall, cpu, bytes, traces, elements, {}, peakRss };
+        for(size_t i = 0; i < PerfCounters::Count; i++) phase.counters[i] = (counters) ? counters[i] : 0;
+        m_phases.push_back(phase);
+
+    }
+
+    /// Returns the phases in the order of their first run, along with the totals of the whole run
+    QJsonObject toJson(const QString & application){
+
+        QJsonObject stats;
+        stats["application"] = application;
+        stats["date"] = QDateTime::currentDateTime().toString(Qt::ISODate);
+        stats["wall-seconds"] = wallTime() - m_startWall;
+        stats["cpu-seconds"] = cpuTime() - m_startCpu;
+        stats["peak-rss-bytes"] = (double) peakResidentSetSize();
+
+        QJsonArray phases;
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        for(const Phase & phase : m_phases){
+
+            QJsonObject entry;
+            entry["phase"] = QString::fromStdString(phase.name);
+            entry["count"] = (double) phase.count;
+            entry["wall-seconds"] = phase.wall;
+            entry["cpu-seconds"] = phase.cpu;
+            entry["bytes"] = (double) phase.bytes;
+            entry["traces"] = (double) phase.traces;
+            if(phase.wall > 0){
+                entry["mb-per-second"] = phase.bytes / phase.wall / 1e6;
+                entry["traces-per-second"] = phase.traces / phase.wall;
+            }
+            if(phase.elements) entry["elements"] = (double) phase.elements;
+            entry["peak-rss-bytes"] = (double) phase.peakRss;
+
+            if(m_countersEnabled){
+
+                QJsonObject counters;
+                for(size_t i = 0; i < PerfCounters::Count; i++){
+                    if(m_counters.isAvailable(i)) counters[PerfCounters::name(i)] = (double) phase.counters[i];
+                }
+                entry["counters"] = counters;
+
+                const double cycles = (double) phase.counters[PerfCounters::Cycles];
+                if(m_counters.isAvailable(PerfCounters::Cycles) && cycles > 0){
+                    if(m_counters.isAvailable(PerfCounters::Instructions)) entry["instructions-per-cycle"] = phase.counters[PerfCounters::Instructions] / cycles;
+                    if(phase.traces) entry["cycles-per-trace"] = cycles / phase.traces;
+                    if(phase.elements) entry["cycles-per-element"] = cycles / phase.elements;
+                }
+                if(m_counters.isAvailable(PerfCounters::LlcMisses) && phase.elements) entry["llc-misses-per-element"] = (double) phase.counters[PerfCounters::LlcMisses] / phase.elements;
+
+            }
+
+            phases.append(entry);
+
+        }
+
+        stats["phases"] = phases;
+
+        return stats;
+
+    }
+
+    /// Saves the phases into a JSON file, see toJson. Returns false on failure
+    bool save(const QString & filename, const QString & application){
+
+        QSaveFile file(filename);
+        if(!file.open(QIODevice::WriteOnly)) return false;
+        file.write(QJsonDocument(toJson(application)).toJson());
+        return file.commit();
+
+    }
+
+    /// Saves the phases into the JSON file given to enable, when enabled, and reports the outcome on the standard output. To be called at the end of the run
+    void saveAndReport(){
+
+        if(!isEnabled()) return;
+
+        QTextStream cout(stdout);
+        QTextStream cerr(stderr);
+
+        if(save(m_filename, QCoreApplication::applicationName())){
+            cout << QString("Statistics of the run were saved to '%1'.\n").arg(m_filename);
+        } else {
+            cerr << QString("Failed to save the statistics of the run to '%1'.\n").arg(m_filename);
+        }
+
+    }
+
+    /// Monotonic wall clock time, in seconds
+    static double wallTime(){
+        return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    /// CPU time of the process (user and system, all threads), in seconds
+    static double cpuTime(){
+#ifdef _WIN32
+        FILETIME creation, exit, kernel, user;
+        if(!GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user)) return 0;
+        const uint64_t k = ((uint64_t) kernel.dwHighDateTime << 32) | kernel.dwLowDateTime;
+        const uint64_t u = ((uint64_t) user.dwHighDateTime << 32) | user.dwLowDateTime;
+        return (k + u) * 1e-7;
+#else
+        struct rusage usage;
+        if(getrusage(RUSAGE_SELF, &usage)) return 0;
+        return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) * 1e-6;
+#endif
+    }
+
+    /// CPU time of the calling thread (user and system), in seconds
+    static double threadCpuTime(){
+#ifdef _WIN32
+        FILETIME creation, exit, kernel, user;
+        if(!GetThreadTimes(GetCurrentThread(), &creation, &exit, &kernel, &user)) return 0;
+        const uint64_t k = ((uint64_t) kernel.dwHighDateTime << 32) | kernel.dwLowDateTime;
+        const uint64_t u = ((uint64_t) user.dwHighDateTime << 32) | user.dwLowDateTime;
+        return (k + u) * 1e-7;
+#else
+        struct timespec time;
+        if(clock_gettime(CLOCK_THREAD_CPUTIME_ID, &time)) return 0;
+        return time.tv_sec + time.tv_nsec * 1e-9;
+#endif
+    }
+
+    /// Peak resident set size of the process, in bytes
+    static uint64_t peakResidentSetSize(){
+#ifdef _WIN32
+        PROCESS_MEMORY_COUNTERS counters;
+        if(!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) return 0;
+        return counters.PeakWorkingSetSize;
+#else
+        struct rusage usage;
+        if(getrusage(RUSAGE_SELF, &usage)) return 0;
+#ifdef __APPLE__
+        return usage.ru_maxrss;
+#else
+        return (uint64_t) usage.ru_maxrss * 1024;
+#endif
+#endif
+    }
+
+protected:
+
+    struct Phase {
+        std::string name;
+        uint64_t count;
+        double wall;
+        double cpu;
+        uint64_t bytes;
+        uint64_t traces;
+        uint64_t elements;
+        uint64_t counters[PerfCounters::Count];
+        uint64_t peakRss;
+    };
+
+    std::atomic<bool> m_enabled;
+    QString m_filename;
+    bool m_countersEnabled;
+    PerfCounters m_counters;
+    double m_startWall;
+    double m_startCpu;
+    std::mutex m_mutex;
+    std::vector<Phase> m_phases;
+
+private:
+
+    PhaseStats(): m_enabled(false), m_filename(""), m_countersEnabled(false), m_startWall(0), m_startCpu(0) {}
+    PhaseStats(PhaseStats const&);
+    void operator=(PhaseStats const&);
+
+};
+
+/**
+* \class PhaseTimer
+*
+* \brief Scoped timer of a phase, see PhaseStats: the phase runs from the construction to the destruction of the timer. Bytes, traces and elements processed by the phase may be added meanwhile.
+* When PhaseStats is disabled, the timer costs a single check.
+*
+*/
+class PhaseTimer {
+
+public:
+
+    /// Starts the phase 'name', the name must outlive the timer
+    PhaseTimer(const char * name): m_name(name), m_enabled(PhaseStats::get().isEnabled()), m_bytes(0), m_traces(0), m_elements(0), m_wall(0), m_cpu(0) {
+        if(m_enabled){
+            if(PhaseStats::get().countersEnabled()) PhaseStats::get().readCounters(m_counters);
+            m_wall = PhaseStats::wallTime();
+            m_cpu = PhaseStats::cpuTime();
+        }
+    }
+
+    /// Ends the phase
+    ~PhaseTimer(){
+        if(m_enabled){
+
+            const double wall = PhaseStats::wallTime() - m_wall;
+            const double cpu = PhaseStats::cpuTime() - m_cpu;
+
+            if(PhaseStats::get().countersEnabled()){
+                uint64_t counters[PerfCounters::Count];
+                PhaseStats::get().readCounters(counters);
+                for(size_t i = 0; i < PerfCounters::Count; i++) m_counters[i] = counters[i] - m_counters[i];
+                PhaseStats::get().record(m_name, wall, cpu, m_bytes, m_traces, m_elements, m_counters);
+            } else {
+                PhaseStats::get().record(m_name, wall, cpu, m_bytes, m_traces, m_elements, nullptr);
+            }
+
+        }
+    }
+
+    /// Add bytes read, written or processed by the phase
+    void addBytes(uint64_t bytes){ m_bytes += bytes; }
+
+    /// Add power traces processed by the phase
+    void addTraces(uint64_t traces){ m_traces += traces; }
+
+    /// Add elements processed by the phase, e.g. (trace, sample, candidate) cells, for the cycles per element
+    void addElements(uint64_t elements){ m_elements += elements; }
+
+protected:
+
+    const char * m_name;
+    bool m_enabled;
+    uint64_t m_bytes;
+    uint64_t m_traces;
+    uint64_t m_elements;
+    uint64_t m_counters[PerfCounters::Count];
+    double m_wall;
+    double m_cpu;
+
+private:
+
+    PhaseTimer(PhaseTimer const&);
+    void operator=(PhaseTimer const&);
+
+};
+
+/**
+* \class ConcurrentPhase
+*
+* \brief A phase run by several threads at once, e.g. a stage of a pipeline, see PhaseStats. Every thread adds the CPU time of its own runs of the phase (see ConcurrentPhaseTimer),
+* and the phase is recorded once, with the wall time of the whole concurrent run. The hardware performance counters are not recorded, as these count the whole process.
+*
+*/
+class ConcurrentPhase {
+
+public:
+
+    /// Prepares the phase 'name', the name must outlive the phase
+    ConcurrentPhase(const char * name): m_name(name), m_enabled(PhaseStats::get().isEnabled()), m_cpu(0), m_bytes(0), m_traces(0) {}
+
+    /// Whether the phase is being recorded
+    bool isEnabled() const { return m_enabled; }
+
+    /// Adds a run of the phase by a thread, any thread may add
+    void add(double cpu, uint64_t bytes, uint64_t traces){
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_cpu += cpu;
+        m_bytes += bytes;
+        m_traces += traces;
+    }
+
+    /// Records the phase, 'wall' being the wall time of the whole concurrent run
+    void record(double wall){
+        if(m_enabled){
+            std::lock_guard<std::mutex> lock(m_mutex);
+            PhaseStats::get().record(m_name, wall, m_cpu, m_bytes, m_traces, 0, nullptr);
+        }
+    }
+
+protected:
+
+    const char * m_name;
+    bool m_enabled;
+    std::mutex m_mutex;
+    double m_cpu;
+    uint64_t m_bytes;
+    uint64_t m_traces;
+
+private:
+
+    ConcurrentPhase(ConcurrentPhase const&);
+    void operator=(ConcurrentPhase const&);
+
+};
+
+/**
+* \class ConcurrentPhaseTimer
+*
+* \brief Scoped timer of a run of a ConcurrentPhase by the calling thread: the CPU time of the calling thread from the construction to the destruction of the timer is added to the phase,
+* along with the bytes and traces added meanwhile. When PhaseStats is disabled, the timer costs a single check.
+*
+*/
+class ConcurrentPhaseTimer {
+
+public:
+
+    /// Starts a run of the phase
+    ConcurrentPhaseTimer(ConcurrentPhase & phase): m_phase(phase), m_enabled(phase.isEnabled()), m_bytes(0), m_traces(0), m_cpu(0) {
+        if(m_enabled) m_cpu = PhaseStats::threadCpuTime();
+    }
+
+    /// Ends the run of the phase
+    ~ConcurrentPhaseTimer(){
+        if(m_enabled) m_phase.add(PhaseStats::threadCpuTime() - m_cpu, m_bytes, m_traces);
+    }
+
+    /// Add bytes read, written or processed by the run
+    void addBytes(uint64_t bytes){ m_bytes += bytes; }
+
+    /// Add power traces processed by the run
+    void addTraces(uint64_t traces){ m_traces += traces; }
+
+protected:
+
+    ConcurrentPhase & m_phase;
+    bool m_enabled;
+    uint64_t m_bytes;
+    uint64_t m_traces;
+    double m_cpu;
+
+private:
+
+    ConcurrentPhaseTimer(ConcurrentPhaseTimer const&);
+    void operator=(ConcurrentPhaseTimer const&);
+
+};
+
+#endif /* INSTRUMENTATION_HPP */
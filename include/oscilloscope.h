@@ -23,7 +23,7 @@
 *
 *
 * \author Petr Socha
-* \version 1.0
+* \version 1.2
 */
 
 #ifndef OSCILLOSCOPE_H
@@ -99,15 +99,21 @@ public:
     
     /// Returns current samples/captures settings
     virtual size_t getCurrentSetup(size_t & samples, size_t & captures) = 0;
+    /// Returns the number of runs the oscilloscope buffers: when greater than 1, the oscilloscope may be run again (from another thread) before the values of the previous runs are downloaded, getValues then returns the runs in order
+    virtual size_t getBufferedRuns() = 0;
     
     /// Downloads values from the oscilloscope, first waits for the aquisition to complete
     virtual size_t getValues(int channel, PowerTraces<int16_t> & traces) = 0;
     /// Downloads values from the oscilloscope, first waits for the aquisition to complete
     virtual size_t getValues(int channel, int16_t * buffer, size_t len, size_t & samples, size_t & captures) = 0;
+    /// Downloads 8-bit values from the oscilloscope, first waits for the aquisition to complete
+    virtual size_t getValues(int channel, PowerTraces<int8_t> & traces) = 0;
+    /// Downloads 8-bit values from the oscilloscope, first waits for the aquisition to complete
+    virtual size_t getValues(int channel, int8_t * buffer, size_t len, size_t & samples, size_t & captures) = 0;
     
 };        
 
-#define Oscilloscope_iid "cz.cvut.fit.Sicak.OscilloscopeInterface/1.0"
+#define Oscilloscope_iid "cz.cvut.fit.Sicak.OscilloscopeInterface/1.2"
 
 Q_DECLARE_INTERFACE(Oscilloscope, Oscilloscope_iid)
 
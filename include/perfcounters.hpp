@@ -0,0 +1,155 @@
+/*
+*  SICAK - SIde-Channel Analysis toolKit
+*  Copyright (C) 2018-2019 Petr Socha, FIT, CTU in Prague
+*
+*  This program is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation, either version 3 of the License, or
+*  (at your option) any later version.
+*
+*  This program is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/**
+* \file perfcounters.hpp
+*
+* \brief This header file contains hardware performance counters of the process, Linux only
+*
+*
+* \author Petr Socha
+* \version 1.0
+*/
+
+#ifndef PERFCOUNTERS_HPP
+#define PERFCOUNTERS_HPP
+
+#include <cstdint>
+#include <cstring>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+/**
+* \class PerfCounters
+*
+* \brief Hardware performance counters (cycles, instructions, last level cache misses, stalled cycles) of the calling process, using perf_event_open.
+*
+* The counters count the user space of the calling thread and of the threads it creates afterwards, so they are to be opened before any worker threads
+* (e.g. the OpenMP ones) are started. The counters run freely, the events of a piece of code are the difference of two readings. Counters not supported
+* by the CPU or the kernel, or not permitted (see /proc/sys/kernel/perf_event_paranoid), are not available; on other systems than Linux none is.
+* When the CPU has less counters than opened, the kernel multiplexes them and the readings are scaled estimates.
+*
+*/
+class PerfCounters {
+
+public:
+
+    enum Counter {
+        Cycles,
+        Instructions,
+        LlcMisses,
+        StalledCyclesFrontend,
+        StalledCyclesBackend,
+        Count
+    };
+
+    /// Name of the counter, as used in the JSON statistics
+    static const char * name(size_t counter){
+        static const char * names[Count] = { "cycles", "instructions", "llc-misses", "stalled-cycles-frontend", "stalled-cycles-backend" };
+        return names[counter];
+    }
+
+    PerfCounters(){
+        for(size_t i = 0; i < Count; i++) m_fd[i] = -1;
+    }
+
+    ~PerfCounters(){
+        close();
+    }
+
+    /// Opens the counters, returns the number of available counters
+    size_t open(){
+
+        close();
+
+        size_t available = 0;
+
+#ifdef __linux__
+        static const uint64_t configs[Count] = { PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_STALLED_CYCLES_FRONTEND, PERF_COUNT_HW_STALLED_CYCLES_BACKEND };
+
+        for(size_t i = 0; i < Count; i++){
+
+            struct perf_event_attr attr;
+            std::memset(&attr, 0, sizeof(attr));
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.size = sizeof(attr);
+            attr.config = configs[i];
+            attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+            attr.inherit = 1;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+
+            m_fd[i] = (int) syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+            if(m_fd[i] >= 0) available++;
+
+        }
+#endif
+
+        return available;
+
+    }
+
+    /// Closes the counters
+    void close(){
+        for(size_t i = 0; i < Count; i++){
+#ifdef __linux__
+            if(m_fd[i] >= 0) ::close(m_fd[i]);
+#endif
+            m_fd[i] = -1;
+        }
+    }
+
+    /// Whether the counter is available
+    bool isAvailable(size_t counter) const {
+        return m_fd[counter] >= 0;
+    }
+
+    /// Reads the events counted so far into values[Count], zero for the counters not available
+    void read(uint64_t * values) const {
+
+        for(size_t i = 0; i < Count; i++){
+
+            values[i] = 0;
+
+#ifdef __linux__
+            // value, time enabled, time running
+            uint64_t data[3];
+            if(m_fd[i] < 0 || ::read(m_fd[i], data, sizeof(data)) != (ssize_t) sizeof(data)) continue;
+            values[i] = (data[2] && data[2] < data[1]) ? (uint64_t) ((double) data[0] * data[1] / data[2]) : data[0];
+#endif
+
+        }
+
+    }
+
+protected:
+
+    int m_fd[Count];
+
+private:
+
+    PerfCounters(PerfCounters const&);
+    void operator=(PerfCounters const&);
+
+};
+
+#endif /* PERFCOUNTERS_HPP */
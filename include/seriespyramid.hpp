@@ -0,0 +1,404 @@
+/*
+*  SICAK - SIde-Channel Analysis toolKit
+*  Copyright (C) 2018-2019 Petr Socha, FIT, CTU in Prague
+*
+*  This program is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation, either version 3 of the License, or
+*  (at your option) any later version.
+*
+*  This program is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/**
+* \file seriespyramid.hpp
+*
+* \brief This header file contains a multi-resolution min/max pyramid of series (power traces, correlation traces, t-values), stored in a sidecar file
+*
+* Pyramid layout: 256 byte ID signature, followed by 4 uint64 attributes (samples per series, number of series, samples per bucket
+* of the finest level, number of levels). Then the levels of every series follow, series after series, the finest level first.
+* A bucket of level l summarizes 'samples per bucket' * 2^l consecutive samples by their minimum, maximum and mean (3 floats),
+* the last bucket of a level may be shorter. The coarsest level has a single bucket.
+*
+* The pyramid of a series of S samples takes about 2 * 12 * S / 'samples per bucket' bytes, any range of the series is summarized
+* into P buckets by reading about P buckets of the pyramid, regardless of the length of the series.
+*
+*
+* \author Petr Socha
+* \version 1.0
+*/
+
+#ifndef SERIESPYRAMID_HPP
+#define SERIESPYRAMID_HPP
+
+#include <fstream>
+#include <vector>
+#include <future>
+#include <thread>
+#include <limits>
+#include <cstring>
+#include <cstdint>
+#include "exceptions.hpp"
+
+/// ID signature of the series pyramid
+#define SERIES_PYRAMID_ID "cz.cvut.fit.Sicak.SeriesPyramid/1.0"
+/// Size of the series pyramid header in bytes
+#define SERIES_PYRAMID_HEADER (256 + 4 * 8)
+/// Default number of samples per bucket of the finest level
+#define SERIES_PYRAMID_BUCKET 64
+
+/**
+* \brief A bucket of the series pyramid: minimum, maximum and mean of the samples. NaN samples are skipped by the minimum and the maximum, and make the mean NaN
+* \ingroup SicakData
+*/
+struct SeriesPyramidBucket {
+    float min;
+    float max;
+    float mean;
+};
+
+static_assert(sizeof(SeriesPyramidBucket) == 3 * sizeof(float), "Series pyramid buckets must be packed");
+
+/**
+*
+* \brief Returns the number of buckets of every level of the pyramid of a series of 'samplesPerSeries' samples, the finest level first
+* \ingroup SicakData
+*
+*/
+inline std::vector<size_t> seriesPyramidLevels(size_t samplesPerSeries, size_t bucketSamples){
+
+    std::vector<size_t> levels;
+    size_t buckets = (samplesPerSeries + bucketSamples - 1) / bucketSamples;
+
+    levels.push_back(buckets);
+
+    while(buckets > 1){
+        buckets = (buckets + 1) / 2;
+        levels.push_back(buckets);
+    }
+
+    return levels;
+
+}
+
+/// Finds the minimum and the maximum of 'len' values, in 8 independent lanes, so that it gets vectorized. NaNs are skipped, NaNs only give an infinite minimum above an infinite maximum
+template <class T>
+inline void minMaxOfRange(const T * values, size_t len, float & min, float & max) {
+
+    const float inf = std::numeric_limits<float>::infinity();
+    float mins[8] = { inf, inf, inf, inf, inf, inf, inf, inf };
+    float maxs[8] = { -inf, -inf, -inf, -inf, -inf, -inf, -inf, -inf };
+    size_t i = 0;
+
+    for(; i + 8 <= len; i += 8){
+        for(size_t l = 0; l < 8; l++){
+            const float v = (float) values[i + l];
+            mins[l] = (v < mins[l]) ? v : mins[l];
+            maxs[l] = (v > maxs[l]) ? v : maxs[l];
+        }
+    }
+
+    for(; i < len; i++){
+        const float v = (float) values[i];
+        mins[0] = (v < mins[0]) ? v : mins[0];
+        maxs[0] = (v > maxs[0]) ? v : maxs[0];
+    }
+
+    min = mins[0];
+    max = maxs[0];
+
+    for(size_t l = 1; l < 8; l++){
+        min = (mins[l] < min) ? mins[l] : min;
+        max = (maxs[l] > max) ? maxs[l] : max;
+    }
+
+}
+
+/**
+* \class SeriesPyramidWriter
+* \ingroup SicakData
+*
+* \brief A class writing the pyramid of series into a file. Pyramids of the series are computed in parallel.
+*
+*/
+template <class T>
+class SeriesPyramidWriter {
+
+public:
+
+    /// Starts a new pyramid at the current position of the output filestream 'fs'
+    SeriesPyramidWriter(std::fstream & fs, size_t samplesPerSeries, size_t bucketSamples = SERIES_PYRAMID_BUCKET) : m_fs(fs), m_samplesPerSeries(samplesPerSeries), m_bucketSamples(bucketSamples), m_noOfSeries(0), m_closed(false) {
+
+        if(!samplesPerSeries || !bucketSamples) throw InvalidInputException("Series pyramid needs non-zero number of samples per series and samples per bucket");
+
+        m_levels = seriesPyramidLevels(m_samplesPerSeries, m_bucketSamples);
+
+        m_bucketsPerSeries = 0;
+        for(size_t level = 0; level < m_levels.size(); level++) m_bucketsPerSeries += m_levels[level];
+
+        m_threads = std::thread::hardware_concurrency();
+        if(!m_threads) m_threads = 1;
+
+        m_start = m_fs.tellp();
+        writeHeader();
+
+    }
+
+    /// Finishes the pyramid, unless closed already
+    ~SeriesPyramidWriter() {
+        try {
+            close();
+        } catch (std::exception & e) {
+            (void)e;
+        }
+    }
+
+    /// Appends the pyramids of 'noOfSeries' series, 'samplesPerSeries' samples each
+    void writeSeries(const T * series, size_t noOfSeries){
+
+        if(m_closed) throw RuntimeException("Series pyramid was already closed");
+        if(!noOfSeries) return;
+
+        m_buckets.resize(noOfSeries * m_bucketsPerSeries);
+
+        std::vector<std::future<void>> workers;
+
+        for(size_t t = 0; t < m_threads && t < noOfSeries; t++){
+            workers.push_back(std::async(std::launch::async, [&, t](){
+                for(size_t s = t; s < noOfSeries; s += m_threads){
+                    buildSeries(series + s * m_samplesPerSeries, m_buckets.data() + s * m_bucketsPerSeries);
+                }
+            }));
+        }
+
+        for(auto & worker : workers) worker.get();
+
+        m_fs.write(reinterpret_cast<const char *>(m_buckets.data()), m_buckets.size() * sizeof(SeriesPyramidBucket));
+
+        if(m_fs.fail()) throw RuntimeException("Could not write the series pyramid. Not enough space?");
+
+        m_noOfSeries += noOfSeries;
+
+    }
+
+    /// Updates the pyramid header with the number of series written
+    void close(){
+
+        if(m_closed) return;
+        m_closed = true;
+
+        writeHeader();
+
+    }
+
+    /// Returns the number of series written so far
+    size_t noOfSeries() const { return m_noOfSeries; }
+
+protected:
+
+    void writeHeader(){
+
+        std::streampos pos = m_fs.tellp();
+        m_fs.seekp(m_start);
+
+        char id[256] = {0};
+        std::strncpy(id, SERIES_PYRAMID_ID, 255);
+        m_fs.write(id, 256);
+
+        uint64_t attrs[4] = { m_samplesPerSeries, m_noOfSeries, m_bucketSamples, m_levels.size() };
+        m_fs.write(reinterpret_cast<const char *>(attrs), sizeof(attrs));
+
+        if(pos > m_start) m_fs.seekp(pos);
+
+        if(m_fs.fail()) throw RuntimeException("Could not write the series pyramid header. Not enough space?");
+
+    }
+
+    /// Computes all the levels of a series: the finest one from the samples, the sums in 8 independent lanes so that they get vectorized, the others from the finer ones
+    void buildSeries(const T * samples, SeriesPyramidBucket * out) const {
+
+        const size_t len = m_samplesPerSeries;
+
+        for(size_t bucket = 0; bucket < m_levels[0]; bucket++){
+
+            const size_t first = bucket * m_bucketSamples;
+            const size_t n = (len - first < m_bucketSamples) ? len - first : m_bucketSamples;
+            const T * x = samples + first;
+
+            minMaxOfRange(x, n, out[bucket].min, out[bucket].max);
+
+            double sums[8] = { 0, 0, 0, 0, 0, 0, 0, 0 };
+            size_t i = 0;
+
+            for(; i + 8 <= n; i += 8){
+                for(size_t l = 0; l < 8; l++) sums[l] += (double) x[i + l];
+            }
+
+            for(; i < n; i++) sums[0] += (double) x[i];
+
+            for(size_t l = 1; l < 8; l++) sums[0] += sums[l];
+
+            out[bucket].mean = (float) (sums[0] / n);
+
+        }
+
+        // Every bucket merges two buckets of the finer level, the mean is weighted by the number of samples
+        const SeriesPyramidBucket * finer = out;
+        SeriesPyramidBucket * coarser = out + m_levels[0];
+        size_t finerSamples = m_bucketSamples;
+
+        for(size_t level = 1; level < m_levels.size(); level++){
+
+            for(size_t bucket = 0; bucket < m_levels[level]; bucket++){
+
+                const SeriesPyramidBucket & a = finer[2 * bucket];
+
+                if(2 * bucket + 1 >= m_levels[level - 1]){
+                    coarser[bucket] = a;
+                    continue;
+                }
+
+                const SeriesPyramidBucket & b = finer[2 * bucket + 1];
+                const size_t bFirst = (2 * bucket + 1) * finerSamples;
+                const double bSamples = (double) ((len - bFirst < finerSamples) ? len - bFirst : finerSamples);
+
+                coarser[bucket].min = (b.min < a.min) ? b.min : a.min;
+                coarser[bucket].max = (b.max > a.max) ? b.max : a.max;
+                coarser[bucket].mean = (float) ((a.mean * (double) finerSamples + b.mean * bSamples) / (finerSamples + bSamples));
+
+            }
+
+            finer = coarser;
+            coarser += m_levels[level];
+            finerSamples *= 2;
+
+        }
+
+    }
+
+    std::fstream & m_fs;
+    std::streampos m_start;
+    size_t m_samplesPerSeries;
+    size_t m_bucketSamples;
+    size_t m_noOfSeries;
+    size_t m_threads;
+    /// Number of buckets of every level
+    std::vector<size_t> m_levels;
+    size_t m_bucketsPerSeries;
+    std::vector<SeriesPyramidBucket> m_buckets;
+    bool m_closed;
+
+};
+
+/**
+* \class SeriesPyramid
+* \ingroup SicakData
+*
+* \brief A class accessing the series pyramid in memory, e.g. in a memory-mapped sidecar file. The memory is not owned by the class.
+*
+*/
+class SeriesPyramid {
+
+public:
+
+    /// Accesses the pyramid of 'size' bytes at 'data', throws when it is not a valid pyramid
+    SeriesPyramid(const void * data, size_t size) {
+
+        const char * bytes = reinterpret_cast<const char *>(data);
+
+        if(size < SERIES_PYRAMID_HEADER || std::strncmp(bytes, SERIES_PYRAMID_ID, 256)) throw RuntimeException("Not a series pyramid");
+
+        uint64_t attrs[4];
+        std::memcpy(attrs, bytes + 256, sizeof(attrs));
+
+        m_samplesPerSeries = attrs[0];
+        m_noOfSeries = attrs[1];
+        m_bucketSamples = attrs[2];
+
+        if(!m_samplesPerSeries || !m_bucketSamples) throw RuntimeException("Invalid series pyramid");
+
+        m_levels = seriesPyramidLevels(m_samplesPerSeries, m_bucketSamples);
+        if(m_levels.size() != attrs[3]) throw RuntimeException("Invalid series pyramid");
+
+        m_bucketsPerSeries = 0;
+        for(size_t level = 0; level < m_levels.size(); level++){
+            m_levelOffsets.push_back(m_bucketsPerSeries);
+            m_bucketsPerSeries += m_levels[level];
+        }
+
+        if((size - SERIES_PYRAMID_HEADER) / sizeof(SeriesPyramidBucket) / m_bucketsPerSeries < m_noOfSeries) throw RuntimeException("Series pyramid is truncated");
+
+        m_buckets = reinterpret_cast<const SeriesPyramidBucket *>(bytes + SERIES_PYRAMID_HEADER);
+
+    }
+
+    /// Returns the number of samples per series
+    size_t samplesPerSeries() const { return m_samplesPerSeries; }
+    /// Returns the number of series
+    size_t noOfSeries() const { return m_noOfSeries; }
+    /// Returns the number of levels
+    size_t levels() const { return m_levels.size(); }
+    /// Returns the number of samples summarized by a bucket of the level (the last bucket of the level may summarize less)
+    size_t bucketSamples(size_t level) const { return m_bucketSamples << level; }
+    /// Returns the number of buckets of the level
+    size_t buckets(size_t level) const { return m_levels[level]; }
+
+    /// Returns the buckets of the level of the series
+    const SeriesPyramidBucket * level(size_t series, size_t level) const {
+        return m_buckets + series * m_bucketsPerSeries + m_levelOffsets[level];
+    }
+
+    /// Returns the coarsest level having buckets of at most 'samples' samples, the finest level when its buckets are larger
+    size_t levelOf(size_t samples) const {
+        size_t level = 0;
+        while(level + 1 < m_levels.size() && bucketSamples(level + 1) <= samples) level++;
+        return level;
+    }
+
+    /// Finds the minimum and the maximum of the samples [first..last) of the series, first < last, from the buckets of the level covering them. NaNs only give an infinite minimum above an infinite maximum
+    void minMax(size_t series, size_t level, size_t first, size_t last, float & min, float & max) const {
+
+        const SeriesPyramidBucket * summaries = (*this).level(series, level);
+        const size_t summarySamples = bucketSamples(level);
+        const size_t lastSummary = buckets(level) - 1;
+
+        size_t from = first / summarySamples;
+        size_t to = (last - 1) / summarySamples;
+        if(from > lastSummary) from = lastSummary;
+        if(to > lastSummary) to = lastSummary;
+
+        min = summaries[from].min;
+        max = summaries[from].max;
+
+        for(size_t i = from + 1; i <= to; i++){
+            min = (summaries[i].min < min) ? summaries[i].min : min;
+            max = (summaries[i].max > max) ? summaries[i].max : max;
+        }
+
+    }
+
+    /// Returns the single bucket of the coarsest level of the series, i.e. the minimum, the maximum and the mean of the whole series
+    const SeriesPyramidBucket & summary(size_t series) const {
+        return level(series, m_levels.size() - 1)[0];
+    }
+
+protected:
+
+    size_t m_samplesPerSeries;
+    size_t m_noOfSeries;
+    size_t m_bucketSamples;
+    /// Number of buckets of every level, and where the levels start within a series
+    std::vector<size_t> m_levels;
+    std::vector<size_t> m_levelOffsets;
+    size_t m_bucketsPerSeries;
+    const SeriesPyramidBucket * m_buckets;
+
+};
+
+#endif /* SERIESPYRAMID_HPP */
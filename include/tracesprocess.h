@@ -23,7 +23,7 @@
 *
 *
 * \author Petr Socha
-* \version 1.0
+* \version 1.2
 */
 
 #ifndef TRACESPROCESS_H
@@ -57,10 +57,23 @@ public:
     
     /// Process data and create/save related output files
     virtual void processTraces(PowerTraces<int16_t> & traces, const char * id) = 0;    
+    /// Process 8-bit data and create/save related output files
+    virtual void processTraces(PowerTraces<int8_t> & traces, const char * id) = 0;    
+    
+    /// Prepare for processing 'noOfTraces' power traces chunk by chunk, e.g. as a stage of a pipeline, returns the number of samples per trace of the processed power traces
+    virtual size_t startStream(size_t samplesPerTrace, size_t noOfTraces) = 0;
+    /// Returns true when the chunks may be processed concurrently, in any order; the first chunk is always processed before the others, though
+    virtual bool isStateless() = 0;
+    /// Process a chunk of power traces, starting with the firstTrace-th power trace, into 'out', which is already initialized to the chunk's size
+    virtual void processChunk(PowerTraces<int16_t> & in, PowerTraces<int16_t> & out, size_t firstTrace) = 0;
+    /// Process a chunk of 8-bit power traces, starting with the firstTrace-th power trace, into 'out', which is already initialized to the chunk's size
+    virtual void processChunk(PowerTraces<int8_t> & in, PowerTraces<int8_t> & out, size_t firstTrace) = 0;
+    /// Finish processing the chunks, e.g. print a summary
+    virtual void finishStream() = 0;
     
 };        
 
-#define TracesProcess_iid "cz.cvut.fit.Sicak.TracesProcessInterface/1.0"
+#define TracesProcess_iid "cz.cvut.fit.Sicak.TracesProcessInterface/1.2"
 
 Q_DECLARE_INTERFACE(TracesProcess, TracesProcess_iid)
 
@@ -23,7 +23,7 @@
 *
 *
 * \author Petr Socha
-* \version 1.1
+* \version 1.2
 */
 
 #ifndef TTESTENGINE_H
@@ -61,13 +61,15 @@ public:
         
     /// Create a t-test computation context based on given random and constant power traces
     virtual Moments2DContext<double> createContext(const PowerTraces<int16_t> & randTraces, const PowerTraces<int16_t> & constTraces) = 0;    
+    /// Create a t-test computation context based on given 8-bit random and constant power traces
+    virtual Moments2DContext<double> createContext(const PowerTraces<int8_t> & randTraces, const PowerTraces<int8_t> & constTraces) = 0;    
     /// Merge the two t-test contexts, stores the result in the first of the contexts
     virtual void mergeContexts(Moments2DContext<double> & firstAndOut, const Moments2DContext<double> & second) = 0;
     /// Compute t-values (stored in first row) and degrees of freedom (second row) based on the given context
     virtual Matrix<double> finalizeContext(const Moments2DContext<double> & context) = 0;
 };        
 
-#define TTestEngine_iid "cz.cvut.fit.Sicak.TTestInterface/1.1"
+#define TTestEngine_iid "cz.cvut.fit.Sicak.TTestInterface/1.2"
 
 Q_DECLARE_INTERFACE(TTestEngine, TTestEngine_iid)
 
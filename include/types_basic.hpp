@@ -238,11 +238,17 @@ public:
         }
 
         /// Move constructor
-        Vector(Vector&& other) : m_data(std::move(other.m_data)), m_length(other.m_length) {  }
+        Vector(Vector&& other) : m_data(std::move(other.m_data)), m_length(other.m_length), m_capacity(other.m_capacity) {
+                other.m_length = 0;
+                other.m_capacity = 0;
+        }
         /// Move assignment operator
         Vector& operator=(Vector&& other) {
                 m_data = std::move(other.m_data);
                 m_length = other.m_length;
+                m_capacity = other.m_capacity;
+                other.m_length = 0;
+                other.m_capacity = 0;
                 return (*this);
         }
 
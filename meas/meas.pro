@@ -6,6 +6,11 @@ INCLUDEPATH    += ./include
 CONFIG += console
 QT -= gui
 
+# peak memory of the per-phase statistics (instrumentation.hpp)
+win32 {
+    LIBS += -lpsapi
+}
+
 HEADERS += include/meas.h
 SOURCES    = src/main.cpp \
              src/meas.cpp
@@ -31,6 +31,7 @@
 #include <QCommandLineParser>
 #include <QtCore>
 #include "meas.h"
+#include "instrumentation.hpp"
 
 #include <random>
 
@@ -51,10 +52,13 @@ int main(int argv, char *args[])
     QObject::connect(meas, SIGNAL(finished()), &app, SLOT(quit()));
      
     switch(meas->parseCommandLineParams(parser)) {
-        case Meas::CommandLineTaskPlanned:
+        case Meas::CommandLineTaskPlanned: {
             cout << qPrintable(QCoreApplication::applicationName()) << " " << qPrintable(QCoreApplication::applicationVersion()) << "\n";
             cout.flush();                      
-            return app.exec();                  
+            const int result = app.exec();
+            PhaseStats::get().saveAndReport();
+            return result;
+        }
         case Meas::CommandLineError:
             cerr << "Error parsing command line options.\n";
             return 1;
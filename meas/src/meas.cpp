@@ -42,6 +42,7 @@
 #include "oscilloscope.h"
 #include "chardevice.h"
 #include "configloader.hpp"
+#include "instrumentation.hpp"
 #include "meas.h"
 
 
@@ -86,6 +87,9 @@ Meas::CommandLineParseResult Meas::parseCommandLineParams(QCommandLineParser & p
     const QCommandLineOption paramOption("param", "Optional measurement plug-in module parameters. Module specific option.", "param");
     parser.addOption(paramOption);
         
+    const QCommandLineOption statsJsonOption("stats-json", "Save the per-phase statistics of the run (wall and CPU time, bytes, traces and peak memory of e.g. reading the files or running the plug-in module) into a JSON file.", "filepath");
+    parser.addOption(statsJsonOption);
+        
     parser.addPositionalArgument("config", "JSON configuration file(s).");
     
     const QCommandLineOption helpOption = parser.addHelpOption();
@@ -100,6 +104,10 @@ Meas::CommandLineParseResult Meas::parseCommandLineParams(QCommandLineParser & p
     
     ConfigLoader cfg(parser);                
     
+    if(cfg.isSet(statsJsonOption)){
+        PhaseStats::get().enable(cfg.getParam(statsJsonOption));
+    }
+    
     m_id = (cfg.isSet(idOption)) ? (cfg.getParam(idOption)) : ((QDateTime::currentDateTime()).toString("ddMMyy-HHmmss"));
     m_param = (cfg.isSet(paramOption)) ? (cfg.getParam(paramOption)) : "";
     
@@ -812,6 +820,7 @@ void Meas::run(){
     
     try {
         
+        PhaseTimer timer("init-module");
         ba = m_param.toLocal8Bit();
         m_measurement->init(ba.data());
         
@@ -829,6 +838,7 @@ void Meas::run(){
         cout << "* Oscilloscope module loaded: '" << m_oscilloscope->getPluginName() << "'\n";
         cout.flush();
         
+        PhaseTimer timer("init-oscilloscope");
         if(!initConfigOscilloscope()){
             cerr << "Failed to initialize and configure the oscilloscope.\n";
             emit finished();
@@ -850,6 +860,7 @@ void Meas::run(){
         cout << "* Character device module loaded: '" << m_chardevice->getPluginName() << "'\n";
         cout.flush();
         
+        PhaseTimer timer("init-chardevice");
         if(!initConfigChardevice()){
             cerr << "Failed to initialize and configure the character device.\n";
             emit finished();
@@ -872,9 +883,19 @@ void Meas::run(){
     cout.flush();
     try {
         
+        PhaseTimer timer("measure");
+        timer.addTraces(m_measurementsN);
         QByteArray ba = m_id.toLocal8Bit();
         m_measurement->run(ba.data(), m_measurementsN, m_oscilloscope, m_chardevice);
         
+        if(m_chardevice != nullptr){
+            QString stats = m_chardevice->getStatistics();
+            if(stats.size()){
+                cout << "* Character device statistics:\n" << stats;
+                cout.flush();
+            }
+        }
+        
     } catch(std::exception & e) {
         cerr << "\nFailed to run the measurement scenario: " << e.what() << "\n";
         emit finished();
@@ -1,3 +1,13 @@
 TEMPLATE    = subdirs
 SUBDIRS     += serialport \
-               smartcard
+               smartcard \
+               simtarget
+
+#
+# Pseudo-terminal test of the serial port plug-in, run by make check
+#
+
+unix {
+    SUBDIRS     += serialporttest
+    serialporttest.file = serialport/test/serialporttest.pro
+}
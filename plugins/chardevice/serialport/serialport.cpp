@@ -23,12 +23,12 @@
 *
 *
 * \author Petr Socha
-* \version 1.0
+* \version 1.1
 */
 
 #include "serialport.h"
 
-SerialPort::SerialPort(): m_opened(false) {
+SerialPort::SerialPort(): m_opened(false), m_timeout(5000), m_transactions(0), m_timeouts(0), m_latencySum(0), m_latencyMin(0), m_latencyMax(0), m_sendPending(false) {
     
 }
 
@@ -47,15 +47,40 @@ QString SerialPort::getPluginName() {
 }
 
 QString SerialPort::getPluginInfo() {
-    return "On Win32, open e.g. with \"\\\\.\\COM10\", on POSIX, open e.g. with \"/dev/ttyUSB0\".";
+    return "On Win32, open e.g. with \"\\\\.\\COM10\", on POSIX, open e.g. with \"/dev/ttyUSB0\". On Linux, append \";low-latency=1\" to ask the driver for low latency mode.";
 }
 
 void SerialPort::init(const char * filename, int baudrate, int parity, int stopBits) {    
     
+    // The port may be followed by parameters, e.g. "/dev/ttyUSB0;low-latency=1"
+    QStringList params = QString(filename).split(";");
+    QByteArray port = params.at(0).toLocal8Bit();
+    QString paramVal;
+    bool lowLatency = false;
+    
+    for (int i = 1; i < params.size(); ++i){ // iterate thru the parameters
+        
+        if(params.at(i).startsWith("low-latency=")){
+            
+            paramVal = params.at(i);
+            paramVal.remove(0,12);
+            
+            if(paramVal == "1") lowLatency = true;
+            else if(paramVal == "0") lowLatency = false;
+            else throw InvalidInputException("Invalid low-latency param, use either 0 or 1");
+            
+        } else if(params.at(i).size()) {
+            
+            throw InvalidInputException("Unknown serial port param");
+            
+        }
+        
+    }
+    
     // Opening the port
     #ifdef _WIN32
 
-    m_osHandle = CreateFileA(filename, GENERIC_READ | GENERIC_WRITE, 0, NULL, OPEN_EXISTING, 0, NULL);
+    m_osHandle = CreateFileA(port.constData(), GENERIC_READ | GENERIC_WRITE, 0, NULL, OPEN_EXISTING, 0, NULL);
 
     if (m_osHandle == INVALID_HANDLE_VALUE) {
         //CloseHandle(m_osHandle);
@@ -64,7 +89,7 @@ void SerialPort::init(const char * filename, int baudrate, int parity, int stopB
 
     #else	
 
-    m_osHandle = open(filename, O_RDWR | O_NOCTTY | O_NDELAY | O_NONBLOCK);
+    m_osHandle = open(port.constData(), O_RDWR | O_NOCTTY | O_NDELAY | O_NONBLOCK);
 
     if(m_osHandle < 0)
         throw InvalidInputException("Could not open the specified serial port", m_osHandle);
@@ -74,9 +99,10 @@ void SerialPort::init(const char * filename, int baudrate, int parity, int stopB
         throw InvalidInputException("Specified filename is not a serial port");
     }
 
-    if(fcntl(m_osHandle, F_SETFL, 0) < 0){
+    // Keep the port non-blocking, send and receive wait for the port using poll
+    if(fcntl(m_osHandle, F_SETFL, O_NONBLOCK) < 0){
         close(m_osHandle);
-        throw RuntimeException("Could not reset the serial port flags");
+        throw RuntimeException("Could not set the serial port flags");
     }
 
     #endif
@@ -263,14 +289,41 @@ void SerialPort::init(const char * filename, int baudrate, int parity, int stopB
     #endif                
     serialParams.c_oflag &= ~OPOST; // only raw output                                 
 
+    // read returns immediately, timeouts are handled by poll
+    serialParams.c_cc[VTIME] = 0;
+    serialParams.c_cc[VMIN] = 0;
+
     status = tcflush(m_osHandle, TCIFLUSH);
     if(status) throw RuntimeException("Could not flush the serial port", status);
 
     status = tcsetattr(m_osHandle, TCSANOW, &serialParams);
     if(status) throw RuntimeException("Could not set serial port parameters", status);	
 
+    #ifdef __linux__
+
+    // On request, ask the driver for low latency (e.g. USB-serial converters otherwise hold the received data for several ms),
+    // not supported by all the drivers (e.g. pseudo-terminals), so failing is fine
+    struct serial_struct serialInfo;
+    if(lowLatency && ioctl(m_osHandle, TIOCGSERIAL, &serialInfo) == 0){
+        serialInfo.flags |= ASYNC_LOW_LATENCY;
+        ioctl(m_osHandle, TIOCSSERIAL, &serialInfo);
+    }
+
+    #else
+
+    (void)lowLatency; // Linux only
+
+    #endif
+
     #endif
     
+    m_transactions = 0;
+    m_timeouts = 0;
+    m_latencySum = 0;
+    m_latencyMin = 0;
+    m_latencyMax = 0;
+    m_sendPending = false;
+    
     (*this).setTimeout();    
 }
 
@@ -311,6 +364,8 @@ void SerialPort::setTimeout(int ms) {
     
     if(!m_opened) throw RuntimeException("The serial port needs to be properly initialized first");
     
+    m_timeout = (ms > 0) ? ms : 0;
+    
     #ifdef _WIN32
 
     BOOL status;
@@ -330,25 +385,11 @@ void SerialPort::setTimeout(int ms) {
 
     #else	
 
-    int status;
-
-    struct termios serialParams;
-
-    status = tcgetattr(m_osHandle, &serialParams);
-    if(status) throw RuntimeException("Could not get serial port parameters in order to set a timeout", status);  
-
-    cc_t ds = ms / 100; // POSIX timeouted read takes deciseconds
-    if( ( ms % 100 ) >= 50 || (ds == 0 && ms > 0) ) ds++; // round up; or set the lowest timeout possible if asking for less, unless setting no timeout at all                 
-
-    serialParams.c_cc[VTIME] = ds;
-    serialParams.c_cc[VMIN] = 0;
+    // The timeout is a deadline of every send/receive call, waited for using poll
 
-    status = tcflush(m_osHandle, TCIFLUSH);
+    int status = tcflush(m_osHandle, TCIFLUSH);
     if(status) throw RuntimeException("Could not flush the serial port while setting the timeout", status);
 
-    status = tcsetattr(m_osHandle, TCSANOW, &serialParams);
-    if(status) throw RuntimeException("Could not set serial port timeout", status);
-
     #endif
         
 }
@@ -365,18 +406,48 @@ size_t SerialPort::send(const uint8_t * buffer, size_t len) {
     status = WriteFile(m_osHandle, buffer, len, &bytesWritten, NULL);		
     if (!status) throw RuntimeException("Write to the serial port failed");
     
-    if(len != bytesWritten) throw RuntimeException("Serial port write timeout.");
+    if(len != bytesWritten) {
+        m_timeouts++;
+        throw RuntimeException("Serial port write timeout.");
+    }
+
+    m_lastSend = std::chrono::steady_clock::now();
+    m_sendPending = true;
 
     return (size_t) bytesWritten;
 
     #else	
 
-    ssize_t bytesWritten = write(m_osHandle, (const void *) buffer, len);                
-    if(bytesWritten < 0) throw RuntimeException("Write to the serial port failed", bytesWritten);
+    std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(m_timeout);
+    size_t bytesWritten = 0;
 
-    if(len != bytesWritten) throw RuntimeException("Serial port write timeout.");
+    while(bytesWritten < len){
+
+        // write may write just a part of the data, e.g. when sending a large batch of data at once; hence the loop
+
+        ssize_t writeRet = write(m_osHandle, (const void *)(buffer + bytesWritten), len - bytesWritten);
+
+        if(writeRet > 0) {
+
+            bytesWritten += writeRet;
+
+        } else if(writeRet < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+
+            throw RuntimeException("Write to the serial port failed", errno);
+
+        } else if(!(*this).waitFor(POLLOUT, deadline)) { // output buffer is full, wait for the room
+
+            m_timeouts++;
+            throw RuntimeException("Serial port write timeout.");
+
+        }
+
+    }
+
+    m_lastSend = std::chrono::steady_clock::now();
+    m_sendPending = true;
     
-    return (size_t) bytesWritten;
+    return bytesWritten;
 
     #endif
     
@@ -402,6 +473,7 @@ size_t SerialPort::receive(uint8_t * buffer, size_t len) {
     
     #ifdef _WIN32
 
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
     DWORD bytesRead = 0;
     BOOL status;
 
@@ -411,36 +483,45 @@ size_t SerialPort::receive(uint8_t * buffer, size_t len) {
     status = ReadFile(m_osHandle, buffer, len, &bytesRead, NULL);
     if (!status) throw RuntimeException("Read from the serial port failed");
 
-    if(len != bytesRead) throw RuntimeException("Serial port read timeout.");
+    if(len != bytesRead) {
+        m_timeouts++;
+        throw RuntimeException("Serial port read timeout.");
+    }
+    
+    (*this).recordTransaction(start);
     
     return (size_t) bytesRead;
 
     #else	
 
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::chrono::steady_clock::time_point deadline = start + std::chrono::milliseconds(m_timeout);
     size_t bytesRead = 0;
-    ssize_t readRet = 1; // set to allow the loop to start
 
-    while(bytesRead < len && readRet > 0){
+    while(bytesRead < len){
 
-        // read returns either when any data is available, or when the timeout expires
-        // (read may return immediately with a single byte of data available, wont wait for the rest of the requested data; hence the loop)
-        // (actually, it might wait, it is really implementation dependent; prefer a posix compliant way)
+        // read returns immediately with the data available so far, possibly none; the data are accumulated in the buffer until the deadline
 
-        readRet = read(m_osHandle, (void *)(buffer + bytesRead), len - bytesRead);
+        ssize_t readRet = read(m_osHandle, (void *)(buffer + bytesRead), len - bytesRead);
 
-        if(readRet < 0) {
+        if(readRet > 0) {
 
-            throw RuntimeException("Read from the serial port failed", readRet);
+            bytesRead += readRet;
 
-        } else {
+        } else if(readRet < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
 
-            bytesRead += readRet;
+            throw RuntimeException("Read from the serial port failed", errno);
+
+        } else if(!(*this).waitFor(POLLIN, deadline)) { // no data available, wait for them
+
+            m_timeouts++;
+            throw RuntimeException("Serial port read timeout.");
 
-        }                    
+        }
 
     }
 
-    if(len != bytesRead) throw RuntimeException("Serial port read timeout.");
+    (*this).recordTransaction(start);
     
     return bytesRead;                
 
@@ -462,3 +543,63 @@ size_t SerialPort::receive(VectorType<uint8_t> & data) {
     
 }
 
+QString SerialPort::getStatistics() {
+    
+    if(!m_transactions && !m_timeouts) return "";
+    
+    double latencyAvg = m_transactions ? (m_latencySum / m_transactions) : 0;
+    
+    return QString("    * Transactions: %1, latency min/avg/max: %2/%3/%4 ms, timeouts: %5\n").arg(m_transactions).arg(m_latencyMin / 1000, 0, 'f', 3).arg(latencyAvg / 1000, 0, 'f', 3).arg(m_latencyMax / 1000, 0, 'f', 3).arg(m_timeouts);
+    
+}
+
+void SerialPort::recordTransaction(std::chrono::steady_clock::time_point start) {
+    
+    // The transaction starts with the last send, if any, otherwise with the receive itself
+    if(m_sendPending) start = m_lastSend;
+    m_sendPending = false;
+    
+    double latency = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+    
+    if(!m_transactions || latency < m_latencyMin) m_latencyMin = latency;
+    if(!m_transactions || latency > m_latencyMax) m_latencyMax = latency;
+    m_latencySum += latency;
+    m_transactions++;
+    
+}
+
+#ifndef _WIN32
+
+bool SerialPort::waitFor(short events, std::chrono::steady_clock::time_point deadline) {
+    
+    struct pollfd pfd;
+    pfd.fd = m_osHandle;
+    pfd.events = events;
+    
+    for(;;){
+        
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        if(now >= deadline) return false;
+        
+        // Round up, so that poll does not return just before the deadline
+        int remaining = (int) std::chrono::duration_cast<std::chrono::milliseconds>(deadline - now + std::chrono::microseconds(999)).count();
+        
+        pfd.revents = 0;
+        int ret = poll(&pfd, 1, remaining);
+        
+        if(ret < 0){
+            if(errno == EINTR) continue;
+            throw RuntimeException("Waiting for the serial port failed", errno);
+        }
+        
+        if(ret == 0) continue; // deadline check above
+        
+        if(pfd.revents & events) return true;
+        
+        if(pfd.revents & (POLLERR | POLLHUP | POLLNVAL)) throw RuntimeException("Serial port disconnected or failed");
+        
+    }
+    
+}
+
+#endif
@@ -30,7 +30,9 @@
 #define SERIALPORT_H 
 
 #include <QObject>
+#include <QStringList>
 #include <QtPlugin>
+#include <chrono>
 #include "chardevice.h"
 #include "exceptions.hpp"
 
@@ -43,6 +45,13 @@
 #include <termios.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <poll.h>
+#include <errno.h>
+#include <sys/ioctl.h>
+
+#ifdef __linux__
+#include <linux/serial.h>
+#endif
 
 #endif
 
@@ -52,11 +61,14 @@
 *
 * \brief Serial port interface (Win32/Posix) SICAK CharDevice plugin
 *
+* On Posix, the port is used in non-blocking mode: every send/receive call waits for the port using poll, until the call's deadline given by the timeout expires.
+* Received data are accumulated directly in the caller's buffer. Latencies of the transactions (time from the end of a send to the end of the following receive) are measured.
+*
 */
 class SerialPort : public QObject, CharDevice {
     
     Q_OBJECT
-    Q_PLUGIN_METADATA(IID "cz.cvut.fit.Sicak.CharDeviceInterface/1.0" FILE "serialport.json")
+    Q_PLUGIN_METADATA(IID "cz.cvut.fit.Sicak.CharDeviceInterface/1.1" FILE "serialport.json")
     Q_INTERFACES(CharDevice)
                 
 public:
@@ -67,7 +79,7 @@ public:
     virtual QString getPluginName() override;
     virtual QString getPluginInfo() override;
     
-    /// Initializes the serial port, on Win32 e.g. filename=COM2, on Posix e.g. filename=/dev/ttyUSB0, parity: 0=none, 1=odd, 2=even
+    /// Initializes the serial port, on Win32 e.g. filename=COM2, on Posix e.g. filename=/dev/ttyUSB0, parity: 0=none, 1=odd, 2=even. On Linux, filename=/dev/ttyUSB0;low-latency=1 asks the driver for low latency mode
     virtual void init(const char * filename, int baudrate = 9600, int parity = 0, int stopBits = 1) override;
     virtual void deInit() override;
     
@@ -84,8 +96,21 @@ public:
     virtual size_t send(const uint8_t * buffer, size_t len) override;		
     virtual size_t receive(uint8_t * buffer, size_t len) override;
     
+    /// Returns the number of transactions, their min/avg/max latency and the number of timeouts
+    virtual QString getStatistics() override;
+    
 protected:
 
+    /// Records the end of a transaction
+    void recordTransaction(std::chrono::steady_clock::time_point start);
+    
+    #ifndef _WIN32
+    
+    /// Waits for the events (POLLIN/POLLOUT) on the port, returns false when the deadline expired
+    bool waitFor(short events, std::chrono::steady_clock::time_point deadline);
+    
+    #endif
+
     #ifdef _WIN32
 
     HANDLE m_osHandle;
@@ -97,6 +122,20 @@ protected:
     #endif
     
     bool m_opened;
+    /// Timeout of a single send/receive call, in milliseconds
+    int m_timeout;
+    
+    /// Number of transactions, i.e. receive calls
+    size_t m_transactions;
+    /// Number of timeouts
+    size_t m_timeouts;
+    /// Transaction latencies, in microseconds
+    double m_latencySum;
+    double m_latencyMin;
+    double m_latencyMax;
+    /// End of the last send, when not yet followed by a receive
+    std::chrono::steady_clock::time_point m_lastSend;
+    bool m_sendPending;
     
 };
 
@@ -0,0 +1,196 @@
+/*
+*  SICAK - SIde-Channel Analysis toolKit
+*  Copyright (C) 2018-2019 Petr Socha, FIT, CTU in Prague
+*
+*  This program is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation, either version 3 of the License, or
+*  (at your option) any later version.
+*
+*  This program is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/**
+* \file serialporttest.cpp
+*
+* \brief Test of the non-blocking send and receive with deadlines of SerialPort, against a fake device on the master side of a pseudo-terminal
+*
+*
+* \author Petr Socha
+* \version 1.0
+*/
+
+#include <stdlib.h>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+#include "serialport.h"
+
+static int failures = 0;
+
+static void check(bool ok, const char * what){
+    std::printf("%s: %s\n", ok ? "ok  " : "FAIL", what);
+    if(!ok) failures++;
+}
+
+/// Milliseconds elapsed since 'start'
+static double elapsedMs(std::chrono::steady_clock::time_point start){
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+/// Reads from the master side until 'len' bytes arrive or nothing arrives for 'ms' milliseconds
+static std::string readMaster(int master, size_t len, int ms){
+    std::string received;
+    char buffer[4096];
+    while(received.size() < len){
+        struct pollfd pfd = { master, POLLIN, 0 };
+        if(poll(&pfd, 1, ms) <= 0) break;
+        ssize_t ret = read(master, buffer, sizeof(buffer));
+        if(ret <= 0) break;
+        received.append(buffer, ret);
+    }
+    return received;
+}
+
+/// Returns true when init with the device id throws an InvalidInputException
+static bool initThrows(SerialPort & port, const std::string & device){
+    try {
+        port.init(device.c_str(), 115200);
+    } catch (InvalidInputException &) {
+        return true;
+    }
+    port.deInit();
+    return false;
+}
+
+int main(){
+
+    int master = posix_openpt(O_RDWR | O_NOCTTY);
+    if(master < 0 || grantpt(master) || unlockpt(master) || !ptsname(master)){
+        std::printf("Failed to create a pseudo-terminal\n");
+        return 1;
+    }
+
+    const std::string slave = ptsname(master);
+
+    // The master side is raw too, so that the data pass unchanged
+    struct termios masterParams;
+    tcgetattr(master, &masterParams);
+    cfmakeraw(&masterParams);
+    tcsetattr(master, TCSANOW, &masterParams);
+
+    SerialPort port;
+
+    try {
+
+        // Device id parameters
+        check(initThrows(port, slave + ";low-latency=2"), "reject an invalid low-latency param");
+        check(initThrows(port, slave + ";latency=1"), "reject an unknown param");
+
+        // Low latency mode is not supported by pseudo-terminals, which must not fail the init
+        port.init((slave + ";low-latency=1").c_str(), 115200);
+        port.deInit();
+        check(true, "open with low-latency=1 on a port without the low latency mode");
+
+        port.init(slave.c_str(), 115200);
+        port.setTimeout(200);
+
+        // Send
+        {
+            const std::string message = "hello, target";
+            size_t sent = port.send(reinterpret_cast<const uint8_t *>(message.data()), message.size());
+            check(sent == message.size() && readMaster(master, message.size(), 1000) == message, "send a message");
+        }
+
+        // Receive, the data arrive in parts, accumulated in the buffer until all of them are there
+        {
+            std::thread fake([&](){
+                if(write(master, "ab", 2) != 2) return;
+                std::this_thread::sleep_for(std::chrono::milliseconds(50));
+                if(write(master, "cde", 3) != 3) return;
+            });
+
+            uint8_t data[5] = { 0 };
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            size_t received = port.receive(data, sizeof(data));
+            double elapsed = elapsedMs(start);
+            fake.join();
+
+            check(received == 5 && std::string(reinterpret_cast<char *>(data), 5) == "abcde" && elapsed >= 40 && elapsed < 200, "receive a message arriving in two parts");
+        }
+
+        // Receive, a part of the data arrives and then the deadline expires
+        {
+            if(write(master, "xy", 2) != 2) throw RuntimeException("Failed to write to the pseudo-terminal");
+
+            uint8_t data[4];
+            bool thrown = false;
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            try {
+                port.receive(data, sizeof(data));
+            } catch (RuntimeException & e) {
+                thrown = (std::string(e.what()) == "Serial port read timeout.");
+            }
+            double elapsed = elapsedMs(start);
+
+            check(thrown && elapsed >= 195 && elapsed < 1000, "time out a partial receive at the deadline");
+        }
+
+        // Receive, the timeout of a call does not shorten the next one
+        {
+            port.setTimeout(100);
+
+            uint8_t data[1];
+            bool thrown = false;
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            try {
+                port.receive(data, sizeof(data));
+            } catch (RuntimeException &) {
+                thrown = true;
+            }
+            double elapsed = elapsedMs(start);
+
+            check(thrown && elapsed >= 95 && elapsed < 600, "time out a receive with nothing to read");
+        }
+
+        // Send, the fake device does not read, so that the output buffer fills up and the deadline expires
+        {
+            std::vector<uint8_t> data(4 * 1024 * 1024, 0x55);
+            bool thrown = false;
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            try {
+                port.send(data.data(), data.size());
+            } catch (RuntimeException & e) {
+                thrown = (std::string(e.what()) == "Serial port write timeout.");
+            }
+            double elapsed = elapsedMs(start);
+
+            check(thrown && elapsed >= 95 && elapsed < 1000, "time out a send when the output buffer stays full");
+        }
+
+        check(port.getStatistics().contains("timeouts: 3"), "count the timeouts in the statistics");
+
+        port.deInit();
+
+    } catch (std::exception & e) {
+
+        std::printf("FAIL: %s\n", e.what());
+        failures++;
+
+    }
+
+    close(master);
+
+    std::printf("%d failure(s)\n", failures);
+
+    return failures ? 1 : 0;
+
+}
@@ -0,0 +1,18 @@
+!include( ../../../../sicak.pri ) {
+  error( "Couldn't find the sicak.pri file!" )
+}
+
+#
+# Test of the send and receive deadlines and of the low latency mode of serialport against a pseudo-terminal fake device, POSIX only.
+# Built with the chardevice plug-ins and run by: make check
+#
+
+TEMPLATE        = app
+CONFIG         += console thread testcase
+CONFIG         -= app_bundle
+QT             += core
+QT             -= gui
+INCLUDEPATH    += ..
+HEADERS        += ../serialport.h
+SOURCES        += ../serialport.cpp serialporttest.cpp
+TARGET          = serialporttest
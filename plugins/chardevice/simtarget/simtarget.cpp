@@ -0,0 +1,353 @@
+/*
+*  SICAK - SIde-Channel Analysis toolKit
+*  Copyright (C) 2018-2019 Petr Socha, FIT, CTU in Prague
+*
+*  This program is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation, either version 3 of the License, or
+*  (at your option) any later version.
+*
+*  This program is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/**
+* \file simtarget.cpp
+*
+* \brief SICAK character device plugin: simulated AES-128 target, triggering the simulated oscilloscope
+*
+*
+* \author Petr Socha
+* \version 1.0
+*/
+
+#include <QString>
+#include <QStringList>
+#include <thread>
+#include <algorithm>
+#include "simtarget.h"
+#include "simulationbus.hpp"
+#include "crc16.hpp"
+
+SimTarget::SimTarget(): m_opened(false), m_apdu(false), m_latency(0), m_encryptions(0) {
+    
+}
+
+SimTarget::~SimTarget() {
+    
+    if(m_opened){
+        
+        (*this).deInit();
+        
+    }
+    
+}
+
+QString SimTarget::getPluginName() {
+    return "Simulated AES-128 target";
+}
+
+QString SimTarget::getPluginInfo() {
+    return "Software AES-128 target running in-process, triggers the simulated oscilloscope. Open with parameters, e.g. \"protocol=co;latency=100;key=00112233445566778899AABBCCDDEEFF\".";
+}
+
+void SimTarget::init(const char * filename, int baudrate, int parity, int stopBits) {
+    
+    QStringList params = QString(filename).split(";");
+    QString paramVal;
+    
+    // Default key of the measurement scenarios
+    uint8_t key[16] = { 0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88, 0x99, 0xAA, 0xBB, 0xCC, 0xDD, 0xEE, 0xFF };
+    
+    m_apdu = false;
+    m_latency = 0;
+    
+    for (int i = 0; i < params.size(); ++i){ // iterate thru all parameters
+        
+        if(params.at(i).startsWith("protocol=")){
+            
+            paramVal = params.at(i);
+            paramVal.remove(0,9);
+            
+            if(paramVal == "co") m_apdu = false;
+            else if(paramVal == "apdu") m_apdu = true;
+            else throw InvalidInputException("Invalid protocol param, use either co or apdu");
+            
+        } else if(params.at(i).startsWith("latency=")){
+            
+            paramVal = params.at(i);
+            paramVal.remove(0,8);
+            
+            bool ok;
+            m_latency = paramVal.toInt(&ok);
+            if(!ok || m_latency < 0) throw InvalidInputException("Invalid latency param");
+            
+        } else if(params.at(i).startsWith("key=")){
+            
+            paramVal = params.at(i);
+            paramVal.remove(0,4);
+            
+            if(paramVal.size() != 32) throw InvalidInputException("Invalid key param, 32 hex digits expected");
+            
+            for(int byte = 0; byte < 16; byte++){
+                bool ok;
+                key[byte] = (uint8_t) paramVal.mid(2 * byte, 2).toUInt(&ok, 16);
+                if(!ok) throw InvalidInputException("Invalid key param, 32 hex digits expected");
+            }
+            
+        } else if(params.at(i).size()) {
+            
+            throw InvalidInputException("Unknown simulated target param");
+            
+        }
+        
+    }
+    
+    m_aes.setKey(key);
+    m_encryptions = 0;
+    m_input.clear();
+    m_output.clear();
+    m_responses.clear();
+    m_busyUntil = std::chrono::steady_clock::now();
+    
+    SimulationBus::get().attachTarget();
+    
+    m_opened = true;
+    
+}
+
+void SimTarget::deInit() {
+    
+    if(!m_opened) throw RuntimeException("The simulated target needs to be properly initialized first");
+    
+    SimulationBus::get().detachTarget();
+    
+    m_opened = false;
+    
+}
+
+QString SimTarget::queryDevices() {
+    
+    return "    * Device ID: 'PARAMS', parameters separated by semicolons, or empty for the defaults:\n"
+           "      protocol=co|apdu (command oriented or APDU protocol), latency=US (response latency in microseconds), key=HEX (32 hex digits, the key used until set by the 0x01 command)\n";
+    
+}
+
+void SimTarget::setTimeout(int ms) {
+    
+    if(!m_opened) throw RuntimeException("The simulated target needs to be properly initialized first");
+    
+    // The target responds synchronously, missing responses are reported immediately
+    
+}
+
+void SimTarget::encrypt(const uint8_t * plaintext) {
+    
+    uint8_t ciphertext[16];
+    uint8_t sboxOut[16];
+    
+    m_aes.encrypt(plaintext, ciphertext, sboxOut);
+    m_encryptions++;
+    
+    SimulationBus::get().trigger(sboxOut, 16); //< The simulated oscilloscope captures the encryption
+    
+    respond(ciphertext, 16);
+    
+}
+
+void SimTarget::respond(const uint8_t * data, size_t len, size_t commands) {
+    
+    // The target processes the commands one by one
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    if(m_busyUntil < now) m_busyUntil = now;
+    m_busyUntil += std::chrono::microseconds(m_latency * commands);
+    
+    m_output.insert(m_output.end(), data, data + len);
+    m_responses.push_back(std::make_pair(len, m_busyUntil));
+    
+}
+
+void SimTarget::process() {
+    
+    size_t pos = 0;
+    
+    for(;;){
+        
+        size_t available = m_input.size() - pos;
+        const uint8_t * command = m_input.data() + pos;
+        
+        if(!available) break;
+        
+        if(m_apdu){
+            
+            // CLA INS P1 P2 Lc {Lc bytes of data} Le
+            if(available < 5 || available < (size_t) 6 + command[4]) break;
+            
+            if(command[4] != 16) throw RuntimeException("The simulated target expects 16 bytes of data in the APDU");
+            
+            (*this).encrypt(command + 5);
+            
+            // Status word 0x9000, appended to the ciphertext response
+            m_output.push_back(0x90);
+            m_output.push_back(0x00);
+            m_responses.back().first += 2;
+            
+            pos += 6 + command[4];
+            
+        } else if(command[0] == 0x01){ // set key
+            
+            if(available < 17) break;
+            
+            m_aes.setKey(command + 1);
+            pos += 17;
+            
+        } else if(command[0] == 0x02){ // encrypt
+            
+            if(available < 17) break;
+            
+            (*this).encrypt(command + 1);
+            pos += 17;
+            
+        } else if(command[0] == 0x03){ // batch encrypt {0x03, count, blocks, crc}
+            
+            if(available < 3) break;
+            
+            size_t count = command[1] | (command[2] << 8);
+            size_t frameLen = 3 + 16 * count + 2;
+            
+            if(available < frameLen) break;
+            
+            uint8_t header[2];
+            uint16_t crc = crc16(command + 1, 2 + 16 * count);
+            
+            if((command[frameLen - 2] | (command[frameLen - 1] << 8)) != crc) count = 0; // corrupted frame, answer with no blocks
+            
+            header[0] = (uint8_t)(count & 0xFF);
+            header[1] = (uint8_t)(count >> 8);
+            crc = crc16(header, 2);
+            
+            std::vector<uint8_t> frame(header, header + 2);
+            
+            for(size_t block = 0; block < count; block++){
+                
+                uint8_t ciphertext[16];
+                uint8_t sboxOut[16];
+                
+                m_aes.encrypt(command + 3 + 16 * block, ciphertext, sboxOut);
+                m_encryptions++;
+                
+                SimulationBus::get().trigger(sboxOut, 16);
+                
+                frame.insert(frame.end(), ciphertext, ciphertext + 16);
+                
+            }
+            
+            crc = crc16(frame.data() + 2, 16 * count, crc);
+            frame.push_back((uint8_t)(crc & 0xFF));
+            frame.push_back((uint8_t)(crc >> 8));
+            
+            (*this).respond(frame.data(), frame.size(), count); //< Every block takes the response latency
+            
+            pos += frameLen;
+            
+        } else {
+            
+            m_input.clear();
+            throw RuntimeException("The simulated target received an unknown command");
+            
+        }
+        
+    }
+    
+    m_input.erase(m_input.begin(), m_input.begin() + pos);
+    
+}
+
+size_t SimTarget::send(const uint8_t * buffer, size_t len) {
+    
+    if(!m_opened) throw RuntimeException("The simulated target needs to be properly initialized first");
+    
+    m_input.insert(m_input.end(), buffer, buffer + len);
+    
+    (*this).process();
+    
+    return len;
+    
+}
+
+size_t SimTarget::send(const VectorType<uint8_t> & data, size_t len) {
+    
+    if(len > data.size()) throw InvalidInputException("Not enough data to send");    
+    
+    return (*this).send(data.data(), len);
+    
+}
+
+size_t SimTarget::send(const VectorType<uint8_t> & data) {        
+    
+    return (*this).send(data.data(), data.size());
+    
+}
+
+size_t SimTarget::receive(uint8_t * buffer, size_t len) {
+    
+    if(!m_opened) throw RuntimeException("The simulated target needs to be properly initialized first");
+    
+    size_t received = 0;
+    
+    while(received < len){
+        
+        if(m_responses.empty()){
+            if(m_apdu && received) break;
+            throw RuntimeException("Simulated target read timeout: no response pending.");
+        }
+        
+        std::this_thread::sleep_until(m_responses.front().second); //< Response latency
+        
+        size_t chunk = std::min(len - received, m_responses.front().first);
+        
+        std::copy(m_output.begin(), m_output.begin() + chunk, buffer + received);
+        m_output.erase(m_output.begin(), m_output.begin() + chunk);
+        received += chunk;
+        
+        m_responses.front().first -= chunk;
+        
+        if(m_apdu){
+            // A response APDU is received at once, the rest of it gets discarded
+            m_output.erase(m_output.begin(), m_output.begin() + m_responses.front().first);
+            m_responses.pop_front();
+            break;
+        }
+        
+        if(!m_responses.front().first) m_responses.pop_front();
+        
+    }
+    
+    return received;
+    
+}
+
+size_t SimTarget::receive(VectorType<uint8_t> & data, size_t len) {
+    
+    data.init(len); //< Make sure we have enough space to receive len chars
+    
+    return (*this).receive(data.data(), len);
+    
+}
+
+size_t SimTarget::receive(VectorType<uint8_t> & data) {    
+    
+    return (*this).receive(data.data(), data.size());
+    
+}
+
+QString SimTarget::getStatistics() {
+    
+    return QString("    * Encryptions: %1\n").arg(m_encryptions);
+    
+}
@@ -0,0 +1,114 @@
+/*
+*  SICAK - SIde-Channel Analysis toolKit
+*  Copyright (C) 2018-2019 Petr Socha, FIT, CTU in Prague
+*
+*  This program is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation, either version 3 of the License, or
+*  (at your option) any later version.
+*
+*  This program is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/**
+* \file simtarget.h
+*
+* \brief SICAK character device plugin: simulated AES-128 target, triggering the simulated oscilloscope
+*
+*
+* \author Petr Socha
+* \version 1.0
+*/
+
+#ifndef SIMTARGET_H
+#define SIMTARGET_H 
+
+#include <QObject>
+#include <QtPlugin>
+#include <chrono>
+#include <deque>
+#include <vector>
+#include "chardevice.h"
+#include "exceptions.hpp"
+#include "aes128.hpp"
+
+/**
+* \class SimTarget
+* \ingroup CharDevice
+*
+* \brief Simulated AES-128 target SICAK CharDevice plugin, running in-process. Understands the command oriented protocol of the measurement scenarios (0x01 set key, 0x02 encrypt, 0x03 batch encrypt)
+* or the APDU one. Every encryption triggers the simulated oscilloscope with the outputs of the first round S-boxes, see SimulationBus.
+*
+*/
+class SimTarget : public QObject, CharDevice {
+    
+    Q_OBJECT
+    Q_PLUGIN_METADATA(IID "cz.cvut.fit.Sicak.CharDeviceInterface/1.1" FILE "simtarget.json")
+    Q_INTERFACES(CharDevice)
+                
+public:
+    
+    SimTarget();
+    virtual ~SimTarget() override;
+    
+    virtual QString getPluginName() override;
+    virtual QString getPluginInfo() override;
+    
+    /// Initializes the simulated target, filename holds the parameters separated by semicolons, e.g. "protocol=apdu;latency=100", other params are ignored
+    virtual void init(const char * filename, int baudrate = 9600, int parity = 0, int stopBits = 1) override;
+    virtual void deInit() override;
+    
+    virtual QString queryDevices() override;
+    
+    virtual void setTimeout(int ms = 5000) override;
+    
+    virtual size_t send(const VectorType<uint8_t> & data) override;
+    virtual size_t receive(VectorType<uint8_t> & data) override;
+    
+    virtual size_t send(const VectorType<uint8_t> & data, size_t len) override;
+    virtual size_t receive(VectorType<uint8_t> & data, size_t len) override;
+
+    /// Processes all the complete commands sent so far
+    virtual size_t send(const uint8_t * buffer, size_t len) override;		
+    /// Receives the responses, each available after the response latency. In the APDU protocol, receives at most the rest of the response APDU
+    virtual size_t receive(uint8_t * buffer, size_t len) override;
+    
+    /// Returns the number of encryptions performed
+    virtual QString getStatistics() override;
+    
+protected:
+    
+    /// Processes the commands in the input buffer, returns when no complete command is left
+    void process();
+    /// Encrypts a block, triggers the simulated oscilloscope, and appends the ciphertext to the output buffer
+    void encrypt(const uint8_t * plaintext);
+    /// Appends a response to the output buffer, available after the response latency of the given number of commands
+    void respond(const uint8_t * data, size_t len, size_t commands = 1);
+    
+    bool m_opened;
+    /// Use the APDU protocol instead of the command oriented one
+    bool m_apdu;
+    /// Response latency, in microseconds
+    int m_latency;
+    
+    Aes128 m_aes;
+    size_t m_encryptions;
+    
+    /// Data sent to the target, not yet processed
+    std::vector<uint8_t> m_input;
+    /// Responses of the target, not yet received
+    std::deque<uint8_t> m_output;
+    /// Lengths of the responses in the output buffer, and the times they get available
+    std::deque<std::pair<size_t, std::chrono::steady_clock::time_point>> m_responses;
+    /// Time the target finishes the last command
+    std::chrono::steady_clock::time_point m_busyUntil;
+    
+};
+
+#endif /* SIMTARGET_H */
@@ -0,0 +1,21 @@
+!include( ../../../sicak.pri ) {
+  error( "Couldn't find the sicak.pri file!" )
+}
+
+
+TEMPLATE        = lib
+CONFIG         += plugin
+QT             += widgets
+INCLUDEPATH    += ../../common
+HEADERS        += simtarget.h
+SOURCES        += simtarget.cpp                
+TARGET          = $$qtLibraryTarget(sicaksimtarget)
+DESTDIR         = ./bin
+
+EXAMPLE_FILES = simtarget.json
+
+# install
+target.path = ../../../INSTALL/plugins/chardevice
+INSTALLS += target
+
+CONFIG += install_ok  # Do not cargo-cult this!
@@ -326,3 +326,8 @@ size_t SmartCard::receive(VectorType<uint8_t> & data) {
     
 }
 
+QString SmartCard::getStatistics() {
+    
+    return "";
+    
+}
@@ -53,7 +53,7 @@
 class SmartCard : public QObject, CharDevice {
     
     Q_OBJECT
-    Q_PLUGIN_METADATA(IID "cz.cvut.fit.Sicak.CharDeviceInterface/1.0" FILE "smartcard.json")
+    Q_PLUGIN_METADATA(IID "cz.cvut.fit.Sicak.CharDeviceInterface/1.1" FILE "smartcard.json")
     Q_INTERFACES(CharDevice)
                 
 public:
@@ -88,6 +88,9 @@ public:
     /// Response to the previously sent APDU message is stored in data, including status word
     virtual size_t receive(uint8_t * buffer, size_t len) override;
     
+    /// Statistics are not supported, returns an empty string
+    virtual QString getStatistics() override;
+    
 protected:
     
     bool m_initialized;
@@ -0,0 +1,52 @@
+/*
+*  SICAK - SIde-Channel Analysis toolKit
+*  Copyright (C) 2018-2019 Petr Socha, FIT, CTU in Prague
+*
+*  This program is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation, either version 3 of the License, or
+*  (at your option) any later version.
+*
+*  This program is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/**
+* \file crc16.hpp
+*
+* \brief CRC-16 of the target communication frames, shared by the SICAK measurement scenario plugins and the simulated target
+*
+*
+* \author Petr Socha
+* \version 1.0
+*/
+
+#ifndef CRC16_H
+#define CRC16_H
+
+#include <cstddef>
+#include <cstdint>
+
+/// Computes CRC-16/CCITT-FALSE (poly 0x1021, init 0xFFFF) of the data, continues from the given crc
+inline uint16_t crc16(const uint8_t * data, size_t len, uint16_t crc = 0xFFFF){
+
+    for(size_t i = 0; i < len; i++){
+
+        crc ^= (uint16_t)(data[i] << 8);
+
+        for(int bit = 0; bit < 8; bit++){
+            crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+        }
+
+    }
+
+    return crc;
+
+}
+
+#endif /* CRC16_H */
@@ -0,0 +1,132 @@
+/*
+*  SICAK - SIde-Channel Analysis toolKit
+*  Copyright (C) 2018-2019 Petr Socha, FIT, CTU in Prague
+*
+*  This program is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation, either version 3 of the License, or
+*  (at your option) any later version.
+*
+*  This program is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/**
+* \file simulationbus.hpp
+*
+* \brief Connects the simulated target (character device) with the simulated oscilloscope within a single process, used by the SICAK simulation plugins
+*
+*
+* \author Petr Socha
+* \version 1.0
+*/
+
+#ifndef SIMULATIONBUS_H
+#define SIMULATIONBUS_H
+
+#include <cstdint>
+#include <deque>
+#include <vector>
+#include <mutex>
+#include <chrono>
+#include <condition_variable>
+#include <QCoreApplication>
+#include <QVariant>
+
+/**
+* \class SimulationBus
+* \ingroup SicakData
+*
+* \brief Queue of the triggers of the simulated target: every time the simulated target processes data (e.g. encrypts a block), it triggers with the processed intermediate values.
+* The simulated oscilloscope takes the triggers in order and synthesizes a power trace from the intermediate values of every trigger.
+*
+* Plugins are separate libraries, so a single bus instance is shared through the application object.
+*
+*/
+class SimulationBus {
+
+public:
+
+    /// Returns the bus shared by all the plugins of the process
+    static SimulationBus & get(){
+
+        QCoreApplication * app = QCoreApplication::instance();
+
+        if(app == nullptr){
+            static SimulationBus localBus; // no application object, e.g. when used outside of the SICAK apps
+            return localBus;
+        }
+
+        QVariant shared = app->property("SicakSimulationBus");
+
+        if(!shared.isValid()){
+            // Never deleted: the plugin library which created the bus may be unloaded before the application object gets destroyed
+            SimulationBus * bus = new SimulationBus();
+            app->setProperty("SicakSimulationBus", QVariant::fromValue(static_cast<void *>(bus)));
+            return *bus;
+        }
+
+        return *static_cast<SimulationBus *>(shared.value<void *>());
+
+    }
+
+    /// Registers a simulated target: the simulated oscilloscope then waits for its triggers
+    void attachTarget(){
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_targets++;
+        m_triggers.clear();
+    }
+
+    /// Unregisters a simulated target
+    void detachTarget(){
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if(m_targets) m_targets--;
+        m_triggers.clear();
+    }
+
+    /// Returns true when a simulated target is attached
+    bool targetAttached(){
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_targets > 0;
+    }
+
+    /// Triggers with the intermediate values processed by the target
+    void trigger(const uint8_t * data, size_t len){
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_triggers.emplace_back(data, data + len);
+        m_cond.notify_all();
+
+    }
+
+    /// Takes the oldest trigger, waits at most timeoutMs for it. Returns false on timeout
+    bool waitTrigger(std::vector<uint8_t> & data, int timeoutMs){
+
+        std::unique_lock<std::mutex> lock(m_mutex);
+
+        if(!m_cond.wait_for(lock, std::chrono::milliseconds(timeoutMs), [this]{ return !m_triggers.empty(); })) return false;
+
+        data.swap(m_triggers.front());
+        m_triggers.pop_front();
+
+        return true;
+
+    }
+
+protected:
+
+    SimulationBus() : m_targets(0) {}
+
+    std::mutex m_mutex;
+    std::condition_variable m_cond;
+    size_t m_targets;
+    std::deque<std::vector<uint8_t>> m_triggers;
+
+};
+
+#endif /* SIMULATIONBUS_H */
@@ -0,0 +1,232 @@
+/*
+*  SICAK - SIde-Channel Analysis toolKit
+*  Copyright (C) 2018-2019 Petr Socha, FIT, CTU in Prague
+*
+*  This program is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation, either version 3 of the License, or
+*  (at your option) any later version.
+*
+*  This program is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/**
+* \file tracesimulation.hpp
+*
+* \brief Synthesis of leaking power traces, shared by the simulated oscilloscope plugin and the SICAK SYNThetic traces generator
+*
+*
+* \author Petr Socha
+* \version 1.0
+*/
+
+#ifndef TRACESIMULATION_H
+#define TRACESIMULATION_H
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/// Number of levels of the Gaussian noise
+#define TRACESIMULATION_NOISE_LEVELS 65536
+/// Number of samples the noise is drawn for at once, a multiple of 4
+#define TRACESIMULATION_NOISE_BLOCK 256
+
+/**
+* \class TraceSimulation
+* \ingroup SicakData
+*
+* \brief Synthesizes power traces consisting of a periodic base waveform, leakage of the given values, Gaussian noise and a random time shift (misalignment).
+*
+* The noise of every power trace is a fresh realization, drawn by a counter based generator keyed by a random number of the power trace (see random): the noise of a sample
+* depends just on the key and the number of the sample, so that the leaking samples are synthesized without storing the noise. The noise takes one of 65536 equiprobable levels,
+* the quantiles of the Gaussian distribution, i.e. it is truncated at about 4.2 standard deviations.
+*
+*/
+class TraceSimulation {
+
+public:
+
+    TraceSimulation() : m_samples(0), m_jitter(0), m_noise(0) {}
+
+    /// Prepares the base waveform and the noise of power traces of 'samples' samples, shifted by up to 'jitter' samples. Noise is the standard deviation in 16-bit LSBs
+    void prepare(size_t samples, size_t jitter, double noise){
+
+        m_samples = samples;
+        m_jitter = jitter;
+        m_noise = noise;
+
+        // Base waveform: a clock-like periodic signal with a slower component
+        m_base.resize(m_samples + 2 * m_jitter);
+
+        const double pi = 3.14159265358979323846;
+
+        for(size_t i = 0; i < m_base.size(); i++){
+            m_base[i] = (int16_t) (4000.0 * std::sin(2 * pi * i / 16.0) + 2000.0 * std::sin(2 * pi * i / 160.0));
+        }
+
+        // Noise levels
+        const std::vector<double> & quantiles = gaussianQuantiles();
+
+        m_levels.resize(TRACESIMULATION_NOISE_LEVELS);
+
+        for(size_t i = 0; i < m_levels.size(); i++){
+            double value = std::round(m_noise * quantiles[i]);
+            value = (value > 16384) ? 16384 : ((value < -16384) ? -16384 : value);
+            m_levels[i] = (int16_t) value;
+        }
+
+    }
+
+    /// Frees the memory
+    void clear(){
+        m_base.clear();
+        m_levels.clear();
+    }
+
+    /// Synthesizes a power trace, T is either int16_t or int8_t (8-bit samples keep the upper byte). The power trace is shifted by 'shift' <= 2 * jitter samples,
+    /// the i-th of 'count' leakages (in 16-bit LSBs) is added to the sample leak + i * spacing (of the power trace shifted by jitter samples), noise is given by the noise key
+    template <class T>
+    void synthesize(T * trace, size_t shift, uint64_t noiseKey, const int * leakages, size_t count, size_t leak, size_t spacing) const {
+
+        const int bits = (sizeof(T) == 1) ? 8 : 0;
+        const size_t samplesPerTrace = m_samples; //< local copy, 8-bit stores may alias the members and prevent the vectorization
+        const int16_t * base = m_base.data() + shift;
+        const int16_t * levels = m_levels.data();
+
+        // Every random number gives the noise of 4 samples, the noise is drawn in blocks, so that the sum gets vectorized
+        int16_t noiseBlock[TRACESIMULATION_NOISE_BLOCK];
+
+        for(size_t first = 0; first < samplesPerTrace; first += TRACESIMULATION_NOISE_BLOCK){
+
+            const size_t blockSamples = (samplesPerTrace - first < TRACESIMULATION_NOISE_BLOCK) ? samplesPerTrace - first : TRACESIMULATION_NOISE_BLOCK;
+
+            for(size_t word = 0; word < TRACESIMULATION_NOISE_BLOCK / 4; word++){
+                uint64_t rnd = noiseBits(noiseKey, first / 4 + word);
+                for(size_t lane = 0; lane < 4; lane++) noiseBlock[4 * word + lane] = levels[(uint16_t) (rnd >> (16 * lane))];
+            }
+
+            for(size_t i = 0; i < blockSamples; i++){
+                int value = base[first + i] + noiseBlock[i];
+                value = (value > 32767) ? 32767 : ((value < -32768) ? -32768 : value);
+                trace[first + i] = (T) (value >> bits);
+            }
+
+        }
+
+        // Leakage, shifted along with the base waveform
+        for(size_t i = 0; i < count; i++){
+
+            size_t pos = leak + i * spacing + m_jitter;
+            if(pos < shift || pos - shift >= samplesPerTrace) continue;
+            pos -= shift;
+
+            int value = base[pos] + noise(noiseKey, pos) + leakages[i];
+            value = (value > 32767) ? 32767 : ((value < -32768) ? -32768 : value);
+            trace[pos] = (T) (value >> bits);
+
+        }
+
+    }
+
+    /// Returns the noise of the sample, given the noise key of the power trace
+    int16_t noise(uint64_t noiseKey, size_t sample) const {
+        return m_levels[(noiseBits(noiseKey, sample / 4) >> (16 * (sample % 4))) & 0xFFFF];
+    }
+
+    /// Returns the standard deviation of the noise, in 16-bit LSBs
+    double getNoise() const { return m_noise; }
+
+    /// Seeds the random numbers, e.g. of a power trace (SplitMix64)
+    static uint64_t splitMix(uint64_t x) {
+
+        x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+        x ^= x >> 31;
+
+        return x ? x : 1; // xorshift state must not be zero
+
+    }
+
+    /// Fast pseudo-random numbers (xorshift64*), the state must not be zero
+    static uint64_t random(uint64_t & state) {
+
+        state ^= state >> 12;
+        state ^= state << 25;
+        state ^= state >> 27;
+
+        return state * 0x2545F4914F6CDD1DULL;
+
+    }
+
+    /// Fills the buffer with random bytes
+    static void randomBytes(uint64_t & state, uint8_t * buffer, size_t len) {
+
+        uint64_t rnd = 0;
+
+        for(size_t i = 0; i < len; i++){
+            if(i % 8 == 0) rnd = random(state);
+            buffer[i] = (uint8_t) (rnd >> (8 * (i % 8)));
+        }
+
+    }
+
+protected:
+
+    /// Random bits of the noise of the block-th four samples
+    static uint64_t noiseBits(uint64_t noiseKey, size_t block) {
+        return splitMix(noiseKey + 0x9E3779B97F4A7C15ULL * (block + 1));
+    }
+
+    /// Quantiles of the standard normal distribution at (i + 0.5) / 65536, computed once
+    static const std::vector<double> & gaussianQuantiles() {
+
+        static const std::vector<double> quantiles = [](){
+
+            std::vector<double> values(TRACESIMULATION_NOISE_LEVELS);
+
+            for(size_t i = 0; i < values.size(); i++){
+
+                // Bisection of the standard normal CDF
+                double p = (i + 0.5) / TRACESIMULATION_NOISE_LEVELS;
+                double low = -10, high = 10;
+
+                for(int iteration = 0; iteration < 60; iteration++){
+                    double mid = 0.5 * (low + high);
+                    if(0.5 * std::erfc(-mid / std::sqrt(2.0)) < p) low = mid;
+                    else high = mid;
+                }
+
+                values[i] = 0.5 * (low + high);
+
+            }
+
+            return values;
+
+        }();
+
+        return quantiles;
+
+    }
+
+    size_t m_samples;
+    /// Maximum random time shift of a power trace, in samples
+    size_t m_jitter;
+    /// Standard deviation of the Gaussian noise, in 16-bit LSBs
+    double m_noise;
+
+    /// Base waveform, m_samples + 2 * m_jitter samples long
+    std::vector<int16_t> m_base;
+    /// Noise levels, the Gaussian quantiles
+    std::vector<int16_t> m_levels;
+
+};
+
+#endif /* TRACESIMULATION_H */
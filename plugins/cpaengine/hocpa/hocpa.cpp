@@ -104,6 +104,17 @@ Moments2DContext<double> HOCPA::createContext(const PowerTraces<int16_t> & power
     
 }
 
+Moments2DContext<double> HOCPA::createContext(const PowerTraces<int8_t> & powerTraces, const PowerPredictions<uint8_t> & powerPredictions) {
+    
+    // Create an empty context    
+    Moments2DContext<double> context(powerTraces.samplesPerTrace(), powerPredictions.noOfCandidates(), 1, 1, 2 * m_order, 2, m_order);
+    context.reset();
+    // Compute context
+    UniHoCpaAddTraces(context, powerTraces, powerPredictions, m_order);
+    return context;
+    
+}
+
 void HOCPA::mergeContexts(Moments2DContext<double> & firstAndOut, const Moments2DContext<double> & second) {
     
     UniHoCpaMergeContexts(firstAndOut, second);
@@ -78,6 +78,17 @@ Moments2DContext<double> LocalCPA::createContext(const PowerTraces<int16_t> & po
     
 }
 
+Moments2DContext<double> LocalCPA::createContext(const PowerTraces<int8_t> & powerTraces, const PowerPredictions<uint8_t> & powerPredictions) {
+    
+    // Create an empty context    
+    Moments2DContext<double> context(powerTraces.samplesPerTrace(), powerPredictions.noOfCandidates(), 1, 1, 2, 2, 1);
+    context.reset();
+    // Compute context (covariance, variances and means)
+    UniFoCpaAddTraces(context, powerTraces, powerPredictions);
+    return context;
+    
+}
+
 void LocalCPA::mergeContexts(Moments2DContext<double> & firstAndOut, const Moments2DContext<double> & second) {
     
     UniFoCpaMergeContexts(firstAndOut, second);
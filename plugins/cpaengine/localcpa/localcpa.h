@@ -45,7 +45,7 @@
 class LocalCPA : public QObject, CpaEngine {
     
     Q_OBJECT
-    Q_PLUGIN_METADATA(IID "cz.cvut.fit.Sicak.CpaEngineInterface/1.1" FILE "localcpa.json")
+    Q_PLUGIN_METADATA(IID "cz.cvut.fit.Sicak.CpaEngineInterface/1.2" FILE "localcpa.json")
     Q_INTERFACES(CpaEngine)
         
 public:
@@ -64,6 +64,7 @@ public:
     virtual void setConstTraces(bool constTraces = false) override;
     
     virtual Moments2DContext<double> createContext(const PowerTraces<int16_t> & powerTraces, const PowerPredictions<uint8_t> & powerPredictions) override;    
+    virtual Moments2DContext<double> createContext(const PowerTraces<int8_t> & powerTraces, const PowerPredictions<uint8_t> & powerPredictions) override;    
     virtual void mergeContexts(Moments2DContext<double> & firstAndOut, const Moments2DContext<double> & second) override;
     virtual Matrix<double> finalizeContext(const Moments2DContext<double> & context) override;
             
@@ -28,7 +28,7 @@
 
 #include "oclcpa.h"
 
-OclCPA::OclCPA(): m_handle(nullptr), m_constTraces(false), m_tracesLoaded(false) {
+OclCPA::OclCPA(): m_handle(nullptr), m_handle8(nullptr), m_platform(0), m_device(0), m_noOfTraces(0), m_samplesPerTrace(0), m_noOfCandidates(0), m_constTraces(false), m_tracesLoaded(false) {
     
 }
 
@@ -46,14 +46,28 @@ QString OclCPA::getPluginInfo() {
 
 void OclCPA::init(int platform, int device, size_t noOfTraces, size_t samplesPerTrace, size_t noOfCandidates, const char * param) {
     if(noOfTraces*samplesPerTrace == 0 || noOfTraces*noOfCandidates == 0) throw RuntimeException("Invalid computation parameters (sizes).");
-    m_handle = new OclCpaEngine<double, int16_t, uint8_t>(platform, device, samplesPerTrace, noOfCandidates, noOfTraces);
+    m_platform = platform;
+    m_device = device;
+    m_noOfTraces = noOfTraces;
+    m_samplesPerTrace = samplesPerTrace;
+    m_noOfCandidates = noOfCandidates;
+    // The engine itself is created with the first context, when the sample type is known
     Q_UNUSED(param);
 }
 
 void OclCPA::deInit() {
+    releaseHandles();
+    m_noOfTraces = 0;
+}
+
+void OclCPA::releaseHandles() {
     if(m_handle)
         delete m_handle;
     m_handle = nullptr;
+    if(m_handle8)
+        delete m_handle8;
+    m_handle8 = nullptr;
+    m_tracesLoaded = false;
 }
 
 QString OclCPA::queryDevices() {
@@ -67,25 +81,44 @@ void OclCPA::setConstTraces(bool constTraces){
     
 Moments2DContext<double> OclCPA::createContext(const PowerTraces<int16_t> & powerTraces, const PowerPredictions<uint8_t> & powerPredictions) {
     
-    if(m_handle == nullptr)
+    return createContextOcl(m_handle, powerTraces, powerPredictions);
+    
+}
+
+Moments2DContext<double> OclCPA::createContext(const PowerTraces<int8_t> & powerTraces, const PowerPredictions<uint8_t> & powerPredictions) {
+    
+    return createContextOcl(m_handle8, powerTraces, powerPredictions);
+    
+}
+
+template <class T>
+Moments2DContext<double> OclCPA::createContextOcl(OclCpaEngine<double, T, uint8_t> * & handle, const PowerTraces<T> & powerTraces, const PowerPredictions<uint8_t> & powerPredictions) {
+    
+    if(m_noOfTraces == 0)
         throw RuntimeException("The Ocl engine needs to be properly initialized first");        
     
+    // Create the engine for this sample type, releasing the device memory held by the other one
+    if(handle == nullptr){
+        releaseHandles();
+        handle = new OclCpaEngine<double, T, uint8_t>(m_platform, m_device, m_samplesPerTrace, m_noOfCandidates, m_noOfTraces);
+    }
+    
     // Load power traces to the GPU
     if(!m_constTraces || !m_tracesLoaded){
-        m_handle->loadTracesToDevice(powerTraces);
+        handle->loadTracesToDevice(powerTraces);
         m_tracesLoaded = true;
     }
     
     // Load power predictions
-    m_handle->loadPredictionsToDevice(powerPredictions);
+    handle->loadPredictionsToDevice(powerPredictions);
     
     // If program is not built yet, build it now
-    m_handle->buildProgram();
+    handle->buildProgram();
         
     Moments2DContext<double> context;
     
     // Launch the computation
-    m_handle->compute(context, 1000); 
+    handle->compute(context, 1000); 
     
     return context;
         
@@ -53,7 +53,7 @@
 class OclCPA : public QObject, CpaEngine {
     
     Q_OBJECT
-    Q_PLUGIN_METADATA(IID "cz.cvut.fit.Sicak.CpaEngineInterface/1.1" FILE "oclcpa.json")
+    Q_PLUGIN_METADATA(IID "cz.cvut.fit.Sicak.CpaEngineInterface/1.2" FILE "oclcpa.json")
     Q_INTERFACES(CpaEngine)
                 
 public:
@@ -73,12 +73,25 @@ public:
     
     /// Creates context from traces and predictions using GPU. When constTraces=true, the traces are loaded to the GPU device only the first time; predictions are loaded every time
     virtual Moments2DContext<double> createContext(const PowerTraces<int16_t> & powerTraces, const PowerPredictions<uint8_t> & powerPredictions) override;    
+    virtual Moments2DContext<double> createContext(const PowerTraces<int8_t> & powerTraces, const PowerPredictions<uint8_t> & powerPredictions) override;    
     virtual void mergeContexts(Moments2DContext<double> & firstAndOut, const Moments2DContext<double> & second) override;
     virtual Matrix<double> finalizeContext(const Moments2DContext<double> & context) override;
          
 protected:
     
+    /// Creates the OpenCL engine specialized for the sample type T, unless created already, and computes the context
+    template <class T>
+    Moments2DContext<double> createContextOcl(OclCpaEngine<double, T, uint8_t> * & handle, const PowerTraces<T> & powerTraces, const PowerPredictions<uint8_t> & powerPredictions);
+    /// Releases the OpenCL engines
+    void releaseHandles();
+    
     OclCpaEngine<double, int16_t, uint8_t> * m_handle;
+    OclCpaEngine<double, int8_t, uint8_t> * m_handle8;
+    int m_platform;
+    int m_device;
+    size_t m_noOfTraces;
+    size_t m_samplesPerTrace;
+    size_t m_noOfCandidates;
     bool m_constTraces;
     bool m_tracesLoaded;
 };
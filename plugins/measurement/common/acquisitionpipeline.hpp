@@ -0,0 +1,268 @@
+/*
+*  SICAK - SIde-Channel Analysis toolKit
+*  Copyright (C) 2018-2019 Petr Socha, FIT, CTU in Prague
+*
+*  This program is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation, either version 3 of the License, or
+*  (at your option) any later version.
+*
+*  This program is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/**
+* \file acquisitionpipeline.hpp
+*
+* \brief Pipelined acquisition engine shared by the SICAK measurement scenario plugins
+*
+*
+* \author Petr Socha
+* \version 1.0
+*/
+
+#ifndef ACQUISITIONPIPELINE_H
+#define ACQUISITIONPIPELINE_H
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <string>
+#include "oscilloscope.h"
+#include "exceptions.hpp"
+#include "types_power.hpp"
+#include "instrumentation.hpp"
+
+/**
+* \class AcquisitionPipeline
+* \ingroup Measurement
+*
+* \brief Runs the oscilloscope runs of a measurement in two threads: a producer thread arms the oscilloscope and talks to the target, a consumer thread downloads the captured power traces and stores them.
+*
+* When the oscilloscope buffers more runs (Oscilloscope::getBufferedRuns), the producer arms the next run while the consumer still downloads the previous one,
+* hiding the download latency. Otherwise the producer waits only for the download itself, while storing the downloaded traces overlaps the next run.
+* Runs are downloaded in order, so that the measured runs always form a contiguous sequence.
+*
+* The power traces are downloaded into a ring of a few runs, which get reused once stored: the measurement runs in constant memory.
+* Data related to the individual measurements (e.g. plaintexts) are meant to be kept in the same ring, see getRingIndex.
+*
+* Every run records the phases "arm-oscilloscope" and "exchange-target" in the producer thread and "download-traces" in the consumer thread, see PhaseTimer.
+* The phases of the two threads overlap, so the wall time of a phase is the time its thread spent in it.
+*
+*/
+template <class T>
+class AcquisitionPipeline {
+
+public:
+
+    /// Exchange with the target during a single capture, gets the number of the measurement
+    typedef std::function<void(size_t)> Exchange;
+    /// Stores the power traces of a single downloaded run, gets the number of the run; the run's place in the ring gets reused afterwards
+    typedef std::function<void(size_t)> Store;
+
+    /// Constructor, samplesPerTrace and capturesPerRun need to match the oscilloscope setup
+    AcquisitionPipeline(Oscilloscope * oscilloscope, int channel, size_t samplesPerTrace, size_t capturesPerRun);
+
+    /// Performs the given number of oscilloscope runs and returns the number of runs successfully downloaded and stored, which is lower than runs after an error
+    size_t measure(size_t runs, Exchange exchange, Store store = nullptr);
+
+    /// Stops the measurement early, without an error: no more runs get armed, the runs armed already still get downloaded and stored. Can be called e.g. from the store callback
+    void stop();
+
+    /// Returns the message of the error that broke the measurement, if any
+    const std::string & getError() const { return m_error; }
+    
+    /// Returns the number of measurements kept in the ring
+    size_t getRingSize() const { return m_ringRuns * m_capturesPerRun; }
+    /// Returns the position of the measurement in the ring
+    size_t getRingIndex(size_t measurement) const { return measurement % (m_ringRuns * m_capturesPerRun); }
+    /// Returns the power traces ring, the measurement's power trace is at getRingIndex(measurement)
+    const PowerTraces<T> & getTraces() const { return m_traces; }
+
+protected:
+
+    /// Producer thread: arms the oscilloscope and talks to the target
+    void produce(size_t runs, Exchange & exchange);
+    /// Consumer thread: downloads and stores the power traces
+    void consume(size_t runs, Store & store);
+    /// Records the first error and stops both threads
+    void fail(const char * what);
+
+    Oscilloscope * m_oscilloscope;
+    int m_channel;
+    size_t m_samplesPerTrace;
+    size_t m_capturesPerRun;
+    size_t m_bufferedRuns;
+    /// Number of runs in the ring
+    size_t m_ringRuns;
+    PowerTraces<T> m_traces;
+
+    std::mutex m_mutex;
+    std::condition_variable m_cond;
+    /// Number of runs the target was triggered for
+    size_t m_armedRuns;
+    /// Number of runs downloaded from the oscilloscope
+    size_t m_downloadedRuns;
+    /// Number of runs downloaded and stored
+    size_t m_storedRuns;
+    bool m_producerDone;
+    bool m_stop;
+    std::string m_error;
+
+};
+
+template <class T>
+AcquisitionPipeline<T>::AcquisitionPipeline(Oscilloscope * oscilloscope, int channel, size_t samplesPerTrace, size_t capturesPerRun): m_oscilloscope(oscilloscope), m_channel(channel), m_samplesPerTrace(samplesPerTrace), m_capturesPerRun(capturesPerRun), m_bufferedRuns(1), m_ringRuns(2), m_armedRuns(0), m_downloadedRuns(0), m_storedRuns(0), m_producerDone(false), m_stop(false), m_error("") {
+
+    if(m_oscilloscope == nullptr) throw InvalidInputException("Oscilloscope is needed to run the acquisition");
+
+    m_bufferedRuns = m_oscilloscope->getBufferedRuns();
+    if(m_bufferedRuns < 1) m_bufferedRuns = 1;
+    
+    // Runs buffered in the oscilloscope, and one more being stored
+    m_ringRuns = m_bufferedRuns + 1;
+    m_traces.init(m_samplesPerTrace, m_ringRuns * m_capturesPerRun);
+
+}
+
+template <class T>
+size_t AcquisitionPipeline<T>::measure(size_t runs, Exchange exchange, Store store) {
+
+    m_armedRuns = 0;
+    m_downloadedRuns = 0;
+    m_storedRuns = 0;
+    m_producerDone = false;
+    m_stop = false;
+    m_error = "";
+
+    std::thread consumer(&AcquisitionPipeline<T>::consume, this, runs, std::ref(store));
+
+    produce(runs, exchange); // the calling thread acts as the producer
+
+    consumer.join();
+
+    return m_storedRuns;
+
+}
+
+template <class T>
+void AcquisitionPipeline<T>::produce(size_t runs, Exchange & exchange) {
+
+    for(size_t run = 0; run < runs; run++){
+
+        {
+            // Wait for a free oscilloscope buffer and a free place in the ring
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_cond.wait(lock, [&]{ return m_stop || (run - m_downloadedRuns < m_bufferedRuns && run - m_storedRuns < m_ringRuns); });
+            if(m_stop) break;
+        }
+
+        try {
+
+            {
+                PhaseTimer timer("arm-oscilloscope");
+                m_oscilloscope->run(); //< Start capturing capturesPerRun captures
+            }
+
+            {
+                PhaseTimer timer("exchange-target");
+                for(size_t capture = 0; capture < m_capturesPerRun; capture++){
+                    exchange(run * m_capturesPerRun + capture);
+                }
+                timer.addTraces(m_capturesPerRun);
+            }
+
+        } catch (std::exception & e) {
+            fail(e.what());
+            break;
+        }
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_armedRuns = run + 1;
+        m_cond.notify_all();
+
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_producerDone = true;
+    m_cond.notify_all();
+
+}
+
+template <class T>
+void AcquisitionPipeline<T>::consume(size_t runs, Store & store) {
+
+    for(size_t run = 0; run < runs; run++){
+
+        {
+            // Wait for the target to finish the run; runs armed before an error of the producer still get downloaded
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_cond.wait(lock, [&]{ return m_armedRuns > run || m_producerDone || m_stop; });
+            if(m_armedRuns <= run) break;
+        }
+
+        try {
+
+            size_t measuredSamples;
+            size_t measuredCaptures;
+
+            {
+                // Download the sampled data from oscilloscope
+                PhaseTimer timer("download-traces");
+                m_oscilloscope->getValues(m_channel, &( m_traces(0, getRingIndex(run * m_capturesPerRun)) ), m_capturesPerRun * m_samplesPerTrace, measuredSamples, measuredCaptures);
+                timer.addBytes(measuredSamples * measuredCaptures * sizeof(T));
+                timer.addTraces(measuredCaptures);
+            }
+
+            if(measuredSamples != m_samplesPerTrace || measuredCaptures != m_capturesPerRun){
+                throw RuntimeException("Measurement went wrong: samples*captures mismatch");
+            }
+
+            {
+                // The oscilloscope buffer is free again
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_downloadedRuns = run + 1;
+                m_cond.notify_all();
+            }
+
+            if(store) store(run);
+
+        } catch (std::exception & e) {
+            fail(e.what());
+            break;
+        }
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_storedRuns = run + 1;
+        m_cond.notify_all();
+
+    }
+
+}
+
+template <class T>
+void AcquisitionPipeline<T>::stop() {
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stop = true;
+    m_cond.notify_all();
+
+}
+
+template <class T>
+void AcquisitionPipeline<T>::fail(const char * what) {
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if(m_error.empty()) m_error = what;
+    m_stop = true;
+    m_cond.notify_all();
+
+}
+
+#endif /* ACQUISITIONPIPELINE_H */
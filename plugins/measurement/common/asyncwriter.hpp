@@ -0,0 +1,244 @@
+/*
+*  SICAK - SIde-Channel Analysis toolKit
+*  Copyright (C) 2018-2019 Petr Socha, FIT, CTU in Prague
+*
+*  This program is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation, either version 3 of the License, or
+*  (at your option) any later version.
+*
+*  This program is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/**
+* \file asyncwriter.hpp
+*
+* \brief Asynchronous writing of the measured data, used by the SICAK measurement scenario plugins to stream the data to disk during the measurement
+*
+*
+* \author Petr Socha
+* \version 1.0
+*/
+
+#ifndef ASYNCWRITER_H
+#define ASYNCWRITER_H
+
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "boundedqueue.hpp"
+#include "compressedtraces.hpp"
+#include "filehandling.hpp"
+#include "exceptions.hpp"
+#include "instrumentation.hpp"
+
+/**
+* \class TracesFileWriter
+* \ingroup Measurement
+*
+* \brief Appends power traces to a raw or compressed power traces file and keeps track of the number of power traces safely stored in the file. Meant to be used from the AsyncWriter jobs.
+*
+*/
+template <class T>
+class TracesFileWriter {
+
+public:
+
+    /// Writes power traces with 'samplesPerTrace' samples to the filestream, either raw or into the compressed container
+    TracesFileWriter(std::fstream & fs, size_t samplesPerTrace, bool compress) : m_fs(fs), m_samplesPerTrace(samplesPerTrace), m_rawTraces(0) {
+        if(compress) m_compressed.reset(new CompressedTracesWriter<T>(fs, samplesPerTrace));
+    }
+
+    /// Appends 'noOfTraces' power traces
+    void write(const T * traces, size_t noOfTraces){
+
+        if(m_compressed){
+            m_compressed->writeTraces(traces, noOfTraces);
+        } else {
+            writeArrayToFile(m_fs, traces, noOfTraces * m_samplesPerTrace);
+            m_rawTraces += noOfTraces;
+        }
+
+    }
+
+    /// Flushes the file, the power traces stored so far (storedTraces) survive a crash of the measurement
+    void flush(){
+
+        if(m_compressed) m_compressed->flush();
+        else m_fs.flush();
+
+        if(m_fs.fail()) throw RuntimeException("Could not write the power traces. Not enough space?");
+
+    }
+
+    /// Returns the number of samples per power trace
+    size_t samplesPerTrace() const { return m_samplesPerTrace; }
+
+    /// Writes all the remaining power traces, finishes the container when compressed
+    void close(){
+
+        if(m_compressed) m_compressed->close();
+        else m_fs.flush();
+
+    }
+
+    /// Returns the number of power traces stored in the file: compressed power traces are stored in whole chunks, the rest is stored on close
+    size_t storedTraces() const { return m_compressed ? m_compressed->encodedTraces() : m_rawTraces; }
+
+protected:
+
+    std::fstream & m_fs;
+    size_t m_samplesPerTrace;
+    size_t m_rawTraces;
+    std::unique_ptr<CompressedTracesWriter<T>> m_compressed;
+
+};
+
+/**
+* \class AsyncWriter
+* \ingroup Measurement
+*
+* \brief Executes the posted write jobs in order in a background thread. The queue of pending jobs is bounded, so that the writer works in constant memory: posting blocks while the queue is full.
+*
+* Every job records the phase "write-files", see PhaseTimer, along with the bytes and power traces written by writeArray and writeTraces.
+*
+*/
+class AsyncWriter {
+
+public:
+
+    /// A write job, executed in the writer thread
+    typedef std::function<void()> Job;
+
+    /// Starts the writer thread, with at most 'maxPendingJobs' jobs waiting
+    AsyncWriter(size_t maxPendingJobs = 16) : m_jobs(maxPendingJobs), m_finished(false), m_writtenBytes(0), m_writtenTraces(0) {
+        m_thread = std::thread(&AsyncWriter::work, this);
+    }
+
+    /// Waits for the pending jobs to be written
+    ~AsyncWriter() {
+        try {
+            finish();
+        } catch (std::exception & e) {
+            (void)e;
+        }
+    }
+
+    /// Posts the job, waits while the queue is full. Throws the error of an already failed job
+    void post(Job job){
+
+        checkError();
+
+        if(!m_jobs.push(std::move(job))) throw RuntimeException("The writer was already finished");
+
+    }
+
+    /// Posts a job writing the data to the filestream
+    template <class T>
+    void writeArray(std::fstream & fs, std::vector<T> data){
+
+        std::shared_ptr<std::vector<T>> shared = std::make_shared<std::vector<T>>(std::move(data));
+        post([this, &fs, shared](){
+            writeArrayToFile(fs, shared->data(), shared->size());
+            m_writtenBytes += shared->size() * sizeof(T);
+        });
+
+    }
+
+    /// Posts a job writing a copy of the array 'len' elements long to the filestream
+    template <class T>
+    void writeArray(std::fstream & fs, const T * data, size_t len){
+        writeArray(fs, std::vector<T>(data, data + len));
+    }
+
+    /// Posts a job appending the power traces to the power traces file
+    template <class T>
+    void writeTraces(TracesFileWriter<T> & tracesFile, std::vector<T> traces){
+
+        std::shared_ptr<std::vector<T>> shared = std::make_shared<std::vector<T>>(std::move(traces));
+        post([this, &tracesFile, shared](){
+            tracesFile.write(shared->data(), shared->size() / tracesFile.samplesPerTrace());
+            m_writtenBytes += shared->size() * sizeof(T);
+            m_writtenTraces += shared->size() / tracesFile.samplesPerTrace();
+        });
+
+    }
+
+    /// Posts a job appending a copy of 'noOfTraces' power traces to the power traces file
+    template <class T>
+    void writeTraces(TracesFileWriter<T> & tracesFile, const T * traces, size_t noOfTraces){
+        writeTraces(tracesFile, std::vector<T>(traces, traces + noOfTraces * tracesFile.samplesPerTrace()));
+    }
+
+    /// Waits for all the posted jobs to be written and stops the writer thread. Throws the error of a failed job
+    void finish(){
+
+        if(!m_finished){
+            m_finished = true;
+            m_jobs.close();
+            m_thread.join();
+        }
+
+        checkError();
+
+    }
+
+protected:
+
+    void work(){
+
+        Job job;
+        bool failed = false;
+
+        while(m_jobs.pop(job)){
+
+            if(failed) continue; // do not write anything after the failed job
+
+            try {
+                PhaseTimer timer("write-files");
+                m_writtenBytes = 0;
+                m_writtenTraces = 0;
+                job();
+                timer.addBytes(m_writtenBytes);
+                timer.addTraces(m_writtenTraces);
+            } catch (std::exception & e) {
+                std::lock_guard<std::mutex> lock(m_errorMutex);
+                m_error = e.what();
+                failed = true;
+                m_jobs.close();
+            }
+
+        }
+
+    }
+
+    void checkError(){
+
+        std::lock_guard<std::mutex> lock(m_errorMutex);
+        if(!m_error.empty()) throw RuntimeException(m_error.c_str());
+
+    }
+
+    BoundedQueue<Job> m_jobs;
+    std::thread m_thread;
+    bool m_finished;
+    std::mutex m_errorMutex;
+    std::string m_error;
+
+    /// Bytes and power traces written by the current job, accessed by the writer thread only
+    uint64_t m_writtenBytes;
+    uint64_t m_writtenTraces;
+
+};
+
+#endif /* ASYNCWRITER_H */
@@ -0,0 +1,142 @@
+/*
+*  SICAK - SIde-Channel Analysis toolKit
+*  Copyright (C) 2018-2019 Petr Socha, FIT, CTU in Prague
+*
+*  This program is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation, either version 3 of the License, or
+*  (at your option) any later version.
+*
+*  This program is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/**
+* \file livettest.hpp
+*
+* \brief On-line first-order univariate t-test evaluated during the measurement, used by the SICAK t-test measurement scenario plugins
+*
+*
+* \author Petr Socha
+* \version 1.0
+*/
+
+#ifndef LIVETTEST_H
+#define LIVETTEST_H
+
+#include <cmath>
+#include <cstring>
+#include "ompttest.hpp"
+#include "exceptions.hpp"
+#include "types_power.hpp"
+#include "types_stat.hpp"
+
+/**
+* \class LiveTTest
+* \ingroup Measurement
+*
+* \brief Accumulates the measured random and constant power traces into a t-test context and evaluates the t-test every 'interval' power traces.
+* Leakage is detected once the maximum |t| exceeds the threshold in 'confirmations' consecutive evaluations.
+*
+*/
+template <class T>
+class LiveTTest {
+
+public:
+
+    /// Constructor, threshold is e.g. 4.5
+    LiveTTest(size_t samplesPerTrace, double threshold, size_t confirmations, size_t interval) : m_samplesPerTrace(samplesPerTrace), m_threshold(threshold), m_confirmations(confirmations), m_interval(interval), m_context(samplesPerTrace, samplesPerTrace, 1, 1, 2, 2, 0), m_randomCount(0), m_constCount(0), m_exceeded(0), m_maxT(0), m_maxTSample(0) {
+
+        if(!samplesPerTrace || !confirmations || !interval) throw InvalidInputException("Invalid live t-test parameters");
+
+        m_context.reset();
+
+        // Up to 'interval' pending power traces of each group, accumulated in place
+        m_randomTraces.init(samplesPerTrace, interval);
+        m_constTraces.init(samplesPerTrace, interval);
+
+    }
+
+    /// Adds a power trace. Returns true when the t-test was evaluated
+    bool addTrace(const T * trace, bool constant){
+
+        if(constant){
+            std::memcpy(&( m_constTraces(0, m_constCount++) ), trace, m_samplesPerTrace * sizeof(T));
+        } else {
+            std::memcpy(&( m_randomTraces(0, m_randomCount++) ), trace, m_samplesPerTrace * sizeof(T));
+        }
+
+        if(m_randomCount + m_constCount < m_interval) return false;
+
+        evaluate();
+        return true;
+
+    }
+
+    /// Adds the pending power traces into the context and evaluates the t-test, when both groups contain at least 2 power traces
+    void evaluate(){
+
+        // Shrinking the buffers to the pending power traces does not reallocate them
+        m_randomTraces.init(m_samplesPerTrace, m_randomCount);
+        m_constTraces.init(m_samplesPerTrace, m_constCount);
+
+        UniFoTTestAddTraces(m_context, m_randomTraces, m_constTraces);
+
+        m_randomTraces.init(m_samplesPerTrace, m_interval);
+        m_constTraces.init(m_samplesPerTrace, m_interval);
+        m_randomCount = 0;
+        m_constCount = 0;
+
+        if(m_context.p1Card() < 2 || m_context.p2Card() < 2) return;
+
+        Matrix<double> tValsDegs;
+        UniFoTTestComputeTValsDegs(m_context, tValsDegs);
+
+        m_maxT = 0;
+        m_maxTSample = 0;
+
+        for(size_t sample = 0; sample < m_samplesPerTrace; sample++){
+            double t = std::fabs(tValsDegs(sample, 0));
+            if(t > m_maxT){ // NaN (zero variance) never passes
+                m_maxT = t;
+                m_maxTSample = sample;
+            }
+        }
+
+        m_exceeded = (m_maxT > m_threshold) ? m_exceeded + 1 : 0;
+
+    }
+
+    /// Returns true when the threshold was exceeded in the required number of consecutive evaluations
+    bool leakageDetected() const { return m_exceeded >= m_confirmations; }
+
+    /// Returns the maximum |t| of the last evaluation
+    double getMaxT() const { return m_maxT; }
+    /// Returns the sample with the maximum |t| of the last evaluation
+    size_t getMaxTSample() const { return m_maxTSample; }
+    /// Returns the number of power traces evaluated so far
+    size_t getTraces() const { return m_context.p1Card() + m_context.p2Card(); }
+
+protected:
+
+    size_t m_samplesPerTrace;
+    double m_threshold;
+    size_t m_confirmations;
+    size_t m_interval;
+    Moments2DContext<double> m_context;
+    PowerTraces<T> m_randomTraces;
+    PowerTraces<T> m_constTraces;
+    size_t m_randomCount;
+    size_t m_constCount;
+    size_t m_exceeded;
+    double m_maxT;
+    size_t m_maxTSample;
+
+};
+
+#endif /* LIVETTEST_H */
@@ -0,0 +1,196 @@
+/*
+*  SICAK - SIde-Channel Analysis toolKit
+*  Copyright (C) 2018-2019 Petr Socha, FIT, CTU in Prague
+*
+*  This program is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation, either version 3 of the License, or
+*  (at your option) any later version.
+*
+*  This program is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/**
+* \file targetprotocol.hpp
+*
+* \brief Communication protocols with command oriented targets, used by the SICAK measurement scenario plugins to exchange blocks of data via a CharDevice
+*
+*
+* \author Petr Socha
+* \version 1.0
+*/
+
+#ifndef TARGETPROTOCOL_H
+#define TARGETPROTOCOL_H
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+#include <QString>
+#include "chardevice.h"
+#include "exceptions.hpp"
+#include "crc16.hpp"
+
+/**
+* \class TargetProtocol
+* \ingroup Measurement
+*
+* \brief Exchanges blocks of data (e.g. plaintexts for ciphertexts) with a command oriented target, in one of the following modes:
+*
+*  - Single: {command, input block} is sent, output block is received, for every block. A full turnaround per block.
+*  - Window: up to 'window' requests {command, input block} are kept in flight, so that the target never waits for the host. Needs no support in the target,
+*    but the target's receive buffer must hold 'window' requests.
+*  - Batch: the whole batch is sent in a single frame {batch command, count, count input blocks, CRC}, the target answers with a single frame {count, count output blocks, CRC}.
+*    Needs support in the target. Counts are 16-bit little endian, CRC is CRC-16/CCITT-FALSE (little endian) of the count and the blocks.
+*
+* A count or a CRC mismatch of the batch frame means the communication got out of sync, an exception is thrown then.
+*
+*/
+class TargetProtocol {
+
+public:
+
+    /// Protocol mode
+    enum class Mode {
+        Single,
+        Window,
+        Batch
+    };
+
+    /// Constructor, the blocks are 'blockLen' bytes long, both in and out
+    TargetProtocol(CharDevice * charDevice, uint8_t command, uint8_t batchCommand, size_t blockLen, Mode mode = Mode::Single, size_t window = 8) : m_charDevice(charDevice), m_command(command), m_batchCommand(batchCommand), m_blockLen(blockLen), m_mode(mode), m_window(window) {
+
+        if(m_charDevice == nullptr) throw InvalidInputException("Character device is needed to talk to the target");
+        if(!m_blockLen || !m_window) throw InvalidInputException("Invalid target protocol parameters");
+
+    }
+
+    /// Parses the mode name: single, window or batch
+    static Mode parseMode(const QString & name){
+
+        if(name == "single") return Mode::Single;
+        else if(name == "window") return Mode::Window;
+        else if(name == "batch") return Mode::Batch;
+        else throw InvalidInputException("Invalid target protocol, use either single, window or batch");
+
+    }
+
+    /// Returns the protocol mode
+    Mode getMode() const { return m_mode; }
+
+    /// Sends 'count' input blocks and receives 'count' output blocks, blocks are stored one after another
+    void exchange(const uint8_t * input, uint8_t * output, size_t count){
+
+        switch(m_mode){
+            case Mode::Single: exchangeSingle(input, output, count); break;
+            case Mode::Window: exchangeWindow(input, output, count); break;
+            case Mode::Batch: exchangeBatch(input, output, count); break;
+        }
+
+    }
+
+protected:
+
+    /// Fills m_frame with 'count' requests {command, input block}
+    void buildRequests(const uint8_t * input, size_t count){
+
+        m_frame.resize(count * (m_blockLen + 1));
+
+        for(size_t block = 0; block < count; block++){
+            m_frame[block * (m_blockLen + 1)] = m_command;
+            std::copy(input + block * m_blockLen, input + (block + 1) * m_blockLen, m_frame.begin() + block * (m_blockLen + 1) + 1);
+        }
+
+    }
+
+    void exchangeSingle(const uint8_t * input, uint8_t * output, size_t count){
+
+        for(size_t block = 0; block < count; block++){
+
+            buildRequests(input + block * m_blockLen, 1);
+            m_charDevice->send(m_frame.data(), m_frame.size()); //< Command and the block in a single write
+            m_charDevice->receive(output + block * m_blockLen, m_blockLen);
+
+        }
+
+    }
+
+    void exchangeWindow(const uint8_t * input, uint8_t * output, size_t count){
+
+        size_t requestLen = m_blockLen + 1;
+
+        buildRequests(input, count);
+
+        // Fill the window
+        size_t sent = (count < m_window) ? count : m_window;
+        m_charDevice->send(m_frame.data(), sent * requestLen);
+
+        // Every received block makes room for another request
+        for(size_t block = 0; block < count; block++){
+
+            m_charDevice->receive(output + block * m_blockLen, m_blockLen);
+
+            if(sent < count){
+                m_charDevice->send(m_frame.data() + sent * requestLen, requestLen);
+                sent++;
+            }
+
+        }
+
+    }
+
+    void exchangeBatch(const uint8_t * input, uint8_t * output, size_t count){
+
+        if(count > 0xFFFF) throw InvalidInputException("Too many blocks in a single batch, at most 65535 are supported");
+
+        size_t dataLen = count * m_blockLen;
+
+        // {batch command, count, blocks, crc}
+        m_frame.resize(1 + 2 + dataLen + 2);
+        m_frame[0] = m_batchCommand;
+        m_frame[1] = (uint8_t)(count & 0xFF);
+        m_frame[2] = (uint8_t)(count >> 8);
+        std::copy(input, input + dataLen, m_frame.begin() + 3);
+
+        uint16_t crc = crc16(m_frame.data() + 1, 2 + dataLen);
+        m_frame[3 + dataLen] = (uint8_t)(crc & 0xFF);
+        m_frame[4 + dataLen] = (uint8_t)(crc >> 8);
+
+        m_charDevice->send(m_frame.data(), m_frame.size());
+
+        // {count, blocks, crc}
+        uint8_t header[2];
+        m_charDevice->receive(header, 2);
+
+        size_t receivedCount = header[0] | (header[1] << 8);
+        if(receivedCount != count) throw RuntimeException("Target communication out of sync: batch count mismatch");
+
+        m_charDevice->receive(output, dataLen);
+
+        uint8_t trailer[2];
+        m_charDevice->receive(trailer, 2);
+
+        crc = crc16(output, dataLen, crc16(header, 2));
+        if((trailer[0] | (trailer[1] << 8)) != crc) throw RuntimeException("Target communication out of sync: batch CRC mismatch");
+
+    }
+
+    CharDevice * m_charDevice;
+    uint8_t m_command;
+    uint8_t m_batchCommand;
+    size_t m_blockLen;
+    Mode m_mode;
+    /// Max number of requests in flight, in the Window mode
+    size_t m_window;
+    /// Outgoing data
+    std::vector<uint8_t> m_frame;
+
+};
+
+#endif /* TARGETPROTOCOL_H */
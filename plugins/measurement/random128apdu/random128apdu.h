@@ -63,7 +63,13 @@ public:
     virtual void run(const char * measurementId, size_t measurements, Oscilloscope * oscilloscope, CharDevice * charDevice) override;
     
 protected:
+    /// Performs the measurement, downloading samples of type T (int8_t or int16_t) from the oscilloscope
+    template <class T>
+    void measure(const char * measurementId, size_t measurements, Oscilloscope * oscilloscope, CharDevice * charDevice);
+    
     int m_channel;
+    bool m_compress;
+    QString m_sampleType;
     uint8_t m_cla;
     uint8_t m_ins;
     
@@ -6,6 +6,7 @@
 TEMPLATE        = lib
 CONFIG         += plugin
 QT             += widgets
+INCLUDEPATH    += ../common ../../common
 HEADERS        += random128apdu.h
 SOURCES        += random128apdu.cpp                
 TARGET          = $$qtLibraryTarget(sicakrandom128apdu)
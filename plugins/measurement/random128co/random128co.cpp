@@ -30,13 +30,17 @@
 #include <QTextStream>
 #include <QJsonObject>
 #include <QJsonDocument>
-#include <QFile>
+#include <QSaveFile>
+#include <QElapsedTimer>
 #include <random>
 #include "random128co.h"
 #include "filehandling.hpp"
 #include "global_calls.hpp"
+#include "acquisitionpipeline.hpp"
+#include "asyncwriter.hpp"
+#include "targetprotocol.hpp"
 
-Random128CO::Random128CO(): m_channel(1) {
+Random128CO::Random128CO(): m_channel(1), m_compress(false), m_sampleType("int16"), m_protocol("single"), m_window(8) {
     
 }
 
@@ -67,6 +71,47 @@ void Random128CO::init(const char * param){
              m_channel = paramVal.toInt();
              if(m_channel < 0) throw RuntimeException("Invalid measurement channel param");                          
              
+         } else if(params.at(i).startsWith("format=")){
+             
+             paramVal = params.at(i);
+             paramVal.remove(0,7);
+             
+             if(paramVal == "raw"){
+                 m_compress = false;
+             } else if(paramVal == "compressed"){
+                 m_compress = true;
+             } else {
+                 throw RuntimeException("Invalid traces format param, use either raw or compressed");
+             }
+             
+         } else if(params.at(i).startsWith("type=")){
+             
+             paramVal = params.at(i);
+             paramVal.remove(0,5);
+             
+             if(paramVal != "int8" && paramVal != "int16") throw RuntimeException("Invalid sample type param, use either int8 or int16");
+             
+             m_sampleType = paramVal;
+             
+         } else if(params.at(i).startsWith("protocol=")){
+             
+             paramVal = params.at(i);
+             paramVal.remove(0,9);
+             
+             if(paramVal != "single" && paramVal != "window" && paramVal != "batch") throw RuntimeException("Invalid protocol param, use either single, window or batch");
+             
+             m_protocol = paramVal;
+             
+         } else if(params.at(i).startsWith("window=")){
+             
+             paramVal = params.at(i);
+             paramVal.remove(0,7);
+             
+             bool ok;
+             m_window = paramVal.toUInt(&ok);
+             
+             if(!ok || !m_window) throw RuntimeException("Invalid protocol window param");
+             
          } 
          
     }        
@@ -79,6 +124,17 @@ void Random128CO::deInit(){
 
 void Random128CO::run(const char * measurementId, size_t measurements, Oscilloscope * oscilloscope, CharDevice * charDevice){
     
+    if(m_sampleType == "int8"){
+        measure<int8_t>(measurementId, measurements, oscilloscope, charDevice);
+    } else {
+        measure<int16_t>(measurementId, measurements, oscilloscope, charDevice);
+    }
+    
+}
+
+template <class T>
+void Random128CO::measure(const char * measurementId, size_t measurements, Oscilloscope * oscilloscope, CharDevice * charDevice){
+    
     if(oscilloscope == nullptr || charDevice == nullptr){
         throw RuntimeException("Oscilloscope and character device are needed to run this measurement.");
     }
@@ -105,14 +161,11 @@ void Random128CO::run(const char * measurementId, size_t measurements, Oscillosc
     CoutProgress::get().start(measurements);
         
     // Alloc space
-    Matrix<uint8_t> plaintext(16, measurements);
-    Matrix<uint8_t> ciphertext(16, measurements);
-    PowerTraces<int16_t> measuredTraces(samplesPerTrace, measurements); 
     Vector<uint8_t> command(1); 
     
     QString tracesFilename = "random-traces-";
     tracesFilename.append(measurementId);
-    tracesFilename.append(".bin");
+    tracesFilename.append(m_compress ? ".ctr" : ".bin");
     QString plaintextFilename = "plaintext-";
     plaintextFilename.append(measurementId);
     plaintextFilename.append(".bin");
@@ -144,71 +197,114 @@ void Random128CO::run(const char * measurementId, size_t measurements, Oscillosc
     
     // Measure
     size_t runs = measurements / capturesPerRun; //< Number of independent oscilloscope runs
-    command(0) = 0x02; //< "Encryption" command        
     
-    // We run the oscilloscope runs times
-    for(size_t run = 0; run < runs; run++){
+    // Encryption command (0x02), or batch encryption command (0x03) in the batch protocol
+    TargetProtocol target(charDevice, 0x02, 0x03, 16, TargetProtocol::parseMode(m_protocol), m_window);
+    size_t blocksPerExchange = (target.getMode() == TargetProtocol::Mode::Single) ? 1 : capturesPerRun; //< Window and batch protocols exchange the whole run at once
+    
+    AcquisitionPipeline<T> pipeline(oscilloscope, m_channel, samplesPerTrace, capturesPerRun);
+    
+    // Alloc space for the measurements kept in the pipeline's ring
+    Matrix<uint8_t> plaintext(16, pipeline.getRingSize());
+    Matrix<uint8_t> ciphertext(16, pipeline.getRingSize());
+    
+    // The measured data get streamed to files during the measurement
+    TracesFileWriter<T> tracesWriter(tracesFile, samplesPerTrace, m_compress);
+    
+    QString tracesDocFilename = measurementId;
+    tracesDocFilename.append(".json");
+    
+    // Flush config to json file, describing just the data already stored in the files
+    auto writeConfig = [&](){
+        
+        QJsonObject tracesConf;
+        tracesConf["random-traces"] = tracesFilename;
+        tracesConf["random-traces-count"] = QString::number(tracesWriter.storedTraces());
+        tracesConf["samples-per-trace"] = QString::number(samplesPerTrace);
+        tracesConf["sample-type"] = m_sampleType;
+        tracesConf["blocks"] = plaintextFilename;
+        tracesConf["blocks"] = ciphertextFilename;
+        tracesConf["blocks-count"] = QString::number(tracesWriter.storedTraces());    
+        tracesConf["blocks-length"] = QString::number(16);
+        QJsonDocument tracesDoc(tracesConf);
+        QSaveFile tracesDocFile(tracesDocFilename);
+        if(tracesDocFile.open(QIODevice::WriteOnly)){
+            tracesDocFile.write(tracesDoc.toJson());
+            tracesDocFile.commit();
+        }
+        
+    };
+    
+    // Flush the files and the json config, so that a crash of the measurement loses as little data as possible
+    auto sync = [&](){
         
-        try { // try to perform a measurement run
+        tracesWriter.flush();
+        plaintextFile.flush();
+        ciphertextFile.flush();
+        writeConfig();
         
-            oscilloscope->run(); //< Start capturing capturesPerRun captures
+    };
+    
+    QElapsedTimer syncTimer;
+    syncTimer.start();
+    
+    // Constructed last, so that the pending writes finish before the objects they use get destroyed
+    AsyncWriter writer;
+    
+    // Talk to the target during every capture, the captured power traces get downloaded in parallel by the pipeline
+    auto exchange = [&](size_t measurement){
+        
+        size_t i = pipeline.getRingIndex(measurement); //< Position of the measurement in the ring
+        
+        // Generate random plaintext
+        for(int byte = 0; byte < 16; byte++){
             
-            // Send capturesPerRun blocks to cipher
-            for(size_t capture = 0; capture < capturesPerRun; capture++){                     
-                
-                size_t measurement = run * capturesPerRun + capture; //< Number of current measurement
-                
-                // Generate random plaintext
-                for(int byte = 0; byte < 16; byte++){
+            plaintext(byte, i) = (uint8_t) byteUnif(prng);
                     
-                    plaintext(byte, measurement) = (uint8_t) byteUnif(prng);
-                            
-                }
-                
-                // Send plaintext
-                charDevice->send(command); //< Send the encryption command
-                charDevice->send( &( plaintext(0, measurement) ), 16); //< Send 16 bytes of plaintext //TODO MatrixRowPtr
-                
-                // Receive ciphertext
-                charDevice->receive( &( ciphertext(0, measurement) ), 16); //< Receive 16 bytes of ciphertext //TODO MatrixRowPtr
-                
-                CoutProgress::get().update(measurement);
-                
-            }
-            
-            size_t measuredSamples;
-            size_t measuredCaptures;
-            
-            // Download the sampled data from oscilloscope
-            oscilloscope->getValues(m_channel, &( measuredTraces(0, run * capturesPerRun) ), capturesPerRun * samplesPerTrace, measuredSamples, measuredCaptures);
-            
-            if(measuredSamples != samplesPerTrace || measuredCaptures != capturesPerRun){
-                throw RuntimeException("Measurement went wrong: samples*captures mismatch");
-            }
+        }
         
-        } catch (std::exception & e){ // an oscilloscope run or communication with the target failed            
-            
-            cout << QString("\n[!] An error has occured during the %1. oscilloscope run: %2\n").arg(run+1).arg(e.what());                                    
-            cout << QString("[!] Before an error, %1 power traces were measured and will be saved.\n").arg(run * capturesPerRun);
-            cout.flush();
-            
-            measurements = run * capturesPerRun; // update the number of succesfully performed measurements                             
-            
-            // Shrink the containers to fit the data actually measured
-            measuredTraces.shrinkRows(measurements);
-            plaintext.shrinkRows(measurements);
-            ciphertext.shrinkRows(measurements);
-            
-            break; // break the measurement
-            
+        if((measurement + 1) % blocksPerExchange) return; //< Wait for the rest of the run's plaintexts
+        
+        size_t first = pipeline.getRingIndex(measurement + 1 - blocksPerExchange); //< Measurements of a run are contiguous in the ring
+        
+        // Send plaintexts, receive ciphertexts
+        target.exchange( &( plaintext(0, first) ), &( ciphertext(0, first) ), blocksPerExchange);
+        
+        CoutProgress::get().update(measurement);
+        
+    };
+    
+    // Stream the data of every downloaded run to files, called in the consumer thread of the pipeline
+    auto store = [&](size_t run){
+        
+        size_t first = pipeline.getRingIndex(run * capturesPerRun);
+        
+        writer.writeTraces(tracesWriter, &( pipeline.getTraces()(0, first) ), capturesPerRun);
+        writer.writeArray(plaintextFile, &( plaintext(0, first) ), 16 * capturesPerRun);
+        writer.writeArray(ciphertextFile, &( ciphertext(0, first) ), 16 * capturesPerRun);
+        
+        if(syncTimer.elapsed() >= 1000){
+            writer.post(sync);
+            syncTimer.restart();
         }
         
+    };
+    
+    size_t measuredRuns = pipeline.measure(runs, exchange, store);
+    
+    if(measuredRuns < runs){ // an oscilloscope run or communication with the target failed
+        
+        cout << QString("\n[!] An error has occured during the %1. oscilloscope run: %2\n").arg(measuredRuns+1).arg(pipeline.getError().c_str());
+        cout << QString("[!] Before an error, %1 power traces were measured and will be saved.\n").arg(measuredRuns * capturesPerRun);
+        cout.flush();
+        
+        measurements = measuredRuns * capturesPerRun; // update the number of succesfully performed measurements                             
+        
     }
     
-    // Write data to files
-    writeArrayToFile(tracesFile, measuredTraces);
-    writeArrayToFile(plaintextFile, plaintext);
-    writeArrayToFile(ciphertextFile, ciphertext);
+    // Write the rest of the data and the final json config
+    writer.post([&](){ tracesWriter.close(); writeConfig(); });
+    writer.finish();
     
     // Close files
     closeFile(tracesFile);
@@ -217,23 +313,6 @@ void Random128CO::run(const char * measurementId, size_t measurements, Oscillosc
     
     CoutProgress::get().finish();
     
-    // Flush config to json files
-    QJsonObject tracesConf;
-    tracesConf["random-traces"] = tracesFilename;
-    tracesConf["random-traces-count"] = QString::number(measurements);
-    tracesConf["samples-per-trace"] = QString::number(samplesPerTrace);
-    tracesConf["blocks"] = plaintextFilename;
-    tracesConf["blocks"] = ciphertextFilename;
-    tracesConf["blocks-count"] = QString::number(measurements);    
-    tracesConf["blocks-length"] = QString::number(16);
-    QJsonDocument tracesDoc(tracesConf);
-    QString tracesDocFilename = measurementId;
-    tracesDocFilename.append(".json");
-    QFile tracesDocFile(tracesDocFilename);
-    if(tracesDocFile.open(QIODevice::WriteOnly)){
-        tracesDocFile.write(tracesDoc.toJson());
-    }
-    
     cout << QString("Measured %1 power traces, %5 samples per trace, and saved them to '%2'.\nUsed plaintext blocks were saved to '%3', retrieved ciphertext blocks were saved to '%4'.\n").arg(measurements).arg(tracesFilename).arg(plaintextFilename).arg(ciphertextFilename).arg(samplesPerTrace);
     
 }
@@ -6,6 +6,7 @@
 TEMPLATE        = lib
 CONFIG         += plugin
 QT             += widgets
+INCLUDEPATH    += ../common ../../common
 HEADERS        += random128co.h
 SOURCES        += random128co.cpp                
 TARGET          = $$qtLibraryTarget(sicakrandom128co)
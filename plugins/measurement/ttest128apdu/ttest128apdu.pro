@@ -6,6 +6,7 @@
 TEMPLATE        = lib
 CONFIG         += plugin
 QT             += widgets
+INCLUDEPATH    += ../common ../../common ../../ttestengine/common
 HEADERS        += ttest128apdu.h
 SOURCES        += ttest128apdu.cpp                
 TARGET          = $$qtLibraryTarget(sicakttest128apdu)
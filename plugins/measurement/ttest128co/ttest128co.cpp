@@ -30,13 +30,19 @@
 #include <QTextStream>
 #include <QJsonObject>
 #include <QJsonDocument>
-#include <QFile>
+#include <QSaveFile>
+#include <QElapsedTimer>
 #include <random>
+#include <memory>
 #include "ttest128co.h"
 #include "filehandling.hpp"
 #include "global_calls.hpp"
+#include "acquisitionpipeline.hpp"
+#include "asyncwriter.hpp"
+#include "targetprotocol.hpp"
+#include "livettest.hpp"
 
-TTest128CO::TTest128CO(): m_channel(1) {
+TTest128CO::TTest128CO(): m_channel(1), m_compress(false), m_sampleType("int16"), m_protocol("single"), m_window(8), m_threshold(0), m_confirmations(3), m_interval(1000) {
     
 }
 
@@ -67,6 +73,77 @@ void TTest128CO::init(const char * param){
              m_channel = paramVal.toInt();
              if(m_channel < 0) throw RuntimeException("Invalid measurement channel param");                          
              
+         } else if(params.at(i).startsWith("format=")){
+             
+             paramVal = params.at(i);
+             paramVal.remove(0,7);
+             
+             if(paramVal == "raw"){
+                 m_compress = false;
+             } else if(paramVal == "compressed"){
+                 m_compress = true;
+             } else {
+                 throw RuntimeException("Invalid traces format param, use either raw or compressed");
+             }
+             
+         } else if(params.at(i).startsWith("type=")){
+             
+             paramVal = params.at(i);
+             paramVal.remove(0,5);
+             
+             if(paramVal != "int8" && paramVal != "int16") throw RuntimeException("Invalid sample type param, use either int8 or int16");
+             
+             m_sampleType = paramVal;
+             
+         } else if(params.at(i).startsWith("protocol=")){
+             
+             paramVal = params.at(i);
+             paramVal.remove(0,9);
+             
+             if(paramVal != "single" && paramVal != "window" && paramVal != "batch") throw RuntimeException("Invalid protocol param, use either single, window or batch");
+             
+             m_protocol = paramVal;
+             
+         } else if(params.at(i).startsWith("window=")){
+             
+             paramVal = params.at(i);
+             paramVal.remove(0,7);
+             
+             bool ok;
+             m_window = paramVal.toUInt(&ok);
+             
+             if(!ok || !m_window) throw RuntimeException("Invalid protocol window param");
+             
+         } else if(params.at(i).startsWith("threshold=")){
+             
+             paramVal = params.at(i);
+             paramVal.remove(0,10);
+             
+             bool ok;
+             m_threshold = paramVal.toDouble(&ok);
+             
+             if(!ok || m_threshold <= 0) throw RuntimeException("Invalid live t-test threshold param");
+             
+         } else if(params.at(i).startsWith("confirmations=")){
+             
+             paramVal = params.at(i);
+             paramVal.remove(0,14);
+             
+             bool ok;
+             m_confirmations = paramVal.toUInt(&ok);
+             
+             if(!ok || !m_confirmations) throw RuntimeException("Invalid live t-test confirmations param");
+             
+         } else if(params.at(i).startsWith("interval=")){
+             
+             paramVal = params.at(i);
+             paramVal.remove(0,9);
+             
+             bool ok;
+             m_interval = paramVal.toUInt(&ok);
+             
+             if(!ok || !m_interval) throw RuntimeException("Invalid live t-test interval param");
+             
          } 
          
     }
@@ -79,6 +156,17 @@ void TTest128CO::deInit(){
 
 void TTest128CO::run(const char * measurementId, size_t measurements, Oscilloscope * oscilloscope, CharDevice * charDevice){
     
+    if(m_sampleType == "int8"){
+        measure<int8_t>(measurementId, measurements, oscilloscope, charDevice);
+    } else {
+        measure<int16_t>(measurementId, measurements, oscilloscope, charDevice);
+    }
+    
+}
+
+template <class T>
+void TTest128CO::measure(const char * measurementId, size_t measurements, Oscilloscope * oscilloscope, CharDevice * charDevice){
+    
     if(oscilloscope == nullptr || charDevice == nullptr){
         throw RuntimeException("Oscilloscope and character device are needed to run this measurement.");
     }
@@ -105,21 +193,15 @@ void TTest128CO::run(const char * measurementId, size_t measurements, Oscillosco
     CoutProgress::get().start(measurements);
         
     // Alloc space
-    Matrix<uint8_t> plaintext(16, measurements);
-    Matrix<uint8_t> ciphertext(16, measurements);
-    PowerTraces<int16_t> measuredTraces(samplesPerTrace, measurements); 
     Vector<uint8_t> command(1); 
     
-    // Constant vs random traces array
-    Vector<uint8_t> isTraceConstant(measurements);
-    
     // Filenames
     QString randTracesFilename = "random-traces-";
     randTracesFilename.append(measurementId);
-    randTracesFilename.append(".bin");
+    randTracesFilename.append(m_compress ? ".ctr" : ".bin");
     QString constTracesFilename = "constant-traces-";
     constTracesFilename.append(measurementId);
-    constTracesFilename.append(".bin");
+    constTracesFilename.append(m_compress ? ".ctr" : ".bin");
     QString plaintextFilename = "plaintext-";
     plaintextFilename.append(measurementId);
     plaintextFilename.append(".bin");
@@ -157,101 +239,192 @@ void TTest128CO::run(const char * measurementId, size_t measurements, Oscillosco
     
     // Measure
     size_t runs = measurements / capturesPerRun; //< Number of independent oscilloscope runs
-    command(0) = 0x02; //< "Encryption" command        
     
-    // We run the oscilloscope runs times
-    for(size_t run = 0; run < runs; run++){
+    // Encryption command (0x02), or batch encryption command (0x03) in the batch protocol
+    TargetProtocol target(charDevice, 0x02, 0x03, 16, TargetProtocol::parseMode(m_protocol), m_window);
+    size_t blocksPerExchange = (target.getMode() == TargetProtocol::Mode::Single) ? 1 : capturesPerRun; //< Window and batch protocols exchange the whole run at once
+    
+    AcquisitionPipeline<T> pipeline(oscilloscope, m_channel, samplesPerTrace, capturesPerRun);
+    
+    // Alloc space for the measurements kept in the pipeline's ring
+    Matrix<uint8_t> plaintext(16, pipeline.getRingSize());
+    Matrix<uint8_t> ciphertext(16, pipeline.getRingSize());
+    Vector<uint8_t> isTraceConstant(pipeline.getRingSize()); //< Constant vs random traces array
+    
+    // The measured data get streamed to files during the measurement
+    TracesFileWriter<T> randomTracesWriter(randomTracesFile, samplesPerTrace, m_compress);
+    TracesFileWriter<T> constTracesWriter(constTracesFile, samplesPerTrace, m_compress);
+    
+    QString tracesDocFilename = measurementId;
+    tracesDocFilename.append(".json");
+    
+    // Flush config to json file, describing just the data already stored in the files
+    auto writeConfig = [&](){
+        
+        QJsonObject tracesConf;
+        tracesConf["random-traces"] = randTracesFilename;
+        tracesConf["random-traces-count"] = QString::number(randomTracesWriter.storedTraces());
+        tracesConf["constant-traces"] = constTracesFilename;
+        tracesConf["constant-traces-count"] = QString::number(constTracesWriter.storedTraces());
+        tracesConf["samples-per-trace"] = QString::number(samplesPerTrace);
+        tracesConf["sample-type"] = m_sampleType;
+        tracesConf["blocks-count"] = QString::number(randomTracesWriter.storedTraces());    
+        tracesConf["blocks-length"] = QString::number(16);
+        QJsonDocument tracesDoc(tracesConf);
+        QSaveFile tracesDocFile(tracesDocFilename);
+        if(tracesDocFile.open(QIODevice::WriteOnly)){
+            tracesDocFile.write(tracesDoc.toJson());
+            tracesDocFile.commit();
+        }
         
-        try { // try to perform a measurement run
+    };
+    
+    // Flush the files and the json config, so that a crash of the measurement loses as little data as possible
+    auto sync = [&](){
+        
+        randomTracesWriter.flush();
+        constTracesWriter.flush();
+        plaintextFile.flush();
+        ciphertextFile.flush();
+        writeConfig();
+        
+    };
+    
+    QElapsedTimer syncTimer;
+    syncTimer.start();
+    
+    // Optional live t-test, evaluated as the power traces arrive
+    std::unique_ptr<LiveTTest<T>> liveTTest;
+    if(m_threshold > 0) liveTTest.reset(new LiveTTest<T>(samplesPerTrace, m_threshold, m_confirmations, m_interval));
+    
+    // Constructed last, so that the pending writes finish before the objects they use get destroyed
+    AsyncWriter writer;
+    
+    // Talk to the target during every capture, the captured power traces get downloaded in parallel by the pipeline
+    auto exchange = [&](size_t measurement){
+        
+        size_t i = pipeline.getRingIndex(measurement); //< Position of the measurement in the ring
+        
+        isTraceConstant(i) = (uint8_t) bitUnif(prng) % 2; //< Decide whatever next measurement will be random or constant                        
+        
+        if(isTraceConstant(i)){
+        
+            // Use constant plaintext
+            for(int byte = 0; byte < 16; byte++){
+                
+                plaintext(byte, i) = constPlaintext[byte];
+                        
+            }   
             
-            oscilloscope->run(); //< Start capturing capturesPerRun captures
+        } else {
             
-            // Send capturesPerRun blocks to cipher
-            for(size_t capture = 0; capture < capturesPerRun; capture++){                     
-                
-                size_t measurement = run * capturesPerRun + capture; //< Number of current measurement
-                
-                isTraceConstant(measurement) = (uint8_t) bitUnif(prng) % 2; //< Decide whatever next measurement will be random or constant                        
+            // Generate random plaintext
+            for(int byte = 0; byte < 16; byte++){
                 
-                if(isTraceConstant(measurement)){
-                
-                    // Use constant plaintext
-                    for(int byte = 0; byte < 16; byte++){
-                        
-                        plaintext(byte, measurement) = constPlaintext[byte];
-                                
-                    }   
-                    
-                } else {
-                    
-                    // Generate random plaintext
-                    for(int byte = 0; byte < 16; byte++){
+                plaintext(byte, i) = (uint8_t) byteUnif(prng);
                         
-                        plaintext(byte, measurement) = (uint8_t) byteUnif(prng);
-                                
-                    }                                
-                    
-                }                                                
+            }                                
+            
+        }                                                
+        
+        if((measurement + 1) % blocksPerExchange) return; //< Wait for the rest of the run's plaintexts
+        
+        size_t first = pipeline.getRingIndex(measurement + 1 - blocksPerExchange); //< Measurements of a run are contiguous in the ring
+        
+        // Send plaintexts, receive ciphertexts
+        target.exchange( &( plaintext(0, first) ), &( ciphertext(0, first) ), blocksPerExchange);
+        
+        CoutProgress::get().update(measurement);
+        
+    };
+    
+    // Stream the data of every downloaded run to files, called in the consumer thread of the pipeline
+    auto store = [&](size_t run){
+        
+        std::vector<T> randomTraces, constTraces;
+        std::vector<uint8_t> randomPlaintext, randomCiphertext;
+        bool evaluated = false;
+        
+        for(size_t capture = 0; capture < capturesPerRun; capture++){
+            
+            size_t i = pipeline.getRingIndex(run * capturesPerRun + capture);
+            const T * trace = &( pipeline.getTraces()(0, i) );
+            
+            if(liveTTest && liveTTest->addTrace(trace, isTraceConstant(i))) evaluated = true;
+            
+            if(isTraceConstant(i)){
                 
-                // Send plaintext
-                charDevice->send(command); //< Send the encryption command
-                charDevice->send( &( plaintext(0, measurement) ), 16); //< Send 16 bytes of plaintext //TODO MatrixRowPtr
+                constTraces.insert(constTraces.end(), trace, trace + samplesPerTrace);
                 
-                // Receive ciphertext
-                charDevice->receive( &( ciphertext(0, measurement) ), 16); //< Receive 16 bytes of ciphertext //TODO MatrixRowPtr
+            } else {
                 
-                CoutProgress::get().update(measurement);
+                randomTraces.insert(randomTraces.end(), trace, trace + samplesPerTrace);
+                randomPlaintext.insert(randomPlaintext.end(), &( plaintext(0, i) ), &( plaintext(0, i) ) + 16);
+                randomCiphertext.insert(randomCiphertext.end(), &( ciphertext(0, i) ), &( ciphertext(0, i) ) + 16);
                 
             }
             
-            size_t measuredSamples;
-            size_t measuredCaptures;
-            
-            // Download the sampled data from oscilloscope
-            oscilloscope->getValues(m_channel, &( measuredTraces(0, run * capturesPerRun) ), capturesPerRun * samplesPerTrace, measuredSamples, measuredCaptures);
-            
-            if(measuredSamples != samplesPerTrace || measuredCaptures != capturesPerRun){
-                throw RuntimeException("Measurement went wrong: samples*captures mismatch");
-            }
+        }
         
-        } catch (std::exception & e){ // an oscilloscope run or communication with the target failed            
-            
-            cout << QString("\n[!] An error has occured during the %1. oscilloscope run: %2\n").arg(run+1).arg(e.what());                                    
-            cout << QString("[!] Before an error, %1 power traces were measured and will be saved.\n").arg(run * capturesPerRun);
-            cout.flush();
-            
-            measurements = run * capturesPerRun; // update the number of succesfully performed measurements                             
+        writer.writeTraces(randomTracesWriter, std::move(randomTraces));
+        writer.writeTraces(constTracesWriter, std::move(constTraces));
+        writer.writeArray(plaintextFile, std::move(randomPlaintext));
+        writer.writeArray(ciphertextFile, std::move(randomCiphertext));
+        
+        // Report the live t-test, stop the measurement once the leakage is detected
+        if(evaluated){
             
-            // No need to shrink the containers here, since every single measurement is written to file separately
+            // Shown by the progress bar, which is drawn by the producer thread
+            CoutProgress::get().setStatus(QString("[t] %1 power traces evaluated, max |t| = %2 at sample %3").arg(liveTTest->getTraces()).arg(liveTTest->getMaxT(), 0, 'f', 2).arg(liveTTest->getMaxTSample()).toStdString());
             
-            break; // break the measurement
+            if(liveTTest->leakageDetected()) pipeline.stop();
             
         }
         
-    }
+        if(syncTimer.elapsed() >= 1000){
+            writer.post(sync);
+            syncTimer.restart();
+        }
+        
+    };
     
-    size_t randomTracesN = 0;
-    size_t constTracesN = 0;    
+    size_t measuredRuns = pipeline.measure(runs, exchange, store);
     
-    // Write data to files
-    for(size_t i = 0; i < measurements; i++){
-     
-        if(isTraceConstant(i)){
-            
-            constTracesN++;
-            writeArrayToFile(constTracesFile, &( measuredTraces(0, i) ), samplesPerTrace);
-            
+    if(measuredRuns < runs && !pipeline.getError().empty()){ // an oscilloscope run or communication with the target failed
+        
+        cout << QString("\n[!] An error has occured during the %1. oscilloscope run: %2\n").arg(measuredRuns+1).arg(pipeline.getError().c_str());
+        cout << QString("[!] Before an error, %1 power traces were measured and will be saved.\n").arg(measuredRuns * capturesPerRun);
+        cout.flush();
+        
+        measurements = measuredRuns * capturesPerRun; // update the number of succesfully performed measurements                             
+        
+    } else if(measuredRuns < runs){ // stopped by the live t-test
+        
+        cout << QString("\n[t] Leakage detected: max |t| exceeded %1 in %2 consecutive evaluations, the measurement was stopped after %3 power traces.\n").arg(m_threshold).arg(m_confirmations).arg(measuredRuns * capturesPerRun);
+        cout.flush();
+        
+        measurements = measuredRuns * capturesPerRun; // update the number of performed measurements
+        
+    } else if(liveTTest){
+        
+        liveTTest->evaluate(); // evaluate the rest of the power traces
+        
+        if(liveTTest->getMaxT() > m_threshold){
+            cout << QString("\n[t] All %1 power traces measured, max |t| = %2 at sample %3 exceeds %4.\n").arg(measurements).arg(liveTTest->getMaxT(), 0, 'f', 2).arg(liveTTest->getMaxTSample()).arg(m_threshold);
         } else {
-            
-            randomTracesN++;
-            writeArrayToFile(randomTracesFile, &( measuredTraces(0, i) ), samplesPerTrace);
-            writeArrayToFile(plaintextFile, &( plaintext(0, i) ), 16);
-            writeArrayToFile(ciphertextFile, &( ciphertext(0, i) ), 16);
-            
+            cout << QString("\n[t] No leakage detected within %1 power traces, max |t| = %2 at sample %3.\n").arg(measurements).arg(liveTTest->getMaxT(), 0, 'f', 2).arg(liveTTest->getMaxTSample());
         }
+        cout.flush();
         
     }
     
+    // Write the rest of the data and the final json config
+    writer.post([&](){ randomTracesWriter.close(); constTracesWriter.close(); writeConfig(); });
+    writer.finish();
+    
+    size_t randomTracesN = randomTracesWriter.storedTraces();
+    size_t constTracesN = constTracesWriter.storedTraces();
+    
     // Close files
     closeFile(randomTracesFile);
     closeFile(constTracesFile);
@@ -260,23 +433,6 @@ void TTest128CO::run(const char * measurementId, size_t measurements, Oscillosco
     
     CoutProgress::get().finish();
     
-    // Flush config to json files
-    QJsonObject tracesConf;
-    tracesConf["random-traces"] = randTracesFilename;
-    tracesConf["random-traces-count"] = QString::number(randomTracesN);
-    tracesConf["constant-traces"] = constTracesFilename;
-    tracesConf["constant-traces-count"] = QString::number(constTracesN);
-    tracesConf["samples-per-trace"] = QString::number(samplesPerTrace);
-    tracesConf["blocks-count"] = QString::number(randomTracesN);    
-    tracesConf["blocks-length"] = QString::number(16);
-    QJsonDocument tracesDoc(tracesConf);
-    QString tracesDocFilename = measurementId;
-    tracesDocFilename.append(".json");
-    QFile tracesDocFile(tracesDocFilename);
-    if(tracesDocFile.open(QIODevice::WriteOnly)){
-        tracesDocFile.write(tracesDoc.toJson());
-    }
-    
     cout << QString("Measured %1 power traces in total, %8 samples per trace,\n%2 random data based power traces were saved to '%3',\n%4 constant data based power traces were saved to '%5'.\nRandom plaintext blocks were saved to '%6', related ciphertext blocks were saved to '%7'.\n").arg(measurements).arg(randomTracesN).arg(randTracesFilename).arg(constTracesN).arg(constTracesFilename).arg(plaintextFilename).arg(ciphertextFilename).arg(samplesPerTrace);
     
 }
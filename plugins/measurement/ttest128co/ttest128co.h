@@ -63,7 +63,23 @@ public:
     virtual void run(const char * measurementId, size_t measurements, Oscilloscope * oscilloscope, CharDevice * charDevice) override;
     
 protected:
+    /// Performs the measurement, downloading samples of type T (int8_t or int16_t) from the oscilloscope
+    template <class T>
+    void measure(const char * measurementId, size_t measurements, Oscilloscope * oscilloscope, CharDevice * charDevice);
+    
     int m_channel;    
+    bool m_compress;
+    QString m_sampleType;
+    /// Target communication protocol: single, window or batch
+    QString m_protocol;
+    /// Max number of requests in flight, in the window protocol
+    size_t m_window;
+    /// Live t-test threshold, 0 disables the live t-test
+    double m_threshold;
+    /// Number of consecutive live t-test evaluations exceeding the threshold, which stop the measurement
+    size_t m_confirmations;
+    /// Number of power traces between the live t-test evaluations
+    size_t m_interval;
     
 };
 
@@ -6,6 +6,7 @@
 TEMPLATE        = lib
 CONFIG         += plugin
 QT             += widgets
+INCLUDEPATH    += ../common ../../common ../../ttestengine/common
 HEADERS        += ttest128co.h
 SOURCES        += ttest128co.cpp                
 TARGET          = $$qtLibraryTarget(sicakttest128co)
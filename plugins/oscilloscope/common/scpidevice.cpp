@@ -26,7 +26,10 @@
 * \version 1.1
 */
 
+#include <algorithm>
+#include <thread>
 #include "scpidevice.h"
+#include "boundedqueue.hpp"
 
 ScpiDevice::ScpiDevice(): m_opened(false) {
     
@@ -217,154 +220,273 @@ size_t ScpiDevice::sendIEEEBlock(const std::string & command, const char * data,
     for (int i = 0; i < 8 - (int64_t)lenStr.length(); i++) header.append("0");
     header.append(lenStr);
 
-    // Prepare the whole IEEE 488.2 data block message        
-    int messageLen = header.length() + len + 1; // header + payload + newline 
-    std::unique_ptr<char[]> buffer(new char[messageLen]);
+    // The whole IEEE 488.2 data block message: header, payload and newline, sent as a single message without copying the payload
+    size_t messageLen = header.length() + len + 1;
+    
+    #ifdef _WIN32
 
-    std::memcpy(buffer.get(), header.c_str(), header.length());
-    std::memcpy(buffer.get() + header.length(), data, len);
-    *(buffer.get() + header.length() + len) = '\n';
+    ViUInt32 retCount = 0;
+    size_t sentBytes = 0;
+    ViStatus ret;
 
-    #ifdef _WIN32
+    // Send the header and the payload without the END indicator, so that the device receives a single message
+    ret = viSetAttribute(m_instrument, VI_ATTR_SEND_END_EN, VI_FALSE);
+    if (ret < VI_SUCCESS) throw RuntimeException("Could not set the VISA device END indicator", ret);
 
-    ViUInt32 retCount;
+    ret = viWrite(m_instrument, (ViBuf)header.c_str(), (ViUInt32)header.length(), &retCount);
+    sentBytes += retCount;
+    if (ret >= VI_SUCCESS) {
+        ret = viWrite(m_instrument, (ViBuf)data, (ViUInt32)len, &retCount);
+        sentBytes += retCount;
+    }
+    
+    ViStatus endRet = viSetAttribute(m_instrument, VI_ATTR_SEND_END_EN, VI_TRUE);
+    if (ret < VI_SUCCESS) throw RuntimeException("Could not write the data to the VISA device", ret);
+    if (endRet < VI_SUCCESS) throw RuntimeException("Could not set the VISA device END indicator", endRet);
 
-    // Send the message
-    ViStatus ret = viWrite(m_instrument, (unsigned char *)buffer.get(), messageLen, &retCount);
-    if (ret < VI_SUCCESS) throw RuntimeException("Could not write the data to the VISA device", ret);        
+    ret = viWrite(m_instrument, (ViBuf)"\n", 1, &retCount);
+    if (ret < VI_SUCCESS) throw RuntimeException("Could not write the data to the VISA device", ret);
+    sentBytes += retCount;
 
     #else	        
     
-    // Send the message                        
-    ssize_t retCount = write(m_osHandle, buffer.get(), messageLen);
-    if(retCount < 0) throw RuntimeException("Could not write the data to the usbtmc device", retCount);
+    struct iovec iov[3];
+    iov[0].iov_base = (void *) header.c_str();
+    iov[0].iov_len = header.length();
+    iov[1].iov_base = (void *) data;
+    iov[1].iov_len = len;
+    iov[2].iov_base = (void *) "\n";
+    iov[2].iov_len = 1;
+    
+    size_t sentBytes = 0;
+    
+    struct stat fileStat;
+    if(fstat(m_osHandle, &fileStat) < 0) throw RuntimeException("Could not stat the usbtmc device");
+    
+    if(S_ISCHR(fileStat.st_mode)){
+        
+        // usbtmc ends a message with every write (writev too, it writes the parts one by one): disable the end of message for all but the last part
+        bool eomControl = false;
+        
+        #ifdef USBTMC_IOCTL_EOM_ENABLE
+        __u8 eom = 0;
+        eomControl = (ioctl(m_osHandle, USBTMC_IOCTL_EOM_ENABLE, &eom) == 0);
+        #endif
+        
+        if(eomControl){
+            
+            for(int part = 0; part < 3; part++){
+                
+                #ifdef USBTMC_IOCTL_EOM_ENABLE
+                if(part == 2){
+                    __u8 eom = 1;
+                    if(ioctl(m_osHandle, USBTMC_IOCTL_EOM_ENABLE, &eom) < 0) throw RuntimeException("Could not enable the end of message of the usbtmc device");
+                }
+                #endif
+                
+                ssize_t retCount = write(m_osHandle, iov[part].iov_base, iov[part].iov_len);
+                
+                if(retCount < 0 || (size_t)retCount != iov[part].iov_len){
+                    #ifdef USBTMC_IOCTL_EOM_ENABLE
+                    __u8 eom = 1;
+                    ioctl(m_osHandle, USBTMC_IOCTL_EOM_ENABLE, &eom); // restore the default
+                    #endif
+                    throw RuntimeException("Could not write the data to the usbtmc device", retCount);
+                }
+                
+                sentBytes += retCount;
+                
+            }
+            
+        } else {
+            
+            // Older usbtmc driver, without the end of message control: a single write it is
+            std::unique_ptr<char[]> buffer(new char[messageLen]);
+            
+            std::memcpy(buffer.get(), header.c_str(), header.length());
+            std::memcpy(buffer.get() + header.length(), data, len);
+            *(buffer.get() + header.length() + len) = '\n';
+            
+            ssize_t retCount = write(m_osHandle, buffer.get(), messageLen);
+            if(retCount < 0) throw RuntimeException("Could not write the data to the usbtmc device", retCount);
+            sentBytes = retCount;
+            
+        }
+        
+    } else {
+        
+        // Streams (e.g. sockets or pipes) have no message boundaries, gather the parts in a single call
+        int part = 0;
+        
+        while(sentBytes < messageLen){
+            
+            ssize_t retCount = writev(m_osHandle, iov + part, 3 - part);
+            if(retCount <= 0) throw RuntimeException("Could not write the data to the usbtmc device", retCount);
+            
+            sentBytes += retCount;
+            
+            // Skip what has been written
+            size_t written = retCount;
+            while(part < 3 && written >= iov[part].iov_len){
+                written -= iov[part].iov_len;
+                part++;
+            }
+            if(part < 3){
+                iov[part].iov_base = (char *) iov[part].iov_base + written;
+                iov[part].iov_len -= written;
+            }
+            
+        }
+        
+    }
             
     #endif	
     
-    if(retCount != messageLen) throw RuntimeException("Could not send the whole message to the scpi device");            
-    return retCount - header.length() - 1;
+    if(sentBytes != messageLen) throw RuntimeException("Could not send the whole message to the scpi device");            
+    return sentBytes - header.length() - 1;
 
 }
 
-size_t ScpiDevice::receiveIEEEBlock(char * data, size_t len){
+size_t ScpiDevice::readRaw(char * data, size_t len){
     
-    if(!m_opened) throw RuntimeException("The device needs to be properly opened first");
-        
-    // 1) Alloc vars and read the first part of the 
-    // 2) Read the first part of the IEEE 488 data block header, i.e. "#n", where n is a Natural number
+    #ifdef _WIN32
     
-    char buffer[16];              
-    size_t receivedBytes = 0;
+    ViUInt32 retCount = 0;
     
-    #ifdef _WIN32
-        
-    ViStatus ret;
-    ViUInt32 retCount = 0;    
+    ViStatus ret = viRead(m_instrument, (ViPBuf)data, (ViUInt32)len, &retCount);
+    if(ret < VI_SUCCESS) throw RuntimeException("Could not read the data from the VISA device", ret);
+    if(retCount == 0) throw RuntimeException("Oscilloscope read timeout");
     
-    ret = viRead (m_instrument, (ViPBuf)buffer, 2, &retCount);
-    if(ret < VI_SUCCESS) throw RuntimeException("Could not read the first part of ieee header from the VISA device", ret);  
-    if(retCount < 2){
-        ret = viRead (m_instrument, (ViPBuf)buffer+1, 1, &retCount);
-        if(ret < VI_SUCCESS) throw RuntimeException("Could not read the first part of ieee header from the VISA device", ret);  
-        if(retCount < 1) throw RuntimeException("Could not read the whole first part of ieee header from the VISA device", ret);  
-    }    
-
-    #else	
-            
-    ssize_t ret;
+    return retCount;
     
-    ret = read(m_osHandle, buffer, 2);
+    #else
+    
+    ssize_t ret = read(m_osHandle, data, len);
     if(ret < 0) throw RuntimeException("Could not read the data from the usbtmc device", ret);  
     if(ret == 0) throw RuntimeException("Oscilloscope read timeout"); // timeout
-    if(ret < 2){
-        ret = read(m_osHandle, buffer+1, 1);
-        if(ret < 0) throw RuntimeException("Could not read the data from the usbtmc device", ret);  
-        if(ret == 0) throw RuntimeException("Oscilloscope read timeout"); // timeout
-    }
     
-    #endif        
+    return ret;
+    
+    #endif
+    
+}
+
+size_t ScpiDevice::receiveIEEEBlock(char * data, size_t len){
+    
+    return receiveIEEEBlock(data, len, 0, nullptr);
+    
+}
+
+size_t ScpiDevice::receiveIEEEBlock(char * data, size_t len, size_t chunkLen, ChunkReady chunkReady){
+    
+    if(!m_opened) throw RuntimeException("The device needs to be properly opened first");
+    
+    // 1) Read the IEEE 488 data block header, i.e. "#nX..X", where n is the number of digits X
+    // A single larger read gets the whole header at once, together with the beginning of the data
+    
+    char buffer[64];
+    size_t bufferBytes = 0;
     
-    // 3) Parse the first part of the header
+    while(bufferBytes < 2) bufferBytes += readRaw(buffer + bufferBytes, sizeof(buffer) - bufferBytes);
     
     if(buffer[0] != '#' || buffer[1] < 48 || buffer[1] > 57) throw RuntimeException("Error parsing the IEEE 488 data block header");
     size_t noOfDigitsHeader = buffer[1] - 48;
     
     if(noOfDigitsHeader == 0) throw RuntimeException("Arbitrary length data block aren't supported");
-    if(noOfDigitsHeader > 9) throw RuntimeException("Invalid IEEE 488 data block header");
-        
-    
-    // 4) Read the second part of the header
-    
-    while(receivedBytes != noOfDigitsHeader){
-        
-        #ifdef _WIN32
-        
-        ret = viRead (m_instrument, (ViPBuf)buffer+receivedBytes, noOfDigitsHeader-receivedBytes, &retCount);    
-        if(ret < VI_SUCCESS) throw RuntimeException("Could not read the data length from the usbtmc device", ret);  
-        receivedBytes += retCount;
-        
-        #else
-        
-        ret = read(m_osHandle, buffer+receivedBytes, noOfDigitsHeader-receivedBytes);
-        if(ret < 0) throw RuntimeException("Could not read the data from the usbtmc device", ret);  
-        if(ret == 0) throw RuntimeException("Oscilloscope read timeout"); // timeout
-        receivedBytes += ret;
-        
-        #endif
-        
-    }
     
-    buffer[receivedBytes] = 0;        
-    size_t bytesExpected = atol(buffer);                
+    size_t headerLen = 2 + noOfDigitsHeader;
     
-    if(receivedBytes != noOfDigitsHeader || bytesExpected <= 0) throw RuntimeException("Error reading the IEEE 488 data block header");
+    while(bufferBytes < headerLen) bufferBytes += readRaw(buffer + bufferBytes, sizeof(buffer) - bufferBytes);
     
-    // 5) Read the announced amount of binary data from the device
+    size_t bytesExpected = 0;
+    for(size_t i = 2; i < headerLen; i++){
+        if(buffer[i] < 48 || buffer[i] > 57) throw RuntimeException("Error reading the IEEE 488 data block header");
+        bytesExpected = bytesExpected * 10 + (buffer[i] - 48);
+    }
     
-    receivedBytes = 0;
+    if(bytesExpected == 0) throw RuntimeException("Error reading the IEEE 488 data block header");
     if(bytesExpected > len) throw RuntimeException("Local recv buffer overflow");
     
-    #ifdef _WIN32
+    // 2) The beginning of the data, and possibly the newline, came with the header
     
-    retCount = 1; // start the loop
+    size_t receivedBytes = std::min(bufferBytes - headerLen, bytesExpected);
+    std::memcpy(data, buffer + headerLen, receivedBytes);
     
-    while(receivedBytes != bytesExpected && retCount > 0){
-        
-        ret = viRead (m_instrument, (ViPBuf)data + receivedBytes, bytesExpected - receivedBytes, &retCount);                
-        if(ret < VI_SUCCESS) throw RuntimeException("Could not read the data from the usbtmc device", ret);  
-        receivedBytes += retCount;        
-        
-    }
+    bool newline = (bufferBytes - headerLen > bytesExpected);
+    if(newline && buffer[headerLen + bytesExpected] != '\n') throw RuntimeException("Something went wrong while receiving the IEEE 488 data block: expected newline", buffer[headerLen + bytesExpected]);
     
-    if(receivedBytes != bytesExpected) throw RuntimeException("Failed to receive the whole IEEE 488 data block");
+    // 3) Received chunks are passed to the caller in another thread, while the next chunk is being received
     
-    // If everything went down smooth, we should read a newline char now
-    ret = viRead (m_instrument, (ViPBuf)buffer, 1, &retCount);
-    if(ret < VI_SUCCESS) throw RuntimeException("Could not read the data from the usbtmc device", ret);  
-    if(buffer[0] != '\n') throw RuntimeException("Something went wrong while receiving the IEEE 488 data block: expected newline", buffer[0]);    
+    if(!chunkLen || !chunkReady) chunkLen = bytesExpected;
     
-    #else
+    BoundedQueue<std::pair<size_t, size_t>> chunks(bytesExpected / chunkLen + 2);
+    std::string chunkError;
+    std::thread chunkThread;
+    size_t passedBytes = 0;
     
-    ret = 1; // start the loop
+    if(chunkReady){
+        chunkThread = std::thread([&](){
+            std::pair<size_t, size_t> chunk;
+            while(chunks.pop(chunk)){
+                if(!chunkError.empty()) continue;
+                try {
+                    chunkReady(data + chunk.first, chunk.first, chunk.second);
+                } catch (std::exception & e) {
+                    chunkError = e.what();
+                }
+            }
+        });
+    }
     
-    while(receivedBytes != bytesExpected && ret > 0){
+    // Passes the received data up to the last chunk boundary reached, or up to the end of the data block
+    auto passChunks = [&](){
+        size_t boundary = (receivedBytes == bytesExpected) ? receivedBytes : (receivedBytes / chunkLen) * chunkLen;
+        while(chunkReady && passedBytes < boundary){
+            size_t chunkEnd = std::min(boundary, (passedBytes / chunkLen + 1) * chunkLen);
+            chunks.push(std::make_pair(passedBytes, chunkEnd - passedBytes));
+            passedBytes = chunkEnd;
+        }
+    };
+    
+    try {
         
-        ret = read(m_osHandle, data + receivedBytes, bytesExpected - receivedBytes);
-        if(ret < 0) throw RuntimeException("Could not read the data from the usbtmc device", ret);  
-        if(ret == 0) throw RuntimeException("Oscilloscope read timeout");
-        receivedBytes += ret;
+        // The data received along with the header are passed right away, as the first chunk
+        if(chunkReady && receivedBytes){
+            chunks.push(std::make_pair((size_t) 0, receivedBytes));
+            passedBytes = receivedBytes;
+        }
+        
+        passChunks();
+        
+        // 4) Read the rest of the data straight into the destination, in reads ending on the chunk boundaries
+        
+        while(receivedBytes != bytesExpected){
+            
+            size_t chunkEnd = std::min(bytesExpected, (receivedBytes / chunkLen + 1) * chunkLen);
+            receivedBytes += readRaw(data + receivedBytes, chunkEnd - receivedBytes);
+            
+            passChunks();
+            
+        }
+        
+        // If everything went down smooth, we should read a newline char now
+        if(!newline){
+            readRaw(buffer, 1);
+            if(buffer[0] != '\n') throw RuntimeException("Something went wrong while receiving the IEEE 488 data block: expected newline", buffer[0]);    
+        }
+        
+    } catch (...) {
+        
+        chunks.close();
+        if(chunkThread.joinable()) chunkThread.join();
+        throw;
         
     }
     
-    if(receivedBytes != bytesExpected) throw RuntimeException("Failed to receive the IEEE 488 data block");
+    chunks.close();
+    if(chunkThread.joinable()) chunkThread.join();
     
-    // If everything went down smooth, we should read a newline char now
-    ret = read(m_osHandle, buffer, 1);
-    if(ret < 0) throw RuntimeException("Could not read the data from the usbtmc device", ret);  
-    if(ret == 0) throw RuntimeException("Oscilloscope read timeout");
-    if(buffer[0] != '\n') throw RuntimeException("Something went wrong while receiving the IEEE 488 data block: expected newline", buffer[0]);    
-    
-    #endif
+    if(!chunkError.empty()) throw RuntimeException(chunkError.c_str());
     
     return receivedBytes;
     
@@ -377,6 +499,13 @@ size_t ScpiDevice::queryIEEEBlock(const std::string & query, char * response, si
     
 }
 
+size_t ScpiDevice::queryIEEEBlock(const std::string & query, char * response, size_t responseLen, size_t chunkLen, ChunkReady chunkReady){
+        
+    if(!sendString(query)) throw RuntimeException("Failed to send the string request");
+    return receiveIEEEBlock(response, responseLen, chunkLen, chunkReady);
+    
+}
+
 int ScpiDevice::checkForInstrumentErrors(std::string & response) {
         
     std::string errors;
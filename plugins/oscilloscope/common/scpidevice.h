@@ -23,7 +23,7 @@
 *
 *
 * \author Petr Socha
-* \version 1.0
+* \version 1.1
 */
 
 #ifndef SCPIDEVICE_H
@@ -32,6 +32,7 @@
 #include <memory>
 #include <string>
 #include <cstring>
+#include <functional>
 
 #ifdef _WIN32
 
@@ -41,6 +42,13 @@
 
 #include <unistd.h>
 #include <fcntl.h>
+#include <sys/uio.h>
+#include <sys/stat.h>
+#include <sys/ioctl.h>
+
+#ifdef __linux__
+#include <linux/usb/tmc.h>
+#endif
 
 #endif
 
@@ -51,6 +59,9 @@
 *
 * \brief SCPI device interface, using either USBTMC Linux module or VISA library.
 *
+* IEEE-488.2 data blocks are transferred without copying the payload: it is sent straight from the caller's buffer, and received straight into the caller's buffer.
+* Received data blocks can be streamed chunk by chunk, so that the caller processes a chunk while the next one is being received.
+*
 */    
 class ScpiDevice {
     
@@ -96,9 +107,23 @@ public:
     /// Send query string, wait for the IEEE-488.2 data block answer
     virtual size_t queryIEEEBlock(const std::string & query, char * response, size_t responseLen);
     
+    /// Receives a chunk of the IEEE-488.2 data block: chunk, offset of the chunk in the data block, length of the chunk
+    typedef std::function<void(const char *, size_t, size_t)> ChunkReady;
+    
+    /// Receive binary block of data from the device, using IEEE-488.2 data format. The received data are passed to chunkReady in another thread, chunk by chunk and in order, as soon as they are received:
+    /// the data received along with the header form the first chunk, every other chunk ends on a multiple of chunkLen bytes, or at the end of the data block
+    virtual size_t receiveIEEEBlock(char * data, size_t len, size_t chunkLen, ChunkReady chunkReady);
+    /// Send query string, wait for the IEEE-488.2 data block answer and stream it chunk by chunk, see receiveIEEEBlock
+    virtual size_t queryIEEEBlock(const std::string & query, char * response, size_t responseLen, size_t chunkLen, ChunkReady chunkReady);
+    
     /// Check for instrument errors
     virtual int checkForInstrumentErrors(std::string & response);
     
+protected:
+    
+    /// Reads at most len bytes, at least one, straight into data. Throws on error or timeout
+    size_t readRaw(char * data, size_t len);
+    
 };
 
 
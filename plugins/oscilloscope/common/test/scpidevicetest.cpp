@@ -0,0 +1,184 @@
+/*
+*  SICAK - SIde-Channel Analysis toolKit
+*  Copyright (C) 2018-2019 Petr Socha, FIT, CTU in Prague
+*
+*  This program is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation, either version 3 of the License, or
+*  (at your option) any later version.
+*
+*  This program is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/**
+* \file scpidevicetest.cpp
+*
+* \brief Test of the IEEE 488.2 data block transfers of ScpiDevice, against a fake device on the other end of a socketpair
+*
+*
+* \author Petr Socha
+* \version 1.0
+*/
+
+#include <sys/socket.h>
+#include <algorithm>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "scpidevice.h"
+
+/// ScpiDevice talking to a socket instead of a usbtmc device
+class SocketScpiDevice : public ScpiDevice {
+    
+public:
+    
+    void attach(int fd){
+        m_osHandle = fd;
+        m_opened = true;
+    }
+    
+};
+
+static int failures = 0;
+
+static void check(bool ok, const char * what){
+    std::printf("%s: %s\n", ok ? "ok  " : "FAIL", what);
+    if(!ok) failures++;
+}
+
+/// Writes the message in pieces of varying length, so that the reads get split at arbitrary positions
+static void writeSplit(int fd, const std::string & message){
+    size_t offset = 0, piece = 5;
+    while(offset < message.size()){
+        size_t len = std::min(piece, message.size() - offset);
+        if(write(fd, message.data() + offset, len) != (ssize_t) len) return;
+        offset += len;
+        piece = piece * 3 % 70001 + 1;
+    }
+}
+
+int main(){
+    
+    int fds[2];
+    if(socketpair(AF_UNIX, SOCK_STREAM, 0, fds)){
+        std::printf("Failed to create a socketpair\n");
+        return 1;
+    }
+    
+    SocketScpiDevice device;
+    device.attach(fds[0]);
+    
+    const size_t len = 4000000;
+    std::string payload(len, 0);
+    for(size_t i = 0; i < len; i++) payload[i] = (char) (i * 31 + 7);
+    
+    const std::string block = "#7" + std::to_string(len) + payload + "\n";
+    
+    try {
+        
+        // Send: the header, payload and newline arrive as a single message
+        {
+            std::string received;
+            std::thread fake([&](){
+                char buffer[65536];
+                while(received.size() < 16 + len + 1){
+                    ssize_t ret = read(fds[1], buffer, sizeof(buffer));
+                    if(ret <= 0) break;
+                    received.append(buffer, ret);
+                }
+            });
+            
+            size_t sent = device.sendIEEEBlock(":DATA", payload.data(), len);
+            fake.join();
+            
+            check(sent == len && received == ":DATA #804000000" + payload + "\n", "send a 4 MB block");
+        }
+        
+        // Receive, the whole block at once and in chunks
+        for(size_t chunkLen : { (size_t) 0, (size_t) 65536, (size_t) 1000000 }){
+            
+            std::thread fake(writeSplit, fds[1], block);
+            
+            std::vector<char> data(len + 10);
+            size_t passedBytes = 0;
+            bool inOrder = true;
+            
+            size_t received;
+            if(chunkLen){
+                received = device.receiveIEEEBlock(data.data(), data.size(), chunkLen, [&](const char * chunk, size_t offset, size_t chunkBytes){
+                    inOrder = inOrder && offset == passedBytes && chunk == data.data() + offset && payload.compare(offset, chunkBytes, chunk, chunkBytes) == 0;
+                    passedBytes += chunkBytes;
+                });
+            } else {
+                received = device.receiveIEEEBlock(data.data(), data.size());
+                passedBytes = len;
+            }
+            
+            fake.join();
+            
+            std::string what = "receive a 4 MB block split at arbitrary positions, chunks of " + std::to_string(chunkLen) + " bytes";
+            check(received == len && payload.compare(0, len, data.data(), len) == 0 && inOrder && passedBytes == len, what.c_str());
+            
+        }
+        
+        // Receive, the data arriving along with the header are passed as the first chunk
+        {
+            std::string small(100, 0);
+            for(size_t i = 0; i < small.size(); i++) small[i] = (char) i;
+            std::string message = "#3100" + small + "\n";
+            if(write(fds[1], message.data(), message.size()) != (ssize_t) message.size()) throw RuntimeException("Failed to write to the socketpair");
+            
+            char data[100];
+            std::vector<std::pair<size_t, size_t>> chunks;
+            size_t received = device.receiveIEEEBlock(data, sizeof(data), 32, [&](const char *, size_t offset, size_t chunkBytes){
+                chunks.push_back(std::make_pair(offset, chunkBytes));
+            });
+            
+            // the header is read along with the first 59 bytes of the data
+            std::vector<std::pair<size_t, size_t>> expected = { {0, 59}, {59, 5}, {64, 32}, {96, 4} };
+            check(received == 100 && small.compare(0, 100, data, 100) == 0 && chunks == expected, "pass the data received along with the header as the first chunk");
+        }
+        
+        // Receive, the whole block including the newline arrives along with the header
+        {
+            if(write(fds[1], "#15hello\n", 9) != 9) throw RuntimeException("Failed to write to the socketpair");
+            char data[10];
+            size_t received = device.receiveIEEEBlock(data, sizeof(data));
+            check(received == 5 && std::string(data, 5) == "hello", "receive a block within the header read");
+        }
+        
+        // Receive, an error of the chunk callback is thrown by the receive
+        {
+            if(write(fds[1], "#15hello\n", 9) != 9) throw RuntimeException("Failed to write to the socketpair");
+            char data[10];
+            bool thrown = false;
+            try {
+                device.receiveIEEEBlock(data, sizeof(data), 2, [](const char *, size_t, size_t){ throw RuntimeException("chunk failed"); });
+            } catch (std::exception & e) {
+                thrown = (std::string(e.what()) == "chunk failed");
+            }
+            check(thrown, "throw the error of the chunk callback");
+        }
+        
+    } catch (std::exception & e) {
+        
+        std::printf("FAIL: %s\n", e.what());
+        failures++;
+        
+    }
+    
+    close(fds[1]);
+    
+    std::printf("%d failure(s)\n", failures);
+    
+    return failures ? 1 : 0;
+    
+}
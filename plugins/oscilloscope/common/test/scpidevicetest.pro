@@ -0,0 +1,17 @@
+!include( ../../../../sicak.pri ) {
+  error( "Couldn't find the sicak.pri file!" )
+}
+
+#
+# Test of the IEEE 488.2 data block transfers of scpidevice against a socketpair fake device, POSIX only.
+# Built with the oscilloscope plug-ins and run by: make check
+#
+
+TEMPLATE        = app
+CONFIG         += console thread testcase
+CONFIG         -= app_bundle
+QT             -= core gui
+INCLUDEPATH    += ..
+HEADERS        += ../scpidevice.h
+SOURCES        += ../scpidevice.cpp scpidevicetest.cpp
+TARGET          = scpidevicetest
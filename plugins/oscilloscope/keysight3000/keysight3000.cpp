@@ -26,8 +26,12 @@
 * \version 1.1
 */
 
+#include <cstring>
 #include "keysight3000.h"
 
+/// Waveform data are received and converted in chunks of this many bytes
+#define KEYSIGHT3000_CHUNK_BYTES (64 * 1024)
+
 // multi-platform Sleep(ms)
 #ifdef _WIN32
 
@@ -374,8 +378,24 @@ size_t Keysight3000::getCurrentSetup(size_t & samples, size_t & captures) {
     
 }
 
+size_t Keysight3000::getBufferedRuns() {
+    return 1;
+}
+
 size_t Keysight3000::getValues(int channel, int16_t * buffer, size_t len, size_t & samples, size_t & captures) {
     
+    return downloadValues(channel, reinterpret_cast<char *>(buffer), len, sizeof(int16_t), samples, captures);
+    
+}
+
+size_t Keysight3000::getValues(int channel, int8_t * buffer, size_t len, size_t & samples, size_t & captures) {
+    
+    return downloadValues(channel, reinterpret_cast<char *>(buffer), len, sizeof(int8_t), samples, captures);
+    
+}
+
+size_t Keysight3000::downloadValues(int channel, char * buffer, size_t len, size_t sampleSize, size_t & samples, size_t & captures) {
+    
     if(!m_opened) throw RuntimeException("The oscilloscope needs to be properly initialized first");
     if(channel < 1 || channel > 4) throw Exception("Invalid channel");
     
@@ -397,6 +417,12 @@ size_t Keysight3000::getValues(int channel, int16_t * buffer, size_t len, size_t
     int ret = m_handle.checkForInstrumentErrors(response);
     if(ret) throw Exception("Error setting the source channel", ret);
     
+    // 16-bit or 8-bit signed samples
+    m_handle.sendString((sampleSize == 1) ? ":WAVeform:FORMat BYTE" : ":WAVeform:FORMat WORD");
+    
+    ret = m_handle.checkForInstrumentErrors(response);
+    if(ret) throw Exception("Error setting the waveform format", ret);
+    
     m_handle.queryString(":WAVeform:POINts?", response); 
     samples = atoi(response.c_str());
     captures = 1;
@@ -405,7 +431,22 @@ size_t Keysight3000::getValues(int channel, int16_t * buffer, size_t len, size_t
     
     Sleep(100);
     
-    size_t recvRet = m_handle.queryIEEEBlock(":WAVeform:DATA?", reinterpret_cast<char *>(buffer), len*2) / 2;
+    // WORD samples arrive LSB first: every received chunk is converted to the host byte order while the next one is being received
+    ScpiDevice::ChunkReady toHostOrder;
+    
+    if(sampleSize == sizeof(int16_t)){
+        toHostOrder = [buffer](const char * chunk, size_t offset, size_t chunkLen){
+            (void)chunk;
+            // A sample is converted along with the chunk its last byte arrived in, the chunks may split the samples
+            for(size_t sample = offset / sizeof(int16_t); sample < (offset + chunkLen) / sizeof(int16_t); sample++){
+                char * bytes = buffer + sample * sizeof(int16_t);
+                int16_t value = (int16_t) (uint16_t) ((uint8_t) bytes[0] | ((uint8_t) bytes[1] << 8));
+                std::memcpy(bytes, &value, sizeof(int16_t));
+            }
+        };
+    }
+    
+    size_t recvRet = m_handle.queryIEEEBlock(":WAVeform:DATA?", buffer, len * sampleSize, KEYSIGHT3000_CHUNK_BYTES, toHostOrder) / sampleSize;
     
     if(recvRet != samples) throw RuntimeException("Failed to download the power trace from oscilloscope: not enough samples");
 
@@ -433,6 +474,19 @@ size_t Keysight3000::getValues(int channel, PowerTraces<int16_t> & traces) {
     return (*this).getValues(channel, traces.data(), traces.size(), samples, captures);
 } 
 
+size_t Keysight3000::getValues(int channel, PowerTraces<int8_t> & traces) {
+    
+    if(!m_opened) throw RuntimeException("The oscilloscope needs to be properly initialized first");
+    
+    if(channel < 1 || channel > 4) throw InvalidInputException("Invalid channel");        
+    
+    traces.init(m_samples, 1); //< alloc memory for aquisition
+    
+    size_t samples, captures;
+    
+    return (*this).getValues(channel, traces.data(), traces.size(), samples, captures);
+} 
+
 size_t Keysight3000::dummyMeasurement() {
     
     std::string response;
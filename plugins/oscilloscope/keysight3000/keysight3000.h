@@ -47,7 +47,7 @@
 class Keysight3000 : public QObject, Oscilloscope {
     
     Q_OBJECT
-    Q_PLUGIN_METADATA(IID "cz.cvut.fit.Sicak.OscilloscopeInterface/1.0" FILE "keysight3000.json")
+    Q_PLUGIN_METADATA(IID "cz.cvut.fit.Sicak.OscilloscopeInterface/1.2" FILE "keysight3000.json")
     Q_INTERFACES(Oscilloscope)
                 
 public:        
@@ -73,8 +73,12 @@ public:
     virtual void stop() override;
     
     virtual size_t getCurrentSetup(size_t & samples, size_t & captures) override;
+    /// The oscilloscope cannot be run again before its memory is downloaded, returns 1
+    virtual size_t getBufferedRuns() override;
     virtual size_t getValues(int channel, PowerTraces<int16_t> & traces) override;
     virtual size_t getValues(int channel, int16_t * buffer, size_t len, size_t & samples, size_t & captures) override;
+    virtual size_t getValues(int channel, PowerTraces<int8_t> & traces) override;
+    virtual size_t getValues(int channel, int8_t * buffer, size_t len, size_t & samples, size_t & captures) override;
     
 protected:
     ScpiDevice m_handle;
@@ -83,6 +87,8 @@ protected:
     bool m_opened;        
     
     size_t dummyMeasurement();
+    /// Downloads 'sampleSize' bytes wide samples (WORD or BYTE waveform format) to the buffer of 'len' samples
+    size_t downloadValues(int channel, char * buffer, size_t len, size_t sampleSize, size_t & samples, size_t & captures);
     
 };
 
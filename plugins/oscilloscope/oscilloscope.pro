@@ -26,3 +26,17 @@ win32 {
     SUBDIRS     += ps6000    
 }
 
+#
+# Simulated oscilloscope plug-in, needs no hardware
+#
+
+SUBDIRS     += simulated
+
+#
+# Socketpair test of the SCPI data block transfers, run by make check
+#
+
+unix {
+    SUBDIRS     += scpidevicetest
+    scpidevicetest.file = common/test/scpidevicetest.pro
+}
@@ -314,6 +314,10 @@ size_t Ps6000::getCurrentSetup(size_t & samples, size_t & captures) {
     return (m_preTriggerSamples + m_postTriggerSamples) * m_captures;
 }
 
+size_t Ps6000::getBufferedRuns() {
+    return 1;
+}
+
 size_t Ps6000::getValues(int channel, int16_t * buffer, size_t len, size_t & samples, size_t & captures) {        
     
     if(!m_opened) throw RuntimeException("The oscilloscope needs to be properly initialized first");
@@ -395,3 +399,36 @@ size_t Ps6000::getValues(int channel, PowerTraces<int16_t> & traces) {
     return (*this).getValues(channel, traces.data(), traces.size(), samples, captures);
     
 }
+
+size_t Ps6000::getValues(int channel, int8_t * buffer, size_t len, size_t & samples, size_t & captures) {        
+    
+    if(!m_opened) throw RuntimeException("The oscilloscope needs to be properly initialized first");
+    
+    m_conversionBuffer.init(len);
+    
+    size_t ret = (*this).getValues(channel, m_conversionBuffer.data(), len, samples, captures);
+    
+    const int16_t * src = m_conversionBuffer.data();
+    const size_t n = samples * captures;
+    
+    for(size_t i = 0; i < n; i++){
+        buffer[i] = static_cast<int8_t>(src[i] >> 8);
+    }
+    
+    return ret;
+    
+}
+
+size_t Ps6000::getValues(int channel, PowerTraces<int8_t> & traces) {        
+    
+    if(!m_opened) throw RuntimeException("The oscilloscope needs to be properly initialized first");
+    
+    if(channel < 1 || channel > 4) throw InvalidInputException("Invalid channel");        
+    
+    traces.init(m_preTriggerSamples + m_postTriggerSamples, m_captures); //< alloc memory for aquisition
+    
+    size_t samples, captures;
+    
+    return (*this).getValues(channel, traces.data(), traces.size(), samples, captures);
+    
+}
@@ -46,7 +46,7 @@
 class Ps6000 : public QObject, Oscilloscope {
    
     Q_OBJECT
-    Q_PLUGIN_METADATA(IID "cz.cvut.fit.Sicak.OscilloscopeInterface/1.0" FILE "ps6000.json")
+    Q_PLUGIN_METADATA(IID "cz.cvut.fit.Sicak.OscilloscopeInterface/1.2" FILE "ps6000.json")
     Q_INTERFACES(Oscilloscope)        
     
 public:        
@@ -71,8 +71,13 @@ public:
     virtual void stop() override;
     
     virtual size_t getCurrentSetup(size_t & samples, size_t & captures) override;
+    /// The oscilloscope cannot be run again before its memory is downloaded, returns 1
+    virtual size_t getBufferedRuns() override;
     virtual size_t getValues(int channel, PowerTraces<int16_t> & traces) override;
     virtual size_t getValues(int channel, int16_t * buffer, size_t len, size_t & samples, size_t & captures) override;
+    /// PicoScope 6000 has 8-bit ADC, whose values are returned MSB aligned in 16-bit samples: downloads 16-bit samples and keeps the upper bytes
+    virtual size_t getValues(int channel, PowerTraces<int8_t> & traces) override;
+    virtual size_t getValues(int channel, int8_t * buffer, size_t len, size_t & samples, size_t & captures) override;
 
 protected:
     int16_t m_handle;
@@ -82,6 +87,8 @@ protected:
     float m_timebaseInterval;
     uint32_t m_captures;
     bool m_opened;
+    /// Buffer for 16-bit samples, converted to 8-bit ones
+    Vector<int16_t> m_conversionBuffer;
     
 };
 
@@ -0,0 +1,351 @@
+/*
+*  SICAK - SIde-Channel Analysis toolKit
+*  Copyright (C) 2018-2019 Petr Socha, FIT, CTU in Prague
+*
+*  This program is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation, either version 3 of the License, or
+*  (at your option) any later version.
+*
+*  This program is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/**
+* \file simulated.cpp
+*
+* \brief SICAK oscilloscope plugin: simulated oscilloscope, synthesizing the power traces from the data processed by the simulated target
+*
+*
+* \author Petr Socha
+* \version 1.0
+*/
+
+#include <QString>
+#include <QStringList>
+#include <random>
+#include <thread>
+#include <chrono>
+#include "simulated.h"
+#include "simulationbus.hpp"
+
+Simulated::Simulated(): m_opened(false), m_triggered(false), m_samples(1000), m_captures(1), m_model(Model::HW), m_leak(100), m_spacing(10), m_gain(200), m_noise(300), m_jitter(0), m_latency(0), m_buffers(1), m_timeout(5000), m_seed(0), m_state(1), m_armedRuns(0), m_downloadedRuns(0) {
+    
+}
+
+Simulated::~Simulated() {
+    
+}
+
+QString Simulated::getPluginName() {
+    return "Simulated oscilloscope";
+}
+
+QString Simulated::getPluginInfo() {
+    return "Synthesizes power traces leaking the data processed by the simulated target, needs no hardware. Open with simulation parameters, e.g. \"model=hw;noise=300;jitter=2\".";
+}
+
+void Simulated::init(const char * filename) {
+    
+    QStringList params = QString(filename).split(";");
+    QString paramVal;
+    
+    std::random_device trng;
+    m_seed = ((uint64_t) trng() << 32) | trng();
+    
+    for (int i = 0; i < params.size(); ++i){ // iterate thru all parameters
+        
+        bool ok = true;
+        
+        if(params.at(i).startsWith("model=")){
+            
+            paramVal = params.at(i);
+            paramVal.remove(0,6);
+            
+            if(paramVal == "hw") m_model = Model::HW;
+            else if(paramVal == "hd") m_model = Model::HD;
+            else if(paramVal == "id") m_model = Model::ID;
+            else throw InvalidInputException("Invalid leakage model param, use either hw, hd or id");
+            
+        } else if(params.at(i).startsWith("leak=")){
+            
+            paramVal = params.at(i);
+            paramVal.remove(0,5);
+            m_leak = paramVal.toULongLong(&ok);
+            
+        } else if(params.at(i).startsWith("spacing=")){
+            
+            paramVal = params.at(i);
+            paramVal.remove(0,8);
+            m_spacing = paramVal.toULongLong(&ok);
+            
+        } else if(params.at(i).startsWith("gain=")){
+            
+            paramVal = params.at(i);
+            paramVal.remove(0,5);
+            m_gain = paramVal.toInt(&ok);
+            
+        } else if(params.at(i).startsWith("noise=")){
+            
+            paramVal = params.at(i);
+            paramVal.remove(0,6);
+            m_noise = paramVal.toDouble(&ok);
+            ok = ok && m_noise >= 0;
+            
+        } else if(params.at(i).startsWith("jitter=")){
+            
+            paramVal = params.at(i);
+            paramVal.remove(0,7);
+            m_jitter = paramVal.toULongLong(&ok);
+            
+        } else if(params.at(i).startsWith("latency=")){
+            
+            paramVal = params.at(i);
+            paramVal.remove(0,8);
+            m_latency = paramVal.toInt(&ok);
+            ok = ok && m_latency >= 0;
+            
+        } else if(params.at(i).startsWith("buffers=")){
+            
+            paramVal = params.at(i);
+            paramVal.remove(0,8);
+            m_buffers = paramVal.toULongLong(&ok);
+            ok = ok && m_buffers > 0;
+            
+        } else if(params.at(i).startsWith("timeout=")){
+            
+            paramVal = params.at(i);
+            paramVal.remove(0,8);
+            m_timeout = paramVal.toInt(&ok);
+            ok = ok && m_timeout >= 0;
+            
+        } else if(params.at(i).startsWith("seed=")){
+            
+            paramVal = params.at(i);
+            paramVal.remove(0,5);
+            m_seed = paramVal.toULongLong(&ok);
+            
+        } else if(params.at(i).size()) {
+            
+            throw InvalidInputException("Unknown simulated oscilloscope param");
+            
+        }
+        
+        if(!ok) throw InvalidInputException("Invalid simulated oscilloscope param");
+        
+    }
+    
+    m_state = m_seed | 1; // xorshift state must not be zero
+    m_armedRuns = 0;
+    m_downloadedRuns = 0;
+    m_triggered = false;
+    
+    m_opened = true;
+    
+    (*this).prepare();
+    
+}
+
+void Simulated::deInit() {
+    
+    if(!m_opened) throw RuntimeException("The oscilloscope needs to be properly initialized first");
+    
+    m_simulation.clear();
+    
+    m_opened = false;
+    
+}
+
+QString Simulated::queryDevices() {
+    
+    return "    * Device ID: 'PARAMS', simulation parameters separated by semicolons, or empty for the defaults:\n"
+           "      model=hw|hd|id (leakage model), leak=N (first leaking sample), spacing=N (samples between the leaking values), gain=N (leakage per unit, LSB),\n"
+           "      noise=S (noise std. deviation, LSB), jitter=N (max time shift, samples), latency=MS (download latency per run), buffers=N (runs buffered), timeout=MS (target trigger timeout), seed=N\n";
+    
+}
+
+void Simulated::setChannel(int & channel, bool & enabled, Coupling & coupling, Impedance & impedance, int & rangemV, int & offsetmV, BandwidthLimiter & bwLimit) {
+    
+    if(!m_opened) throw RuntimeException("The oscilloscope needs to be properly initialized first");
+    if(channel < 1 || channel > 4) throw InvalidInputException("Invalid channel");
+    
+    // The synthesized power traces do not depend on the channel settings
+    
+}
+
+void Simulated::setTrigger(int & sourceChannel, float & level, TriggerSlope & slope) {
+    
+    if(!m_opened) throw RuntimeException("The oscilloscope needs to be properly initialized first");
+    if(sourceChannel < 1 || sourceChannel > 4) throw InvalidInputException("Invalid channel");
+    
+    m_triggered = true;
+    
+}
+
+void Simulated::unsetTrigger() {
+    
+    if(!m_opened) throw RuntimeException("The oscilloscope needs to be properly initialized first");
+    
+    m_triggered = false;
+    
+}
+
+void Simulated::setTiming(float & preTriggerRange, float & postTriggerRange, size_t & samples, size_t & captures) {
+    
+    if(!m_opened) throw RuntimeException("The oscilloscope needs to be properly initialized first");
+    if(!samples || !captures) throw InvalidInputException("Invalid number of samples or captures");
+    
+    std::lock_guard<std::mutex> lock(m_mutex);
+    
+    m_samples = samples;
+    m_captures = captures;
+    m_armedRuns = 0;
+    m_downloadedRuns = 0;
+    
+    (*this).prepare();
+    
+}
+
+void Simulated::prepare() {
+    
+    m_simulation.prepare(m_samples, m_jitter, m_noise);
+    
+}
+
+void Simulated::run() {
+    
+    if(!m_opened) throw RuntimeException("The oscilloscope needs to be properly initialized first");
+    
+    std::lock_guard<std::mutex> lock(m_mutex);
+    
+    if(m_armedRuns - m_downloadedRuns >= m_buffers) throw RuntimeException("The oscilloscope memory is full, the previous runs need to be downloaded first");
+    
+    m_armedRuns++;
+    
+}
+
+void Simulated::stop() {
+    
+    if(!m_opened) throw RuntimeException("The oscilloscope needs to be properly initialized first");
+    
+}
+
+size_t Simulated::getCurrentSetup(size_t & samples, size_t & captures) {
+    samples = m_samples;
+    captures = m_captures;
+    return m_samples * m_captures;
+}
+
+size_t Simulated::getBufferedRuns() {
+    return m_buffers;
+}
+
+int Simulated::leakage(const std::vector<uint8_t> & values, size_t i) const {
+    
+    uint8_t value = values[i];
+    
+    if(m_model == Model::ID) return value;
+    if(m_model == Model::HD) value ^= (i > 0) ? values[i - 1] : 0;
+    
+    int weight = 0;
+    while(value){
+        weight += value & 1;
+        value >>= 1;
+    }
+    
+    return weight;
+    
+}
+
+template <class T>
+size_t Simulated::synthesize(int channel, T * buffer, size_t len, size_t & samples, size_t & captures) {
+    
+    if(!m_opened) throw RuntimeException("The oscilloscope needs to be properly initialized first");
+    if(channel < 1 || channel > 4) throw InvalidInputException("Invalid channel");
+    if(m_samples * m_captures > len) throw RuntimeException("Receiving buffer too small");
+    
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if(m_downloadedRuns >= m_armedRuns) throw RuntimeException("The oscilloscope needs to be run first");
+    }
+    
+    if(m_latency) std::this_thread::sleep_for(std::chrono::milliseconds(m_latency));
+    
+    SimulationBus & bus = SimulationBus::get();
+    bool targetTriggered = m_triggered && bus.targetAttached();
+    
+    for(size_t capture = 0; capture < m_captures; capture++){
+        
+        // Intermediate values leaked in this capture
+        if(targetTriggered){
+            
+            if(!bus.waitTrigger(m_values, m_timeout)) throw RuntimeException("The simulated target did not trigger in time");
+            
+        } else {
+            
+            m_values.resize(16);
+            TraceSimulation::randomBytes(m_state, m_values.data(), m_values.size());
+            
+        }
+        
+        size_t shift = m_jitter ? TraceSimulation::random(m_state) % (2 * m_jitter + 1) : 0;
+        uint64_t noiseKey = TraceSimulation::random(m_state);
+        
+        // Leakage of the intermediate values
+        m_leakages.resize(m_values.size());
+        for(size_t i = 0; i < m_values.size(); i++){
+            m_leakages[i] = m_gain * (*this).leakage(m_values, i);
+        }
+        
+        m_simulation.synthesize(buffer + capture * m_samples, shift, noiseKey, m_leakages.data(), m_leakages.size(), m_leak, m_spacing);
+        
+    }
+    
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_downloadedRuns++;
+    }
+    
+    samples = m_samples;
+    captures = m_captures;
+    
+    return m_samples;
+    
+}
+
+size_t Simulated::getValues(int channel, int16_t * buffer, size_t len, size_t & samples, size_t & captures) {
+    
+    return (*this).synthesize(channel, buffer, len, samples, captures);
+    
+}
+
+size_t Simulated::getValues(int channel, int8_t * buffer, size_t len, size_t & samples, size_t & captures) {
+    
+    return (*this).synthesize(channel, buffer, len, samples, captures);
+    
+}
+
+size_t Simulated::getValues(int channel, PowerTraces<int16_t> & traces) {
+    
+    traces.init(m_samples, m_captures); //< alloc memory for aquisition
+    
+    size_t samples, captures;
+    
+    return (*this).getValues(channel, traces.data(), traces.size(), samples, captures);
+    
+}
+
+size_t Simulated::getValues(int channel, PowerTraces<int8_t> & traces) {
+    
+    traces.init(m_samples, m_captures); //< alloc memory for aquisition
+    
+    size_t samples, captures;
+    
+    return (*this).getValues(channel, traces.data(), traces.size(), samples, captures);
+    
+}
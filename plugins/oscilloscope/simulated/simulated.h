@@ -0,0 +1,150 @@
+/*
+*  SICAK - SIde-Channel Analysis toolKit
+*  Copyright (C) 2018-2019 Petr Socha, FIT, CTU in Prague
+*
+*  This program is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation, either version 3 of the License, or
+*  (at your option) any later version.
+*
+*  This program is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/**
+* \file simulated.h
+*
+* \brief SICAK oscilloscope plugin: simulated oscilloscope, synthesizing the power traces from the data processed by the simulated target
+*
+*
+* \author Petr Socha
+* \version 1.0
+*/
+
+#ifndef SIMULATED_H
+#define SIMULATED_H 
+
+#include <QObject>
+#include <QtPlugin>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+#include "oscilloscope.h"
+#include "exceptions.hpp"
+#include "tracesimulation.hpp"
+
+/**
+* \class Simulated
+* \ingroup Oscilloscope
+*
+* \brief Simulated oscilloscope, needs no hardware. Synthesizes power traces consisting of a periodic base waveform, data dependent leakage, Gaussian noise and a random time shift (jitter),
+* see TraceSimulation.
+*
+* When triggered and a simulated target is attached (see SimulationBus), every capture waits for a trigger of the target and leaks the intermediate values the target processed.
+* Otherwise, captures are made immediately and leak random values.
+*
+*/
+class Simulated : public QObject, Oscilloscope {
+    
+    Q_OBJECT
+    Q_PLUGIN_METADATA(IID "cz.cvut.fit.Sicak.OscilloscopeInterface/1.2" FILE "simulated.json")
+    Q_INTERFACES(Oscilloscope)
+                
+public:
+    
+    Simulated();
+    virtual ~Simulated() override;
+    
+    virtual QString getPluginName() override;
+    virtual QString getPluginInfo() override;
+    
+    /// Initialize the oscilloscope, filename holds the simulation parameters separated by semicolons, e.g. "noise=100;jitter=2"
+    virtual void init(const char * filename) override;
+    virtual void deInit() override;
+    
+    virtual QString queryDevices() override;
+    
+    virtual void setChannel(int & channel, bool & enabled, Coupling & coupling, Impedance & impedance, int & rangemV, int & offsetmV, BandwidthLimiter & bwLimit) override;        
+    virtual void setTrigger(int & sourceChannel, float & level, TriggerSlope & slope) override;        
+    virtual void unsetTrigger() override;
+    /// Set the timing settings: any number of samples and captures per run is supported
+    virtual void setTiming(float & preTriggerRange, float & postTriggerRange, size_t & samples, size_t & captures) override;
+    virtual void run() override;
+    virtual void stop() override;
+    
+    virtual size_t getCurrentSetup(size_t & samples, size_t & captures) override;
+    /// Returns the number of runs the simulated oscilloscope buffers, set by the buffers parameter
+    virtual size_t getBufferedRuns() override;
+    virtual size_t getValues(int channel, PowerTraces<int16_t> & traces) override;
+    virtual size_t getValues(int channel, int16_t * buffer, size_t len, size_t & samples, size_t & captures) override;
+    virtual size_t getValues(int channel, PowerTraces<int8_t> & traces) override;
+    virtual size_t getValues(int channel, int8_t * buffer, size_t len, size_t & samples, size_t & captures) override;
+    
+protected:
+    
+    /// Leakage model of the intermediate values
+    enum class Model {
+        HW, //< Hamming weight
+        HD, //< Hamming distance of the consecutive values
+        ID  //< value itself
+    };
+    
+    /// Waits for the run to complete and synthesizes its power traces, T is either int16_t or int8_t
+    template <class T>
+    size_t synthesize(int channel, T * buffer, size_t len, size_t & samples, size_t & captures);
+    
+    /// Prepares the base waveform and the noise for the current setup
+    void prepare();
+    
+    /// Returns the leakage of the i-th intermediate value
+    int leakage(const std::vector<uint8_t> & values, size_t i) const;
+    
+    bool m_opened;
+    bool m_triggered;
+    size_t m_samples;
+    size_t m_captures;
+    
+    /// Simulation parameters
+    Model m_model;
+    /// First sample leaking an intermediate value
+    size_t m_leak;
+    /// Distance of the samples leaking the consecutive intermediate values
+    size_t m_spacing;
+    /// Leakage of a single unit of the model, in 16-bit LSBs
+    int m_gain;
+    /// Standard deviation of the Gaussian noise, in 16-bit LSBs
+    double m_noise;
+    /// Maximum random time shift of a power trace, in samples
+    size_t m_jitter;
+    /// Download latency of a single run, in milliseconds
+    int m_latency;
+    /// Number of runs buffered in the oscilloscope memory
+    size_t m_buffers;
+    /// Timeout of a trigger of the simulated target, in milliseconds
+    int m_timeout;
+    uint64_t m_seed;
+    
+    /// Base waveform and noise
+    TraceSimulation m_simulation;
+    /// Intermediate values of a single capture
+    std::vector<uint8_t> m_values;
+    /// Leakages of the intermediate values, in 16-bit LSBs
+    std::vector<int> m_leakages;
+    
+    /// State of the pseudo-random numbers (xorshift64*)
+    uint64_t m_state;
+    
+    std::mutex m_mutex;
+    /// Number of runs the oscilloscope was run for
+    size_t m_armedRuns;
+    /// Number of runs downloaded
+    size_t m_downloadedRuns;
+    
+};
+
+#endif /* SIMULATED_H */
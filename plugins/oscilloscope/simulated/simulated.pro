@@ -0,0 +1,29 @@
+!include( ../../../sicak.pri ) {
+  error( "Couldn't find the sicak.pri file!" )
+}
+
+unix { 
+    # enable more agressive optimization, the synthesis needs to get vectorized
+    QMAKE_CXXFLAGS_RELEASE -= -O2
+    QMAKE_LFLAGS_RELEASE -= -O2
+    
+    QMAKE_CXXFLAGS_RELEASE += -O3
+    QMAKE_LFLAGS_RELEASE += -O3
+}
+
+TEMPLATE        = lib
+CONFIG         += plugin
+QT             += widgets
+INCLUDEPATH    += ../../common
+HEADERS        += simulated.h
+SOURCES        += simulated.cpp                
+TARGET          = $$qtLibraryTarget(sicaksimulated)
+DESTDIR         = ./bin
+
+EXAMPLE_FILES = simulated.json
+
+# install
+target.path = ../../../INSTALL/plugins/oscilloscope
+INSTALLS += target
+
+CONFIG += install_ok  # Do not cargo-cult this!
@@ -0,0 +1,386 @@
+/*
+*  SICAK - SIde-Channel Analysis toolKit
+*  Copyright (C) 2018-2019 Petr Socha, FIT, CTU in Prague
+*
+*  This program is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation, either version 3 of the License, or
+*  (at your option) any later version.
+*
+*  This program is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/**
+* \file align.cpp
+*
+* \brief SICAK traces processing plugin: static alignment of power traces by maximum cross-correlation with a reference window
+*
+*
+* \author Petr Socha
+* \version 1.0
+*/
+
+#include "align.h"
+#include "filehandling.hpp"
+#include "global_calls.hpp"
+#include "tracesoutput.hpp"
+#include <QString>
+#include <QStringList>
+#include <QTextStream>
+#include <QJsonObject>
+#include <cmath>
+#include <limits>
+#include <vector>
+#include <omp.h>
+
+/// Number of power traces aligned at once, then written to the file
+#define ALIGN_CHUNK_TRACES 65536
+
+Align::Align(): m_start(0), m_length(0), m_shift(100), m_reference(0), m_method(CrossCorrelation::Method::Auto), m_referenceVar(0), m_samplesPerTrace(0), m_streamTraces(0), m_streamCorrelationSum(0), m_streamShiftedTraces(0) {
+    
+}
+
+Align::~Align() {
+    
+    (*this).deInit();
+               
+}
+
+QString Align::getPluginName() {
+    return "Static alignment of power traces by maximum cross-correlation with a reference window";
+}
+
+QString Align::getPluginInfo() {
+    return "Shifts every power trace so that it matches the reference window best. Set the window using params, e.g. \"start=1000;length=200;shift=50;ref=0\".";
+}
+
+void Align::init(const char * param) {    
+    
+    QStringList params = QString(param).split(";");
+    QString paramVal;
+    
+    m_start = 0;
+    m_length = 0;
+    m_shift = 100;
+    m_reference = 0;
+    m_method = CrossCorrelation::Method::Auto;
+    
+    for (int i = 0; i < params.size(); ++i){ // iterate thru all parameters
+        
+        bool ok = true;
+        
+        if(params.at(i).startsWith("start=")){
+            
+            paramVal = params.at(i);
+            paramVal.remove(0,6);
+            m_start = paramVal.toULongLong(&ok);
+            
+        } else if(params.at(i).startsWith("length=")){
+            
+            paramVal = params.at(i);
+            paramVal.remove(0,7);
+            m_length = paramVal.toULongLong(&ok);
+            ok = ok && m_length > 1;
+            
+        } else if(params.at(i).startsWith("shift=")){
+            
+            paramVal = params.at(i);
+            paramVal.remove(0,6);
+            m_shift = paramVal.toULongLong(&ok);
+            
+        } else if(params.at(i).startsWith("ref=")){
+            
+            paramVal = params.at(i);
+            paramVal.remove(0,4);
+            m_reference = paramVal.toULongLong(&ok);
+            
+        } else if(params.at(i).startsWith("method=")){
+            
+            paramVal = params.at(i);
+            paramVal.remove(0,7);
+            
+            if(paramVal == "auto") m_method = CrossCorrelation::Method::Auto;
+            else if(paramVal == "fft") m_method = CrossCorrelation::Method::Fft;
+            else if(paramVal == "direct") m_method = CrossCorrelation::Method::Direct;
+            else throw InvalidInputException("Invalid method param, use either auto, fft or direct");
+            
+        } else if(params.at(i).size()) {
+            
+            throw InvalidInputException("Unknown alignment param");
+            
+        }
+        
+        if(!ok) throw InvalidInputException("Invalid alignment param");
+        
+    }
+    
+    if(!m_length) throw InvalidInputException("Length of the reference window needs to be set, e.g. \"start=1000;length=200\"");
+    
+}
+
+void Align::deInit() {
+        
+}
+
+void Align::processTraces(PowerTraces<int16_t> & traces, const char * id) {
+    
+    (*this).alignTraces(traces, id);
+    
+}
+
+void Align::processTraces(PowerTraces<int8_t> & traces, const char * id) {
+    
+    (*this).alignTraces(traces, id);
+    
+}
+
+template <class T>
+void Align::prepareReference(const T * referenceTrace, size_t samplesPerTrace) {
+    
+    if(m_start < m_shift || m_start + m_length + m_shift > samplesPerTrace) throw InvalidInputException("The reference window, extended by the maximum shift on both sides, does not fit into the power traces");
+    
+    // Reference window, centered, so that the cross-correlation equals the covariance
+    std::vector<float> reference(m_length);
+    double referenceMean = 0;
+    
+    for(size_t j = 0; j < m_length; j++) referenceMean += referenceTrace[m_start + j];
+    referenceMean /= m_length;
+    
+    m_referenceVar = 0;
+    
+    for(size_t j = 0; j < m_length; j++){
+        reference[j] = (float) (referenceTrace[m_start + j] - referenceMean);
+        m_referenceVar += (double) reference[j] * reference[j];
+    }
+    
+    if(m_referenceVar <= 0) throw InvalidInputException("The reference window is constant, choose another one");
+    
+    m_correlation.reset(new CrossCorrelation(reference, 2 * m_shift + 1, m_method));
+    m_samplesPerTrace = samplesPerTrace;
+    
+}
+
+template <class T>
+void Align::alignPair(T * first, T * second, Workspace & ws, double & correlationSum, long long & shiftedTraces) const {
+    
+    const CrossCorrelation & correlation = *m_correlation;
+    const size_t lags = correlation.lags();
+    const size_t segmentLength = correlation.segmentLength();
+    const size_t segmentStart = m_start - m_shift;
+    const size_t length = m_length;
+    const size_t shift = m_shift;
+    const size_t samplesPerTrace = m_samplesPerTrace;
+    const size_t count = (second != nullptr) ? 2 : 1;
+    
+    T * traces[2] = { first, second };
+    
+    ws.segments.resize(2 * segmentLength);
+    ws.correlations.resize(2 * lags);
+    
+    for(size_t k = 0; k < count; k++){
+        for(size_t i = 0; i < segmentLength; i++) ws.segments[k * segmentLength + i] = traces[k][segmentStart + i];
+    }
+    
+    correlation.correlate(ws.segments.data(), (count == 2) ? ws.segments.data() + segmentLength : nullptr, ws.correlations.data(), ws.correlations.data() + lags, ws.work);
+    
+    for(size_t k = 0; k < count; k++){
+        
+        const float * segment = ws.segments.data() + k * segmentLength;
+        const float * covariances = ws.correlations.data() + k * lags;
+        
+        // Sums of the power trace samples under the window, sliding along with the lag
+        double sum = 0, sumSq = 0;
+        for(size_t j = 0; j < length; j++){
+            sum += segment[j];
+            sumSq += (double) segment[j] * segment[j];
+        }
+        
+        size_t bestLag = shift;
+        double bestScore = -std::numeric_limits<double>::infinity();
+        
+        for(size_t lag = 0; lag < lags; lag++){
+            
+            if(lag){
+                const double in = segment[lag + length - 1];
+                const double out = segment[lag - 1];
+                sum += in - out;
+                sumSq += in * in - out * out;
+            }
+            
+            const double var = sumSq - sum * sum / length;
+            if(var <= 0) continue;
+            
+            const double score = covariances[lag] / std::sqrt(var); //< Pearson correlation times the reference deviation
+            if(score > bestScore){
+                bestScore = score;
+                bestLag = lag;
+            }
+            
+        }
+        
+        if(bestScore > -std::numeric_limits<double>::infinity()) correlationSum += bestScore / std::sqrt(m_referenceVar);
+        
+        // Positive offset: the power trace is late, move it left. Samples shifted in repeat the edge sample
+        const long long offset = (long long) bestLag - (long long) shift;
+        T * trace = traces[k];
+        
+        if(offset > 0){
+            
+            const T edge = trace[samplesPerTrace - 1];
+            for(size_t i = 0; i + offset < samplesPerTrace; i++) trace[i] = trace[i + offset];
+            for(size_t i = samplesPerTrace - offset; i < samplesPerTrace; i++) trace[i] = edge;
+            shiftedTraces++;
+            
+        } else if(offset < 0){
+            
+            const T edge = trace[0];
+            for(size_t i = samplesPerTrace - 1; i >= (size_t) -offset; i--) trace[i] = trace[i + offset];
+            for(size_t i = 0; i < (size_t) -offset; i++) trace[i] = edge;
+            shiftedTraces++;
+            
+        }
+        
+    }
+    
+}
+
+template <class T>
+void Align::alignTraces(PowerTraces<T> & traces, const char * id) {
+    
+    const size_t samplesPerTrace = traces.samplesPerTrace();
+    const size_t noOfTraces = traces.noOfTraces();
+    
+    if(m_reference >= noOfTraces) throw InvalidInputException("The reference power trace is out of range");
+    
+    (*this).prepareReference(&(traces(0, m_reference)), samplesPerTrace);
+    
+    QString tracesFilename = "aligned-traces-";
+    tracesFilename.append(id);
+    tracesFilename.append(".bin");
+    QByteArray ba = tracesFilename.toLocal8Bit();
+    std::fstream outFile = openOutFile(ba.data());
+    
+    QTextStream cout(stdout);
+    cout << QString("Aligning to the window of %1 samples starting at %2, maximum shift is %3 samples, using %4\n").arg(m_length).arg(m_start).arg(m_shift).arg(m_correlation->isDirect() ? "sliding dot products" : "FFT");
+    cout.flush();
+    
+    CoutProgress::get().start(noOfTraces);
+    
+    double correlationSum = 0;
+    long long shiftedTraces = 0;
+    
+    for(size_t chunkFirst = 0; chunkFirst < noOfTraces; chunkFirst += ALIGN_CHUNK_TRACES){
+        
+        const size_t chunkTraces = (noOfTraces - chunkFirst < ALIGN_CHUNK_TRACES) ? noOfTraces - chunkFirst : ALIGN_CHUNK_TRACES;
+        const long long chunkPairs = (chunkTraces + 1) / 2; //< FFTs transform two power traces at once
+        
+        #pragma omp parallel reduction(+:correlationSum,shiftedTraces)
+        {
+            
+            Workspace ws;
+            
+            #pragma omp for schedule(dynamic, 64)
+            for(long long pair = 0; pair < chunkPairs; pair++){
+                
+                const size_t first = chunkFirst + 2 * pair;
+                T * second = (2 * pair + 1 < (long long) chunkTraces) ? &(traces(0, first + 1)) : nullptr;
+                
+                (*this).alignPair(&(traces(0, first)), second, ws, correlationSum, shiftedTraces);
+                
+            }
+            
+        }
+        
+        writeArrayToFile(outFile, &(traces(0, chunkFirst)), chunkTraces * samplesPerTrace);
+        
+        CoutProgress::get().update(chunkFirst + chunkTraces);
+        
+    }
+    
+    CoutProgress::get().finish();
+    
+    closeFile(outFile);
+    
+    // Flush config to json file
+    QJsonObject tracesConf = tracesConfig<T>(tracesFilename, noOfTraces, samplesPerTrace);
+    saveTracesConfig(tracesConf, id);
+    
+    cout << QString("Aligned %1 power traces, %2 of them were shifted, average correlation with the reference window is %3,\nand saved to '%4'.\n").arg(noOfTraces).arg(shiftedTraces).arg(correlationSum / noOfTraces).arg(tracesFilename);
+    
+}
+
+size_t Align::startStream(size_t samplesPerTrace, size_t noOfTraces) {
+    
+    if(m_reference >= noOfTraces) throw InvalidInputException("The reference power trace is out of range");
+    if(m_start < m_shift || m_start + m_length + m_shift > samplesPerTrace) throw InvalidInputException("The reference window, extended by the maximum shift on both sides, does not fit into the power traces");
+    
+    m_correlation.reset();
+    m_streamTraces = noOfTraces;
+    m_streamCorrelationSum = 0;
+    m_streamShiftedTraces = 0;
+    
+    return samplesPerTrace;
+    
+}
+
+bool Align::isStateless() {
+    
+    return true;
+    
+}
+
+void Align::processChunk(PowerTraces<int16_t> & in, PowerTraces<int16_t> & out, size_t firstTrace) {
+    
+    (*this).alignChunk(in, out, firstTrace);
+    
+}
+
+void Align::processChunk(PowerTraces<int8_t> & in, PowerTraces<int8_t> & out, size_t firstTrace) {
+    
+    (*this).alignChunk(in, out, firstTrace);
+    
+}
+
+template <class T>
+void Align::alignChunk(PowerTraces<T> & in, PowerTraces<T> & out, size_t firstTrace) {
+    
+    const size_t noOfTraces = in.noOfTraces();
+    
+    // The first chunk is processed before the others
+    if(!firstTrace){
+        if(m_reference >= noOfTraces) throw InvalidInputException("The reference power trace needs to be in the first chunk of power traces");
+        (*this).prepareReference(&(in(0, m_reference)), in.samplesPerTrace());
+    }
+    
+    if(!m_correlation) throw RuntimeException("The reference window has not been prepared");
+    
+    // Aligned in place, then copied out
+    Workspace ws;
+    double correlationSum = 0;
+    long long shiftedTraces = 0;
+    
+    for(size_t trace = 0; trace < noOfTraces; trace += 2){
+        T * second = (trace + 1 < noOfTraces) ? &(in(0, trace + 1)) : nullptr;
+        (*this).alignPair(&(in(0, trace)), second, ws, correlationSum, shiftedTraces);
+    }
+    
+    std::copy(in.data(), in.data() + in.length(), out.data());
+    
+    std::lock_guard<std::mutex> lock(m_streamMutex);
+    m_streamCorrelationSum += correlationSum;
+    m_streamShiftedTraces += shiftedTraces;
+    
+}
+
+void Align::finishStream() {
+    
+    QTextStream cout(stdout);
+    cout << QString("align: %1 of %2 power traces were shifted, average correlation with the reference window is %3.\n").arg(m_streamShiftedTraces).arg(m_streamTraces).arg(m_streamTraces ? m_streamCorrelationSum / m_streamTraces : 0.0);
+    
+}
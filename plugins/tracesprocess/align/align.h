@@ -0,0 +1,131 @@
+/*
+*  SICAK - SIde-Channel Analysis toolKit
+*  Copyright (C) 2018-2019 Petr Socha, FIT, CTU in Prague
+*
+*  This program is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation, either version 3 of the License, or
+*  (at your option) any later version.
+*
+*  This program is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/**
+* \file align.h
+*
+* \brief SICAK traces processing plugin: static alignment of power traces by maximum cross-correlation with a reference window
+*
+*
+* \author Petr Socha
+* \version 1.0
+*/
+
+#ifndef ALIGN_H
+#define ALIGN_H 
+
+#include <QObject>
+#include <QtPlugin>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "tracesprocess.h"
+#include "exceptions.hpp"
+#include "fft.hpp"
+
+/**
+* \class Align
+* \ingroup TracesProcess
+*
+* \brief Static alignment SICAK TracesProcess plugin. Every power trace is shifted so that it matches the reference window (a part of the reference power trace) best,
+* i.e. the Pearson correlation of the window and the power trace is maximal. The correlations are computed using batched FFTs, or sliding dot products for small windows and shifts.
+*
+*/
+class Align : public QObject, TracesProcess {
+    
+    Q_OBJECT
+    Q_PLUGIN_METADATA(IID "cz.cvut.fit.Sicak.TracesProcessInterface/1.2" FILE "align.json")
+    Q_INTERFACES(TracesProcess)
+                
+public:
+    
+    Align();
+    virtual ~Align() override;
+    
+    virtual QString getPluginName() override;
+    virtual QString getPluginInfo() override;
+    
+    /// Initializes the plugin, param holds the alignment parameters separated by semicolons, e.g. "start=1000;length=200;shift=50"
+    virtual void init(const char * param) override;
+    virtual void deInit() override;
+    
+    /// Aligns the power traces and saves them into a new file
+    virtual void processTraces(PowerTraces<int16_t> & traces, const char * id) override;    
+    /// Aligns the 8-bit power traces and saves them into a new file
+    virtual void processTraces(PowerTraces<int8_t> & traces, const char * id) override;    
+    
+    virtual size_t startStream(size_t samplesPerTrace, size_t noOfTraces) override;
+    /// Chunks are independent, once the reference window is taken from the first chunk
+    virtual bool isStateless() override;
+    /// Aligns a chunk of power traces, the reference power trace needs to be in the first chunk
+    virtual void processChunk(PowerTraces<int16_t> & in, PowerTraces<int16_t> & out, size_t firstTrace) override;
+    /// Aligns a chunk of 8-bit power traces, the reference power trace needs to be in the first chunk
+    virtual void processChunk(PowerTraces<int8_t> & in, PowerTraces<int8_t> & out, size_t firstTrace) override;
+    /// Prints the alignment summary
+    virtual void finishStream() override;
+    
+protected:
+    
+    /// Scratch buffers of a thread
+    struct Workspace {
+        std::vector<float> segments;
+        std::vector<float> correlations;
+        std::vector<std::complex<float>> work;
+    };
+    
+    /// Aligns the power traces, T is either int16_t or int8_t
+    template <class T>
+    void alignTraces(PowerTraces<T> & traces, const char * id);
+    
+    /// Aligns a chunk of power traces, T is either int16_t or int8_t
+    template <class T>
+    void alignChunk(PowerTraces<T> & in, PowerTraces<T> & out, size_t firstTrace);
+    
+    /// Takes the reference window from the reference power trace and prepares the cross-correlation
+    template <class T>
+    void prepareReference(const T * referenceTrace, size_t samplesPerTrace);
+    
+    /// Aligns two power traces in place, 'second' may be nullptr. Adds the correlations with the reference window and the number of shifted power traces
+    template <class T>
+    void alignPair(T * first, T * second, Workspace & ws, double & correlationSum, long long & shiftedTraces) const;
+    
+    /// First sample of the reference window
+    size_t m_start;
+    /// Length of the reference window, zero until set
+    size_t m_length;
+    /// Maximum shift, in samples, in both directions
+    size_t m_shift;
+    /// Power trace the reference window is taken from
+    size_t m_reference;
+    CrossCorrelation::Method m_method;
+    
+    /// Cross-correlation with the reference window, prepared by prepareReference
+    std::unique_ptr<CrossCorrelation> m_correlation;
+    /// Sum of squares of the centered reference window
+    double m_referenceVar;
+    size_t m_samplesPerTrace;
+    
+    /// Streaming: number of power traces and the summary
+    size_t m_streamTraces;
+    std::mutex m_streamMutex;
+    double m_streamCorrelationSum;
+    long long m_streamShiftedTraces;
+    
+};
+
+#endif /* ALIGN_H */
@@ -0,0 +1,345 @@
+/*
+*  SICAK - SIde-Channel Analysis toolKit
+*  Copyright (C) 2018-2019 Petr Socha, FIT, CTU in Prague
+*
+*  This program is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation, either version 3 of the License, or
+*  (at your option) any later version.
+*
+*  This program is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/**
+* \file fft.hpp
+*
+* \brief Fast Fourier transform, real FFT and cross-correlation, used by the SICAK traces processing plugins
+*
+*
+* \author Petr Socha
+* \version 1.0
+*/
+
+#ifndef FFT_H
+#define FFT_H
+
+#include <cmath>
+#include <complex>
+#include <vector>
+#include "exceptions.hpp"
+
+/**
+* \class Fft
+* \ingroup TracesProcess
+*
+* \brief Iterative radix-2 complex FFT of a fixed power of two size. The twiddle factors and the bit reversal permutation are precomputed, so a single Fft object
+* is meant to transform many power traces. Transforms are const, the object can be shared by multiple threads.
+*
+*/
+class Fft {
+
+public:
+
+    /// Constructs the FFT of 'size' points, size must be a power of two
+    Fft(size_t size) : m_size(size) {
+
+        if(size < 2 || (size & (size - 1))) throw InvalidInputException("FFT size must be a power of two");
+
+        const double pi = 3.14159265358979323846;
+
+        // Twiddle factors of every stage stored contiguously, the stage of 'half' butterflies per block starts at half - 1
+        m_twiddles.resize(size - 1);
+        for(size_t half = 1; half < size; half <<= 1){
+            for(size_t i = 0; i < half; i++){
+                m_twiddles[half - 1 + i] = std::complex<float>((float) std::cos(-pi * i / half), (float) std::sin(-pi * i / half));
+            }
+        }
+
+        size_t bits = 0;
+        while(((size_t) 1 << bits) < size) bits++;
+
+        m_reversed.resize(size);
+        for(size_t i = 0; i < size; i++){
+            size_t reversed = 0;
+            for(size_t bit = 0; bit < bits; bit++){
+                if(i & ((size_t) 1 << bit)) reversed |= (size_t) 1 << (bits - 1 - bit);
+            }
+            m_reversed[i] = reversed;
+        }
+
+    }
+
+    /// Returns the smallest power of two not smaller than len
+    static size_t sizeFor(size_t len){
+
+        size_t size = 2;
+        while(size < len) size <<= 1;
+
+        return size;
+
+    }
+
+    /// Returns the number of points
+    size_t size() const { return m_size; }
+
+    /// Forward transform, in place
+    void forward(std::complex<float> * data) const {
+        transform(data);
+    }
+
+    /// Inverse transform, in place, normalized by 1/size. Computed as the conjugated forward transform of the conjugated data
+    void inverse(std::complex<float> * data) const {
+
+        float * d = reinterpret_cast<float *>(data);
+        const size_t size = m_size;
+
+        for(size_t i = 0; i < size; i++) d[2 * i + 1] = -d[2 * i + 1];
+
+        transform(data);
+
+        const float scale = 1.0f / size;
+        for(size_t i = 0; i < size; i++){
+            d[2 * i] *= scale;
+            d[2 * i + 1] *= -scale;
+        }
+
+    }
+
+protected:
+
+    void transform(std::complex<float> * data) const {
+
+        for(size_t i = 0; i < m_size; i++){
+            if(i < m_reversed[i]) std::swap(data[i], data[m_reversed[i]]);
+        }
+
+        // Butterflies on the real and imaginary parts (complex<float> is an array of two floats), with contiguous twiddles, so that they get vectorized
+        float * d = reinterpret_cast<float *>(data);
+        const size_t size = m_size;
+        size_t half = 1;
+
+        // The first two stages have trivial twiddles (1 and -i), done at once as radix-4 butterflies
+        if(size >= 4){
+
+            for(size_t block = 0; block < size; block += 4){
+
+                float * x = d + 2 * block;
+
+                const float s0r = x[0] + x[2], s0i = x[1] + x[3];
+                const float d0r = x[0] - x[2], d0i = x[1] - x[3];
+                const float s1r = x[4] + x[6], s1i = x[5] + x[7];
+                const float d1r = x[4] - x[6], d1i = x[5] - x[7];
+
+                x[0] = s0r + s1r; x[1] = s0i + s1i;
+                x[4] = s0r - s1r; x[5] = s0i - s1i;
+                x[2] = d0r + d1i; x[3] = d0i - d1r; //< d0 + (-i) * d1
+                x[6] = d0r - d1i; x[7] = d0i + d1r;
+
+            }
+
+            half = 4;
+
+        }
+
+        for(; half < size; half <<= 1){
+
+            const float * w = reinterpret_cast<const float *>(m_twiddles.data() + half - 1);
+
+            for(size_t block = 0; block < size; block += 2 * half){
+
+                float * a = d + 2 * block;
+                float * b = a + 2 * half;
+
+                for(size_t i = 0; i < half; i++){
+
+                    const float wr = w[2 * i], wi = w[2 * i + 1];
+                    const float br = b[2 * i], bi = b[2 * i + 1];
+                    const float ar = a[2 * i], ai = a[2 * i + 1];
+                    const float tr = wr * br - wi * bi;
+                    const float ti = wr * bi + wi * br;
+
+                    b[2 * i] = ar - tr;
+                    b[2 * i + 1] = ai - ti;
+                    a[2 * i] = ar + tr;
+                    a[2 * i + 1] = ai + ti;
+
+                }
+
+            }
+
+        }
+
+    }
+
+    size_t m_size;
+    std::vector<std::complex<float>> m_twiddles;
+    std::vector<size_t> m_reversed;
+
+};
+
+/**
+* \class RealFft
+* \ingroup TracesProcess
+*
+* \brief FFT of real sequences, two sequences at once packed into a single complex transform: the spectrum of (first + i*second) is split by its conjugate symmetry.
+* Transforms are const, the object can be shared by multiple threads.
+*
+*/
+class RealFft {
+
+public:
+
+    /// Constructs the FFT of 'size' points, size must be a power of two
+    RealFft(size_t size) : m_fft(size) { }
+
+    /// Returns the number of points
+    size_t size() const { return m_fft.size(); }
+    /// Returns the number of bins of a real sequence spectrum, i.e. size / 2 + 1
+    size_t bins() const { return m_fft.size() / 2 + 1; }
+
+    /// Transforms two real sequences of 'len' samples, zero padded to the size, 'second' may be nullptr. Stores the first 'bins' bins of each spectrum. 'work' is a scratch buffer, resized as needed
+    void forward(const float * first, const float * second, size_t len, std::complex<float> * firstOut, std::complex<float> * secondOut, size_t bins, std::vector<std::complex<float>> & work) const {
+
+        const size_t size = m_fft.size();
+        work.resize(size);
+
+        for(size_t i = 0; i < len; i++) work[i] = std::complex<float>(first[i], (second != nullptr) ? second[i] : 0.0f);
+        for(size_t i = len; i < size; i++) work[i] = std::complex<float>(0, 0);
+
+        m_fft.forward(work.data());
+
+        // first = (Z[k] + conj(Z[-k])) / 2, second = (Z[k] - conj(Z[-k])) / 2i
+        for(size_t k = 0; k < bins; k++){
+
+            const std::complex<float> z = work[k];
+            const std::complex<float> c = work[(size - k) & (size - 1)];
+
+            firstOut[k] = std::complex<float>(0.5f * (z.real() + c.real()), 0.5f * (z.imag() - c.imag()));
+            if(second != nullptr) secondOut[k] = std::complex<float>(0.5f * (z.imag() + c.imag()), 0.5f * (c.real() - z.real()));
+
+        }
+
+    }
+
+protected:
+
+    Fft m_fft;
+
+};
+
+/**
+* \class CrossCorrelation
+* \ingroup TracesProcess
+*
+* \brief Cross-correlation of a fixed reference with many segments, each 'reference length + lags - 1' long: c[lag] = sum_j reference[j] * segment[lag + j].
+* Computes either by FFT, two segments at once packed into a single complex transform, or by direct sliding dot products, whichever is cheaper.
+* Computations are const, a single object can be shared by multiple threads.
+*
+*/
+class CrossCorrelation {
+
+public:
+
+    /// Computation method
+    enum class Method {
+        Auto,   //< whichever is cheaper
+        Fft,    //< batched FFTs
+        Direct  //< sliding dot products
+    };
+
+    /// Prepares the cross-correlation of the reference with segments, for 'lags' lags
+    CrossCorrelation(const std::vector<float> & reference, size_t lags, Method method = Method::Auto) : m_reference(reference), m_lags(lags), m_fft(Fft::sizeFor(reference.size() + lags - 1)) {
+
+        if(reference.empty() || !lags) throw InvalidInputException("Invalid cross-correlation parameters");
+
+        size_t logSize = 0;
+        while(((size_t) 1 << logSize) < m_fft.size()) logSize++;
+
+        // Direct computation costs a multiply-add per reference sample and lag, FFT approach costs two transforms per two segments
+        if(method == Method::Auto) method = (m_reference.size() * m_lags <= 4 * m_fft.size() * logSize) ? Method::Direct : Method::Fft;
+        m_direct = (method == Method::Direct);
+
+        // Conjugated spectrum of the zero padded reference
+        m_spectrum.assign(m_fft.size(), std::complex<float>(0, 0));
+        for(size_t j = 0; j < m_reference.size(); j++) m_spectrum[j] = m_reference[j];
+        m_fft.forward(m_spectrum.data());
+        for(size_t k = 0; k < m_spectrum.size(); k++) m_spectrum[k] = std::conj(m_spectrum[k]);
+
+    }
+
+    /// Returns the length of the segments
+    size_t segmentLength() const { return m_reference.size() + m_lags - 1; }
+    /// Returns the number of lags
+    size_t lags() const { return m_lags; }
+    /// Returns true when the direct computation is used
+    bool isDirect() const { return m_direct; }
+
+    /// Correlates two segments at once, 'second' may be nullptr. Stores 'lags' values into each of the outputs. 'work' is a scratch buffer, resized as needed
+    void correlate(const float * first, const float * second, float * firstOut, float * secondOut, std::vector<std::complex<float>> & work) const {
+
+        if(m_direct){
+
+            correlateDirect(first, firstOut);
+            if(second != nullptr) correlateDirect(second, secondOut);
+            return;
+
+        }
+
+        // The spectrum of (first + i*second) times the reference spectrum transforms back to (first corr + i*second corr), both being real
+        work.resize(m_fft.size());
+
+        const size_t len = segmentLength();
+
+        for(size_t i = 0; i < len; i++) work[i] = std::complex<float>(first[i], (second != nullptr) ? second[i] : 0.0f);
+        for(size_t i = len; i < work.size(); i++) work[i] = std::complex<float>(0, 0);
+
+        m_fft.forward(work.data());
+
+        for(size_t k = 0; k < work.size(); k++){
+            const std::complex<float> a = work[k];
+            const std::complex<float> b = m_spectrum[k];
+            work[k] = std::complex<float>(a.real() * b.real() - a.imag() * b.imag(), a.real() * b.imag() + a.imag() * b.real());
+        }
+
+        m_fft.inverse(work.data());
+
+        for(size_t lag = 0; lag < m_lags; lag++){
+            firstOut[lag] = work[lag].real();
+            if(second != nullptr) secondOut[lag] = work[lag].imag();
+        }
+
+    }
+
+protected:
+
+    /// Sliding dot products, lags in the inner loop, so that it gets vectorized
+    void correlateDirect(const float * segment, float * out) const {
+
+        const size_t lags = m_lags;
+        const size_t len = m_reference.size();
+
+        for(size_t lag = 0; lag < lags; lag++) out[lag] = 0;
+
+        for(size_t j = 0; j < len; j++){
+            const float r = m_reference[j];
+            const float * s = segment + j;
+            for(size_t lag = 0; lag < lags; lag++) out[lag] += r * s[lag];
+        }
+
+    }
+
+    std::vector<float> m_reference;
+    size_t m_lags;
+    Fft m_fft;
+    bool m_direct;
+    std::vector<std::complex<float>> m_spectrum;
+
+};
+
+#endif /* FFT_H */
@@ -0,0 +1,89 @@
+/*
+*  SICAK - SIde-Channel Analysis toolKit
+*  Copyright (C) 2018-2019 Petr Socha, FIT, CTU in Prague
+*
+*  This program is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation, either version 3 of the License, or
+*  (at your option) any later version.
+*
+*  This program is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/**
+* \file tracesoutput.hpp
+*
+* \brief Output of the processed power traces: rounding of the samples and the json config file, shared by the SICAK traces processing plugins and prep
+*
+*
+* \author Petr Socha
+* \version 1.0
+*/
+
+#ifndef TRACESOUTPUT_H
+#define TRACESOUTPUT_H
+
+#include <QString>
+#include <QJsonObject>
+#include <QJsonDocument>
+#include <QFile>
+#include <cstddef>
+#include <cstdint>
+
+/// Rounds and saturates to the range of U, either int16_t or int8_t
+template <class U>
+inline U saturate(float value){
+    const float low = (sizeof(U) == 1) ? -128.0f : -32768.0f;
+    const float high = (sizeof(U) == 1) ? 127.0f : 32767.0f;
+    value = (value < low) ? low : ((value > high) ? high : value);
+    return (U) (value + ((value >= 0) ? 0.5f : -0.5f));
+}
+
+/// Returns the config of the processed power traces with samples of type U: the file, the number of power traces and of samples per trace and the sample type
+template <class U>
+inline QJsonObject tracesConfig(const QString & tracesFilename, size_t noOfTraces, size_t samplesPerTrace){
+
+    QJsonObject tracesConf;
+    tracesConf["traces"] = tracesFilename;
+    tracesConf["traces-count"] = QString::number(noOfTraces);
+    tracesConf["samples-per-trace"] = QString::number(samplesPerTrace);
+    tracesConf["sample-type"] = (sizeof(U) == 1) ? "int8" : "int16";
+
+    return tracesConf;
+
+}
+
+/// Flushes the config to the json file 'id'.json, returns false on failure
+inline bool saveTracesConfig(const QJsonObject & tracesConf, const QString & id){
+
+    QJsonDocument tracesDoc(tracesConf);
+    QString tracesDocFilename = id;
+    tracesDocFilename.append(".json");
+    QFile tracesDocFile(tracesDocFilename);
+    if(!tracesDocFile.open(QIODevice::WriteOnly)) return false;
+
+    return tracesDocFile.write(tracesDoc.toJson()) >= 0;
+
+}
+
+/// Loads the json config 'filename', e.g. of the processed power traces, returns false on failure
+inline bool loadTracesConfig(const QString & filename, QJsonObject & tracesConf){
+
+    QFile tracesDocFile(filename);
+    if(!tracesDocFile.open(QIODevice::ReadOnly | QIODevice::Text)) return false;
+
+    QJsonDocument tracesDoc = QJsonDocument::fromJson(tracesDocFile.readAll());
+    if(!tracesDoc.isObject()) return false;
+
+    tracesConf = tracesDoc.object();
+    return true;
+
+}
+
+#endif /* TRACESOUTPUT_H */
@@ -0,0 +1,435 @@
+/*
+*  SICAK - SIde-Channel Analysis toolKit
+*  Copyright (C) 2018-2019 Petr Socha, FIT, CTU in Prague
+*
+*  This program is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation, either version 3 of the License, or
+*  (at your option) any later version.
+*
+*  This program is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/**
+* \file decimate.cpp
+*
+* \brief SICAK traces processing plugin: decimation, per clock cycle compression and moving average of power traces
+*
+*
+* \author Petr Socha
+* \version 1.0
+*/
+
+#include "decimate.h"
+#include "filehandling.hpp"
+#include "global_calls.hpp"
+#include "tracesoutput.hpp"
+#include <QString>
+#include <QStringList>
+#include <QTextStream>
+#include <QJsonObject>
+#include <cmath>
+#include <cstdint>
+#include <omp.h>
+
+/// Number of power traces decimated at once, then written to the file
+#define DECIMATE_CHUNK_TRACES 16384
+
+Decimate::Decimate(): m_mode(Mode::Fir), m_factor(1), m_taps(0), m_period(0), m_phase(0), m_width(0), m_scale(1.0f) {
+    
+}
+
+Decimate::~Decimate() {
+    
+    (*this).deInit();
+               
+}
+
+QString Decimate::getPluginName() {
+    return "Decimation, per clock cycle compression and moving average of power traces";
+}
+
+QString Decimate::getPluginInfo() {
+    return "Reduces the number of samples of oversampled power traces. Set the mode using params, e.g. \"mode=fir;factor=10\", \"mode=sum;period=50;phase=12\" or \"mode=average;width=8\".";
+}
+
+void Decimate::init(const char * param) {    
+    
+    QStringList params = QString(param).split(";");
+    QString paramVal;
+    
+    m_mode = Mode::Fir;
+    m_factor = 1;
+    m_taps = 0;
+    m_period = 0;
+    m_phase = 0;
+    m_width = 0;
+    m_scale = 1.0f;
+    
+    for (int i = 0; i < params.size(); ++i){ // iterate thru all parameters
+        
+        bool ok = true;
+        
+        if(params.at(i).startsWith("mode=")){
+            
+            paramVal = params.at(i);
+            paramVal.remove(0,5);
+            
+            if(paramVal == "fir") m_mode = Mode::Fir;
+            else if(paramVal == "sum") m_mode = Mode::Sum;
+            else if(paramVal == "abssum") m_mode = Mode::AbsSum;
+            else if(paramVal == "average") m_mode = Mode::Average;
+            else throw InvalidInputException("Invalid mode param, use either fir, sum, abssum or average");
+            
+        } else if(params.at(i).startsWith("factor=")){
+            
+            paramVal = params.at(i);
+            paramVal.remove(0,7);
+            m_factor = paramVal.toULongLong(&ok);
+            ok = ok && m_factor > 0;
+            
+        } else if(params.at(i).startsWith("taps=")){
+            
+            paramVal = params.at(i);
+            paramVal.remove(0,5);
+            m_taps = paramVal.toULongLong(&ok);
+            ok = ok && m_taps > 0;
+            
+        } else if(params.at(i).startsWith("period=")){
+            
+            paramVal = params.at(i);
+            paramVal.remove(0,7);
+            m_period = paramVal.toULongLong(&ok);
+            ok = ok && m_period > 0 && m_period < 65536; //< sums of int16 samples (also absolute values) fit in int32
+            
+        } else if(params.at(i).startsWith("phase=")){
+            
+            paramVal = params.at(i);
+            paramVal.remove(0,6);
+            m_phase = paramVal.toULongLong(&ok);
+            
+        } else if(params.at(i).startsWith("width=")){
+            
+            paramVal = params.at(i);
+            paramVal.remove(0,6);
+            m_width = paramVal.toULongLong(&ok);
+            ok = ok && m_width > 0;
+            
+        } else if(params.at(i).startsWith("scale=")){
+            
+            paramVal = params.at(i);
+            paramVal.remove(0,6);
+            m_scale = paramVal.toFloat(&ok);
+            
+        } else if(params.at(i).size()) {
+            
+            throw InvalidInputException("Unknown decimation param");
+            
+        }
+        
+        if(!ok) throw InvalidInputException("Invalid decimation param");
+        
+    }
+    
+    if(m_mode == Mode::Fir){
+        
+        if(m_factor < 2) throw InvalidInputException("Decimation factor needs to be set, e.g. \"mode=fir;factor=10\"");
+        if(!m_taps) m_taps = 8 * m_factor + 1;
+        (*this).designFilter();
+        
+    } else if(m_mode == Mode::Sum || m_mode == Mode::AbsSum){
+        
+        if(!m_period) throw InvalidInputException("Clock period needs to be set, e.g. \"mode=sum;period=50\"");
+        
+    } else {
+        
+        if(!m_width) m_width = m_factor;
+        
+    }
+    
+}
+
+void Decimate::deInit() {
+        
+}
+
+void Decimate::designFilter() {
+    
+    // Windowed-sinc low-pass, cutoff at the Nyquist frequency of the decimated power traces, Hamming window
+    const double pi = 3.14159265358979323846;
+    const double cutoff = 0.5 / m_factor;
+    const double center = (m_taps - 1) / 2.0;
+    
+    std::vector<double> coefs(m_taps);
+    double sum = 0;
+    
+    for(size_t k = 0; k < m_taps; k++){
+        
+        const double x = k - center;
+        const double sinc = (x == 0) ? 2 * cutoff : std::sin(2 * pi * cutoff * x) / (pi * x);
+        const double window = (m_taps > 1) ? 0.54 - 0.46 * std::cos(2 * pi * k / (m_taps - 1)) : 1.0;
+        
+        coefs[k] = sinc * window;
+        sum += coefs[k];
+        
+    }
+    
+    // Unity gain at DC, times the scale
+    m_coefs.resize(m_taps);
+    for(size_t k = 0; k < m_taps; k++) m_coefs[k] = (float) (coefs[k] / sum * m_scale);
+    
+}
+
+void Decimate::processTraces(PowerTraces<int16_t> & traces, const char * id) {
+    
+    (*this).decimateTraces(traces, id);
+    
+}
+
+void Decimate::processTraces(PowerTraces<int8_t> & traces, const char * id) {
+    
+    (*this).decimateTraces(traces, id);
+    
+}
+
+template <class T, class U>
+void Decimate::filterTrace(const T * trace, size_t samplesPerTrace, U * out, size_t outSamples, std::vector<float> & phases, std::vector<float> & acc) const {
+    
+    // y[m] = sum_k h[k] * x[m * D + k - center]. With k = j * D + p, every phase p of the input is filtered by the p-th subfilter,
+    // so that the inner loop runs over consecutive outputs and gets vectorized
+    const size_t factor = m_factor;
+    const size_t subTaps = (m_taps + factor - 1) / factor;
+    const size_t phaseLength = outSamples + subTaps;
+    const long long center = (m_taps - 1) / 2;
+    
+    phases.resize(factor * phaseLength);
+    acc.resize(outSamples);
+    
+    // Split the power trace into the phases, samples beyond the edges repeat the edge samples
+    for(size_t p = 0; p < factor; p++){
+        float * phase = phases.data() + p * phaseLength;
+        for(size_t q = 0; q < phaseLength; q++){
+            long long sample = (long long) (q * factor + p) - center;
+            sample = (sample < 0) ? 0 : ((sample >= (long long) samplesPerTrace) ? samplesPerTrace - 1 : sample);
+            phase[q] = trace[sample];
+        }
+    }
+    
+    float * y = acc.data();
+    for(size_t m = 0; m < outSamples; m++) y[m] = 0;
+    
+    for(size_t p = 0; p < factor; p++){
+        for(size_t j = 0; j < subTaps; j++){
+            
+            const size_t k = j * factor + p;
+            if(k >= m_taps) continue;
+            
+            const float h = m_coefs[k];
+            const float * x = phases.data() + p * phaseLength + j;
+            
+            for(size_t m = 0; m < outSamples; m++) y[m] += h * x[m];
+            
+        }
+    }
+    
+    for(size_t m = 0; m < outSamples; m++) out[m] = saturate<U>(y[m]);
+    
+}
+
+template <class T, class U>
+void Decimate::compressTrace(const T * trace, U * out, size_t outSamples) const {
+    
+    const size_t period = m_period;
+    const float scale = m_scale;
+    const T * cycle = trace + m_phase;
+    
+    if(m_mode == Mode::AbsSum){
+        
+        for(size_t c = 0; c < outSamples; c++, cycle += period){
+            int32_t sum = 0;
+            for(size_t i = 0; i < period; i++) sum += (cycle[i] < 0) ? -(int32_t) cycle[i] : (int32_t) cycle[i];
+            out[c] = saturate<U>(sum * scale);
+        }
+        
+    } else {
+        
+        for(size_t c = 0; c < outSamples; c++, cycle += period){
+            int32_t sum = 0;
+            for(size_t i = 0; i < period; i++) sum += cycle[i];
+            out[c] = saturate<U>(sum * scale);
+        }
+        
+    }
+    
+}
+
+template <class T, class U>
+void Decimate::averageTrace(const T * trace, size_t samplesPerTrace, U * out, size_t outSamples, std::vector<int64_t> & prefix) const {
+    
+    prefix.resize(samplesPerTrace + 1);
+    prefix[0] = 0;
+    for(size_t i = 0; i < samplesPerTrace; i++) prefix[i + 1] = prefix[i] + trace[i];
+    
+    // Window of 'width' samples centered at the middle of every group of 'factor' samples, cut at the edges of the power trace
+    for(size_t m = 0; m < outSamples; m++){
+        
+        const long long center = m * m_factor + (m_factor - 1) / 2;
+        long long first = center - (long long) (m_width / 2);
+        long long last = first + m_width;
+        first = (first < 0) ? 0 : first;
+        last = (last > (long long) samplesPerTrace) ? samplesPerTrace : last;
+        
+        out[m] = saturate<U>((float) (prefix[last] - prefix[first]) / (last - first) * m_scale);
+        
+    }
+    
+}
+
+size_t Decimate::outputSamples(size_t samplesPerTrace, size_t & offset, size_t & step) const {
+    
+    size_t outSamples;
+    
+    if(m_mode == Mode::Sum || m_mode == Mode::AbsSum){
+        
+        outSamples = (m_phase < samplesPerTrace) ? (samplesPerTrace - m_phase) / m_period : 0;
+        offset = m_phase;
+        step = m_period;
+        
+    } else {
+        
+        outSamples = samplesPerTrace / m_factor;
+        offset = (m_mode == Mode::Fir) ? 0 : (m_factor - 1) / 2;
+        step = m_factor;
+        
+    }
+    
+    if(!outSamples) throw InvalidInputException("The power traces are too short to be decimated");
+    
+    return outSamples;
+    
+}
+
+template <class T, class U>
+void Decimate::decimateTrace(const T * trace, size_t samplesPerTrace, U * out, size_t outSamples, std::vector<float> & phases, std::vector<float> & acc, std::vector<int64_t> & prefix) const {
+    
+    if(m_mode == Mode::Fir) (*this).filterTrace(trace, samplesPerTrace, out, outSamples, phases, acc);
+    else if(m_mode == Mode::Average) (*this).averageTrace(trace, samplesPerTrace, out, outSamples, prefix);
+    else (*this).compressTrace(trace, out, outSamples);
+    
+}
+
+template <class T>
+void Decimate::decimateTraces(PowerTraces<T> & traces, const char * id) {
+    
+    const size_t samplesPerTrace = traces.samplesPerTrace();
+    const size_t noOfTraces = traces.noOfTraces();
+    
+    size_t offset, step;
+    const size_t outSamples = (*this).outputSamples(samplesPerTrace, offset, step);
+    
+    QString tracesFilename = "decimated-traces-";
+    tracesFilename.append(id);
+    tracesFilename.append(".bin");
+    QByteArray ba = tracesFilename.toLocal8Bit();
+    std::fstream outFile = openOutFile(ba.data());
+    
+    const size_t chunkSize = (noOfTraces < DECIMATE_CHUNK_TRACES) ? noOfTraces : DECIMATE_CHUNK_TRACES;
+    std::vector<int16_t> decimated(chunkSize * outSamples);
+    
+    CoutProgress::get().start(noOfTraces);
+    
+    for(size_t chunkFirst = 0; chunkFirst < noOfTraces; chunkFirst += chunkSize){
+        
+        const long long chunkTraces = (noOfTraces - chunkFirst < chunkSize) ? noOfTraces - chunkFirst : chunkSize;
+        
+        #pragma omp parallel
+        {
+            
+            std::vector<float> phases;
+            std::vector<float> acc;
+            std::vector<int64_t> prefix;
+            
+            #pragma omp for schedule(static)
+            for(long long trace = 0; trace < chunkTraces; trace++){
+                (*this).decimateTrace(&(traces(0, chunkFirst + trace)), samplesPerTrace, decimated.data() + trace * outSamples, outSamples, phases, acc, prefix);
+            }
+            
+        }
+        
+        writeArrayToFile(outFile, decimated.data(), chunkTraces * outSamples);
+        
+        CoutProgress::get().update(chunkFirst + chunkTraces);
+        
+    }
+    
+    CoutProgress::get().finish();
+    
+    closeFile(outFile);
+    
+    // Flush config to json file, along with the original position of the first sample and the distance of the samples
+    QJsonObject tracesConf = tracesConfig<int16_t>(tracesFilename, noOfTraces, outSamples);
+    tracesConf["original-samples-per-trace"] = QString::number(samplesPerTrace);
+    tracesConf["sample-offset"] = QString::number(offset);
+    tracesConf["sample-step"] = QString::number(step);
+    saveTracesConfig(tracesConf, id);
+    
+    QTextStream cout(stdout);
+    cout << QString("Reduced %1 power traces from %2 to %3 samples per trace,\nand saved to '%4'.\n").arg(noOfTraces).arg(samplesPerTrace).arg(outSamples).arg(tracesFilename);
+    
+}
+
+size_t Decimate::startStream(size_t samplesPerTrace, size_t noOfTraces) {
+    
+    (void) noOfTraces;
+    
+    size_t offset, step;
+    return (*this).outputSamples(samplesPerTrace, offset, step);
+    
+}
+
+bool Decimate::isStateless() {
+    
+    return true;
+    
+}
+
+void Decimate::processChunk(PowerTraces<int16_t> & in, PowerTraces<int16_t> & out, size_t firstTrace) {
+    
+    (void) firstTrace;
+    (*this).decimateChunk(in, out);
+    
+}
+
+void Decimate::processChunk(PowerTraces<int8_t> & in, PowerTraces<int8_t> & out, size_t firstTrace) {
+    
+    (void) firstTrace;
+    
+    // The output of a pipeline keeps the 8-bit sample type, a sum of 'period' samples fits only when scaled down
+    if((m_mode == Mode::Sum || m_mode == Mode::AbsSum) && m_scale * m_period > 1.0f) throw InvalidInputException("8-bit sums of the clock cycles would saturate in a pipeline, set scale to at most 1/period, or decimate the power traces alone to get int16 samples");
+    
+    (*this).decimateChunk(in, out);
+    
+}
+
+template <class T>
+void Decimate::decimateChunk(PowerTraces<T> & in, PowerTraces<T> & out) {
+    
+    std::vector<float> phases;
+    std::vector<float> acc;
+    std::vector<int64_t> prefix;
+    
+    for(size_t trace = 0; trace < in.noOfTraces(); trace++){
+        (*this).decimateTrace(&(in(0, trace)), in.samplesPerTrace(), &(out(0, trace)), out.samplesPerTrace(), phases, acc, prefix);
+    }
+    
+}
+
+void Decimate::finishStream() {
+    
+}
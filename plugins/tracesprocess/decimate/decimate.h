@@ -0,0 +1,141 @@
+/*
+*  SICAK - SIde-Channel Analysis toolKit
+*  Copyright (C) 2018-2019 Petr Socha, FIT, CTU in Prague
+*
+*  This program is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation, either version 3 of the License, or
+*  (at your option) any later version.
+*
+*  This program is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/**
+* \file decimate.h
+*
+* \brief SICAK traces processing plugin: decimation, per clock cycle compression and moving average of power traces
+*
+*
+* \author Petr Socha
+* \version 1.0
+*/
+
+#ifndef DECIMATE_H
+#define DECIMATE_H 
+
+#include <QObject>
+#include <QtPlugin>
+#include <vector>
+#include "tracesprocess.h"
+#include "exceptions.hpp"
+
+/**
+* \class Decimate
+* \ingroup TracesProcess
+*
+* \brief Decimation SICAK TracesProcess plugin. Reduces the number of samples of oversampled power traces, using one of the modes:
+*  - fir: low-pass (anti-alias) FIR filtering and decimation by an integer factor, computed as a polyphase filter,
+*  - sum, abssum: sum, or sum of absolute values, of the samples of every clock cycle, given the clock period and phase,
+*  - average: moving average, optionally decimated by an integer factor.
+*
+* Output samples are int16, rounded and saturated. In a pipeline, they keep the sample type of the power traces, and 8-bit sums
+* are accepted only when scaled so that they cannot saturate.
+*
+*/
+class Decimate : public QObject, TracesProcess {
+    
+    Q_OBJECT
+    Q_PLUGIN_METADATA(IID "cz.cvut.fit.Sicak.TracesProcessInterface/1.2" FILE "decimate.json")
+    Q_INTERFACES(TracesProcess)
+                
+public:
+    
+    Decimate();
+    virtual ~Decimate() override;
+    
+    virtual QString getPluginName() override;
+    virtual QString getPluginInfo() override;
+    
+    /// Initializes the plugin, param holds the parameters separated by semicolons, e.g. "mode=fir;factor=10"
+    virtual void init(const char * param) override;
+    virtual void deInit() override;
+    
+    /// Decimates the power traces and saves them into a new file
+    virtual void processTraces(PowerTraces<int16_t> & traces, const char * id) override;    
+    /// Decimates the 8-bit power traces and saves them into a new int16 file
+    virtual void processTraces(PowerTraces<int8_t> & traces, const char * id) override;    
+    
+    virtual size_t startStream(size_t samplesPerTrace, size_t noOfTraces) override;
+    /// Power traces are decimated independently
+    virtual bool isStateless() override;
+    /// Decimates a chunk of power traces
+    virtual void processChunk(PowerTraces<int16_t> & in, PowerTraces<int16_t> & out, size_t firstTrace) override;
+    /// Decimates a chunk of 8-bit power traces, the output samples are saturated to 8 bits, sums need the scale at most 1/period
+    virtual void processChunk(PowerTraces<int8_t> & in, PowerTraces<int8_t> & out, size_t firstTrace) override;
+    virtual void finishStream() override;
+    
+protected:
+    
+    /// Decimation mode
+    enum class Mode {
+        Fir,
+        Sum,
+        AbsSum,
+        Average
+    };
+    
+    /// Decimates the power traces, T is either int16_t or int8_t
+    template <class T>
+    void decimateTraces(PowerTraces<T> & traces, const char * id);
+    
+    /// Decimates a chunk of power traces, T is either int16_t or int8_t
+    template <class T>
+    void decimateChunk(PowerTraces<T> & in, PowerTraces<T> & out);
+    
+    /// Returns the number of output samples per trace, the original position of the first output sample and the distance of the output samples
+    size_t outputSamples(size_t samplesPerTrace, size_t & offset, size_t & step) const;
+    
+    /// Decimates a single power trace into 'out', using the selected mode. U is the output sample type
+    template <class T, class U>
+    void decimateTrace(const T * trace, size_t samplesPerTrace, U * out, size_t outSamples, std::vector<float> & phases, std::vector<float> & acc, std::vector<int64_t> & prefix) const;
+    
+    /// Anti-alias FIR filter, decimating a single power trace. 'phases' and 'acc' are scratch buffers
+    template <class T, class U>
+    void filterTrace(const T * trace, size_t samplesPerTrace, U * out, size_t outSamples, std::vector<float> & phases, std::vector<float> & acc) const;
+    
+    /// Sum, or absolute sum, of the samples of every clock cycle of a single power trace
+    template <class T, class U>
+    void compressTrace(const T * trace, U * out, size_t outSamples) const;
+    
+    /// Decimated moving average of a single power trace. 'prefix' is a scratch buffer
+    template <class T, class U>
+    void averageTrace(const T * trace, size_t samplesPerTrace, U * out, size_t outSamples, std::vector<int64_t> & prefix) const;
+    
+    /// Designs the windowed-sinc low-pass filter
+    void designFilter();
+    
+    Mode m_mode;
+    /// Decimation factor
+    size_t m_factor;
+    /// Number of taps of the FIR filter
+    size_t m_taps;
+    /// Clock period, in samples
+    size_t m_period;
+    /// First sample of the first clock cycle
+    size_t m_phase;
+    /// Width of the moving average
+    size_t m_width;
+    /// Output samples are multiplied by the scale
+    float m_scale;
+    /// FIR filter coefficients, scaled
+    std::vector<float> m_coefs;
+    
+};
+
+#endif /* DECIMATE_H */
@@ -0,0 +1,514 @@
+/*
+*  SICAK - SIde-Channel Analysis toolKit
+*  Copyright (C) 2018-2019 Petr Socha, FIT, CTU in Prague
+*
+*  This program is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation, either version 3 of the License, or
+*  (at your option) any later version.
+*
+*  This program is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/**
+* \file dtw.cpp
+*
+* \brief SICAK traces processing plugin: elastic alignment of power traces by dynamic time warping
+*
+*
+* \author Petr Socha
+* \version 1.0
+*/
+
+#include "dtw.h"
+#include "filehandling.hpp"
+#include "global_calls.hpp"
+#include "tracesoutput.hpp"
+#include <QString>
+#include <QStringList>
+#include <QTextStream>
+#include <QJsonObject>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+#include <omp.h>
+
+/// Number of power traces warped at once, then written to the file
+#define DTW_CHUNK_TRACES 65536
+
+/// Steps of the warping path, as stored in Workspace::steps
+#define DTW_STEP_DIAGONAL 0
+#define DTW_STEP_UP 1
+#define DTW_STEP_LEFT 2
+
+Dtw::Dtw(): m_start(0), m_length(0), m_band(50), m_reference(0), m_fast(false), m_coarse(4), m_radius(4), m_warpLength(0), m_streamTraces(0), m_streamCostSum(0) {
+    
+}
+
+Dtw::~Dtw() {
+    
+    (*this).deInit();
+               
+}
+
+QString Dtw::getPluginName() {
+    return "Elastic alignment of power traces by dynamic time warping";
+}
+
+QString Dtw::getPluginInfo() {
+    return "Warps every power trace onto the reference power trace, within a band of the given radius. Set the parameters using params, e.g. \"band=50;ref=0;start=1000;length=2000;method=fast\".";
+}
+
+void Dtw::init(const char * param) {    
+    
+    QStringList params = QString(param).split(";");
+    QString paramVal;
+    
+    m_start = 0;
+    m_length = 0;
+    m_band = 50;
+    m_reference = 0;
+    m_fast = false;
+    m_coarse = 4;
+    m_radius = 0;
+    
+    bool radiusSet = false;
+    
+    for (int i = 0; i < params.size(); ++i){ // iterate thru all parameters
+        
+        bool ok = true;
+        
+        if(params.at(i).startsWith("start=")){
+            
+            paramVal = params.at(i);
+            paramVal.remove(0,6);
+            m_start = paramVal.toULongLong(&ok);
+            
+        } else if(params.at(i).startsWith("length=")){
+            
+            paramVal = params.at(i);
+            paramVal.remove(0,7);
+            m_length = paramVal.toULongLong(&ok);
+            ok = ok && m_length > 1;
+            
+        } else if(params.at(i).startsWith("band=")){
+            
+            paramVal = params.at(i);
+            paramVal.remove(0,5);
+            m_band = paramVal.toULongLong(&ok);
+            ok = ok && m_band > 0;
+            
+        } else if(params.at(i).startsWith("ref=")){
+            
+            paramVal = params.at(i);
+            paramVal.remove(0,4);
+            m_reference = paramVal.toULongLong(&ok);
+            
+        } else if(params.at(i).startsWith("method=")){
+            
+            paramVal = params.at(i);
+            paramVal.remove(0,7);
+            
+            if(paramVal == "banded") m_fast = false;
+            else if(paramVal == "fast") m_fast = true;
+            else throw InvalidInputException("Invalid method param, use either banded or fast");
+            
+        } else if(params.at(i).startsWith("coarse=")){
+            
+            paramVal = params.at(i);
+            paramVal.remove(0,7);
+            m_coarse = paramVal.toULongLong(&ok);
+            ok = ok && m_coarse > 1;
+            
+        } else if(params.at(i).startsWith("radius=")){
+            
+            paramVal = params.at(i);
+            paramVal.remove(0,7);
+            m_radius = paramVal.toULongLong(&ok);
+            radiusSet = true;
+            
+        } else if(params.at(i).size()) {
+            
+            throw InvalidInputException("Unknown DTW param");
+            
+        }
+        
+        if(!ok) throw InvalidInputException("Invalid DTW param");
+        
+    }
+    
+    // The refinement covers a coarse sample on both sides of the projected path by default
+    if(!radiusSet) m_radius = m_coarse;
+    
+}
+
+void Dtw::deInit() {
+        
+}
+
+void Dtw::processTraces(PowerTraces<int16_t> & traces, const char * id) {
+    
+    (*this).warpTraces(traces, id);
+    
+}
+
+void Dtw::processTraces(PowerTraces<int8_t> & traces, const char * id) {
+    
+    (*this).warpTraces(traces, id);
+    
+}
+
+template <class T>
+void Dtw::prepareReference(const T * referenceTrace, size_t samplesPerTrace) {
+    
+    m_warpLength = m_length ? m_length : ((m_start < samplesPerTrace) ? samplesPerTrace - m_start : 0);
+    
+    if(m_warpLength < 2 || m_start + m_warpLength > samplesPerTrace) throw InvalidInputException("The warped part does not fit into the power traces");
+    
+    m_referenceWindow.resize(m_warpLength);
+    for(size_t i = 0; i < m_warpLength; i++) m_referenceWindow[i] = referenceTrace[m_start + i];
+    
+    if(m_fast){
+        (*this).coarsen(m_referenceWindow.data(), m_warpLength, m_coarse, m_coarseReference);
+        if(m_coarseReference.size() < 2) throw InvalidInputException("The coarse factor is too large for the warped part of the power traces");
+    }
+    
+}
+
+void Dtw::bandWindow(size_t n, size_t radius, std::vector<size_t> & first, std::vector<size_t> & last) {
+    
+    first.resize(n);
+    last.resize(n);
+    
+    for(size_t i = 0; i < n; i++){
+        first[i] = (i > radius) ? i - radius : 0;
+        last[i] = (i + radius < n) ? i + radius : n - 1;
+    }
+    
+}
+
+void Dtw::coarsen(const float * in, size_t n, size_t factor, std::vector<float> & out) {
+    
+    out.resize((n + factor - 1) / factor);
+    
+    for(size_t k = 0; k < out.size(); k++){
+        
+        const size_t end = std::min(n, (k + 1) * factor);
+        float sum = 0;
+        
+        for(size_t i = k * factor; i < end; i++) sum += in[i];
+        out[k] = sum / (end - k * factor);
+        
+    }
+    
+}
+
+double Dtw::warpPath(const float * reference, const float * trace, size_t n, const std::vector<size_t> & first, const std::vector<size_t> & last, Workspace & ws) {
+    
+    const float inf = std::numeric_limits<float>::infinity();
+    
+    // Rows of the cost matrix are shifted by one column: previous[j + 1] holds D(i - 1, j), previous[0] the column left of the matrix
+    ws.previous.assign(n + 1, inf);
+    ws.current.assign(n + 1, inf);
+    ws.costs.resize(n);
+    
+    ws.rowStart.resize(n + 1);
+    ws.rowStart[0] = 0;
+    for(size_t i = 0; i < n; i++) ws.rowStart[i + 1] = ws.rowStart[i] + (last[i] - first[i] + 1);
+    ws.steps.resize(ws.rowStart[n]);
+    
+    // Row above the matrix: the path enters D(0, 0) diagonally from zero cost
+    ws.previous[0] = 0;
+    size_t validFirst = 0, validLast = 0; //< valid (shifted) columns of the previous row
+    
+    for(size_t i = 0; i < n; i++){
+        
+        const size_t lo = first[i];
+        const size_t hi = last[i];
+        
+        const size_t width = hi - lo + 1;
+        
+        float * prev = ws.previous.data();
+        
+        // Cells of the previous row outside of its band are unreachable
+        for(size_t k = lo; k <= hi + 1 && k < validFirst; k++) prev[k] = inf;
+        for(size_t k = std::max(lo, validLast + 1); k <= hi + 1; k++) prev[k] = inf;
+        
+        // Band-local views of the row: column lo + w
+        const float * diagonals = ws.previous.data() + lo;
+        const float * ups = ws.previous.data() + lo + 1;
+        const float * samples = trace + lo;
+        float * curr = ws.current.data() + lo + 1;
+        float * costs = ws.costs.data();
+        uint8_t * steps = ws.steps.data() + ws.rowStart[i];
+        
+        // Diagonal and vertical steps do not depend on each other within a row, this loop gets vectorized
+        const float r = reference[i];
+        
+        for(size_t w = 0; w < width; w++){
+            
+            const float diff = r - samples[w];
+            const float cost = diff * diff;
+            const float diagonal = diagonals[w];
+            const float up = ups[w];
+            
+            costs[w] = cost;
+            curr[w] = cost + ((up < diagonal) ? up : diagonal);
+            steps[w] = (up < diagonal) ? DTW_STEP_UP : DTW_STEP_DIAGONAL;
+            
+        }
+        
+        // Horizontal steps depend on the cell to the left, scan. Branchless, the choice is data dependent
+        float previousCell = curr[0];
+        
+        for(size_t w = 1; w < width; w++){
+            
+            const float left = costs[w] + previousCell;
+            const uint8_t mask = (uint8_t) -(left < curr[w]);
+            
+            previousCell = std::min(left, curr[w]);
+            curr[w] = previousCell;
+            steps[w] = (uint8_t) ((steps[w] & ~mask) | (DTW_STEP_LEFT & mask));
+            
+        }
+        
+        validFirst = lo + 1;
+        validLast = hi + 1;
+        std::swap(ws.previous, ws.current);
+        
+    }
+    
+    const double total = ws.previous[n];
+    
+    // Backtrack the warping path from the corner
+    ws.pathRows.clear();
+    ws.pathColumns.clear();
+    
+    size_t i = n - 1, j = n - 1;
+    
+    for(;;){
+        
+        ws.pathRows.push_back(i);
+        ws.pathColumns.push_back(j);
+        
+        if(!i && !j) break;
+        
+        const uint8_t step = ws.steps[ws.rowStart[i] + j - first[i]];
+        
+        if(step == DTW_STEP_DIAGONAL){
+            i--;
+            j--;
+        } else if(step == DTW_STEP_UP){
+            i--;
+        } else {
+            j--;
+        }
+        
+    }
+    
+    return total;
+    
+}
+
+template <class T>
+double Dtw::warpTrace(T * trace, Workspace & ws) const {
+    
+    const size_t n = m_warpLength;
+    
+    ws.trace.resize(n);
+    for(size_t i = 0; i < n; i++) ws.trace[i] = trace[m_start + i];
+    
+    if(m_fast){
+        
+        // Coarse warping path, constrained to the band
+        const size_t coarseLength = m_coarseReference.size();
+        const size_t factor = m_coarse;
+        
+        (*this).coarsen(ws.trace.data(), n, factor, ws.coarseTrace);
+        (*this).bandWindow(coarseLength, (m_band + factor - 1) / factor, ws.coarseFirst, ws.coarseLast);
+        (*this).warpPath(m_coarseReference.data(), ws.coarseTrace.data(), coarseLength, ws.coarseFirst, ws.coarseLast, ws);
+        
+        // Projected onto the full resolution and widened by the radius
+        ws.first.assign(n, n);
+        ws.last.assign(n, 0);
+        
+        for(size_t step = 0; step < ws.pathRows.size(); step++){
+            
+            const size_t rowFirst = ws.pathRows[step] * factor;
+            const size_t rowEnd = std::min(n, rowFirst + factor);
+            const size_t column = ws.pathColumns[step] * factor;
+            const size_t lo = (column > m_radius) ? column - m_radius : 0;
+            const size_t hi = std::min(n - 1, column + factor - 1 + m_radius);
+            
+            for(size_t row = rowFirst; row < rowEnd; row++){
+                ws.first[row] = std::min(ws.first[row], lo);
+                ws.last[row] = std::max(ws.last[row], hi);
+            }
+            
+        }
+        
+        // Keep the window monotone
+        for(size_t row = 1; row < n; row++) ws.last[row] = std::max(ws.last[row], ws.last[row - 1]);
+        for(size_t row = n - 1; row > 0; row--) ws.first[row - 1] = std::min(ws.first[row - 1], ws.first[row]);
+        
+    } else {
+        
+        (*this).bandWindow(n, m_band, ws.first, ws.last);
+        
+    }
+    
+    const double total = (*this).warpPath(m_referenceWindow.data(), ws.trace.data(), n, ws.first, ws.last, ws);
+    
+    // Every reference sample gets the average of the samples matched to it
+    ws.sums.assign(n, 0);
+    ws.counts.assign(n, 0);
+    
+    for(size_t step = 0; step < ws.pathRows.size(); step++){
+        ws.sums[ws.pathRows[step]] += ws.trace[ws.pathColumns[step]];
+        ws.counts[ws.pathRows[step]]++;
+    }
+    
+    for(size_t i = 0; i < n; i++) trace[m_start + i] = (T) std::lround(ws.sums[i] / ws.counts[i]);
+    
+    return total / ws.pathRows.size();
+    
+}
+
+template <class T>
+void Dtw::warpTraces(PowerTraces<T> & traces, const char * id) {
+    
+    const size_t samplesPerTrace = traces.samplesPerTrace();
+    const size_t noOfTraces = traces.noOfTraces();
+    
+    if(m_reference >= noOfTraces) throw InvalidInputException("The reference power trace is out of range");
+    
+    (*this).prepareReference(&(traces(0, m_reference)), samplesPerTrace);
+    
+    QString tracesFilename = "warped-traces-";
+    tracesFilename.append(id);
+    tracesFilename.append(".bin");
+    QByteArray ba = tracesFilename.toLocal8Bit();
+    std::fstream outFile = openOutFile(ba.data());
+    
+    QTextStream cout(stdout);
+    if(m_fast){
+        cout << QString("Warping %1 samples starting at %2 onto the reference, band radius is %3 samples, coarse factor %4, refinement radius %5 samples\n").arg(m_warpLength).arg(m_start).arg(m_band).arg(m_coarse).arg(m_radius);
+    } else {
+        cout << QString("Warping %1 samples starting at %2 onto the reference, band radius is %3 samples\n").arg(m_warpLength).arg(m_start).arg(m_band);
+    }
+    cout.flush();
+    
+    CoutProgress::get().start(noOfTraces);
+    
+    double costSum = 0;
+    
+    for(size_t chunkFirst = 0; chunkFirst < noOfTraces; chunkFirst += DTW_CHUNK_TRACES){
+        
+        const size_t chunkTraces = (noOfTraces - chunkFirst < DTW_CHUNK_TRACES) ? noOfTraces - chunkFirst : DTW_CHUNK_TRACES;
+        
+        #pragma omp parallel reduction(+:costSum)
+        {
+            
+            Workspace ws;
+            
+            #pragma omp for schedule(dynamic, 16)
+            for(long long trace = 0; trace < (long long) chunkTraces; trace++){
+                
+                costSum += (*this).warpTrace(&(traces(0, chunkFirst + trace)), ws);
+                
+            }
+            
+        }
+        
+        writeArrayToFile(outFile, &(traces(0, chunkFirst)), chunkTraces * samplesPerTrace);
+        
+        CoutProgress::get().update(chunkFirst + chunkTraces);
+        
+    }
+    
+    CoutProgress::get().finish();
+    
+    closeFile(outFile);
+    
+    // Flush config to json file
+    QJsonObject tracesConf = tracesConfig<T>(tracesFilename, noOfTraces, samplesPerTrace);
+    saveTracesConfig(tracesConf, id);
+    
+    cout << QString("Warped %1 power traces, average squared distance of the matched samples is %2,\nand saved to '%3'.\n").arg(noOfTraces).arg(costSum / noOfTraces).arg(tracesFilename);
+    
+}
+
+size_t Dtw::startStream(size_t samplesPerTrace, size_t noOfTraces) {
+    
+    if(m_reference >= noOfTraces) throw InvalidInputException("The reference power trace is out of range");
+    
+    const size_t warpLength = m_length ? m_length : ((m_start < samplesPerTrace) ? samplesPerTrace - m_start : 0);
+    if(warpLength < 2 || m_start + warpLength > samplesPerTrace) throw InvalidInputException("The warped part does not fit into the power traces");
+    
+    m_referenceWindow.clear();
+    m_streamTraces = noOfTraces;
+    m_streamCostSum = 0;
+    
+    return samplesPerTrace;
+    
+}
+
+bool Dtw::isStateless() {
+    
+    return true;
+    
+}
+
+void Dtw::processChunk(PowerTraces<int16_t> & in, PowerTraces<int16_t> & out, size_t firstTrace) {
+    
+    (*this).warpChunk(in, out, firstTrace);
+    
+}
+
+void Dtw::processChunk(PowerTraces<int8_t> & in, PowerTraces<int8_t> & out, size_t firstTrace) {
+    
+    (*this).warpChunk(in, out, firstTrace);
+    
+}
+
+template <class T>
+void Dtw::warpChunk(PowerTraces<T> & in, PowerTraces<T> & out, size_t firstTrace) {
+    
+    const size_t noOfTraces = in.noOfTraces();
+    
+    // The first chunk is processed before the others
+    if(!firstTrace){
+        if(m_reference >= noOfTraces) throw InvalidInputException("The reference power trace needs to be in the first chunk of power traces");
+        (*this).prepareReference(&(in(0, m_reference)), in.samplesPerTrace());
+    }
+    
+    if(m_referenceWindow.empty()) throw RuntimeException("The reference has not been prepared");
+    
+    // Warped in place, then copied out
+    Workspace ws;
+    double costSum = 0;
+    
+    for(size_t trace = 0; trace < noOfTraces; trace++){
+        costSum += (*this).warpTrace(&(in(0, trace)), ws);
+    }
+    
+    std::copy(in.data(), in.data() + in.length(), out.data());
+    
+    std::lock_guard<std::mutex> lock(m_streamMutex);
+    m_streamCostSum += costSum;
+    
+}
+
+void Dtw::finishStream() {
+    
+    QTextStream cout(stdout);
+    cout << QString("dtw: warped %1 power traces, average squared distance of the matched samples is %2.\n").arg(m_streamTraces).arg(m_streamTraces ? m_streamCostSum / m_streamTraces : 0.0);
+    
+}
@@ -0,0 +1,164 @@
+/*
+*  SICAK - SIde-Channel Analysis toolKit
+*  Copyright (C) 2018-2019 Petr Socha, FIT, CTU in Prague
+*
+*  This program is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation, either version 3 of the License, or
+*  (at your option) any later version.
+*
+*  This program is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/**
+* \file dtw.h
+*
+* \brief SICAK traces processing plugin: elastic alignment of power traces by dynamic time warping
+*
+*
+* \author Petr Socha
+* \version 1.0
+*/
+
+#ifndef DTW_H
+#define DTW_H 
+
+#include <QObject>
+#include <QtPlugin>
+#include <mutex>
+#include <vector>
+#include "tracesprocess.h"
+#include "exceptions.hpp"
+
+/**
+* \class Dtw
+* \ingroup TracesProcess
+*
+* \brief Elastic alignment SICAK TracesProcess plugin. Every power trace is warped onto the reference power trace using dynamic time warping (DTW), constrained to a Sakoe-Chiba band:
+* a sample of the reference is replaced by the average of the samples of the power trace matched to it. Useful against random delay countermeasures.
+*
+* The fast variant runs DTW on power traces averaged down by a coarse factor first, and then only refines the projected warping path within a small radius.
+*
+* The cost matrix recurrence is computed row by row: the diagonal and vertical steps, independent within a row, in a vectorized pass, then the horizontal steps in a scan.
+* Only two rows of the cost matrix and the step directions within the band are kept.
+*
+*/
+class Dtw : public QObject, TracesProcess {
+    
+    Q_OBJECT
+    Q_PLUGIN_METADATA(IID "cz.cvut.fit.Sicak.TracesProcessInterface/1.2" FILE "dtw.json")
+    Q_INTERFACES(TracesProcess)
+                
+public:
+    
+    Dtw();
+    virtual ~Dtw() override;
+    
+    virtual QString getPluginName() override;
+    virtual QString getPluginInfo() override;
+    
+    /// Initializes the plugin, param holds the parameters separated by semicolons, e.g. "band=50;method=fast"
+    virtual void init(const char * param) override;
+    virtual void deInit() override;
+    
+    /// Warps the power traces and saves them into a new file
+    virtual void processTraces(PowerTraces<int16_t> & traces, const char * id) override;    
+    /// Warps the 8-bit power traces and saves them into a new file
+    virtual void processTraces(PowerTraces<int8_t> & traces, const char * id) override;    
+    
+    virtual size_t startStream(size_t samplesPerTrace, size_t noOfTraces) override;
+    /// Chunks are independent, once the reference is taken from the first chunk
+    virtual bool isStateless() override;
+    /// Warps a chunk of power traces, the reference power trace needs to be in the first chunk
+    virtual void processChunk(PowerTraces<int16_t> & in, PowerTraces<int16_t> & out, size_t firstTrace) override;
+    /// Warps a chunk of 8-bit power traces, the reference power trace needs to be in the first chunk
+    virtual void processChunk(PowerTraces<int8_t> & in, PowerTraces<int8_t> & out, size_t firstTrace) override;
+    /// Prints the warping summary
+    virtual void finishStream() override;
+    
+protected:
+    
+    /// Scratch buffers of a thread, reused for all its power traces
+    struct Workspace {
+        /// Warped part of the power trace, and its coarse version
+        std::vector<float> trace;
+        std::vector<float> coarseTrace;
+        /// Two rows of the cost matrix and the local costs of a row
+        std::vector<float> previous;
+        std::vector<float> current;
+        std::vector<float> costs;
+        /// Step directions of the cells within the band, and the start of every row in it
+        std::vector<uint8_t> steps;
+        std::vector<size_t> rowStart;
+        /// Band: the first and the last column of every row
+        std::vector<size_t> first;
+        std::vector<size_t> last;
+        std::vector<size_t> coarseFirst;
+        std::vector<size_t> coarseLast;
+        /// Warping path, the matched column of every step, and the number of steps of every row
+        std::vector<size_t> pathColumns;
+        std::vector<size_t> pathRows;
+        /// Sums and counts of the samples matched to the reference samples
+        std::vector<float> sums;
+        std::vector<uint32_t> counts;
+    };
+    
+    /// Warps the power traces, T is either int16_t or int8_t
+    template <class T>
+    void warpTraces(PowerTraces<T> & traces, const char * id);
+    
+    /// Warps a chunk of power traces, T is either int16_t or int8_t
+    template <class T>
+    void warpChunk(PowerTraces<T> & in, PowerTraces<T> & out, size_t firstTrace);
+    
+    /// Takes the reference from the reference power trace
+    template <class T>
+    void prepareReference(const T * referenceTrace, size_t samplesPerTrace);
+    
+    /// Warps a single power trace in place, returns the average cost of the warping path
+    template <class T>
+    double warpTrace(T * trace, Workspace & ws) const;
+    
+    /// Sakoe-Chiba band of the given radius, for sequences of length n
+    static void bandWindow(size_t n, size_t radius, std::vector<size_t> & first, std::vector<size_t> & last);
+    
+    /// DTW of the reference and the trace, both of length n, within the window. Stores the warping path into ws.pathRows and ws.pathColumns, returns its total cost
+    static double warpPath(const float * reference, const float * trace, size_t n, const std::vector<size_t> & first, const std::vector<size_t> & last, Workspace & ws);
+    
+    /// Averages the sequence down by the factor
+    static void coarsen(const float * in, size_t n, size_t factor, std::vector<float> & out);
+    
+    /// First reference sample of the warped part of the power traces
+    size_t m_start;
+    /// Length of the warped part, zero for the rest of the power trace
+    size_t m_length;
+    /// Radius of the Sakoe-Chiba band, in samples
+    size_t m_band;
+    /// Power trace the reference is taken from
+    size_t m_reference;
+    /// Use the fast (coarse to fine) variant
+    bool m_fast;
+    /// Coarse factor of the fast variant
+    size_t m_coarse;
+    /// Radius of the refinement of the fast variant, in samples
+    size_t m_radius;
+    
+    /// Reference (warped part), its coarse version, and the number of warped samples
+    std::vector<float> m_referenceWindow;
+    std::vector<float> m_coarseReference;
+    size_t m_warpLength;
+    
+    /// Streaming: number of power traces and the summary
+    size_t m_streamTraces;
+    std::mutex m_streamMutex;
+    double m_streamCostSum;
+    
+};
+
+#endif /* DTW_H */
@@ -0,0 +1,1058 @@
+/*
+*  SICAK - SIde-Channel Analysis toolKit
+*  Copyright (C) 2018-2019 Petr Socha, FIT, CTU in Prague
+*
+*  This program is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation, either version 3 of the License, or
+*  (at your option) any later version.
+*
+*  This program is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/**
+* \file pca.cpp
+*
+* \brief SICAK traces processing plugin: principal component analysis (PCA) of power traces
+*
+*
+* \author Petr Socha
+* \version 1.0
+*/
+
+#include "pca.h"
+#include "filehandling.hpp"
+#include "global_calls.hpp"
+#include "tracesoutput.hpp"
+#include <QString>
+#include <QStringList>
+#include <QTextStream>
+#include <QJsonObject>
+#include <QDateTime>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <vector>
+#include <omp.h>
+
+/// Number of power traces in a block of the matrix products
+#define PCA_BLOCK_TRACES 256
+/// Number of samples in a tile of the covariance matrix
+#define PCA_TILE_SAMPLES 64
+/// Number of power traces projected at once, then written to the file
+#define PCA_CHUNK_TRACES 16384
+/// Longest power traces the covariance matrix is computed for by default
+#define PCA_COVARIANCE_MAX_SAMPLES 4096
+
+/// Dot product in 8 independent partial sums, so that it gets vectorized without reordering the float additions by the compiler
+static inline float dot(const float * a, const float * b, size_t len) {
+    float lanes[8] = { 0, 0, 0, 0, 0, 0, 0, 0 };
+    size_t i = 0;
+    for(; i + 8 <= len; i += 8){
+        for(size_t l = 0; l < 8; l++) lanes[l] += a[i + l] * b[i + l];
+    }
+    for(; i < len; i++) lanes[0] += a[i] * b[i];
+    return ((lanes[0] + lanes[1]) + (lanes[2] + lanes[3])) + ((lanes[4] + lanes[5]) + (lanes[6] + lanes[7]));
+}
+
+Pca::Pca(): m_components(20), m_method(Method::Auto), m_oversample(10), m_iterations(0), m_scale(0), m_pass(Pass::All), m_samplesPerTrace(0), m_count(0), m_totalVariance(0), m_projectionScale(1.0f) {
+    
+}
+
+Pca::~Pca() {
+    
+    (*this).deInit();
+               
+}
+
+QString Pca::getPluginName() {
+    return "Principal component analysis (PCA) of power traces";
+}
+
+QString Pca::getPluginInfo() {
+    return "Projects the power traces onto their top principal components. Set the parameters using params, e.g. \"components=20;method=randomized;iterations=3\". To process chunks (e.g. in a pipeline), accumulate the statistics by \"pass=statistics;id=ID\", then project by \"pass=project;state=pca-statistics-ID.bin\".";
+}
+
+void Pca::init(const char * param) {    
+    
+    QStringList params = QString(param).split(";");
+    QString paramVal;
+    
+    m_components = 20;
+    m_method = Method::Auto;
+    m_oversample = 10;
+    m_iterations = 0;
+    m_scale = 0;
+    m_pass = Pass::All;
+    m_id = (QDateTime::currentDateTime()).toString("ddMMyy-HHmmss");
+    m_states.clear();
+    
+    for (int i = 0; i < params.size(); ++i){ // iterate thru all parameters
+        
+        bool ok = true;
+        
+        if(params.at(i).startsWith("components=")){
+            
+            paramVal = params.at(i);
+            paramVal.remove(0,11);
+            m_components = paramVal.toULongLong(&ok);
+            ok = ok && m_components > 0;
+            
+        } else if(params.at(i).startsWith("method=")){
+            
+            paramVal = params.at(i);
+            paramVal.remove(0,7);
+            
+            if(paramVal == "auto") m_method = Method::Auto;
+            else if(paramVal == "covariance") m_method = Method::Covariance;
+            else if(paramVal == "randomized") m_method = Method::Randomized;
+            else throw InvalidInputException("Invalid method param, use either auto, covariance or randomized");
+            
+        } else if(params.at(i).startsWith("oversample=")){
+            
+            paramVal = params.at(i);
+            paramVal.remove(0,11);
+            m_oversample = paramVal.toULongLong(&ok);
+            
+        } else if(params.at(i).startsWith("iterations=")){
+            
+            paramVal = params.at(i);
+            paramVal.remove(0,11);
+            m_iterations = paramVal.toULongLong(&ok);
+            ok = ok && m_iterations > 0;
+            
+        } else if(params.at(i).startsWith("scale=")){
+            
+            paramVal = params.at(i);
+            paramVal.remove(0,6);
+            m_scale = paramVal.toFloat(&ok);
+            ok = ok && m_scale > 0;
+            
+        } else if(params.at(i).startsWith("pass=")){
+            
+            paramVal = params.at(i);
+            paramVal.remove(0,5);
+            
+            if(paramVal == "all") m_pass = Pass::All;
+            else if(paramVal == "statistics") m_pass = Pass::Statistics;
+            else if(paramVal == "project") m_pass = Pass::Project;
+            else throw InvalidInputException("Invalid pass param, use either all, statistics or project");
+            
+        } else if(params.at(i).startsWith("id=")){
+            
+            m_id = params.at(i);
+            m_id.remove(0,3);
+            ok = !m_id.isEmpty();
+            
+        } else if(params.at(i).startsWith("state=")){
+            
+            paramVal = params.at(i);
+            paramVal.remove(0,6);
+            m_states = paramVal.split(",");
+            ok = !paramVal.isEmpty();
+            
+        } else if(params.at(i).size()) {
+            
+            throw InvalidInputException("Unknown PCA param");
+            
+        }
+        
+        if(!ok) throw InvalidInputException("Invalid PCA param");
+        
+    }
+    
+    if(m_pass == Pass::Project && m_states.isEmpty()) throw InvalidInputException("Statistics files need to be set to project the power traces, e.g. \"state=pca-statistics-ID.bin\"");
+    
+}
+
+void Pca::deInit() {
+    
+    (*this).freeStatistics();
+        
+}
+
+void Pca::processTraces(PowerTraces<int16_t> & traces, const char * id) {
+    
+    if(m_pass == Pass::Statistics) (*this).saveTracesStatistics(traces, id);
+    else if(m_pass == Pass::Project) (*this).projectTracesFromStatistics(traces, id);
+    else (*this).analyzeTraces(traces, id);
+    
+}
+
+void Pca::processTraces(PowerTraces<int8_t> & traces, const char * id) {
+    
+    if(m_pass == Pass::Statistics) (*this).saveTracesStatistics(traces, id);
+    else if(m_pass == Pass::Project) (*this).projectTracesFromStatistics(traces, id);
+    else (*this).analyzeTraces(traces, id);
+    
+}
+
+size_t Pca::startStream(size_t samplesPerTrace, size_t noOfTraces) {
+    
+    (void) noOfTraces;
+    
+    if(m_pass == Pass::All) throw InvalidInputException("PCA of chunks of power traces takes two passes, accumulate the statistics by \"pass=statistics\" first, then project by \"pass=project\"");
+    
+    if(m_pass == Pass::Statistics){
+        (*this).startStatistics(samplesPerTrace);
+        return samplesPerTrace;
+    }
+    
+    (*this).prepareProjection(samplesPerTrace);
+    
+    return m_components;
+    
+}
+
+bool Pca::isStateless() {
+    
+    return m_pass == Pass::Project;
+    
+}
+
+void Pca::processChunk(PowerTraces<int16_t> & in, PowerTraces<int16_t> & out, size_t firstTrace) {
+    
+    (void) firstTrace;
+    
+    if(m_pass == Pass::Project){
+        (*this).projectChunk(in, out);
+        return;
+    }
+    
+    // The power traces pass thru unchanged
+    (*this).accumulateStatistics(in.data(), in.noOfTraces());
+    std::copy(in.data(), in.data() + in.length(), out.data());
+    
+}
+
+void Pca::processChunk(PowerTraces<int8_t> & in, PowerTraces<int8_t> & out, size_t firstTrace) {
+    
+    (void) firstTrace;
+    
+    // The output of a pipeline keeps the 8-bit sample type, which is too narrow for the projections
+    if(m_pass == Pass::Project) throw InvalidInputException("8-bit projections would saturate in a pipeline, project the 8-bit power traces by pca alone to get int16 samples");
+    
+    // The power traces pass thru unchanged
+    (*this).accumulateStatistics(in.data(), in.noOfTraces());
+    std::copy(in.data(), in.data() + in.length(), out.data());
+    
+}
+
+void Pca::finishStream() {
+    
+    QTextStream cout(stdout);
+    QByteArray ba = m_id.toLocal8Bit();
+    
+    if(m_pass == Pass::Statistics){
+        
+        QString statisticsFilename = (*this).saveStatistics(ba.data());
+        cout << QString("Saved the statistics of %1 power traces to '%2'.\n").arg(m_count).arg(statisticsFilename);
+        
+    } else if(m_pass == Pass::Project){
+        
+        // Flush the components and the mean power trace to json file, the projected power traces are saved by the pipeline
+        QJsonObject projectionConf;
+        QString componentsFilename, meanFilename;
+        (*this).saveComponents(ba.data(), projectionConf, componentsFilename, meanFilename);
+        QString projectionId = "pca-";
+        projectionId.append(m_id);
+        saveTracesConfig(projectionConf, projectionId);
+        
+        cout << QString("Projected the power traces onto %1 principal components of %2 power traces,\nsaved components to '%3', mean power trace to '%4', the scale and the variances to '%5'.\n").arg(m_components).arg(m_count).arg(componentsFilename).arg(meanFilename).arg(projectionId + ".json");
+        
+    }
+    
+    (*this).freeStatistics();
+    
+}
+
+template <class T>
+void Pca::computeMean(PowerTraces<T> & traces, std::vector<double> & mean, double & totalVariance) const {
+    
+    const size_t samplesPerTrace = traces.samplesPerTrace();
+    const size_t noOfTraces = traces.noOfTraces();
+    const long long noOfTiles = (samplesPerTrace + PCA_TILE_SAMPLES - 1) / PCA_TILE_SAMPLES;
+    
+    mean.assign(samplesPerTrace, 0);
+    totalVariance = 0;
+    
+    // Exact sums, threads split the samples
+    #pragma omp parallel for schedule(dynamic) reduction(+:totalVariance)
+    for(long long tile = 0; tile < noOfTiles; tile++){
+        
+        const size_t first = tile * PCA_TILE_SAMPLES;
+        const size_t last = std::min(first + PCA_TILE_SAMPLES, samplesPerTrace);
+        int64_t sums[PCA_TILE_SAMPLES] = { 0 };
+        int64_t sumsSq[PCA_TILE_SAMPLES] = { 0 };
+        
+        for(size_t trace = 0; trace < noOfTraces; trace++){
+            const T * samples = &(traces(0, trace));
+            for(size_t sample = first; sample < last; sample++){
+                const int64_t value = samples[sample];
+                sums[sample - first] += value;
+                sumsSq[sample - first] += value * value;
+            }
+        }
+        
+        for(size_t sample = first; sample < last; sample++){
+            const double sum = (double) sums[sample - first];
+            mean[sample] = sum / noOfTraces;
+            totalVariance += ((double) sumsSq[sample - first] - sum * sum / noOfTraces) / (noOfTraces - 1);
+        }
+        
+    }
+    
+}
+
+template <class T>
+void Pca::centerBlock(const T * traces, size_t samplesPerTrace, const std::vector<double> & mean, size_t count, std::vector<float> & block) {
+    
+    block.resize(count * samplesPerTrace);
+    
+    for(size_t trace = 0; trace < count; trace++){
+        const T * samples = traces + trace * samplesPerTrace;
+        float * centered = block.data() + trace * samplesPerTrace;
+        for(size_t sample = 0; sample < samplesPerTrace; sample++) centered[sample] = (float) (samples[sample] - mean[sample]);
+    }
+    
+}
+
+std::vector<std::pair<size_t, size_t>> Pca::covarianceTiles(size_t samplesPerTrace) {
+    
+    const size_t noOfTiles = (samplesPerTrace + PCA_TILE_SAMPLES - 1) / PCA_TILE_SAMPLES;
+    
+    std::vector<std::pair<size_t, size_t>> tiles;
+    for(size_t row = 0; row < noOfTiles; row++){
+        for(size_t col = row; col < noOfTiles; col++) tiles.push_back(std::make_pair(row, col));
+    }
+    
+    return tiles;
+    
+}
+
+void Pca::accumulateProducts(const std::vector<float> & block, size_t blockTraces, size_t samplesPerTrace, const std::vector<std::pair<size_t, size_t>> & tiles, std::vector<double> & products) {
+    
+    // Block of the products += block of power traces transposed times the same block, accumulated in floats within the block, in doubles across the blocks
+    #pragma omp parallel for schedule(dynamic)
+    for(long long tile = 0; tile < (long long) tiles.size(); tile++){
+        
+        const size_t rowFirst = tiles[tile].first * PCA_TILE_SAMPLES;
+        const size_t rowLast = std::min(rowFirst + PCA_TILE_SAMPLES, samplesPerTrace);
+        const size_t colFirst = tiles[tile].second * PCA_TILE_SAMPLES;
+        const size_t colLast = std::min(colFirst + PCA_TILE_SAMPLES, samplesPerTrace);
+        const size_t cols = colLast - colFirst;
+        
+        float acc[PCA_TILE_SAMPLES * PCA_TILE_SAMPLES] = { 0 };
+        
+        // Four power traces at once, so that a row of the tile is loaded and stored once per four products
+        size_t trace = 0;
+        
+        for(; trace + 4 <= blockTraces; trace += 4){
+            
+            const float * s0 = block.data() + trace * samplesPerTrace;
+            const float * s1 = s0 + samplesPerTrace;
+            const float * s2 = s1 + samplesPerTrace;
+            const float * s3 = s2 + samplesPerTrace;
+            const float * c0 = s0 + colFirst;
+            const float * c1 = s1 + colFirst;
+            const float * c2 = s2 + colFirst;
+            const float * c3 = s3 + colFirst;
+            
+            for(size_t row = rowFirst; row < rowLast; row++){
+                const float v0 = s0[row], v1 = s1[row], v2 = s2[row], v3 = s3[row];
+                float * accRow = acc + (row - rowFirst) * PCA_TILE_SAMPLES;
+                for(size_t col = 0; col < cols; col++) accRow[col] += v0 * c0[col] + v1 * c1[col] + v2 * c2[col] + v3 * c3[col];
+            }
+            
+        }
+        
+        for(; trace < blockTraces; trace++){
+            
+            const float * samples = block.data() + trace * samplesPerTrace;
+            const float * colSamples = samples + colFirst;
+            
+            for(size_t row = rowFirst; row < rowLast; row++){
+                const float value = samples[row];
+                float * accRow = acc + (row - rowFirst) * PCA_TILE_SAMPLES;
+                for(size_t col = 0; col < cols; col++) accRow[col] += value * colSamples[col];
+            }
+            
+        }
+        
+        for(size_t row = rowFirst; row < rowLast; row++){
+            double * productsRow = products.data() + row * samplesPerTrace + colFirst;
+            const float * accRow = acc + (row - rowFirst) * PCA_TILE_SAMPLES;
+            for(size_t col = 0; col < cols; col++) productsRow[col] += accRow[col];
+        }
+        
+    }
+    
+}
+
+template <class T>
+void Pca::computeCovariance(PowerTraces<T> & traces, const std::vector<double> & mean, std::vector<double> & covariance) const {
+    
+    const size_t samplesPerTrace = traces.samplesPerTrace();
+    const size_t noOfTraces = traces.noOfTraces();
+    
+    // Tiles of the upper triangle, every tile is owned by a single thread, so that the threads do not share any sums
+    const std::vector<std::pair<size_t, size_t>> tiles = (*this).covarianceTiles(samplesPerTrace);
+    
+    covariance.assign(samplesPerTrace * samplesPerTrace, 0);
+    std::vector<float> block;
+    
+    CoutProgress::get().start(noOfTraces);
+    
+    for(size_t blockFirst = 0; blockFirst < noOfTraces; blockFirst += PCA_BLOCK_TRACES){
+        
+        const size_t blockTraces = std::min((size_t) PCA_BLOCK_TRACES, noOfTraces - blockFirst);
+        
+        (*this).centerBlock(&(traces(0, blockFirst)), samplesPerTrace, mean, blockTraces, block);
+        (*this).accumulateProducts(block, blockTraces, samplesPerTrace, tiles, covariance);
+        
+        CoutProgress::get().update(blockFirst + blockTraces);
+        
+    }
+    
+    CoutProgress::get().finish();
+    
+    // Normalize and mirror the upper triangle
+    for(size_t row = 0; row < samplesPerTrace; row++){
+        for(size_t col = row; col < samplesPerTrace; col++){
+            const double value = covariance[row * samplesPerTrace + col] / (noOfTraces - 1);
+            covariance[row * samplesPerTrace + col] = value;
+            covariance[col * samplesPerTrace + row] = value;
+        }
+    }
+    
+}
+
+void Pca::multiplyMatrix(const std::vector<double> & covariance, size_t samplesPerTrace, const std::vector<double> & basis, size_t columns, std::vector<double> & product) {
+    
+    product.assign(samplesPerTrace * columns, 0);
+    
+    #pragma omp parallel for schedule(static)
+    for(long long row = 0; row < (long long) samplesPerTrace; row++){
+        const double * covRow = covariance.data() + row * samplesPerTrace;
+        for(size_t c = 0; c < columns; c++){
+            const double * column = basis.data() + c * samplesPerTrace;
+            double sum = 0;
+            for(size_t sample = 0; sample < samplesPerTrace; sample++) sum += covRow[sample] * column[sample];
+            product[c * samplesPerTrace + row] = sum;
+        }
+    }
+    
+}
+
+template <class T>
+void Pca::multiplyCovariance(PowerTraces<T> & traces, const std::vector<double> & mean, const std::vector<double> & covariance, const std::vector<double> & basis, size_t columns, std::vector<double> & product) const {
+    
+    const size_t samplesPerTrace = traces.samplesPerTrace();
+    const size_t noOfTraces = traces.noOfTraces();
+    
+    if(!covariance.empty()){
+        (*this).multiplyMatrix(covariance, samplesPerTrace, basis, columns, product);
+        return;
+    }
+    
+    product.assign(samplesPerTrace * columns, 0);
+    
+    // Covariance times the basis = X^T (X basis) / (n - 1), where X are the centered power traces, block by block.
+    // Every thread accumulates its own product, the products are merged at the end
+    std::vector<float> basisF(basis.begin(), basis.end());
+    const long long noOfBlocks = (noOfTraces + PCA_BLOCK_TRACES - 1) / PCA_BLOCK_TRACES;
+    
+    #pragma omp parallel
+    {
+        
+        std::vector<double> partial(samplesPerTrace * columns, 0);
+        std::vector<float> block;
+        std::vector<float> projections(PCA_BLOCK_TRACES * columns);
+        
+        #pragma omp for schedule(dynamic)
+        for(long long b = 0; b < noOfBlocks; b++){
+            
+            const size_t blockFirst = b * PCA_BLOCK_TRACES;
+            const size_t blockTraces = std::min((size_t) PCA_BLOCK_TRACES, noOfTraces - blockFirst);
+            
+            (*this).centerBlock(&(traces(0, blockFirst)), samplesPerTrace, mean, blockTraces, block);
+            
+            // Projections of the block onto the basis
+            for(size_t trace = 0; trace < blockTraces; trace++){
+                const float * samples = block.data() + trace * samplesPerTrace;
+                for(size_t c = 0; c < columns; c++){
+                    projections[trace * columns + c] = dot(samples, basisF.data() + c * samplesPerTrace, samplesPerTrace);
+                }
+            }
+            
+            // Block transposed times the projections, tile by tile, so that the partial product tile stays in the cache
+            for(size_t tileFirst = 0; tileFirst < samplesPerTrace; tileFirst += PCA_TILE_SAMPLES){
+                const size_t tileLength = std::min((size_t) PCA_TILE_SAMPLES, samplesPerTrace - tileFirst);
+                for(size_t c = 0; c < columns; c++){
+                    double * out = partial.data() + c * samplesPerTrace + tileFirst;
+                    for(size_t trace = 0; trace < blockTraces; trace++){
+                        const float projection = projections[trace * columns + c];
+                        const float * samples = block.data() + trace * samplesPerTrace + tileFirst;
+                        for(size_t sample = 0; sample < tileLength; sample++) out[sample] += projection * samples[sample];
+                    }
+                }
+            }
+            
+        }
+        
+        #pragma omp critical
+        {
+            for(size_t i = 0; i < product.size(); i++) product[i] += partial[i];
+        }
+        
+    }
+    
+    for(size_t i = 0; i < product.size(); i++) product[i] /= (noOfTraces - 1);
+    
+}
+
+void Pca::orthonormalize(std::vector<double> & columns, size_t rows, size_t noOfColumns) {
+    
+    for(size_t c = 0; c < noOfColumns; c++){
+        
+        double * column = columns.data() + c * rows;
+        
+        // Twice is enough (Kahan), a single pass loses the orthogonality for ill-conditioned columns
+        for(int pass = 0; pass < 2; pass++){
+            for(size_t p = 0; p < c; p++){
+                const double * previous = columns.data() + p * rows;
+                double dot = 0;
+                for(size_t i = 0; i < rows; i++) dot += column[i] * previous[i];
+                for(size_t i = 0; i < rows; i++) column[i] -= dot * previous[i];
+            }
+        }
+        
+        double norm = 0;
+        for(size_t i = 0; i < rows; i++) norm += column[i] * column[i];
+        norm = std::sqrt(norm);
+        
+        // Linearly dependent column, e.g. fewer power traces than columns
+        const double inverse = (norm > 1e-300) ? 1.0 / norm : 0.0;
+        for(size_t i = 0; i < rows; i++) column[i] *= inverse;
+        
+    }
+    
+}
+
+void Pca::eigenSymmetric(std::vector<double> & matrix, size_t size, std::vector<double> & values, std::vector<double> & vectors) {
+    
+    vectors.assign(size * size, 0);
+    for(size_t i = 0; i < size; i++) vectors[i * size + i] = 1;
+    
+    for(int sweep = 0; sweep < 100; sweep++){
+        
+        double offDiagonal = 0, diagonal = 0;
+        for(size_t i = 0; i < size; i++){
+            diagonal += matrix[i * size + i] * matrix[i * size + i];
+            for(size_t j = i + 1; j < size; j++) offDiagonal += matrix[i * size + j] * matrix[i * size + j];
+        }
+        
+        if(offDiagonal <= 1e-30 * diagonal) break;
+        
+        for(size_t p = 0; p < size; p++){
+            for(size_t q = p + 1; q < size; q++){
+                
+                const double apq = matrix[p * size + q];
+                if(apq == 0) continue;
+                
+                // Rotation zeroing the (p, q) element
+                const double theta = (matrix[q * size + q] - matrix[p * size + p]) / (2 * apq);
+                const double t = ((theta >= 0) ? 1.0 : -1.0) / (std::fabs(theta) + std::sqrt(theta * theta + 1));
+                const double c = 1 / std::sqrt(t * t + 1);
+                const double s = t * c;
+                
+                for(size_t k = 0; k < size; k++){
+                    const double akp = matrix[k * size + p];
+                    const double akq = matrix[k * size + q];
+                    matrix[k * size + p] = c * akp - s * akq;
+                    matrix[k * size + q] = s * akp + c * akq;
+                }
+                
+                for(size_t k = 0; k < size; k++){
+                    const double apk = matrix[p * size + k];
+                    const double aqk = matrix[q * size + k];
+                    matrix[p * size + k] = c * apk - s * aqk;
+                    matrix[q * size + k] = s * apk + c * aqk;
+                }
+                
+                for(size_t k = 0; k < size; k++){
+                    const double vkp = vectors[k * size + p];
+                    const double vkq = vectors[k * size + q];
+                    vectors[k * size + p] = c * vkp - s * vkq;
+                    vectors[k * size + q] = s * vkp + c * vkq;
+                }
+                
+            }
+        }
+        
+    }
+    
+    values.resize(size);
+    for(size_t i = 0; i < size; i++) values[i] = matrix[i * size + i];
+    
+}
+
+template <class Multiply>
+void Pca::findComponents(size_t samplesPerTrace, size_t iterations, Multiply multiply, std::vector<double> & components, std::vector<double> & variances) const {
+    
+    const size_t columns = std::min(m_components + m_oversample, samplesPerTrace);
+    
+    // Subspace iteration from a random (Gaussian) basis, deterministic
+    std::vector<double> basis(samplesPerTrace * columns);
+    std::vector<double> product;
+    
+    std::mt19937_64 prng(0x5ca1ab1e);
+    std::normal_distribution<double> gauss(0.0, 1.0);
+    for(size_t i = 0; i < basis.size(); i++) basis[i] = gauss(prng);
+    (*this).orthonormalize(basis, samplesPerTrace, columns);
+    
+    CoutProgress::get().start(iterations + 1);
+    
+    for(size_t iteration = 0; iteration < iterations; iteration++){
+        multiply(basis, columns, product);
+        (*this).orthonormalize(product, samplesPerTrace, columns);
+        std::swap(basis, product);
+        CoutProgress::get().update(iteration + 1);
+    }
+    
+    // Rayleigh-Ritz: eigendecomposition of the covariance projected onto the basis
+    multiply(basis, columns, product);
+    
+    CoutProgress::get().finish();
+    
+    std::vector<double> projected(columns * columns);
+    for(size_t i = 0; i < columns; i++){
+        for(size_t j = 0; j < columns; j++){
+            double sum = 0;
+            for(size_t sample = 0; sample < samplesPerTrace; sample++) sum += basis[i * samplesPerTrace + sample] * product[j * samplesPerTrace + sample];
+            projected[i * columns + j] = sum;
+        }
+    }
+    for(size_t i = 0; i < columns; i++){
+        for(size_t j = i + 1; j < columns; j++){
+            const double value = 0.5 * (projected[i * columns + j] + projected[j * columns + i]);
+            projected[i * columns + j] = value;
+            projected[j * columns + i] = value;
+        }
+    }
+    
+    std::vector<double> eigenValues, eigenVectors;
+    (*this).eigenSymmetric(projected, columns, eigenValues, eigenVectors);
+    
+    std::vector<size_t> order(columns);
+    for(size_t i = 0; i < columns; i++) order[i] = i;
+    std::sort(order.begin(), order.end(), [&eigenValues](size_t a, size_t b){ return eigenValues[a] > eigenValues[b]; });
+    
+    // Components (a row each) = basis times the eigenvectors, the largest element is positive
+    const size_t noOfComponents = m_components;
+    components.assign(noOfComponents * samplesPerTrace, 0);
+    variances.resize(noOfComponents);
+    
+    for(size_t k = 0; k < noOfComponents; k++){
+        
+        double * component = components.data() + k * samplesPerTrace;
+        variances[k] = std::max(0.0, eigenValues[order[k]]);
+        
+        for(size_t c = 0; c < columns; c++){
+            const double weight = eigenVectors[c * columns + order[k]];
+            const double * column = basis.data() + c * samplesPerTrace;
+            for(size_t sample = 0; sample < samplesPerTrace; sample++) component[sample] += weight * column[sample];
+        }
+        
+        size_t largest = 0;
+        for(size_t sample = 1; sample < samplesPerTrace; sample++) if(std::fabs(component[sample]) > std::fabs(component[largest])) largest = sample;
+        if(component[largest] < 0) for(size_t sample = 0; sample < samplesPerTrace; sample++) component[sample] = -component[sample];
+        
+    }
+    
+}
+
+void Pca::setProjection(std::vector<double> & mean, std::vector<double> & components, std::vector<double> & variances, double totalVariance) {
+    
+    m_mean.swap(mean);
+    m_componentRows.swap(components);
+    m_variances.swap(variances);
+    m_totalVariance = totalVariance;
+    
+    // The first component gets the deviation of 4096 by default, leaving a headroom of 8 deviations in int16
+    m_projectionScale = (m_scale > 0) ? m_scale : ((m_variances[0] > 0) ? (float) (4096.0 / std::sqrt(m_variances[0])) : 1.0f);
+    
+    // Floats for the projections, the samples are centered sample by sample, so that the float dot products do not cancel out the mean
+    m_meanF.assign(m_mean.begin(), m_mean.end());
+    m_componentRowsF.assign(m_componentRows.begin(), m_componentRows.end());
+    
+}
+
+template <class T, class U>
+void Pca::projectTrace(const T * samples, std::vector<float> & centered, U * out) const {
+    
+    const size_t samplesPerTrace = m_meanF.size();
+    const size_t noOfComponents = m_variances.size();
+    
+    centered.resize(samplesPerTrace);
+    for(size_t sample = 0; sample < samplesPerTrace; sample++) centered[sample] = samples[sample] - m_meanF[sample];
+    
+    for(size_t k = 0; k < noOfComponents; k++){
+        const float sum = dot(centered.data(), m_componentRowsF.data() + k * samplesPerTrace, samplesPerTrace);
+        out[k] = saturate<U>(sum * m_projectionScale);
+    }
+    
+}
+
+template <class T>
+void Pca::projectChunk(PowerTraces<T> & in, PowerTraces<T> & out) const {
+    
+    std::vector<float> centered;
+    
+    for(size_t trace = 0; trace < in.noOfTraces(); trace++){
+        (*this).projectTrace(&(in(0, trace)), centered, &(out(0, trace)));
+    }
+    
+}
+
+void Pca::saveComponents(const char * id, QJsonObject & conf, QString & componentsFilename, QString & meanFilename) const {
+    
+    componentsFilename = "pca-components-";
+    componentsFilename.append(id);
+    componentsFilename.append(".bin");
+    QByteArray ba = componentsFilename.toLocal8Bit();
+    std::fstream componentsFile = openOutFile(ba.data());
+    writeArrayToFile(componentsFile, m_componentRows.data(), m_componentRows.size());
+    closeFile(componentsFile);
+    
+    meanFilename = "pca-mean-";
+    meanFilename.append(id);
+    meanFilename.append(".bin");
+    ba = meanFilename.toLocal8Bit();
+    std::fstream meanFile = openOutFile(ba.data());
+    writeArrayToFile(meanFile, m_mean.data(), m_mean.size());
+    closeFile(meanFile);
+    
+    QStringList variancesList;
+    for(size_t k = 0; k < m_variances.size(); k++) variancesList << QString::number(m_variances[k]);
+    
+    conf["original-samples-per-trace"] = QString::number(m_mean.size());
+    conf["components"] = componentsFilename;
+    conf["mean"] = meanFilename;
+    conf["scale"] = QString::number(m_projectionScale);
+    conf["variances"] = variancesList.join(",");
+    
+}
+
+void Pca::checkStreaming(size_t samplesPerTrace) const {
+    
+    if(m_method == Method::Randomized) throw InvalidInputException("The statistics of chunks of power traces are the covariance matrix, the randomized method needs all the power traces at once");
+    if(m_method == Method::Auto && samplesPerTrace > PCA_COVARIANCE_MAX_SAMPLES) throw InvalidInputException("The statistics of long power traces take samples^2 doubles, set method=covariance to accumulate them anyway, or reduce the power traces first");
+    if(m_components > samplesPerTrace) throw InvalidInputException("More components than samples per trace requested");
+    
+}
+
+void Pca::startStatistics(size_t samplesPerTrace) {
+    
+    (*this).checkStreaming(samplesPerTrace);
+    
+    m_samplesPerTrace = samplesPerTrace;
+    m_count = 0;
+    m_shift.assign(samplesPerTrace, 0);
+    m_sums.assign(samplesPerTrace, 0);
+    m_products.assign(samplesPerTrace * samplesPerTrace, 0);
+    
+}
+
+template <class T>
+void Pca::accumulateStatistics(const T * traces, size_t noOfTraces) {
+    
+    const size_t samplesPerTrace = m_samplesPerTrace;
+    
+    if(!noOfTraces) return;
+    
+    // The samples are shifted by the mean of the first chunk, close enough to the mean for the float products not to cancel out
+    if(!m_count){
+        for(size_t trace = 0; trace < noOfTraces; trace++){
+            const T * samples = traces + trace * samplesPerTrace;
+            for(size_t sample = 0; sample < samplesPerTrace; sample++) m_shift[sample] += samples[sample];
+        }
+        for(size_t sample = 0; sample < samplesPerTrace; sample++) m_shift[sample] /= noOfTraces;
+    }
+    
+    const std::vector<std::pair<size_t, size_t>> tiles = (*this).covarianceTiles(samplesPerTrace);
+    std::vector<float> block;
+    
+    for(size_t blockFirst = 0; blockFirst < noOfTraces; blockFirst += PCA_BLOCK_TRACES){
+        
+        const size_t blockTraces = std::min((size_t) PCA_BLOCK_TRACES, noOfTraces - blockFirst);
+        
+        (*this).centerBlock(traces + blockFirst * samplesPerTrace, samplesPerTrace, m_shift, blockTraces, block);
+        
+        for(size_t trace = 0; trace < blockTraces; trace++){
+            const float * shifted = block.data() + trace * samplesPerTrace;
+            for(size_t sample = 0; sample < samplesPerTrace; sample++) m_sums[sample] += shifted[sample];
+        }
+        
+        (*this).accumulateProducts(block, blockTraces, samplesPerTrace, tiles, m_products);
+        
+    }
+    
+    m_count += noOfTraces;
+    
+}
+
+QString Pca::saveStatistics(const char * id) {
+    
+    const size_t samplesPerTrace = m_samplesPerTrace;
+    
+    if(!m_count) throw RuntimeException("No power traces to save the statistics of");
+    
+    // Mean = shift + sums / n, centered products M2 = products - sums * sums^T / n, mirrored from the upper triangle
+    std::vector<double> mean(samplesPerTrace);
+    for(size_t sample = 0; sample < samplesPerTrace; sample++) mean[sample] = m_shift[sample] + m_sums[sample] / m_count;
+    
+    for(size_t row = 0; row < samplesPerTrace; row++){
+        for(size_t col = row; col < samplesPerTrace; col++){
+            const double value = m_products[row * samplesPerTrace + col] - m_sums[row] * m_sums[col] / m_count;
+            m_products[row * samplesPerTrace + col] = value;
+            m_products[col * samplesPerTrace + row] = value;
+        }
+    }
+    
+    // Number of the power traces and of the samples per trace, the mean power trace and M2, row major
+    QString statisticsFilename = "pca-statistics-";
+    statisticsFilename.append(id);
+    statisticsFilename.append(".bin");
+    QByteArray ba = statisticsFilename.toLocal8Bit();
+    std::fstream statisticsFile = openOutFile(ba.data());
+    
+    const uint64_t header[2] = { (uint64_t) m_count, (uint64_t) samplesPerTrace };
+    writeArrayToFile(statisticsFile, header, 2);
+    writeArrayToFile(statisticsFile, mean.data(), mean.size());
+    writeArrayToFile(statisticsFile, m_products.data(), m_products.size());
+    closeFile(statisticsFile);
+    
+    return statisticsFilename;
+    
+}
+
+void Pca::freeStatistics() {
+    
+    std::vector<double>().swap(m_shift);
+    std::vector<double>().swap(m_sums);
+    std::vector<double>().swap(m_products);
+    std::vector<double>().swap(m_mean);
+    std::vector<double>().swap(m_componentRows);
+    std::vector<double>().swap(m_variances);
+    std::vector<float>().swap(m_meanF);
+    std::vector<float>().swap(m_componentRowsF);
+    
+}
+
+void Pca::prepareProjection(size_t samplesPerTrace) {
+    
+    (*this).checkStreaming(samplesPerTrace);
+    
+    QTextStream cout(stdout);
+    
+    // Merge the statistics files, the means and M2s are merged exactly: M2 = M2a + M2b + delta * delta^T * na * nb / n, where delta = mean b - mean a
+    size_t count = 0;
+    std::vector<double> mean(samplesPerTrace, 0);
+    std::vector<double> m2(samplesPerTrace * samplesPerTrace, 0);
+    Vector<uint64_t> header(2);
+    Vector<double> otherMean(samplesPerTrace);
+    Vector<double> otherM2(samplesPerTrace * samplesPerTrace);
+    std::vector<double> delta(samplesPerTrace);
+    
+    for(int i = 0; i < m_states.size(); i++){
+        
+        QByteArray ba = m_states.at(i).toLocal8Bit();
+        std::fstream statisticsFile = openInFile(ba.data());
+        fillArrayFromFile(statisticsFile, header);
+        if(header(1) != samplesPerTrace) throw InvalidInputException("The statistics were accumulated from power traces of a different length");
+        fillArrayFromFile(statisticsFile, otherMean);
+        fillArrayFromFile(statisticsFile, otherM2);
+        closeFile(statisticsFile);
+        
+        const size_t otherCount = header(0);
+        const size_t total = count + otherCount;
+        const double weight = (double) count * otherCount / total;
+        
+        for(size_t sample = 0; sample < samplesPerTrace; sample++) delta[sample] = otherMean(sample) - mean[sample];
+        
+        #pragma omp parallel for schedule(static)
+        for(long long row = 0; row < (long long) samplesPerTrace; row++){
+            for(size_t col = 0; col < samplesPerTrace; col++){
+                m2[row * samplesPerTrace + col] += otherM2(row * samplesPerTrace + col) + delta[row] * delta[col] * weight;
+            }
+        }
+        
+        for(size_t sample = 0; sample < samplesPerTrace; sample++) mean[sample] += delta[sample] * otherCount / total;
+        count = total;
+        
+    }
+    
+    if(count < 2) throw InvalidInputException("PCA needs at least 2 power traces");
+    
+    // Covariance = M2 / (n - 1), the total variance is its trace
+    double totalVariance = 0;
+    for(size_t i = 0; i < m2.size(); i++) m2[i] /= (count - 1);
+    for(size_t sample = 0; sample < samplesPerTrace; sample++) totalVariance += m2[sample * samplesPerTrace + sample];
+    
+    const size_t iterations = m_iterations ? m_iterations : 10;
+    
+    cout << QString("Finding %1 principal components of %2 samples of %3 power traces, %4 subspace iterations on the covariance matrix\n").arg(m_components).arg(samplesPerTrace).arg(count).arg(iterations);
+    cout.flush();
+    
+    std::vector<double> components, variances;
+    (*this).findComponents(samplesPerTrace, iterations, [&m2, samplesPerTrace](const std::vector<double> & basis, size_t columns, std::vector<double> & product){ Pca::multiplyMatrix(m2, samplesPerTrace, basis, columns, product); }, components, variances);
+    
+    m_count = count;
+    (*this).setProjection(mean, components, variances, totalVariance);
+    
+}
+
+template <class T>
+void Pca::analyzeTraces(PowerTraces<T> & traces, const char * id) {
+    
+    const size_t samplesPerTrace = traces.samplesPerTrace();
+    const size_t noOfTraces = traces.noOfTraces();
+    
+    if(noOfTraces < 2) throw InvalidInputException("PCA needs at least 2 power traces");
+    if(m_components > samplesPerTrace) throw InvalidInputException("More components than samples per trace requested");
+    
+    const bool covarianceMethod = (m_method == Method::Covariance) || (m_method == Method::Auto && samplesPerTrace <= PCA_COVARIANCE_MAX_SAMPLES);
+    const size_t iterations = m_iterations ? m_iterations : (covarianceMethod ? 10 : 2);
+    
+    QTextStream cout(stdout);
+    cout << QString("Finding %1 principal components of %2 samples, %3 subspace iterations %4\n").arg(m_components).arg(samplesPerTrace).arg(iterations).arg(covarianceMethod ? "on the covariance matrix" : "on the power traces (randomized)");
+    cout.flush();
+    
+    std::vector<double> mean;
+    double totalVariance;
+    (*this).computeMean(traces, mean, totalVariance);
+    
+    std::vector<double> covariance;
+    if(covarianceMethod){
+        cout << "Computing the covariance matrix...\n";
+        cout.flush();
+        (*this).computeCovariance(traces, mean, covariance);
+    }
+    
+    std::vector<double> components, variances;
+    (*this).findComponents(samplesPerTrace, iterations, [&](const std::vector<double> & basis, size_t columns, std::vector<double> & product){ (*this).multiplyCovariance(traces, mean, covariance, basis, columns, product); }, components, variances);
+    
+    (*this).setProjection(mean, components, variances, totalVariance);
+    (*this).saveProjectedTraces(traces, id);
+    (*this).freeStatistics();
+    
+}
+
+template <class T>
+void Pca::saveTracesStatistics(PowerTraces<T> & traces, const char * id) {
+    
+    const size_t noOfTraces = traces.noOfTraces();
+    
+    (*this).startStatistics(traces.samplesPerTrace());
+    
+    QTextStream cout(stdout);
+    cout << "Accumulating the statistics of the power traces...\n";
+    cout.flush();
+    
+    CoutProgress::get().start(noOfTraces);
+    
+    for(size_t chunkFirst = 0; chunkFirst < noOfTraces; chunkFirst += PCA_CHUNK_TRACES){
+        
+        const size_t chunkTraces = std::min((size_t) PCA_CHUNK_TRACES, noOfTraces - chunkFirst);
+        (*this).accumulateStatistics(&(traces(0, chunkFirst)), chunkTraces);
+        
+        CoutProgress::get().update(chunkFirst + chunkTraces);
+        
+    }
+    
+    CoutProgress::get().finish();
+    
+    QString statisticsFilename = (*this).saveStatistics(id);
+    (*this).freeStatistics();
+    
+    cout << QString("Saved the statistics of %1 power traces to '%2'.\n").arg(noOfTraces).arg(statisticsFilename);
+    
+}
+
+template <class T>
+void Pca::projectTracesFromStatistics(PowerTraces<T> & traces, const char * id) {
+    
+    (*this).prepareProjection(traces.samplesPerTrace());
+    (*this).saveProjectedTraces(traces, id);
+    (*this).freeStatistics();
+    
+}
+
+template <class T>
+void Pca::saveProjectedTraces(PowerTraces<T> & traces, const char * id) {
+    
+    const size_t noOfTraces = traces.noOfTraces();
+    const size_t noOfComponents = m_variances.size();
+    
+    QTextStream cout(stdout);
+    
+    QString tracesFilename = "pca-traces-";
+    tracesFilename.append(id);
+    tracesFilename.append(".bin");
+    QByteArray ba = tracesFilename.toLocal8Bit();
+    std::fstream tracesFile = openOutFile(ba.data());
+    
+    cout << "Projecting the power traces...\n";
+    cout.flush();
+    
+    const size_t chunkSize = (noOfTraces < PCA_CHUNK_TRACES) ? noOfTraces : PCA_CHUNK_TRACES;
+    std::vector<int16_t> projectedTraces(chunkSize * noOfComponents);
+    
+    CoutProgress::get().start(noOfTraces);
+    
+    for(size_t chunkFirst = 0; chunkFirst < noOfTraces; chunkFirst += chunkSize){
+        
+        const long long chunkTraces = (noOfTraces - chunkFirst < chunkSize) ? noOfTraces - chunkFirst : chunkSize;
+        
+        #pragma omp parallel
+        {
+            
+            std::vector<float> centered;
+            
+            #pragma omp for schedule(static)
+            for(long long trace = 0; trace < chunkTraces; trace++){
+                (*this).projectTrace(&(traces(0, chunkFirst + trace)), centered, projectedTraces.data() + trace * noOfComponents);
+            }
+            
+        }
+        
+        writeArrayToFile(tracesFile, projectedTraces.data(), chunkTraces * noOfComponents);
+        
+        CoutProgress::get().update(chunkFirst + chunkTraces);
+        
+    }
+    
+    CoutProgress::get().finish();
+    
+    closeFile(tracesFile);
+    
+    // Save the components and the mean power trace, flush config to json file, along with the variances of the components and the scale of the projections
+    QJsonObject tracesConf = tracesConfig<int16_t>(tracesFilename, noOfTraces, noOfComponents);
+    QString componentsFilename, meanFilename;
+    (*this).saveComponents(id, tracesConf, componentsFilename, meanFilename);
+    saveTracesConfig(tracesConf, id);
+    
+    double explained = 0;
+    for(size_t k = 0; k < noOfComponents; k++) explained += m_variances[k];
+    
+    cout << QString("Projected %1 power traces onto %2 principal components, explaining %3 % of the variance,\nand saved to '%4', components to '%5', mean power trace to '%6'.\n").arg(noOfTraces).arg(noOfComponents).arg((m_totalVariance > 0) ? 100 * explained / m_totalVariance : 0.0).arg(tracesFilename).arg(componentsFilename).arg(meanFilename);
+    
+}
@@ -0,0 +1,228 @@
+/*
+*  SICAK - SIde-Channel Analysis toolKit
+*  Copyright (C) 2018-2019 Petr Socha, FIT, CTU in Prague
+*
+*  This program is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation, either version 3 of the License, or
+*  (at your option) any later version.
+*
+*  This program is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/**
+* \file pca.h
+*
+* \brief SICAK traces processing plugin: principal component analysis (PCA) of power traces
+*
+*
+* \author Petr Socha
+* \version 1.0
+*/
+
+#ifndef PCA_H
+#define PCA_H 
+
+#include <QObject>
+#include <QtPlugin>
+#include <QString>
+#include <QJsonObject>
+#include <QStringList>
+#include <vector>
+#include "tracesprocess.h"
+#include "exceptions.hpp"
+
+/**
+* \class Pca
+* \ingroup TracesProcess
+*
+* \brief Principal component analysis SICAK TracesProcess plugin. Finds the top principal components of the power traces and saves the power traces projected onto them,
+* along with the components and the mean power trace.
+*
+* The components are found by a subspace iteration followed by the eigendecomposition of the small projected matrix (Rayleigh-Ritz), either:
+*  - covariance: on the sample covariance matrix, accumulated in a single pass thru the power traces by blocked matrix products, or
+*  - randomized: on a randomized range sketch, every iteration being a single pass thru the power traces, without forming the covariance matrix (for long power traces).
+*
+* Threads accumulate partial sums over blocks of power traces, which are then merged.
+*
+* The components need all the power traces before the first one can be projected, so that processing chunks of power traces (e.g. in a pipeline) takes two passes,
+* set by the "pass" param, both using the covariance method:
+*  - statistics: the number of power traces, the mean power trace and the sums of the products of the centered samples are accumulated, while the power traces
+*    pass thru unchanged, and saved into 'pca-statistics-ID.bin', ID being set by the "id" param. The statistics of several files (e.g. several campaigns) are merged exactly,
+*  - project: the statistics files given by the "state" param are merged, the components are found, and the chunks are projected onto them.
+*
+*/
+class Pca : public QObject, TracesProcess {
+    
+    Q_OBJECT
+    Q_PLUGIN_METADATA(IID "cz.cvut.fit.Sicak.TracesProcessInterface/1.2" FILE "pca.json")
+    Q_INTERFACES(TracesProcess)
+                
+public:
+    
+    Pca();
+    virtual ~Pca() override;
+    
+    virtual QString getPluginName() override;
+    virtual QString getPluginInfo() override;
+    
+    /// Initializes the plugin, param holds the parameters separated by semicolons, e.g. "components=20;method=randomized"
+    virtual void init(const char * param) override;
+    virtual void deInit() override;
+    
+    /// Finds the principal components and saves the projected power traces into a new file
+    virtual void processTraces(PowerTraces<int16_t> & traces, const char * id) override;    
+    /// Finds the principal components and saves the projected 8-bit power traces into a new file
+    virtual void processTraces(PowerTraces<int8_t> & traces, const char * id) override;    
+    
+    /// Prepares the statistics, or merges the statistics files and finds the components, returns the number of samples of the output power traces
+    virtual size_t startStream(size_t samplesPerTrace, size_t noOfTraces) override;
+    /// Projections of the power traces are independent, the statistics are not
+    virtual bool isStateless() override;
+    /// Accumulates the statistics of the chunk, the power traces pass thru unchanged, or projects the chunk onto the components
+    virtual void processChunk(PowerTraces<int16_t> & in, PowerTraces<int16_t> & out, size_t firstTrace) override;
+    /// Accumulates the statistics of the 8-bit chunk, the power traces pass thru unchanged; 8-bit chunks cannot be projected, the projections would saturate
+    virtual void processChunk(PowerTraces<int8_t> & in, PowerTraces<int8_t> & out, size_t firstTrace) override;
+    /// Saves the statistics, or the components and the mean power trace
+    virtual void finishStream() override;
+    
+protected:
+    
+    /// Computation of the components
+    enum class Method {
+        Auto,       //< covariance for shorter power traces, randomized otherwise
+        Covariance, //< subspace iteration on the covariance matrix
+        Randomized  //< subspace iteration on the power traces
+    };
+    
+    /// Pass thru the power traces
+    enum class Pass {
+        All,        //< statistics and projections of all the power traces at once
+        Statistics, //< statistics of the power traces, saved into a file
+        Project     //< projections onto the components found from the statistics files
+    };
+    
+    /// Finds the principal components and projects the power traces, T is either int16_t or int8_t
+    template <class T>
+    void analyzeTraces(PowerTraces<T> & traces, const char * id);
+    
+    /// Accumulates the statistics and saves them into a file, without projecting the power traces
+    template <class T>
+    void saveTracesStatistics(PowerTraces<T> & traces, const char * id);
+    
+    /// Finds the components from the statistics files and projects the power traces
+    template <class T>
+    void projectTracesFromStatistics(PowerTraces<T> & traces, const char * id);
+    
+    /// Saves the components and the mean power trace, projects the power traces onto the components and saves them into a new file
+    template <class T>
+    void saveProjectedTraces(PowerTraces<T> & traces, const char * id);
+    
+    /// Computes the mean power trace and the total variance, i.e. the sum of the variances of the samples
+    template <class T>
+    void computeMean(PowerTraces<T> & traces, std::vector<double> & mean, double & totalVariance) const;
+    
+    /// Computes the sample covariance matrix (row major), in a single pass thru the power traces
+    template <class T>
+    void computeCovariance(PowerTraces<T> & traces, const std::vector<double> & mean, std::vector<double> & covariance) const;
+    
+    /// Multiplies the 'columns' columns of the basis by the covariance matrix: either the given one, or, when it is empty, implicitly by a pass thru the power traces
+    template <class T>
+    void multiplyCovariance(PowerTraces<T> & traces, const std::vector<double> & mean, const std::vector<double> & covariance, const std::vector<double> & basis, size_t columns, std::vector<double> & product) const;
+    
+    /// Multiplies the 'columns' columns of the basis by the covariance matrix (row major)
+    static void multiplyMatrix(const std::vector<double> & covariance, size_t samplesPerTrace, const std::vector<double> & basis, size_t columns, std::vector<double> & product);
+    
+    /// Finds the components (a row each) and their variances by the subspace iteration, 'multiply' multiplies the columns of a basis by the covariance matrix
+    template <class Multiply>
+    void findComponents(size_t samplesPerTrace, size_t iterations, Multiply multiply, std::vector<double> & components, std::vector<double> & variances) const;
+    
+    /// Copies 'count' power traces into a block of centered samples
+    template <class T>
+    static void centerBlock(const T * traces, size_t samplesPerTrace, const std::vector<double> & mean, size_t count, std::vector<float> & block);
+    
+    /// Tiles of the upper triangle of the covariance matrix
+    static std::vector<std::pair<size_t, size_t>> covarianceTiles(size_t samplesPerTrace);
+    
+    /// Adds the products of the samples of the block of centered power traces to the upper triangle of 'products', tile by tile
+    static void accumulateProducts(const std::vector<float> & block, size_t blockTraces, size_t samplesPerTrace, const std::vector<std::pair<size_t, size_t>> & tiles, std::vector<double> & products);
+    
+    /// Checks the parameters of the streaming passes, which compute the covariance matrix
+    void checkStreaming(size_t samplesPerTrace) const;
+    
+    /// Prepares the statistics of the power traces
+    void startStatistics(size_t samplesPerTrace);
+    
+    /// Adds 'noOfTraces' power traces to the statistics
+    template <class T>
+    void accumulateStatistics(const T * traces, size_t noOfTraces);
+    
+    /// Saves the number of power traces, the mean power trace and the sums of the products of the centered samples, returns the filename
+    QString saveStatistics(const char * id);
+    
+    /// Frees the statistics and the projection
+    void freeStatistics();
+    
+    /// Merges the statistics files, finds the components and prepares the projection
+    void prepareProjection(size_t samplesPerTrace);
+    
+    /// Sets the projection: the mean power trace, the components, their variances and the scale of the projections
+    void setProjection(std::vector<double> & mean, std::vector<double> & components, std::vector<double> & variances, double totalVariance);
+    
+    /// Projects a power trace onto the components, 'centered' is a scratch buffer
+    template <class T, class U>
+    void projectTrace(const T * samples, std::vector<float> & centered, U * out) const;
+    
+    /// Projects a chunk of the power traces
+    template <class T>
+    void projectChunk(PowerTraces<T> & in, PowerTraces<T> & out) const;
+    
+    /// Saves the components and the mean power trace, adds their filenames, the scale and the variances to the json config
+    void saveComponents(const char * id, QJsonObject & conf, QString & componentsFilename, QString & meanFilename) const;
+    
+    /// Orthonormalizes the columns (each 'rows' long, stored one after another) by the modified Gram-Schmidt process
+    static void orthonormalize(std::vector<double> & columns, size_t rows, size_t noOfColumns);
+    
+    /// Eigendecomposition of a symmetric matrix by the cyclic Jacobi method. The matrix is destroyed, eigenvectors are the columns of 'vectors' (row major)
+    static void eigenSymmetric(std::vector<double> & matrix, size_t size, std::vector<double> & values, std::vector<double> & vectors);
+    
+    /// Number of the principal components
+    size_t m_components;
+    Method m_method;
+    /// Number of the extra columns of the subspace, improving the accuracy of the components
+    size_t m_oversample;
+    /// Number of the subspace iterations, zero for the default of the method
+    size_t m_iterations;
+    /// Output samples are multiplied by the scale, zero for an automatic scale
+    float m_scale;
+    Pass m_pass;
+    /// ID in the names of the files saved when the stream finishes
+    QString m_id;
+    /// Statistics files the components are found from
+    QStringList m_states;
+    
+    /// Statistics: number of the power traces, the samples are shifted by the mean of the first chunk, sums of the shifted samples and of their products
+    size_t m_samplesPerTrace;
+    size_t m_count;
+    std::vector<double> m_shift;
+    std::vector<double> m_sums;
+    std::vector<double> m_products;
+    
+    /// Projection: the mean power trace, the components (a row each), their variances, the total variance and the scale of the projections
+    std::vector<double> m_mean;
+    std::vector<double> m_componentRows;
+    std::vector<double> m_variances;
+    double m_totalVariance;
+    float m_projectionScale;
+    std::vector<float> m_meanF;
+    std::vector<float> m_componentRowsF;
+    
+};
+
+#endif /* PCA_H */
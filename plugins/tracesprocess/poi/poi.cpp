@@ -0,0 +1,613 @@
+/*
+*  SICAK - SIde-Channel Analysis toolKit
+*  Copyright (C) 2018-2019 Petr Socha, FIT, CTU in Prague
+*
+*  This program is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation, either version 3 of the License, or
+*  (at your option) any later version.
+*
+*  This program is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/**
+* \file poi.cpp
+*
+* \brief SICAK traces processing plugin: points of interest selection by SNR or NICV
+*
+*
+* \author Petr Socha
+* \version 1.0
+*/
+
+#include "poi.h"
+#include "aes128.hpp"
+#include "filehandling.hpp"
+#include "global_calls.hpp"
+#include "tracesoutput.hpp"
+#include <QStringList>
+#include <QTextStream>
+#include <QJsonObject>
+#include <QDateTime>
+#include <algorithm>
+#include <cstdint>
+#include <omp.h>
+
+/// Number of samples a thread accumulates the statistics of at once
+#define POI_BLOCK_SAMPLES 1024
+/// Number of reduced power traces written at once
+#define POI_CHUNK_TRACES 65536
+
+Poi::Poi(): m_blockLength(16), m_byte(0), m_key(0), m_sbox(true), m_hw(true), m_nicv(false), m_top(0), m_threshold(0), m_thresholdSet(false), m_window(0), m_noOfClasses(0), m_samplesPerTrace(0), m_noOfTraces(0) {
+    
+}
+
+Poi::~Poi() {
+    
+    (*this).deInit();
+               
+}
+
+QString Poi::getPluginName() {
+    return "Select points of interest using SNR or NICV of AES-128 first round intermediate";
+}
+
+QString Poi::getPluginInfo() {
+    return "Computes SNR or NICV of every sample and saves the power traces reduced to the selected samples. Set the intermediate and the selection using params, e.g. \"data=plaintext.bin;byte=0;key=2b;top=2000\". In a pipeline, the power traces pass thru unchanged and the indices of the selected samples are saved to 'poi-ID.json', ID set by \"id=\". Set \"select=poi-ID.json\" to reduce the power traces to these samples, e.g. in a second pipeline.";
+}
+
+void Poi::init(const char * param) {    
+    
+    QStringList params = QString(param).split(";");
+    QString paramVal;
+    
+    m_data = "";
+    m_blockLength = 16;
+    m_byte = 0;
+    m_key = 0;
+    m_sbox = true;
+    m_hw = true;
+    m_nicv = false;
+    m_top = 0;
+    m_threshold = 0;
+    m_thresholdSet = false;
+    m_window = 0;
+    m_select = "";
+    m_id = (QDateTime::currentDateTime()).toString("ddMMyy-HHmmss");
+    
+    for (int i = 0; i < params.size(); ++i){ // iterate thru all parameters
+        
+        bool ok = true;
+        
+        if(params.at(i).startsWith("data=")){
+            
+            m_data = params.at(i);
+            m_data.remove(0,5);
+            
+        } else if(params.at(i).startsWith("blocklength=")){
+            
+            paramVal = params.at(i);
+            paramVal.remove(0,12);
+            m_blockLength = paramVal.toULongLong(&ok);
+            ok = ok && m_blockLength > 0;
+            
+        } else if(params.at(i).startsWith("byte=")){
+            
+            paramVal = params.at(i);
+            paramVal.remove(0,5);
+            m_byte = paramVal.toULongLong(&ok);
+            
+        } else if(params.at(i).startsWith("key=")){
+            
+            paramVal = params.at(i);
+            paramVal.remove(0,4);
+            unsigned key = paramVal.toUInt(&ok, 16);
+            ok = ok && key < 256;
+            m_key = (uint8_t) key;
+            
+        } else if(params.at(i).startsWith("intermediate=")){
+            
+            paramVal = params.at(i);
+            paramVal.remove(0,13);
+            
+            if(paramVal == "sbox") m_sbox = true;
+            else if(paramVal == "xor") m_sbox = false;
+            else throw InvalidInputException("Invalid intermediate param, use either sbox or xor");
+            
+        } else if(params.at(i).startsWith("model=")){
+            
+            paramVal = params.at(i);
+            paramVal.remove(0,6);
+            
+            if(paramVal == "hw") m_hw = true;
+            else if(paramVal == "id") m_hw = false;
+            else throw InvalidInputException("Invalid model param, use either hw or id");
+            
+        } else if(params.at(i).startsWith("metric=")){
+            
+            paramVal = params.at(i);
+            paramVal.remove(0,7);
+            
+            if(paramVal == "snr") m_nicv = false;
+            else if(paramVal == "nicv") m_nicv = true;
+            else throw InvalidInputException("Invalid metric param, use either snr or nicv");
+            
+        } else if(params.at(i).startsWith("top=")){
+            
+            paramVal = params.at(i);
+            paramVal.remove(0,4);
+            m_top = paramVal.toULongLong(&ok);
+            ok = ok && m_top > 0;
+            
+        } else if(params.at(i).startsWith("threshold=")){
+            
+            paramVal = params.at(i);
+            paramVal.remove(0,10);
+            m_threshold = paramVal.toDouble(&ok);
+            m_thresholdSet = true;
+            
+        } else if(params.at(i).startsWith("window=")){
+            
+            paramVal = params.at(i);
+            paramVal.remove(0,7);
+            m_window = paramVal.toULongLong(&ok);
+            
+        } else if(params.at(i).startsWith("id=")){
+            
+            m_id = params.at(i);
+            m_id.remove(0,3);
+            ok = !m_id.isEmpty();
+            
+        } else if(params.at(i).startsWith("select=")){
+            
+            m_select = params.at(i);
+            m_select.remove(0,7);
+            ok = !m_select.isEmpty();
+            
+        } else if(params.at(i).size()) {
+            
+            throw InvalidInputException("Unknown points of interest param");
+            
+        }
+        
+        if(!ok) throw InvalidInputException("Invalid points of interest param");
+        
+    }
+    
+    // The selection is given, no statistics are needed
+    if(!m_select.isEmpty()) return;
+    
+    if(m_data.isEmpty()) throw InvalidInputException("Data blocks file needs to be set, e.g. \"data=plaintext.bin\"");
+    if(m_byte >= m_blockLength) throw InvalidInputException("Byte param is out of the data block");
+    if(!m_top && !m_thresholdSet) throw InvalidInputException("Set either the number of points (top=K), or the threshold (threshold=X), or both");
+    
+}
+
+void Poi::deInit() {
+    
+    (*this).freeStatistics();
+    std::vector<size_t>().swap(m_selected);
+    
+}
+
+void Poi::processTraces(PowerTraces<int16_t> & traces, const char * id) {
+    
+    if(m_select.isEmpty()) (*this).selectPoints(traces, id);
+    else (*this).applySelection(traces, id);
+    
+}
+
+void Poi::processTraces(PowerTraces<int8_t> & traces, const char * id) {
+    
+    if(m_select.isEmpty()) (*this).selectPoints(traces, id);
+    else (*this).applySelection(traces, id);
+    
+}
+
+size_t Poi::startStream(size_t samplesPerTrace, size_t noOfTraces) {
+    
+    if(!m_select.isEmpty()){
+        m_selected = (*this).loadSampleIndices(samplesPerTrace);
+        m_samplesPerTrace = samplesPerTrace;
+        return m_selected.size();
+    }
+    
+    (*this).startStatistics(samplesPerTrace, noOfTraces);
+    
+    return samplesPerTrace;
+    
+}
+
+bool Poi::isStateless() {
+    
+    // Reducing the power traces to the given samples needs no state, unlike accumulating the statistics
+    return !m_select.isEmpty();
+    
+}
+
+void Poi::processChunk(PowerTraces<int16_t> & in, PowerTraces<int16_t> & out, size_t firstTrace) {
+    
+    if(m_select.isEmpty()) (*this).accumulateChunk(in, out, firstTrace);
+    else (*this).reduceTraces(in.data(), out.data(), in.noOfTraces(), m_samplesPerTrace, m_selected);
+    
+}
+
+void Poi::processChunk(PowerTraces<int8_t> & in, PowerTraces<int8_t> & out, size_t firstTrace) {
+    
+    if(m_select.isEmpty()) (*this).accumulateChunk(in, out, firstTrace);
+    else (*this).reduceTraces(in.data(), out.data(), in.noOfTraces(), m_samplesPerTrace, m_selected);
+    
+}
+
+void Poi::finishStream() {
+    
+    QTextStream cout(stdout);
+    
+    if(!m_select.isEmpty()){
+        cout << QString("Reduced the power traces to %1 of %2 samples selected in '%3'.\n").arg(m_selected.size()).arg(m_samplesPerTrace).arg(m_select);
+        std::vector<size_t>().swap(m_selected);
+        return;
+    }
+    
+    std::vector<double> metric = (*this).computeMetric();
+    (*this).freeStatistics();
+    
+    std::vector<size_t> selected = (*this).pickSamples(metric);
+    
+    if(selected.empty()) throw RuntimeException("No sample has been selected, lower the threshold");
+    
+    QByteArray ba = m_id.toLocal8Bit();
+    QString metricFilename = (*this).saveMetric(metric, ba.data());
+    
+    // Flush the original positions of the selected samples to json file
+    QJsonObject selectionConf;
+    (*this).addSampleIndices(selectionConf, selected);
+    QString selectionId = "poi-";
+    selectionId.append(m_id);
+    saveTracesConfig(selectionConf, selectionId);
+    
+    const size_t best = *std::max_element(selected.begin(), selected.end(), [&metric](size_t a, size_t b){ return metric[a] < metric[b]; });
+    
+    cout << QString("Selected %1 of %2 samples, the highest %3 is %4 at sample %5.\n").arg(selected.size()).arg(m_samplesPerTrace).arg(m_nicv ? "NICV" : "SNR").arg(metric[best]).arg(best);
+    cout << QString("Saved %1 to '%2', the indices of the selected samples to '%3'.\n").arg(m_nicv ? "NICV" : "SNR").arg(metricFilename).arg(selectionId + ".json");
+    
+}
+
+void Poi::classifyTraces(size_t noOfTraces, std::vector<uint8_t> & classes, size_t & noOfClasses) {
+    
+    Matrix<uint8_t> blocks(m_blockLength, noOfTraces);
+    
+    QByteArray ba = m_data.toLocal8Bit();
+    std::fstream dataFile = openInFile(ba.data());
+    fillArrayFromFile(dataFile, blocks);
+    closeFile(dataFile);
+    
+    const uint8_t * sbox = Aes128::sbox();
+    
+    noOfClasses = m_hw ? 9 : 256;
+    classes.resize(noOfTraces);
+    
+    for(size_t trace = 0; trace < noOfTraces; trace++){
+        
+        uint8_t value = blocks(m_byte, trace) ^ m_key;
+        if(m_sbox) value = sbox[value];
+        
+        if(m_hw){
+            uint8_t weight = 0;
+            for(int bit = 0; bit < 8; bit++) weight += (value >> bit) & 1;
+            value = weight;
+        }
+        
+        classes[trace] = value;
+        
+    }
+    
+}
+
+std::vector<size_t> Poi::pickSamples(const std::vector<double> & metric) {
+    
+    const size_t samplesPerTrace = metric.size();
+    
+    // Candidates, best first
+    std::vector<size_t> order;
+    for(size_t sample = 0; sample < samplesPerTrace; sample++){
+        if(!m_thresholdSet || metric[sample] >= m_threshold) order.push_back(sample);
+    }
+    
+    std::sort(order.begin(), order.end(), [&metric](size_t a, size_t b){ return metric[a] > metric[b]; });
+    
+    if(m_top && order.size() > m_top) order.resize(m_top);
+    
+    // Points along with their windows, merged
+    std::vector<bool> selected(samplesPerTrace, false);
+    
+    for(size_t i = 0; i < order.size(); i++){
+        size_t first = (order[i] > m_window) ? order[i] - m_window : 0;
+        size_t last = (order[i] + m_window < samplesPerTrace) ? order[i] + m_window : samplesPerTrace - 1;
+        for(size_t sample = first; sample <= last; sample++) selected[sample] = true;
+    }
+    
+    std::vector<size_t> samples;
+    for(size_t sample = 0; sample < samplesPerTrace; sample++){
+        if(selected[sample]) samples.push_back(sample);
+    }
+    
+    return samples;
+    
+}
+
+std::vector<size_t> Poi::loadSampleIndices(size_t samplesPerTrace) {
+    
+    QJsonObject conf;
+    if(!loadTracesConfig(m_select, conf)) throw RuntimeException("Failed to load the selected samples, the json file is missing or invalid");
+    
+    if(!conf.contains("sample-indices") || !conf.contains("original-samples-per-trace")) throw InvalidInputException("The json file does not contain the selected samples (sample-indices)");
+    
+    bool ok;
+    if(conf.value("original-samples-per-trace").toString().toULongLong(&ok) != samplesPerTrace || !ok) throw InvalidInputException("The samples were selected in power traces of a different length");
+    
+    const QStringList values = conf.value("sample-indices").toString().split(",");
+    std::vector<size_t> selected;
+    
+    for(int i = 0; i < values.size(); i++){
+        
+        const size_t sample = values.at(i).trimmed().toULongLong(&ok);
+        if(!ok || sample >= samplesPerTrace || (!selected.empty() && sample <= selected.back())) throw InvalidInputException("Invalid sample-indices in the json file, expected ascending indices of samples of the power traces");
+        selected.push_back(sample);
+        
+    }
+    
+    return selected;
+    
+}
+
+template <class T>
+void Poi::reduceTraces(const T * traces, T * reduced, size_t noOfTraces, size_t samplesPerTrace, const std::vector<size_t> & selected) {
+    
+    const size_t noOfSelected = selected.size();
+    
+    for(size_t trace = 0; trace < noOfTraces; trace++){
+        const T * samples = traces + trace * samplesPerTrace;
+        T * out = reduced + trace * noOfSelected;
+        for(size_t i = 0; i < noOfSelected; i++) out[i] = samples[selected[i]];
+    }
+    
+}
+
+template <class T>
+QString Poi::saveReducedTraces(PowerTraces<T> & traces, const std::vector<size_t> & selected, const char * id) {
+    
+    const size_t samplesPerTrace = traces.samplesPerTrace();
+    const size_t noOfTraces = traces.noOfTraces();
+    
+    QString tracesFilename = "poi-traces-";
+    tracesFilename.append(id);
+    tracesFilename.append(".bin");
+    QByteArray ba = tracesFilename.toLocal8Bit();
+    std::fstream tracesFile = openOutFile(ba.data());
+    
+    const size_t noOfSelected = selected.size();
+    const size_t chunkSize = (noOfTraces < POI_CHUNK_TRACES) ? noOfTraces : POI_CHUNK_TRACES;
+    std::vector<T> reduced(chunkSize * noOfSelected);
+    
+    for(size_t chunkFirst = 0; chunkFirst < noOfTraces; chunkFirst += chunkSize){
+        
+        const long long chunkTraces = (noOfTraces - chunkFirst < chunkSize) ? noOfTraces - chunkFirst : chunkSize;
+        
+        // Threads reduce the power traces of the chunk, in a pipeline the workers process the chunks in parallel instead
+        #pragma omp parallel for
+        for(long long trace = 0; trace < chunkTraces; trace++){
+            (*this).reduceTraces(&(traces(0, chunkFirst + trace)), reduced.data() + trace * noOfSelected, 1, samplesPerTrace, selected);
+        }
+        
+        writeArrayToFile(tracesFile, reduced.data(), chunkTraces * noOfSelected);
+        
+    }
+    
+    closeFile(tracesFile);
+    
+    return tracesFilename;
+    
+}
+
+template <class T>
+void Poi::applySelection(PowerTraces<T> & traces, const char * id) {
+    
+    QTextStream cout(stdout);
+    
+    m_samplesPerTrace = traces.samplesPerTrace();
+    std::vector<size_t> selected = (*this).loadSampleIndices(m_samplesPerTrace);
+    
+    QString tracesFilename = (*this).saveReducedTraces(traces, selected, id);
+    
+    // Flush config to json file, along with the original positions of the samples
+    QJsonObject tracesConf = tracesConfig<T>(tracesFilename, traces.noOfTraces(), selected.size());
+    (*this).addSampleIndices(tracesConf, selected);
+    saveTracesConfig(tracesConf, id);
+    
+    cout << QString("Saved %1 power traces reduced to %2 of %3 samples selected in '%4' to '%5'.\n").arg(traces.noOfTraces()).arg(selected.size()).arg(m_samplesPerTrace).arg(m_select).arg(tracesFilename);
+    
+}
+
+void Poi::startStatistics(size_t samplesPerTrace, size_t noOfTraces) {
+    
+    (*this).classifyTraces(noOfTraces, m_classes, m_noOfClasses);
+    
+    m_classCounts.assign(m_noOfClasses, 0);
+    for(size_t trace = 0; trace < noOfTraces; trace++) m_classCounts[m_classes[trace]]++;
+    
+    m_samplesPerTrace = samplesPerTrace;
+    m_noOfTraces = noOfTraces;
+    m_classSums.assign(m_noOfClasses * samplesPerTrace, 0);
+    m_sumsSq.assign(samplesPerTrace, 0);
+    
+}
+
+void Poi::freeStatistics() {
+    
+    std::vector<uint8_t>().swap(m_classes);
+    std::vector<uint64_t>().swap(m_classCounts);
+    std::vector<int64_t>().swap(m_classSums);
+    std::vector<int64_t>().swap(m_sumsSq);
+    
+}
+
+template <class T>
+void Poi::accumulateTraces(const T * traces, size_t noOfTraces, size_t firstTrace) {
+    
+    const size_t samplesPerTrace = m_samplesPerTrace;
+    const long long noOfBlocks = (samplesPerTrace + POI_BLOCK_SAMPLES - 1) / POI_BLOCK_SAMPLES;
+    
+    // Sums of the samples per class and sums of squares of the samples, exact. Threads split the samples, so that they do not share any sums
+    #pragma omp parallel for schedule(dynamic)
+    for(long long block = 0; block < noOfBlocks; block++){
+        
+        const size_t first = block * POI_BLOCK_SAMPLES;
+        const size_t last = (first + POI_BLOCK_SAMPLES < samplesPerTrace) ? first + POI_BLOCK_SAMPLES : samplesPerTrace;
+        int64_t * sumSq = m_sumsSq.data();
+        
+        for(size_t trace = 0; trace < noOfTraces; trace++){
+            
+            const T * samples = traces + trace * samplesPerTrace;
+            int64_t * sum = m_classSums.data() + m_classes[firstTrace + trace] * samplesPerTrace;
+            
+            for(size_t sample = first; sample < last; sample++){
+                const int64_t value = samples[sample];
+                sum[sample] += value;
+                sumSq[sample] += value * value;
+            }
+            
+        }
+        
+    }
+    
+}
+
+template <class T>
+void Poi::accumulateChunk(PowerTraces<T> & in, PowerTraces<T> & out, size_t firstTrace) {
+    
+    (*this).accumulateTraces(in.data(), in.noOfTraces(), firstTrace);
+    
+    // The power traces pass thru unchanged
+    std::copy(in.data(), in.data() + in.length(), out.data());
+    
+}
+
+std::vector<double> Poi::computeMetric() {
+    
+    const size_t samplesPerTrace = m_samplesPerTrace;
+    const size_t noOfTraces = m_noOfTraces;
+    
+    // Var(E[X|class]) is the signal, E[Var(X|class)] is the noise, Var(X) is the total
+    std::vector<double> metric(samplesPerTrace, 0);
+    
+    for(size_t sample = 0; sample < samplesPerTrace; sample++){
+        
+        double sum = 0, classMeansSq = 0;
+        
+        for(size_t c = 0; c < m_noOfClasses; c++){
+            if(!m_classCounts[c]) continue;
+            const double classSum = (double) m_classSums[c * samplesPerTrace + sample];
+            sum += classSum;
+            classMeansSq += classSum * classSum / m_classCounts[c];
+        }
+        
+        const double mean = sum / noOfTraces;
+        const double signal = classMeansSq / noOfTraces - mean * mean;
+        const double total = (double) m_sumsSq[sample] / noOfTraces - mean * mean;
+        const double noise = total - signal;
+        
+        if(m_nicv){
+            metric[sample] = (total > 0) ? signal / total : 0;
+        } else {
+            metric[sample] = (noise > 0) ? signal / noise : 0;
+        }
+        
+    }
+    
+    return metric;
+    
+}
+
+QString Poi::saveMetric(const std::vector<double> & metric, const char * id) {
+    
+    // A double per sample
+    QString metricFilename = m_nicv ? "nicv-" : "snr-";
+    metricFilename.append(id);
+    metricFilename.append(".bin");
+    QByteArray ba = metricFilename.toLocal8Bit();
+    std::fstream metricFile = openOutFile(ba.data());
+    writeArrayToFile(metricFile, metric.data(), metric.size());
+    closeFile(metricFile);
+    
+    return metricFilename;
+    
+}
+
+void Poi::addSampleIndices(QJsonObject & conf, const std::vector<size_t> & selected) {
+    
+    QStringList indices;
+    for(size_t i = 0; i < selected.size(); i++) indices << QString::number(selected[i]);
+    
+    conf["original-samples-per-trace"] = QString::number(m_samplesPerTrace);
+    conf["sample-indices"] = indices.join(",");
+    
+}
+
+template <class T>
+void Poi::selectPoints(PowerTraces<T> & traces, const char * id) {
+    
+    const size_t samplesPerTrace = traces.samplesPerTrace();
+    const size_t noOfTraces = traces.noOfTraces();
+    
+    QTextStream cout(stdout);
+    
+    (*this).startStatistics(samplesPerTrace, noOfTraces);
+    
+    cout << QString("Computing %1 of %2 samples, %3 classes of the intermediate...\n").arg(m_nicv ? "NICV" : "SNR").arg(samplesPerTrace).arg(m_noOfClasses);
+    cout.flush();
+    
+    CoutProgress::get().start(noOfTraces);
+    
+    for(size_t chunkFirst = 0; chunkFirst < noOfTraces; chunkFirst += POI_CHUNK_TRACES){
+        
+        const size_t chunkTraces = (noOfTraces - chunkFirst < POI_CHUNK_TRACES) ? noOfTraces - chunkFirst : POI_CHUNK_TRACES;
+        
+        (*this).accumulateTraces(&(traces(0, chunkFirst)), chunkTraces, chunkFirst);
+        
+        CoutProgress::get().update(chunkFirst + chunkTraces);
+        
+    }
+    
+    CoutProgress::get().finish();
+    
+    std::vector<double> metric = (*this).computeMetric();
+    (*this).freeStatistics();
+    
+    std::vector<size_t> selected = (*this).pickSamples(metric);
+    
+    if(selected.empty()) throw RuntimeException("No sample has been selected, lower the threshold");
+    
+    QString metricFilename = (*this).saveMetric(metric, id);
+    
+    // Save the reduced power traces
+    const size_t noOfSelected = selected.size();
+    QString tracesFilename = (*this).saveReducedTraces(traces, selected, id);
+    
+    // Flush config to json file, along with the original positions of the samples
+    QJsonObject tracesConf = tracesConfig<T>(tracesFilename, noOfTraces, noOfSelected);
+    (*this).addSampleIndices(tracesConf, selected);
+    saveTracesConfig(tracesConf, id);
+    
+    const size_t best = *std::max_element(selected.begin(), selected.end(), [&metric](size_t a, size_t b){ return metric[a] < metric[b]; });
+    
+    cout << QString("Selected %1 of %2 samples, the highest %3 is %4 at sample %5.\n").arg(noOfSelected).arg(samplesPerTrace).arg(m_nicv ? "NICV" : "SNR").arg(metric[best]).arg(best);
+    cout << QString("Saved %1 reduced power traces to '%2', %3 to '%4'.\n").arg(noOfTraces).arg(tracesFilename).arg(m_nicv ? "NICV" : "SNR").arg(metricFilename);
+    
+}
@@ -0,0 +1,170 @@
+/*
+*  SICAK - SIde-Channel Analysis toolKit
+*  Copyright (C) 2018-2019 Petr Socha, FIT, CTU in Prague
+*
+*  This program is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation, either version 3 of the License, or
+*  (at your option) any later version.
+*
+*  This program is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/**
+* \file poi.h
+*
+* \brief SICAK traces processing plugin: points of interest selection by SNR or NICV
+*
+*
+* \author Petr Socha
+* \version 1.0
+*/
+
+#ifndef POI_H
+#define POI_H 
+
+#include <QObject>
+#include <QtPlugin>
+#include <QString>
+#include <QJsonObject>
+#include <vector>
+#include "tracesprocess.h"
+#include "exceptions.hpp"
+
+/**
+* \class Poi
+* \ingroup TracesProcess
+*
+* \brief Points of interest SICAK TracesProcess plugin. Computes SNR or NICV of every sample with respect to an AES-128 first round intermediate
+* (the S-box output or input, classified by its Hamming weight or value), selects the leaking samples and saves the power traces reduced to these samples.
+* The original positions of the selected samples are saved in the json file.
+*
+* The selection needs the statistics of all the power traces before the first power trace can be reduced. When processing chunks of power traces (e.g. in a pipeline),
+* the statistics are accumulated in a single pass while the power traces pass thru unchanged; once the stream finishes, the metric and the original positions
+* of the selected samples are saved, the latter into 'poi-ID.json', ID being set by the "id" param.
+*
+* With the "select" param set to such a json file, no statistics are computed: the power traces are reduced to the samples listed there, chunk by chunk,
+* so that a second pass (e.g. a pipeline) applies the selection to power traces that do not fit into the memory.
+*
+*/
+class Poi : public QObject, TracesProcess {
+    
+    Q_OBJECT
+    Q_PLUGIN_METADATA(IID "cz.cvut.fit.Sicak.TracesProcessInterface/1.2" FILE "poi.json")
+    Q_INTERFACES(TracesProcess)
+                
+public:
+    
+    Poi();
+    virtual ~Poi() override;
+    
+    virtual QString getPluginName() override;
+    virtual QString getPluginInfo() override;
+    
+    /// Initializes the plugin, param holds the parameters separated by semicolons, e.g. "data=plaintext.bin;byte=0;key=2b;top=2000"
+    virtual void init(const char * param) override;
+    virtual void deInit() override;
+    
+    /// Selects the points of interest and saves the reduced power traces into a new file
+    virtual void processTraces(PowerTraces<int16_t> & traces, const char * id) override;    
+    /// Selects the points of interest and saves the reduced 8-bit power traces into a new file
+    virtual void processTraces(PowerTraces<int8_t> & traces, const char * id) override;    
+    
+    /// Classifies the power traces and prepares the statistics, or loads the selected samples, returns the number of samples of the output power traces
+    virtual size_t startStream(size_t samplesPerTrace, size_t noOfTraces) override;
+    virtual bool isStateless() override;
+    /// Accumulates the statistics of the chunk, the power traces pass thru unchanged, or reduces the chunk to the selected samples
+    virtual void processChunk(PowerTraces<int16_t> & in, PowerTraces<int16_t> & out, size_t firstTrace) override;
+    /// Accumulates the statistics of the 8-bit chunk, the power traces pass thru unchanged, or reduces the chunk to the selected samples
+    virtual void processChunk(PowerTraces<int8_t> & in, PowerTraces<int8_t> & out, size_t firstTrace) override;
+    /// Selects the points of interest, saves the metric and the indices of the selected samples, nothing to do when applying a selection
+    virtual void finishStream() override;
+    
+protected:
+    
+    /// Selects the points of interest, T is either int16_t or int8_t
+    template <class T>
+    void selectPoints(PowerTraces<T> & traces, const char * id);
+    
+    /// Classifies 'noOfTraces' power traces and zeroes the sums
+    void startStatistics(size_t samplesPerTrace, size_t noOfTraces);
+    /// Frees the classes and the sums
+    void freeStatistics();
+    /// Adds 'noOfTraces' power traces, starting with the firstTrace-th one, to the sums of the samples per class and to the sums of squares
+    template <class T>
+    void accumulateTraces(const T * traces, size_t noOfTraces, size_t firstTrace);
+    /// Accumulates the chunk and copies it to 'out'
+    template <class T>
+    void accumulateChunk(PowerTraces<T> & in, PowerTraces<T> & out, size_t firstTrace);
+    /// Returns SNR or NICV of every sample, from the sums
+    std::vector<double> computeMetric();
+    /// Saves the metric, a double per sample, returns the filename
+    QString saveMetric(const std::vector<double> & metric, const char * id);
+    /// Adds the original positions of the selected samples to the json config
+    void addSampleIndices(QJsonObject & conf, const std::vector<size_t> & selected);
+    
+    /// Loads the data blocks and classifies the power traces by the intermediate value
+    void classifyTraces(size_t noOfTraces, std::vector<uint8_t> & classes, size_t & noOfClasses);
+    
+    /// Returns the indices of the selected samples, in ascending order
+    std::vector<size_t> pickSamples(const std::vector<double> & metric);
+    /// Loads the indices of the selected samples from the "select" json file, checks them against the number of samples per trace
+    std::vector<size_t> loadSampleIndices(size_t samplesPerTrace);
+    
+    /// Reduces 'noOfTraces' power traces to the selected samples
+    template <class T>
+    void reduceTraces(const T * traces, T * reduced, size_t noOfTraces, size_t samplesPerTrace, const std::vector<size_t> & selected);
+    /// Saves the power traces reduced to the selected samples, returns the filename
+    template <class T>
+    QString saveReducedTraces(PowerTraces<T> & traces, const std::vector<size_t> & selected, const char * id);
+    /// Reduces the power traces to the samples of the "select" json file and saves them
+    template <class T>
+    void applySelection(PowerTraces<T> & traces, const char * id);
+    
+    /// File with the data blocks, one block per power trace
+    QString m_data;
+    /// Length of a data block, in bytes
+    size_t m_blockLength;
+    /// Byte of the data block the intermediate is computed from
+    size_t m_byte;
+    /// Key byte
+    uint8_t m_key;
+    /// Intermediate is the S-box output, otherwise the S-box input
+    bool m_sbox;
+    /// Classify by the Hamming weight of the intermediate, otherwise by its value
+    bool m_hw;
+    /// Compute NICV, otherwise SNR
+    bool m_nicv;
+    /// Maximum number of the selected points, zero for no limit
+    size_t m_top;
+    /// Minimum value of the metric of a selected point
+    double m_threshold;
+    bool m_thresholdSet;
+    /// Neighbouring samples selected on both sides of a point
+    size_t m_window;
+    /// ID in the names of the files saved when the stream finishes
+    QString m_id;
+    /// Json file with the indices of the samples to select, empty when selecting by the metric
+    QString m_select;
+    /// Indices of the samples to select, when applying the selection to a stream
+    std::vector<size_t> m_selected;
+    
+    /// Class of every power trace
+    std::vector<uint8_t> m_classes;
+    size_t m_noOfClasses;
+    std::vector<uint64_t> m_classCounts;
+    /// Sums of the samples per class, class by class, and sums of squares of the samples
+    std::vector<int64_t> m_classSums;
+    std::vector<int64_t> m_sumsSq;
+    size_t m_samplesPerTrace;
+    size_t m_noOfTraces;
+    
+};
+
+#endif /* POI_H */
@@ -0,0 +1,342 @@
+/*
+*  SICAK - SIde-Channel Analysis toolKit
+*  Copyright (C) 2018-2019 Petr Socha, FIT, CTU in Prague
+*
+*  This program is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation, either version 3 of the License, or
+*  (at your option) any later version.
+*
+*  This program is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/**
+* \file spectrum.cpp
+*
+* \brief SICAK traces processing plugin: magnitude or power spectra of power traces
+*
+*
+* \author Petr Socha
+* \version 1.0
+*/
+
+#include "spectrum.h"
+#include "filehandling.hpp"
+#include "global_calls.hpp"
+#include "tracesoutput.hpp"
+#include <QString>
+#include <QStringList>
+#include <QTextStream>
+#include <QJsonObject>
+#include <cmath>
+#include <vector>
+#include <omp.h>
+
+/// Number of power traces transformed at once, then written to the file
+#define SPECTRUM_CHUNK_TRACES 16384
+
+Spectrum::Spectrum(): m_power(false), m_length(0), m_step(0), m_hann(true), m_bins(0), m_scale(1.0f), m_frameLength(0), m_frameStep(0), m_frames(0), m_binsKept(0) {
+    
+}
+
+Spectrum::~Spectrum() {
+    
+    (*this).deInit();
+               
+}
+
+QString Spectrum::getPluginName() {
+    return "Magnitude or power spectra of power traces, optionally of sliding frames (STFT)";
+}
+
+QString Spectrum::getPluginInfo() {
+    return "Replaces every power trace by its spectrum, or by the spectra of its frames. Set the parameters using params, e.g. \"output=magnitude;length=256;step=128;bins=64\".";
+}
+
+void Spectrum::init(const char * param) {    
+    
+    QStringList params = QString(param).split(";");
+    QString paramVal;
+    
+    m_power = false;
+    m_length = 0;
+    m_step = 0;
+    m_hann = true;
+    m_bins = 0;
+    m_scale = 1.0f;
+    m_fft.reset();
+    
+    for (int i = 0; i < params.size(); ++i){ // iterate thru all parameters
+        
+        bool ok = true;
+        
+        if(params.at(i).startsWith("output=")){
+            
+            paramVal = params.at(i);
+            paramVal.remove(0,7);
+            
+            if(paramVal == "magnitude") m_power = false;
+            else if(paramVal == "power") m_power = true;
+            else throw InvalidInputException("Invalid output param, use either magnitude or power");
+            
+        } else if(params.at(i).startsWith("length=")){
+            
+            paramVal = params.at(i);
+            paramVal.remove(0,7);
+            m_length = paramVal.toULongLong(&ok);
+            ok = ok && m_length > 1;
+            
+        } else if(params.at(i).startsWith("step=")){
+            
+            paramVal = params.at(i);
+            paramVal.remove(0,5);
+            m_step = paramVal.toULongLong(&ok);
+            ok = ok && m_step > 0;
+            
+        } else if(params.at(i).startsWith("taper=")){
+            
+            paramVal = params.at(i);
+            paramVal.remove(0,6);
+            
+            if(paramVal == "hann") m_hann = true;
+            else if(paramVal == "rect") m_hann = false;
+            else throw InvalidInputException("Invalid taper param, use either hann or rect");
+            
+        } else if(params.at(i).startsWith("bins=")){
+            
+            paramVal = params.at(i);
+            paramVal.remove(0,5);
+            m_bins = paramVal.toULongLong(&ok);
+            ok = ok && m_bins > 0;
+            
+        } else if(params.at(i).startsWith("scale=")){
+            
+            paramVal = params.at(i);
+            paramVal.remove(0,6);
+            m_scale = paramVal.toFloat(&ok);
+            
+        } else if(params.at(i).size()) {
+            
+            throw InvalidInputException("Unknown spectrum param");
+            
+        }
+        
+        if(!ok) throw InvalidInputException("Invalid spectrum param");
+        
+    }
+    
+}
+
+void Spectrum::deInit() {
+        
+}
+
+void Spectrum::processTraces(PowerTraces<int16_t> & traces, const char * id) {
+    
+    (*this).transformTraces(traces, id);
+    
+}
+
+void Spectrum::processTraces(PowerTraces<int8_t> & traces, const char * id) {
+    
+    (*this).transformTraces(traces, id);
+    
+}
+
+size_t Spectrum::prepare(size_t samplesPerTrace) {
+    
+    m_frameLength = m_length ? m_length : samplesPerTrace;
+    m_frameStep = m_step ? m_step : m_frameLength;
+    
+    if(m_frameLength < 2 || m_frameLength > samplesPerTrace) throw InvalidInputException("The frame length needs to be at least 2 and at most the number of samples per trace");
+    
+    m_frames = (samplesPerTrace - m_frameLength) / m_frameStep + 1;
+    
+    // The FFT plan (twiddles, bit reversal) is kept as long as the size does not change
+    const size_t fftSize = Fft::sizeFor(m_frameLength);
+    if(!m_fft || m_fft->size() != fftSize) m_fft.reset(new RealFft(fftSize));
+    
+    m_binsKept = m_bins ? m_bins : m_fft->bins();
+    if(m_binsKept > m_fft->bins()) throw InvalidInputException("Too many bins, a frame has only (FFT size / 2 + 1) bins");
+    
+    // Taper normalized by its energy: white noise of a deviation s has the magnitudes around s, whatever the frame length
+    const double pi = 3.14159265358979323846;
+    double energy = 0;
+    
+    m_taper.resize(m_frameLength);
+    
+    for(size_t j = 0; j < m_frameLength; j++){
+        m_taper[j] = m_hann ? (float) (0.5 - 0.5 * std::cos(2 * pi * j / (m_frameLength - 1))) : 1.0f;
+        energy += (double) m_taper[j] * m_taper[j];
+    }
+    
+    for(size_t j = 0; j < m_frameLength; j++) m_taper[j] = (float) (m_taper[j] / std::sqrt(energy));
+    
+    return m_frames * m_binsKept;
+    
+}
+
+template <class T, class U>
+void Spectrum::transformPair(const T * in, size_t inSamples, U * out, size_t unit, bool pair, Workspace & ws) const {
+    
+    const size_t frameLength = m_frameLength;
+    const size_t bins = m_binsKept;
+    const size_t outSamples = m_frames * bins;
+    const float * taper = m_taper.data();
+    const float scale = m_scale;
+    
+    const size_t count = pair ? 2 : 1;
+    std::vector<float> * frames[2] = { &ws.first, &ws.second };
+    std::vector<std::complex<float>> * spectra[2] = { &ws.firstSpectrum, &ws.secondSpectrum };
+    
+    for(size_t k = 0; k < count; k++){
+        
+        const size_t trace = (unit + k) / m_frames;
+        const size_t frame = (unit + k) % m_frames;
+        const T * samples = in + trace * inSamples + frame * m_frameStep;
+        
+        frames[k]->resize(frameLength);
+        spectra[k]->resize(bins);
+        
+        float * tapered = frames[k]->data();
+        for(size_t j = 0; j < frameLength; j++) tapered[j] = samples[j] * taper[j];
+        
+    }
+    
+    m_fft->forward(ws.first.data(), pair ? ws.second.data() : nullptr, frameLength, ws.firstSpectrum.data(), ws.secondSpectrum.data(), bins, ws.work);
+    
+    for(size_t k = 0; k < count; k++){
+        
+        const size_t trace = (unit + k) / m_frames;
+        const size_t frame = (unit + k) % m_frames;
+        const float * spectrum = reinterpret_cast<const float *>(spectra[k]->data());
+        U * outBins = out + trace * outSamples + frame * bins;
+        
+        if(m_power){
+            for(size_t b = 0; b < bins; b++) outBins[b] = saturate<U>((spectrum[2 * b] * spectrum[2 * b] + spectrum[2 * b + 1] * spectrum[2 * b + 1]) * scale);
+        } else {
+            for(size_t b = 0; b < bins; b++) outBins[b] = saturate<U>(std::sqrt(spectrum[2 * b] * spectrum[2 * b] + spectrum[2 * b + 1] * spectrum[2 * b + 1]) * scale);
+        }
+        
+    }
+    
+}
+
+template <class T>
+void Spectrum::transformTraces(PowerTraces<T> & traces, const char * id) {
+    
+    const size_t samplesPerTrace = traces.samplesPerTrace();
+    const size_t noOfTraces = traces.noOfTraces();
+    const size_t outSamples = (*this).prepare(samplesPerTrace);
+    
+    QString tracesFilename = "spectrum-traces-";
+    tracesFilename.append(id);
+    tracesFilename.append(".bin");
+    QByteArray ba = tracesFilename.toLocal8Bit();
+    std::fstream outFile = openOutFile(ba.data());
+    
+    QTextStream cout(stdout);
+    cout << QString("Computing %1 spectra of %2 frames of %3 samples per power trace, %4-point FFT, keeping %5 bins\n").arg(m_power ? "power" : "magnitude").arg(m_frames).arg(m_frameLength).arg(m_fft->size()).arg(m_binsKept);
+    cout.flush();
+    
+    const size_t chunkSize = (noOfTraces < SPECTRUM_CHUNK_TRACES) ? noOfTraces : SPECTRUM_CHUNK_TRACES;
+    std::vector<int16_t> spectra(chunkSize * outSamples);
+    
+    CoutProgress::get().start(noOfTraces);
+    
+    for(size_t chunkFirst = 0; chunkFirst < noOfTraces; chunkFirst += chunkSize){
+        
+        const size_t chunkTraces = (noOfTraces - chunkFirst < chunkSize) ? noOfTraces - chunkFirst : chunkSize;
+        const size_t units = chunkTraces * m_frames;
+        const long long pairs = (units + 1) / 2; //< a single FFT transforms two frames at once
+        const T * chunk = &(traces(0, chunkFirst));
+        
+        #pragma omp parallel
+        {
+            
+            Workspace ws;
+            
+            #pragma omp for schedule(static)
+            for(long long pair = 0; pair < pairs; pair++){
+                (*this).transformPair(chunk, samplesPerTrace, spectra.data(), 2 * pair, 2 * pair + 1 < (long long) units, ws);
+            }
+            
+        }
+        
+        writeArrayToFile(outFile, spectra.data(), chunkTraces * outSamples);
+        
+        CoutProgress::get().update(chunkFirst + chunkTraces);
+        
+    }
+    
+    CoutProgress::get().finish();
+    
+    closeFile(outFile);
+    
+    // Flush config to json file, along with the frames and bins layout
+    QJsonObject tracesConf = tracesConfig<int16_t>(tracesFilename, noOfTraces, outSamples);
+    tracesConf["original-samples-per-trace"] = QString::number(samplesPerTrace);
+    tracesConf["frames"] = QString::number(m_frames);
+    tracesConf["frame-length"] = QString::number(m_frameLength);
+    tracesConf["frame-step"] = QString::number(m_frameStep);
+    tracesConf["fft-size"] = QString::number(m_fft->size());
+    tracesConf["bins"] = QString::number(m_binsKept);
+    saveTracesConfig(tracesConf, id);
+    
+    cout << QString("Transformed %1 power traces of %2 samples into %3 samples per trace,\nand saved to '%4'.\n").arg(noOfTraces).arg(samplesPerTrace).arg(outSamples).arg(tracesFilename);
+    
+}
+
+size_t Spectrum::startStream(size_t samplesPerTrace, size_t noOfTraces) {
+    
+    (void) noOfTraces;
+    
+    return (*this).prepare(samplesPerTrace);
+    
+}
+
+bool Spectrum::isStateless() {
+    
+    return true;
+    
+}
+
+void Spectrum::processChunk(PowerTraces<int16_t> & in, PowerTraces<int16_t> & out, size_t firstTrace) {
+    
+    (void) firstTrace;
+    (*this).transformChunk(in, out);
+    
+}
+
+void Spectrum::processChunk(PowerTraces<int8_t> & in, PowerTraces<int8_t> & out, size_t firstTrace) {
+    
+    (void) in;
+    (void) out;
+    (void) firstTrace;
+    
+    // The output of a pipeline keeps the 8-bit sample type, which is too narrow for the spectra
+    throw InvalidInputException("8-bit spectra would saturate in a pipeline, transform the 8-bit power traces alone to get int16 samples");
+    
+}
+
+template <class T>
+void Spectrum::transformChunk(PowerTraces<T> & in, PowerTraces<T> & out) {
+    
+    Workspace ws;
+    const size_t units = in.noOfTraces() * m_frames;
+    
+    for(size_t unit = 0; unit < units; unit += 2){
+        (*this).transformPair(in.data(), in.samplesPerTrace(), out.data(), unit, unit + 1 < units, ws);
+    }
+    
+}
+
+void Spectrum::finishStream() {
+    
+}
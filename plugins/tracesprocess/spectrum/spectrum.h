@@ -0,0 +1,132 @@
+/*
+*  SICAK - SIde-Channel Analysis toolKit
+*  Copyright (C) 2018-2019 Petr Socha, FIT, CTU in Prague
+*
+*  This program is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation, either version 3 of the License, or
+*  (at your option) any later version.
+*
+*  This program is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/**
+* \file spectrum.h
+*
+* \brief SICAK traces processing plugin: magnitude or power spectra of power traces
+*
+*
+* \author Petr Socha
+* \version 1.0
+*/
+
+#ifndef SPECTRUM_H
+#define SPECTRUM_H 
+
+#include <QObject>
+#include <QtPlugin>
+#include <complex>
+#include <memory>
+#include <vector>
+#include "tracesprocess.h"
+#include "exceptions.hpp"
+#include "fft.hpp"
+
+/**
+* \class Spectrum
+* \ingroup TracesProcess
+*
+* \brief Spectrum SICAK TracesProcess plugin. Replaces every power trace by its magnitude or power spectrum, or by the spectra of its frames (short-time Fourier transform).
+* A time shift of a power trace only changes the phases of its spectrum, so that misaligned power traces can be attacked by CPA in the frequency domain.
+*
+* Frames are tapered, zero padded to a power of two and transformed two at once by a single complex FFT. The output samples are the bins of the frames, frame after frame.
+*
+* Output samples are int16, saturated. When processing chunks of power traces, e.g. in a pipeline, the sample type is kept instead, so that 8-bit chunks are rejected.
+*
+*/
+class Spectrum : public QObject, TracesProcess {
+    
+    Q_OBJECT
+    Q_PLUGIN_METADATA(IID "cz.cvut.fit.Sicak.TracesProcessInterface/1.2" FILE "spectrum.json")
+    Q_INTERFACES(TracesProcess)
+                
+public:
+    
+    Spectrum();
+    virtual ~Spectrum() override;
+    
+    virtual QString getPluginName() override;
+    virtual QString getPluginInfo() override;
+    
+    /// Initializes the plugin, param holds the parameters separated by semicolons, e.g. "output=magnitude;length=256;step=128"
+    virtual void init(const char * param) override;
+    virtual void deInit() override;
+    
+    /// Transforms the power traces and saves the spectra into a new file
+    virtual void processTraces(PowerTraces<int16_t> & traces, const char * id) override;    
+    /// Transforms the 8-bit power traces and saves the spectra into a new file
+    virtual void processTraces(PowerTraces<int8_t> & traces, const char * id) override;    
+    
+    virtual size_t startStream(size_t samplesPerTrace, size_t noOfTraces) override;
+    virtual bool isStateless() override;
+    virtual void processChunk(PowerTraces<int16_t> & in, PowerTraces<int16_t> & out, size_t firstTrace) override;
+    /// Rejects a chunk of 8-bit power traces, the spectra would be saturated to 8 bits
+    virtual void processChunk(PowerTraces<int8_t> & in, PowerTraces<int8_t> & out, size_t firstTrace) override;
+    virtual void finishStream() override;
+    
+protected:
+    
+    /// Scratch buffers of a thread, reused for all its frames
+    struct Workspace {
+        std::vector<float> first;
+        std::vector<float> second;
+        std::vector<std::complex<float>> firstSpectrum;
+        std::vector<std::complex<float>> secondSpectrum;
+        std::vector<std::complex<float>> work;
+    };
+    
+    /// Transforms the power traces, T is either int16_t or int8_t
+    template <class T>
+    void transformTraces(PowerTraces<T> & traces, const char * id);
+    
+    /// Transforms a chunk of power traces, T is either int16_t or int8_t
+    template <class T>
+    void transformChunk(PowerTraces<T> & in, PowerTraces<T> & out);
+    
+    /// Computes the frames, the FFT and the taper for the power traces, returns the number of output samples per trace
+    size_t prepare(size_t samplesPerTrace);
+    
+    /// Transforms the frames (power trace, frame) number 'unit' and 'unit + 1', the latter when 'pair' is true. 'in' holds 'inSamples' samples per trace, 'out' the output samples
+    template <class T, class U>
+    void transformPair(const T * in, size_t inSamples, U * out, size_t unit, bool pair, Workspace & ws) const;
+    
+    /// Power spectrum instead of the magnitude spectrum
+    bool m_power;
+    /// Length of a frame and the distance of the frames, zero for the whole power trace
+    size_t m_length;
+    size_t m_step;
+    /// Hann taper instead of the rectangular one
+    bool m_hann;
+    /// Number of the lowest bins kept, zero for all of them
+    size_t m_bins;
+    /// Output samples are multiplied by the scale
+    float m_scale;
+    
+    /// Frames and bins of the prepared power traces
+    size_t m_frameLength;
+    size_t m_frameStep;
+    size_t m_frames;
+    size_t m_binsKept;
+    /// Taper, normalized so that the spectrum of white noise has the level of the noise
+    std::vector<float> m_taper;
+    std::unique_ptr<RealFft> m_fft;
+    
+};
+
+#endif /* SPECTRUM_H */
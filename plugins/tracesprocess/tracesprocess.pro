@@ -1,2 +1,2 @@
 TEMPLATE    = subdirs
-SUBDIRS     += 
+SUBDIRS     += align poi decimate dtw spectrum pca
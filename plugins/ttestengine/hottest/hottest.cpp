@@ -99,6 +99,17 @@ Moments2DContext<double> HOTTest::createContext(const PowerTraces<int16_t> & ran
     
 }
 
+Moments2DContext<double> HOTTest::createContext(const PowerTraces<int8_t> & randTraces, const PowerTraces<int8_t> & constTraces) {
+    
+    // Create an empty context    
+    Moments2DContext<double> context(randTraces.samplesPerTrace(), constTraces.samplesPerTrace(), 1, 1, 2 * m_order, 2 * m_order, 0);    
+    context.reset();
+    // Compute context (covariance, variances and means)
+    UniHoTTestAddTraces(context, randTraces, constTraces, m_order);
+    return context;
+    
+}
+
 void HOTTest::mergeContexts(Moments2DContext<double> & firstAndOut, const Moments2DContext<double> & second) {
     
     UniHoTTestMergeContexts(firstAndOut, second);
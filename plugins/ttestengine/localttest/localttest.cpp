@@ -73,6 +73,17 @@ Moments2DContext<double> LocalTTest::createContext(const PowerTraces<int16_t> &
     
 }
 
+Moments2DContext<double> LocalTTest::createContext(const PowerTraces<int8_t> & randTraces, const PowerTraces<int8_t> & constTraces) {
+    
+    // Create an empty context    
+    Moments2DContext<double> context(randTraces.samplesPerTrace(), constTraces.samplesPerTrace(), 1, 1, 2, 2, 0);
+    context.reset();
+    // Compute context (covariance, variances and means)
+    UniFoTTestAddTraces(context, randTraces, constTraces);
+    return context;
+    
+}
+
 void LocalTTest::mergeContexts(Moments2DContext<double> & firstAndOut, const Moments2DContext<double> & second) {
     
     UniFoTTestMergeContexts(firstAndOut, second);
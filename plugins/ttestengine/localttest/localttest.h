@@ -45,7 +45,7 @@
 class LocalTTest : public QObject, TTestEngine {
     
     Q_OBJECT
-    Q_PLUGIN_METADATA(IID "cz.cvut.fit.Sicak.TTestInterface/1.1" FILE "localttest.json")
+    Q_PLUGIN_METADATA(IID "cz.cvut.fit.Sicak.TTestInterface/1.2" FILE "localttest.json")
     Q_INTERFACES(TTestEngine)
         
 public:
@@ -62,6 +62,7 @@ public:
     virtual QString queryDevices() override;
         
     virtual Moments2DContext<double> createContext(const PowerTraces<int16_t> & randTraces, const PowerTraces<int16_t> & constTraces) override;    
+    virtual Moments2DContext<double> createContext(const PowerTraces<int8_t> & randTraces, const PowerTraces<int8_t> & constTraces) override;    
     virtual void mergeContexts(Moments2DContext<double> & firstAndOut, const Moments2DContext<double> & second) override;
     virtual Matrix<double> finalizeContext(const Moments2DContext<double> & context) override;
             
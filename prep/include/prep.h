@@ -31,6 +31,7 @@
 
 #include <QObject>
 #include <QCommandLineParser>
+#include <vector>
 #include "blockprocess.h"
 #include "tracesprocess.h"
 
@@ -56,17 +57,23 @@ public:
         CommandLineQueryRequested
     };
     
-    Prep(QObject *parent = 0) : QObject(parent), m_tracesEngine(nullptr), m_blockEngine(nullptr), m_param(""), m_id(""), m_tracesModule(""), m_blockModule(""), m_traces(""), m_tracesN(0), m_samples(0), m_blocks(""), m_blocksM(0), m_blocksLen(0) {}
+    Prep(QObject *parent = 0) : QObject(parent), m_tracesEngine(nullptr), m_blockEngine(nullptr), m_param(""), m_id(""), m_tracesModule(""), m_blockModule(""), m_traces(""), m_tracesN(0), m_samples(0), m_sampleType("int16"), m_chunkTraces(0), m_threads(0), m_blocks(""), m_blocksM(0), m_blocksLen(0) {}
     
     /// Parse parameters from the command line and configuration files and plan tasks for event loop accordingly
     CommandLineParseResult parseCommandLineParams(QCommandLineParser & parser);    
 
 protected:
     
-    /// Load the specified traces preprocessing module
-    bool loadTracesModule();
+    /// Load the given traces preprocessing module, returns nullptr on failure
+    TracesProcess * loadTracesModule(const QString & module);
     /// Load the specified block data preprocessing module
     bool loadBlocksModule();
+    /// Load and preprocess power traces with samples of type T, using the already initialized traces preprocessing module
+    template <class T>
+    void preprocessTracesTyped();
+    /// Run the already initialized traces preprocessing modules as a streaming pipeline over power traces with samples of type T
+    template <class T>
+    void pipelineTracesTyped(std::vector<TracesProcess *> & engines);
     
     TracesProcess * m_tracesEngine;
     BlockProcess * m_blockEngine;
@@ -80,6 +87,11 @@ protected:
     QString m_traces;
     size_t m_tracesN;
     size_t m_samples;
+    QString m_sampleType;
+    /// Number of power traces in a chunk of the pipeline, 0 for default
+    size_t m_chunkTraces;
+    /// Number of pipeline workers, 0 for the number of hardware threads
+    size_t m_threads;
     
     QString m_blocks;
     size_t m_blocksM;
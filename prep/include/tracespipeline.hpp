@@ -0,0 +1,354 @@
+/*
+*  SICAK - SIde-Channel Analysis toolKit
+*  Copyright (C) 2018-2019 Petr Socha, FIT, CTU in Prague
+*
+*  This program is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation, either version 3 of the License, or
+*  (at your option) any later version.
+*
+*  This program is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/**
+* \file tracespipeline.hpp
+*
+* \brief Streaming pipeline of traces processing plug-in modules, used by the SICAK PREProcessing
+*
+*
+* \author Petr Socha
+* \version 1.0
+*/
+
+#ifndef TRACESPIPELINE_H
+#define TRACESPIPELINE_H
+
+#include <fstream>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "tracesprocess.h"
+#include "boundedqueue.hpp"
+#include "compressedtraces.hpp"
+#include "filehandling.hpp"
+#include "global_calls.hpp"
+#include "instrumentation.hpp"
+#include "exceptions.hpp"
+
+/// Default number of power traces in a chunk
+#define TRACESPIPELINE_CHUNK_TRACES 1024
+
+/**
+* \class TracesPipeline
+* \ingroup Sicak
+*
+* \brief Runs a chain of traces processing plug-in modules (stages) over a power traces file in a single pass, chunk by chunk, in constant memory.
+*
+* A reader thread reads the chunks of power traces, worker threads run all the stages over a chunk one after another (the stages are fused), and the calling thread
+* writes the processed chunks in order. The threads are connected by bounded queues, and the chunks are recycled once written.
+*
+* When all the stages are stateless (TracesProcess::isStateless), multiple chunks are processed concurrently by multiple workers, otherwise a single worker
+* processes the chunks in order. The first chunk is always processed by all the stages before any other chunk, so that the stages may set up from it (e.g. take a reference power trace).
+*
+* Reading, processing and writing the power traces run concurrently, so they are recorded as concurrent phases, see ConcurrentPhase.
+*
+*/
+template <class T>
+class TracesPipeline {
+
+public:
+
+    /// Constructor, prepares the stages for streaming (TracesProcess::startStream). Zero threads means the number of hardware threads
+    TracesPipeline(const std::vector<TracesProcess *> & stages, size_t samplesPerTrace, size_t noOfTraces, size_t chunkTraces = TRACESPIPELINE_CHUNK_TRACES, size_t threads = 0);
+
+    /// Returns the number of samples per trace of the processed power traces
+    size_t getOutputSamplesPerTrace() const { return m_samples.back(); }
+    /// Returns the number of workers processing the chunks
+    size_t getWorkers() const { return m_workers; }
+
+    /// Reads the power traces from 'in' (raw or compressed), processes them by the stages and writes them to 'out' (raw). Throws on error
+    void run(std::fstream & in, std::fstream & out);
+
+protected:
+
+    /// A chunk of power traces, processed from 'traces' into 'spare' by a stage, then swapped
+    struct Chunk {
+        size_t index;
+        size_t firstTrace;
+        PowerTraces<T> traces;
+        PowerTraces<T> spare;
+    };
+
+    /// Reader thread: reads the chunks of power traces
+    void read(std::fstream & in);
+    /// Worker thread: processes the chunks by all the stages
+    void work();
+    /// Records the first error and stops all the threads
+    void fail(const char * what);
+    /// Lets the workers waiting for the first chunk go
+    void releaseFirst();
+
+    std::vector<TracesProcess *> m_stages;
+    /// Number of samples per trace entering each of the stages, and leaving the last one
+    std::vector<size_t> m_samples;
+    size_t m_noOfTraces;
+    size_t m_chunkTraces;
+    size_t m_noOfChunks;
+    size_t m_workers;
+
+    /// Chunks in flight, at most the number of recycled chunks
+    std::vector<std::unique_ptr<Chunk>> m_chunks;
+    /// Chunks ready to be read into, read chunks and processed chunks. Each queue can hold all the chunks, so that a push never blocks
+    std::unique_ptr<BoundedQueue<Chunk *>> m_free;
+    std::unique_ptr<BoundedQueue<Chunk *>> m_read;
+    std::unique_ptr<BoundedQueue<Chunk *>> m_processed;
+
+    std::promise<void> m_firstPromise;
+    std::shared_future<void> m_firstDone;
+
+    /// Reading, processing and writing, recorded once per run
+    ConcurrentPhase m_readPhase;
+    ConcurrentPhase m_processPhase;
+    ConcurrentPhase m_writePhase;
+
+    std::mutex m_mutex;
+    bool m_firstReleased;
+    size_t m_runningWorkers;
+    std::string m_error;
+
+};
+
+template <class T>
+TracesPipeline<T>::TracesPipeline(const std::vector<TracesProcess *> & stages, size_t samplesPerTrace, size_t noOfTraces, size_t chunkTraces, size_t threads)
+    : m_stages(stages), m_noOfTraces(noOfTraces), m_chunkTraces(chunkTraces), m_noOfChunks(0), m_workers(1), m_readPhase("read-traces"), m_processPhase("process-traces"), m_writePhase("write-traces"), m_firstReleased(false), m_runningWorkers(0), m_error("") {
+
+    if(m_stages.empty()) throw InvalidInputException("Pipeline needs at least one traces processing module");
+    if(!samplesPerTrace || !m_noOfTraces || !m_chunkTraces) throw InvalidInputException("Invalid pipeline parameters");
+
+    m_noOfChunks = (m_noOfTraces + m_chunkTraces - 1) / m_chunkTraces;
+
+    // Prepare the stages, each one gets the power traces as processed by the previous one
+    bool stateless = true;
+    m_samples.push_back(samplesPerTrace);
+
+    for(size_t i = 0; i < m_stages.size(); i++){
+        size_t samples = m_stages[i]->startStream(m_samples.back(), m_noOfTraces);
+        if(!samples) throw RuntimeException("Traces processing module produces no samples");
+        m_samples.push_back(samples);
+        stateless = stateless && m_stages[i]->isStateless();
+    }
+
+    if(stateless){
+        m_workers = threads ? threads : std::thread::hardware_concurrency();
+        if(!m_workers) m_workers = 1;
+    }
+
+    if(m_workers > m_noOfChunks) m_workers = m_noOfChunks;
+
+    // Every worker has a chunk being processed and one waiting, the reader and the writer have one each
+    const size_t noOfBuffers = 2 * m_workers + 2;
+
+    m_free.reset(new BoundedQueue<Chunk *>(noOfBuffers));
+    m_read.reset(new BoundedQueue<Chunk *>(noOfBuffers));
+    m_processed.reset(new BoundedQueue<Chunk *>(noOfBuffers));
+
+    for(size_t i = 0; i < noOfBuffers; i++){
+        m_chunks.emplace_back(new Chunk());
+        m_free->push(m_chunks.back().get());
+    }
+
+    m_firstDone = m_firstPromise.get_future().share();
+
+}
+
+template <class T>
+void TracesPipeline<T>::run(std::fstream & in, std::fstream & out) {
+
+    m_runningWorkers = m_workers;
+
+    const double start = PhaseStats::wallTime();
+
+    std::thread reader(&TracesPipeline<T>::read, this, std::ref(in));
+
+    std::vector<std::thread> workers;
+    for(size_t i = 0; i < m_workers; i++) workers.emplace_back(&TracesPipeline<T>::work, this);
+
+    // The calling thread writes the processed chunks in order, the chunks processed ahead wait in 'pending'
+    std::map<size_t, Chunk *> pending;
+    size_t written = 0;
+    Chunk * chunk;
+
+    CoutProgress::get().start(m_noOfTraces);
+
+    while(written < m_noOfChunks && m_processed->pop(chunk)){
+
+        pending[chunk->index] = chunk;
+
+        while(!pending.empty() && pending.begin()->first == written){
+
+            chunk = pending.begin()->second;
+            pending.erase(pending.begin());
+
+            try {
+
+                ConcurrentPhaseTimer timer(m_writePhase);
+                writeArrayToFile(out, chunk->traces.data(), chunk->traces.length());
+                timer.addBytes(chunk->traces.size());
+                timer.addTraces(chunk->traces.noOfTraces());
+
+            } catch (std::exception & e) {
+                fail(e.what());
+                break;
+            }
+
+            written++;
+            CoutProgress::get().update(chunk->firstTrace + chunk->traces.noOfTraces());
+
+            m_free->push(chunk);
+
+        }
+
+    }
+
+    CoutProgress::get().finish();
+
+    // Stops the reader and the workers in case of an error
+    if(written < m_noOfChunks) fail("Pipeline stopped before processing all the power traces");
+
+    reader.join();
+    for(size_t i = 0; i < workers.size(); i++) workers[i].join();
+
+    const double wall = PhaseStats::wallTime() - start;
+    m_readPhase.record(wall);
+    m_processPhase.record(wall);
+    m_writePhase.record(wall);
+
+    if(!m_error.empty()) throw RuntimeException(m_error.c_str());
+
+}
+
+template <class T>
+void TracesPipeline<T>::read(std::fstream & in) {
+
+    try {
+
+        std::unique_ptr<CompressedTracesReader<T>> compressed;
+
+        if(isCompressedTracesFile(in)){
+            compressed.reset(new CompressedTracesReader<T>(in));
+            if(compressed->samplesPerTrace() != m_samples.front()) throw RuntimeException("Could not read the power traces from the file. Number of samples per trace mismatch.");
+        }
+
+        for(size_t index = 0; index < m_noOfChunks; index++){
+
+            Chunk * chunk;
+            if(!m_free->pop(chunk)) break; //< closed on error
+
+            chunk->index = index;
+            chunk->firstTrace = index * m_chunkTraces;
+            const size_t chunkTraces = (m_noOfTraces - chunk->firstTrace < m_chunkTraces) ? m_noOfTraces - chunk->firstTrace : m_chunkTraces;
+            chunk->traces.init(m_samples.front(), chunkTraces);
+
+            {
+                ConcurrentPhaseTimer timer(m_readPhase);
+                if(compressed) compressed->readTraces(chunk->firstTrace, chunkTraces, chunk->traces.data());
+                else fillArrayFromFile(in, chunk->traces);
+                timer.addBytes(chunk->traces.size());
+                timer.addTraces(chunkTraces);
+            }
+
+            if(!m_read->push(chunk)) break;
+
+        }
+
+    } catch (std::exception & e) {
+        fail(e.what());
+    }
+
+    m_read->close();
+
+}
+
+template <class T>
+void TracesPipeline<T>::work() {
+
+    Chunk * chunk;
+
+    while(m_read->pop(chunk)){
+
+        try {
+
+            // The first chunk goes thru all the stages before the others
+            if(chunk->index) m_firstDone.wait();
+
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                if(!m_error.empty()) break;
+            }
+
+            ConcurrentPhaseTimer timer(m_processPhase);
+            timer.addBytes(chunk->traces.size());
+            timer.addTraces(chunk->traces.noOfTraces());
+
+            for(size_t i = 0; i < m_stages.size(); i++){
+                chunk->spare.init(m_samples[i + 1], chunk->traces.noOfTraces());
+                m_stages[i]->processChunk(chunk->traces, chunk->spare, chunk->firstTrace);
+                std::swap(chunk->traces, chunk->spare);
+            }
+
+            if(!chunk->index) releaseFirst();
+
+        } catch (std::exception & e) {
+            fail(e.what());
+            break;
+        }
+
+        if(!m_processed->push(chunk)) break;
+
+    }
+
+    // The last worker out closes the processed chunks queue
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if(!--m_runningWorkers) m_processed->close();
+
+}
+
+template <class T>
+void TracesPipeline<T>::releaseFirst() {
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if(!m_firstReleased){
+        m_firstReleased = true;
+        m_firstPromise.set_value();
+    }
+
+}
+
+template <class T>
+void TracesPipeline<T>::fail(const char * what) {
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if(m_error.empty()) m_error = what;
+    }
+
+    m_free->close();
+    m_read->close();
+    m_processed->close();
+
+    releaseFirst();
+
+}
+
+#endif /* TRACESPIPELINE_H */
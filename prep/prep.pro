@@ -2,11 +2,18 @@
   error( "Couldn't find the sicak.pri file!" )
 }
 
-INCLUDEPATH    += ./include
+INCLUDEPATH    += ./include \
+                  ../plugins/tracesprocess/common
 CONFIG += console
 QT -= gui
 
-HEADERS += include/prep.h
+# peak memory of the per-phase statistics (instrumentation.hpp)
+win32 {
+    LIBS += -lpsapi
+}
+
+HEADERS += include/prep.h \
+           include/tracespipeline.hpp
 SOURCES    = src/main.cpp \
              src/prep.cpp
 
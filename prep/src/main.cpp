@@ -31,6 +31,7 @@
 #include <QCommandLineParser>
 #include <QtCore>
 #include "prep.h"
+#include "instrumentation.hpp"
 
 int main(int argv, char *args[])
 {
@@ -49,10 +50,13 @@ int main(int argv, char *args[])
     QObject::connect(prep, SIGNAL(finished()), &app, SLOT(quit()));
      
     switch(prep->parseCommandLineParams(parser)) {
-        case Prep::CommandLineTaskPlanned:
+        case Prep::CommandLineTaskPlanned: {
             cout << qPrintable(QCoreApplication::applicationName()) << " " << qPrintable(QCoreApplication::applicationVersion()) << "\n";
             cout.flush();                      
-            return app.exec();                  
+            const int result = app.exec();
+            PhaseStats::get().saveAndReport();
+            return result;
+        }
         case Prep::CommandLineError:
             cerr << "Error parsing command line options.\n";
             return 1;
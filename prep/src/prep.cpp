@@ -36,11 +36,17 @@
 #include <QJsonDocument>
 #include <QDateTime>
 #include <QTimer>
+#include <QFile>
+#include <QStringList>
+#include <algorithm>
 
 #include "configloader.hpp"
 #include "global_calls.hpp"
+#include "instrumentation.hpp"
 #include "filehandling.hpp"
 #include "prep.h"
+#include "tracespipeline.hpp"
+#include "tracesoutput.hpp"
 
 
 Prep::CommandLineParseResult Prep::parseCommandLineParams(QCommandLineParser & parser) {
@@ -56,14 +62,14 @@ Prep::CommandLineParseResult Prep::parseCommandLineParams(QCommandLineParser & p
     const QCommandLineOption queryOption({"Q", "query"}, "Query available traces and block data preprocessing plug-in modules (-T, -B).");
     parser.addOption(queryOption);
     
-    const QCommandLineOption tracesModuleOption({"T", "traces-preprocess-module"}, "ID of traces preprocessing plug-in module to use. Select either -T or -B.", "string");
+    const QCommandLineOption tracesModuleOption({"T", "traces-preprocess-module"}, "ID of traces preprocessing plug-in module to use, or a comma separated list of IDs to run as a streaming pipeline. Select either -T or -B.", "string");
     parser.addOption(tracesModuleOption);    
     
     const QCommandLineOption blockModuleOption({"B", "block-preprocess-module"}, "ID of block data preprocessing plug-in module to use. Select either -T or -B.", "string");
     parser.addOption(blockModuleOption);    
     
     
-    const QCommandLineOption tracesOption({"t", "traces"}, "File containing -n traces, each of which containing -s samples (int16).", "filepath");
+    const QCommandLineOption tracesOption({"t", "traces"}, "File containing -n traces, each of which containing -s samples (int16 or int8, see --sample-type; raw or compressed container).", "filepath");
     parser.addOption(tracesOption);    
     
     const QCommandLineOption tracesNOption({"n", "traces-count"}, "Number of power traces in -t file.", "positive integer");
@@ -72,6 +78,15 @@ Prep::CommandLineParseResult Prep::parseCommandLineParams(QCommandLineParser & p
     const QCommandLineOption samplesOption({"s", "samples-per-trace"}, "Number of samples per trace.", "positive integer");
     parser.addOption(samplesOption);    
     
+    const QCommandLineOption sampleTypeOption("sample-type", "Type of samples in raw power traces files: int16 (default) or int8. Compressed power traces files declare the sample type themselves.", "int8|int16");
+    parser.addOption(sampleTypeOption);    
+    
+    const QCommandLineOption chunkTracesOption("chunk-traces", "Number of power traces in a chunk of the pipeline (-T with multiple modules, or with a single module to stream the power traces chunk by chunk). Default is 1024.", "positive integer");
+    parser.addOption(chunkTracesOption);    
+    
+    const QCommandLineOption threadsOption("threads", "Number of threads processing the chunks of the pipeline (-T with multiple modules). Default is the number of hardware threads.", "positive integer");
+    parser.addOption(threadsOption);    
+    
     
     const QCommandLineOption blocksOption({"b", "blocks"}, "File containing -m blocks of data, each of which -k bytes long.", "filepath");
     parser.addOption(blocksOption);    
@@ -83,9 +98,12 @@ Prep::CommandLineParseResult Prep::parseCommandLineParams(QCommandLineParser & p
     parser.addOption(blocksKOption);            
     
     
-    const QCommandLineOption paramOption("param", "Optional plug-in module parameters. Module specific option.", "param");
+    const QCommandLineOption paramOption("param", "Optional plug-in module parameters. Module specific option. Parameters of the modules of a pipeline are separated by '|'.", "param");
     parser.addOption(paramOption);
         
+    const QCommandLineOption statsJsonOption("stats-json", "Save the per-phase statistics of the run (wall and CPU time, bytes, traces and peak memory of e.g. reading the files or running the plug-in module) into a JSON file.", "filepath");
+    parser.addOption(statsJsonOption);
+        
     parser.addPositionalArgument("config", "JSON configuration file(s).");
     
     const QCommandLineOption helpOption = parser.addHelpOption();
@@ -100,8 +118,31 @@ Prep::CommandLineParseResult Prep::parseCommandLineParams(QCommandLineParser & p
     
     ConfigLoader cfg(parser);                
     
+    if(cfg.isSet(statsJsonOption)){
+        PhaseStats::get().enable(cfg.getParam(statsJsonOption));
+    }
+    
     m_id = (cfg.isSet(idOption)) ? (cfg.getParam(idOption)) : ((QDateTime::currentDateTime()).toString("ddMMyy-HHmmss"));
     m_param = (cfg.isSet(paramOption)) ? (cfg.getParam(paramOption)) : "";
+    m_sampleType = (cfg.isSet(sampleTypeOption)) ? (cfg.getParam(sampleTypeOption)) : "int16";
+    
+    if(m_sampleType != "int8" && m_sampleType != "int16"){
+        cerr << "Invalid sample type: --sample-type, use either int8 or int16\n";
+        return CommandLineError;
+    }
+    
+    bool ok = true;
+    m_chunkTraces = (cfg.isSet(chunkTracesOption)) ? (cfg.getParam(chunkTracesOption).toULongLong(&ok)) : 0;
+    if(!ok || (cfg.isSet(chunkTracesOption) && !m_chunkTraces)){
+        cerr << "Invalid number of power traces in a chunk: --chunk-traces\n";
+        return CommandLineError;
+    }
+    
+    m_threads = (cfg.isSet(threadsOption)) ? (cfg.getParam(threadsOption).toULongLong(&ok)) : 0;
+    if(!ok || (cfg.isSet(threadsOption) && !m_threads)){
+        cerr << "Invalid number of threads: --threads\n";
+        return CommandLineError;
+    }
             
     if(cfg.isSet(tracesModuleOption) && cfg.isSet(blockModuleOption)){
         cerr << "Only one of the following options is allowed: -T, -B\n";
@@ -220,14 +261,14 @@ void Prep::queryPlugins(){
     emit finished();
 }    
 
-bool Prep::loadTracesModule() {
+TracesProcess * Prep::loadTracesModule(const QString & module) {
     
     QDir pluginsDir(QCoreApplication::instance()->applicationDirPath());
     pluginsDir.cd("plugins");           
         
     pluginsDir.cd("tracesprocess");
     
-    QString fileName = m_tracesModule;
+    QString fileName = module;
     fileName.prepend("sicak");
     
     #if defined(Q_OS_WIN)
@@ -240,13 +281,10 @@ bool Prep::loadTracesModule() {
     QPluginLoader pluginLoader(pluginsDir.absoluteFilePath(fileName));
     QObject *plugin = pluginLoader.instance();    
     if (plugin) {
-        m_tracesEngine = qobject_cast<TracesProcess *>(plugin);
-        if (m_tracesEngine){
-            return true;
-        }
+        return qobject_cast<TracesProcess *>(plugin);
     }
     
-    return false;
+    return nullptr;
     
 }
 
@@ -287,25 +325,94 @@ void Prep::preprocessTraces(){
     cout << "Preprocessing power traces...\n";
     cout.flush();
     
-    if(!loadTracesModule()){
-        cerr << "Failed to load the specified plug-in module\n";
-        emit finished();
-        return;
+    // A single module processes all the power traces at once, unless the chunk size is set, multiple modules run as a pipeline
+    QStringList modules = m_tracesModule.split(",");
+    QStringList params = (modules.size() > 1) ? m_param.split("|") : QStringList(m_param);
+    std::vector<TracesProcess *> engines;
+    
+    for(int i = 0; i < modules.size(); i++){
+        
+        TracesProcess * engine = loadTracesModule(modules.at(i));
+        
+        if(engine == nullptr){
+            cerr << "Failed to load the specified plug-in module: '" << modules.at(i) << "'\n";
+            emit finished();
+            return;
+        }
+        
+        // Modules are singletons, a module can appear in the pipeline only once
+        if(std::find(engines.begin(), engines.end(), engine) != engines.end()){
+            cerr << "A plug-in module can be used only once in the pipeline: '" << modules.at(i) << "'\n";
+            emit finished();
+            return;
+        }
+        
+        engines.push_back(engine);
+        
     }
     
+    m_tracesEngine = engines.front();
+    
     // Init
+    for(size_t i = 0; i < engines.size(); i++){
+        
+        try {
+            
+            PhaseTimer timer("init-module");
+            QByteArray ba = ((int) i < params.size()) ? params.at(i).toLocal8Bit() : QByteArray();
+            engines[i]->init(ba.data());
+            
+        } catch(std::exception & e){
+            cerr << "Failed to initialize the plug-in module '" << modules.at(i) << "': " << e.what() << "\n";
+            emit finished();
+            return;
+        }
+        
+    }
+    
+    // Compressed power traces files declare the sample type, raw ones rely on --sample-type
+    size_t sampleSize = (m_sampleType == "int8") ? sizeof(int8_t) : sizeof(int16_t);
+    
     try {
-                
-        QByteArray ba = m_param.toLocal8Bit();
-        m_tracesEngine->init(ba.data());
         
-    } catch(std::exception & e){
-        cerr << "Failed to initialize the plug-in module: " << e.what() << "\n";
+        QByteArray ba = m_traces.toLocal8Bit();
+        std::fstream fs = openInFile(ba.data());
+        size_t declared = getDeclaredSampleSize(fs);
+        closeFile(fs);
+        if(declared) sampleSize = declared;
+        
+    } catch (std::exception & e) {
+        cerr << "Failed to open power traces file: " << e.what() << "\n";
         emit finished();
         return;
     }
     
-    PowerTraces<int16_t> powerTraces;
+    if(engines.size() > 1 || m_chunkTraces){
+        
+        if(sampleSize == sizeof(int8_t)){
+            pipelineTracesTyped<int8_t>(engines);
+        } else {
+            pipelineTracesTyped<int16_t>(engines);
+        }
+        
+    } else {
+        
+        if(sampleSize == sizeof(int8_t)){
+            preprocessTracesTyped<int8_t>();
+        } else {
+            preprocessTracesTyped<int16_t>();
+        }
+        
+    }
+    
+}
+
+template <class T>
+void Prep::preprocessTracesTyped(){
+    
+    QTextStream cerr(stderr);
+    
+    PowerTraces<T> powerTraces;
     
     // Alloc memory
     try {
@@ -324,6 +431,7 @@ void Prep::preprocessTraces(){
     // Open file
     try {
         
+        PhaseTimer timer("open-files");
         ba = m_traces.toLocal8Bit();    
         tracesFile = openInFile(ba.data());
         
@@ -336,7 +444,10 @@ void Prep::preprocessTraces(){
     // Load data
     try {
         
-        fillArrayFromFile(tracesFile, powerTraces);                
+        PhaseTimer timer("read-traces");
+        fillTracesFromFile(tracesFile, powerTraces);                
+        timer.addBytes(powerTraces.size());
+        timer.addTraces(powerTraces.noOfTraces());
         closeFile(tracesFile);        
         
     } catch (std::exception & e) {
@@ -348,6 +459,9 @@ void Prep::preprocessTraces(){
     // Run the processing
     try {
         
+        PhaseTimer timer("process-traces");
+        timer.addBytes(powerTraces.size());
+        timer.addTraces(powerTraces.noOfTraces());
         ba = m_id.toLocal8Bit();
         m_tracesEngine->processTraces(powerTraces, ba.data());
         
@@ -371,6 +485,91 @@ void Prep::preprocessTraces(){
     emit finished();
 }
 
+template <class T>
+void Prep::pipelineTracesTyped(std::vector<TracesProcess *> & engines){
+    
+    QTextStream cout(stdout);
+    QTextStream cerr(stderr);
+    
+    QString tracesFilename = "processed-traces-";
+    tracesFilename.append(m_id);
+    tracesFilename.append(".bin");
+    
+    std::fstream tracesFile;
+    std::fstream outFile;
+    bool outFileCreated = false;
+    size_t outSamples = 0;
+    
+    try {
+        
+        TracesPipeline<T> pipeline(engines, m_samples, m_tracesN, m_chunkTraces ? m_chunkTraces : TRACESPIPELINE_CHUNK_TRACES, m_threads);
+        outSamples = pipeline.getOutputSamplesPerTrace();
+        
+        {
+            PhaseTimer timer("open-files");
+            QByteArray ba = m_traces.toLocal8Bit();
+            tracesFile = openInFile(ba.data());
+            ba = tracesFilename.toLocal8Bit();
+            outFile = openOutFile(ba.data());
+            outFileCreated = true;
+        }
+        
+        cout << QString("Running a pipeline of %1 plug-in module(s), %2 worker(s)...\n").arg(engines.size()).arg(pipeline.getWorkers());
+        cout.flush();
+        
+        PhaseTimer timer("pipeline");
+        timer.addTraces(m_tracesN);
+        pipeline.run(tracesFile, outFile);
+        
+        closeFile(tracesFile);
+        closeFile(outFile);
+        
+    } catch (std::exception & e) {
+        
+        cerr << "Failed to process the power traces: " << e.what() << "\n";
+        
+        // Remove the partially written output file
+        if(tracesFile.is_open()) tracesFile.close();
+        if(outFile.is_open()) outFile.close();
+        if(outFileCreated) QFile::remove(tracesFilename);
+        
+        // deInit, the streams are not finished
+        for(size_t i = 0; i < engines.size(); i++){
+            try {
+                engines[i]->deInit();
+            } catch(std::exception & e){
+                cerr << "Failed to properly deinitialize the plug-in modules: " << e.what() << "\n";
+            }
+        }
+        
+        emit finished();
+        return;
+        
+    }
+    
+    // Finish and deInit
+    try {
+        
+        for(size_t i = 0; i < engines.size(); i++){
+            engines[i]->finishStream();
+            engines[i]->deInit();
+        }
+        
+    } catch(std::exception & e){
+        cerr << "Failed to properly deinitialize the plug-in modules: " << e.what() << "\n";
+        emit finished();
+        return;
+    }
+    
+    // Flush config to json file
+    QJsonObject tracesConf = tracesConfig<T>(tracesFilename, m_tracesN, outSamples);
+    saveTracesConfig(tracesConf, m_id);
+    
+    cout << QString("Processed %1 power traces, %2 samples per trace,\nand saved to '%3'.\n").arg(m_tracesN).arg(outSamples).arg(tracesFilename);
+    
+    emit finished();
+}
+
 void Prep::preprocessBlocks(){
     
     QTextStream cout(stdout);
@@ -387,6 +586,7 @@ void Prep::preprocessBlocks(){
     // Init
     try {
                 
+        PhaseTimer timer("init-module");
         QByteArray ba = m_param.toLocal8Bit();
         m_blockEngine->init(ba.data());
         
@@ -415,6 +615,7 @@ void Prep::preprocessBlocks(){
     // Open  file
     try {
         
+        PhaseTimer timer("open-files");
         ba = m_blocks.toLocal8Bit();    
         dataFile = openInFile(ba.data());
         
@@ -427,7 +628,10 @@ void Prep::preprocessBlocks(){
     // Load data
     try {
         
+        PhaseTimer timer("read-blocks");
         fillArrayFromFile(dataFile, blockData);                
+        timer.addBytes(blockData.size());
+        timer.addTraces(blockData.rows());
         closeFile(dataFile);        
         
     } catch (std::exception & e) {
@@ -439,6 +643,9 @@ void Prep::preprocessBlocks(){
     // Run the processing
     try {
         
+        PhaseTimer timer("process-blocks");
+        timer.addBytes(blockData.size());
+        timer.addTraces(blockData.rows());
         ba = m_id.toLocal8Bit();
         m_blockEngine->processBlockData(blockData, ba.data());
         
@@ -461,4 +668,3 @@ void Prep::preprocessBlocks(){
     
     emit finished();
 }
-
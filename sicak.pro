@@ -4,5 +4,7 @@ SUBDIRS     = plugins \
               stan \
               correv \
               prep \
-              visu
+              visu \
+              synt \
+              bench
 
@@ -31,6 +31,8 @@
 
 #include <QObject>
 #include <QCommandLineParser>
+#include <QJsonObject>
+#include <vector>
 #include "cpaengine.h"
 #include "ttestengine.h"
 
@@ -56,7 +58,7 @@ public:
         CommandLineQueryRequested
     };
     
-    Stan(QObject *parent = 0) : QObject(parent), m_id(""), m_platform(0), m_device(0), m_param(""), m_cpaEngine(nullptr), m_tTestEngine(nullptr), m_cpaModule(""), m_tTestModule(""), m_randomTraces(""), m_randomTracesCount(0), m_constantTraces(""), m_constantTracesCount(0), m_samplesPerTrace(0), m_predictions(""), m_predictionsSetsCount(0), m_predictionsCandidatesCount(0), m_contextA(""), m_contextB("") {}
+    Stan(QObject *parent = 0) : QObject(parent), m_id(""), m_platform(0), m_device(0), m_param(""), m_cpaEngine(nullptr), m_tTestEngine(nullptr), m_cpaModule(""), m_tTestModule(""), m_randomTraces(""), m_randomTracesCount(0), m_constantTraces(""), m_constantTracesCount(0), m_samplesPerTrace(0), m_sampleType("int16"), m_predictions(""), m_predictionsSetsCount(0), m_predictionsCandidatesCount(0), m_contextA(""), m_contextB(""), m_originalSamplesPerTrace(0), m_pyramid(false) {}
     
     /// Parse parameters from the command line and configuration files and plan tasks for event loop accordingly
     CommandLineParseResult parseCommandLineParams(QCommandLineParser & parser);    
@@ -67,6 +69,17 @@ protected:
     bool loadCpaModule();
     /// Load the specified t-test computation module
     bool loadTTestModule();
+    /// Returns the size of samples in the given power traces file: declared by the file, or set by --sample-type
+    size_t getSampleSize(const QString & tracesFile);
+    /// Passes the original positions of the samples on to the json file of the results, if set and if they match the samples per trace (unless zero)
+    void addSampleIndices(QJsonObject & conf, size_t samplesPerTrace);
+    
+    /// Create new CPA contexts from power traces with samples of type T
+    template <class T>
+    void cpaCreateTyped();
+    /// Create a new t-test context from power traces with samples of type T
+    template <class T>
+    void tTestCreateTyped();
     
     QString m_id;
     int m_platform;
@@ -86,6 +99,7 @@ protected:
     size_t m_constantTracesCount;
     
     size_t m_samplesPerTrace;
+    QString m_sampleType;
     
     QString m_predictions;
     size_t m_predictionsSetsCount;
@@ -94,6 +108,13 @@ protected:
     QString m_contextA;
     QString m_contextB;
     
+    /// Original positions of the samples, e.g. of the points of interest selected by the poi plug-in module, empty when not set
+    std::vector<size_t> m_sampleIndices;
+    size_t m_originalSamplesPerTrace;
+    
+    /// Create the series pyramid sidecar files along with the correlations/t-values
+    bool m_pyramid;
+    
         
 public slots:
     
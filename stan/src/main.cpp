@@ -31,6 +31,7 @@
 #include <QCommandLineParser>
 #include <QtCore>
 #include "stan.h"
+#include "instrumentation.hpp"
 
 int main(int argv, char *args[])
 {
@@ -49,10 +50,13 @@ int main(int argv, char *args[])
     QObject::connect(stan, SIGNAL(finished()), &app, SLOT(quit()));
      
     switch(stan->parseCommandLineParams(parser)) {
-        case Stan::CommandLineTaskPlanned:
+        case Stan::CommandLineTaskPlanned: {
             cout << qPrintable(QCoreApplication::applicationName()) << " " << qPrintable(QCoreApplication::applicationVersion()) << "\n";
             cout.flush();                      
-            return app.exec();                  
+            const int result = app.exec();
+            PhaseStats::get().saveAndReport();
+            return result;
+        }
         case Stan::CommandLineError:
             cerr << "Error parsing command line options.\n";
             return 1;
@@ -34,12 +34,17 @@
 #include <QCommandLineParser>
 #include <QJsonObject>
 #include <QJsonDocument>
+#include <QStringList>
 #include <QDateTime>
 #include <QTimer>
+#include <memory>
+#include <stdexcept>
 
 #include "configloader.hpp"
 #include "global_calls.hpp"
+#include "instrumentation.hpp"
 #include "filehandling.hpp"
+#include "seriespyramid.hpp"
 #include "stan.h"
 
 
@@ -73,14 +78,14 @@ Stan::CommandLineParseResult Stan::parseCommandLineParams(QCommandLineParser & p
     
     // Computation options
     
-    const QCommandLineOption randTracesOption({"r", "random-traces"}, "File containing -n random data traces, each of which containing -s samples (int16).", "filepath");
+    const QCommandLineOption randTracesOption({"r", "random-traces"}, "File containing -n random data traces, each of which containing -s samples (int16 or int8, see --sample-type; raw or compressed container).", "filepath");
     parser.addOption(randTracesOption);
     
     const QCommandLineOption randTracesNOption({"n", "random-traces-count"}, "Number of random data power traces in -r file.", "positive integer");
     parser.addOption(randTracesNOption);    
     
     
-    const QCommandLineOption constTracesOption({"c", "constant-traces"}, "File containing -m constant data traces, each of which containing -s samples (int16).", "filepath");
+    const QCommandLineOption constTracesOption({"c", "constant-traces"}, "File containing -m constant data traces, each of which containing -s samples (int16 or int8, see --sample-type; raw or compressed container).", "filepath");
     parser.addOption(constTracesOption);
     
     const QCommandLineOption constTracesMOption({"m", "constant-traces-count"}, "Number of constant data power traces in -c file.", "positive integer");
@@ -90,6 +95,9 @@ Stan::CommandLineParseResult Stan::parseCommandLineParams(QCommandLineParser & p
     const QCommandLineOption samplesOption({"s", "samples-per-trace"}, "Number of samples per trace.", "positive integer");
     parser.addOption(samplesOption);    
     
+    const QCommandLineOption sampleTypeOption("sample-type", "Type of samples in raw power traces files: int16 (default) or int8. Compressed power traces files declare the sample type themselves.", "int8|int16");
+    parser.addOption(sampleTypeOption);    
+    
     
     const QCommandLineOption predictionsOption({"p", "predictions"}, "File containing -q power prediction sets, each of which containing -k power predictions (uint8) for every random trace in -r file. ", "filepath");
     parser.addOption(predictionsOption);
@@ -110,6 +118,21 @@ Stan::CommandLineParseResult Stan::parseCommandLineParams(QCommandLineParser & p
     
     const QCommandLineOption paramOption("param", "Optional plug-in module parameters. Module specific option.", "param");
     parser.addOption(paramOption);
+    
+    const QCommandLineOption pyramidOption("pyramid", "Along with the finalized correlations/t-values, create the min/max pyramid sidecar file (<file>.pyr), so that visu opens and zooms them quickly.");
+    parser.addOption(pyramidOption);
+    
+    const QCommandLineOption sampleIndicesOption("sample-indices", "Original positions of the -s samples, comma separated in ascending order, e.g. of the points of interest selected by the poi plug-in module. Passed on to the config JSON files of the contexts and of the correlations/t-values, so that visu plots them at their original positions.", "list");
+    parser.addOption(sampleIndicesOption);
+    
+    const QCommandLineOption originalSamplesOption("original-samples-per-trace", "Number of samples per trace before the samples were selected, see --sample-indices. Default is the last index plus one.", "positive integer");
+    parser.addOption(originalSamplesOption);
+        
+    const QCommandLineOption statsJsonOption("stats-json", "Save the per-phase statistics of the run (wall and CPU time, bytes, traces and peak memory of e.g. reading the files or running the plug-in module) into a JSON file.", "filepath");
+    parser.addOption(statsJsonOption);
+    
+    const QCommandLineOption perfCountersOption("perf-counters", "Along with the statistics (--stats-json), count the hardware performance counters of the CPU (cycles, instructions, last level cache misses, stalled cycles) in every phase. Linux only.");
+    parser.addOption(perfCountersOption);
         
     parser.addPositionalArgument("config", "JSON configuration file(s).");
     
@@ -125,11 +148,57 @@ Stan::CommandLineParseResult Stan::parseCommandLineParams(QCommandLineParser & p
     
     ConfigLoader cfg(parser);        
     
+    if(cfg.isSet(statsJsonOption)){
+        PhaseStats::get().enable(cfg.getParam(statsJsonOption));
+    }
+    
+    if(cfg.isSet(perfCountersOption)){
+        
+        if(!cfg.isSet(statsJsonOption)){
+            cerr << "Hardware performance counters are saved along with the statistics: --stats-json is required\n";
+            return CommandLineError;
+        }
+        
+        // Before the plug-in modules start any threads, so that the counters count them too
+        if(!PhaseStats::get().enableCounters()){
+            cerr << "Hardware performance counters are not available (see /proc/sys/kernel/perf_event_paranoid), the statistics will not contain them\n";
+        }
+        
+    }
+    
     // straight thru params
     m_id = (cfg.isSet(idOption)) ? (cfg.getParam(idOption)) : ((QDateTime::currentDateTime()).toString("ddMMyy-HHmmss"));
     m_platform = (cfg.isSet(platformOption)) ? (cfg.getParam(platformOption)).toInt() : 0;
     m_device = (cfg.isSet(deviceOption)) ? (cfg.getParam(deviceOption)).toInt() : 0;
     m_param = (cfg.isSet(paramOption)) ? (cfg.getParam(paramOption)) : "";
+    m_sampleType = (cfg.isSet(sampleTypeOption)) ? (cfg.getParam(sampleTypeOption)) : "int16";
+    m_pyramid = (cfg.isSet(pyramidOption)) ? true : false;
+    
+    if(m_sampleType != "int8" && m_sampleType != "int16"){
+        cerr << "Invalid sample type: --sample-type, use either int8 or int16\n";
+        return CommandLineError;
+    }
+    
+    if(cfg.isSet(sampleIndicesOption)){
+        
+        bool ok;
+        m_sampleIndices = cfg.getIndicesParam(sampleIndicesOption, ok);
+        
+        for(size_t i = 1; i < m_sampleIndices.size(); i++) ok = ok && m_sampleIndices[i] > m_sampleIndices[i - 1];
+        
+        m_originalSamplesPerTrace = (cfg.isSet(originalSamplesOption)) ? cfg.getParam(originalSamplesOption).toULongLong() : m_sampleIndices.back() + 1;
+        
+        if(!ok || m_originalSamplesPerTrace <= m_sampleIndices.back()){
+            cerr << "Invalid sample indices: --sample-indices, use ascending sample positions below --original-samples-per-trace\n";
+            return CommandLineError;
+        }
+        
+        if(cfg.isSet(samplesOption) && m_sampleIndices.size() != (size_t) cfg.getParam(samplesOption).toULongLong()){
+            cerr << "Number of the sample indices (--sample-indices) does not match the number of samples per trace (-s)\n";
+            return CommandLineError;
+        }
+        
+    }
     
     // CPA vs t-test
     if(cfg.isSet(cpaModuleOption) && cfg.isSet(ttestModuleOption)){
@@ -284,6 +353,24 @@ Stan::CommandLineParseResult Stan::parseCommandLineParams(QCommandLineParser & p
     
 }
 
+void Stan::addSampleIndices(QJsonObject & conf, size_t samplesPerTrace){
+    
+    if(m_sampleIndices.empty()) return;
+    
+    if(samplesPerTrace && samplesPerTrace != m_sampleIndices.size()){
+        QTextStream cerr(stderr);
+        cerr << "Number of the sample indices (--sample-indices) does not match the number of samples per trace, the indices were not passed on\n";
+        return;
+    }
+    
+    QStringList indices;
+    for(size_t i = 0; i < m_sampleIndices.size(); i++) indices << QString::number(m_sampleIndices[i]);
+    
+    conf["sample-indices"] = indices.join(",");
+    conf["original-samples-per-trace"] = QString::number(m_originalSamplesPerTrace);
+    
+}
+
 void Stan::queryPlugins(){
         
     QTextStream cout(stdout);
@@ -407,8 +494,39 @@ bool Stan::loadTTestModule(){
     return false;
 }
 
+size_t Stan::getSampleSize(const QString & tracesFile) {
+    
+    // Compressed power traces files declare the sample type, raw ones rely on --sample-type
+    try {
+        
+        QByteArray ba = tracesFile.toLocal8Bit();
+        std::fstream fs = openInFile(ba.data());
+        size_t declared = getDeclaredSampleSize(fs);
+        fs.close();
+        
+        if(declared) return declared;
+        
+    } catch (std::exception & e) {
+        (void)e; // reported when the file gets opened again
+    }
+    
+    return (m_sampleType == "int8") ? sizeof(int8_t) : sizeof(int16_t);
+    
+}
+
 void Stan::cpaCreate() {
     
+    if(getSampleSize(m_randomTraces) == sizeof(int8_t)){
+        cpaCreateTyped<int8_t>();
+    } else {
+        cpaCreateTyped<int16_t>();
+    }
+    
+}
+
+template <class T>
+void Stan::cpaCreateTyped() {
+    
     QTextStream cout(stdout);
     QTextStream cerr(stderr);
     cout << "Creating new CPA contexts...\n";
@@ -423,6 +541,7 @@ void Stan::cpaCreate() {
     // Init
     try {
                 
+        PhaseTimer timer("init-module");
         QByteArray ba = m_param.toLocal8Bit();
         m_cpaEngine->init(m_platform, m_device, m_randomTracesCount, m_samplesPerTrace, m_predictionsCandidatesCount, ba.data());
         
@@ -443,12 +562,13 @@ void Stan::cpaCreate() {
     std::fstream powerTracesFile;
     std::fstream powerPredictionsFile;
         
-    PowerTraces<int16_t> powerTraces;        
+    PowerTraces<T> powerTraces;        
     PowerPredictions<uint8_t> powerPredictions;    
             
     // Open random traces file
     try {
         
+        PhaseTimer timer("open-files");
         ba = m_randomTraces.toLocal8Bit();    
         powerTracesFile = openInFile(ba.data());
         
@@ -461,6 +581,7 @@ void Stan::cpaCreate() {
     // Open power predictions file
     try {
         
+        PhaseTimer timer("open-files");
         ba = m_predictions.toLocal8Bit();
         powerPredictionsFile = openInFile(ba.data());
         
@@ -485,7 +606,10 @@ void Stan::cpaCreate() {
     // Load power traces
     try {
         
-        fillArrayFromFile(powerTracesFile, powerTraces);                
+        PhaseTimer timer("read-traces");
+        fillTracesFromFile(powerTracesFile, powerTraces);                
+        timer.addBytes(powerTraces.size());
+        timer.addTraces(powerTraces.noOfTraces());
         closeFile(powerTracesFile);        
         
     } catch (std::exception & e) {
@@ -497,6 +621,7 @@ void Stan::cpaCreate() {
     // Open output file
     try{
         
+        PhaseTimer timer("open-files");
         ba = contextsFileName.toLocal8Bit();    
         contextsFile = openOutFile(ba.data());
         
@@ -518,7 +643,10 @@ void Stan::cpaCreate() {
         // Load power predictions
         try {
         
+            PhaseTimer timer("read-predictions");
             fillArrayFromFile(powerPredictionsFile, powerPredictions);                            
+            timer.addBytes(powerPredictions.size());
+            timer.addTraces(powerPredictions.noOfTraces());
             
         } catch (std::exception & e) {
             cerr << "Failed to read power predictions from file: " << e.what() << "\n";
@@ -529,6 +657,9 @@ void Stan::cpaCreate() {
         // Run the computation
         try {
             
+            PhaseTimer timer("create-context");
+            timer.addTraces(powerTraces.noOfTraces());
+            timer.addElements((uint64_t) powerTraces.noOfTraces() * powerTraces.samplesPerTrace() * powerPredictions.noOfCandidates());
             context = m_cpaEngine->createContext(powerTraces, powerPredictions);
             
         } catch(std::exception & e){
@@ -540,7 +671,10 @@ void Stan::cpaCreate() {
         // Save the context to the file
         try {
         
+            PhaseTimer timer("write-context");
+            const std::streamoff start = contextsFile.tellp();
             writeContextToFile(contextsFile, context);
+            timer.addBytes(contextsFile.tellp() - start);
             
         } catch (std::exception & e) {
             cerr << "Failed to write a CPA context to file: " << e.what() << "\n";
@@ -572,6 +706,7 @@ void Stan::cpaCreate() {
     contextConf["context-a"] = contextsFileName;
     contextConf["prediction-sets-count"] = QString::number(m_predictionsSetsCount);
     contextConf["contexts-count"] = QString::number(m_predictionsSetsCount);    
+    addSampleIndices(contextConf, 0);
     QJsonDocument contextDoc(contextConf);
     QString contextDocFilename = m_id;
     contextDocFilename.append(".json");
@@ -604,6 +739,7 @@ void Stan::cpaMerge() {
     // Init
     try {
                 
+        PhaseTimer timer("init-module");
         QByteArray ba = m_param.toLocal8Bit();
         m_cpaEngine->init(m_platform, m_device, m_randomTracesCount, m_samplesPerTrace, m_predictionsCandidatesCount, ba.data());
         
@@ -627,6 +763,7 @@ void Stan::cpaMerge() {
     // Open first context file
     try {
         
+        PhaseTimer timer("open-files");
         ba = m_contextA.toLocal8Bit();    
         firstCtxFile = openInFile(ba.data());
         
@@ -639,6 +776,7 @@ void Stan::cpaMerge() {
     // Open second context file
     try {
         
+        PhaseTimer timer("open-files");
         ba = m_contextB.toLocal8Bit();    
         secondCtxFile = openInFile(ba.data());
         
@@ -651,6 +789,7 @@ void Stan::cpaMerge() {
     // Open output context file
     try {
         
+        PhaseTimer timer("open-files");
         ba = contextsFileName.toLocal8Bit();    
         outputFile = openOutFile(ba.data());
         
@@ -669,7 +808,10 @@ void Stan::cpaMerge() {
         
         // Read context from first file
         try {
+            PhaseTimer timer("read-context");
+            const std::streamoff start = firstCtxFile.tellg();
             firstContext = readContextFromFile<double>(firstCtxFile);
+            timer.addBytes(firstCtxFile.tellg() - start);
         } catch(std::exception & e) {
             cerr << "Failed to read from context-A file: " << e.what() << "\n";
             emit finished();
@@ -678,7 +820,10 @@ void Stan::cpaMerge() {
         
         // Read context from second file
         try {
+            PhaseTimer timer("read-context");
+            const std::streamoff start = secondCtxFile.tellg();
             secondContext = readContextFromFile<double>(secondCtxFile);
+            timer.addBytes(secondCtxFile.tellg() - start);
         } catch(std::exception & e) {
             cerr << "Failed to read from context-B file: " << e.what() << "\n";
             emit finished();
@@ -687,6 +832,8 @@ void Stan::cpaMerge() {
         
         // Merge them
         try {            
+            PhaseTimer timer("merge-contexts");
+            timer.addElements((uint64_t) firstContext.p1Width() * firstContext.p2Width());
             m_cpaEngine->mergeContexts(firstContext, secondContext);
             
         } catch(std::exception & e){
@@ -697,7 +844,10 @@ void Stan::cpaMerge() {
         
         // Save the merged context to file
         try {
+            PhaseTimer timer("write-context");
+            const std::streamoff start = outputFile.tellp();
             writeContextToFile(outputFile, firstContext);
+            timer.addBytes(outputFile.tellp() - start);
         } catch(std::exception & e) {
             cerr << "Failed to save a merged context to file: " << e.what() << "\n";
             emit finished();
@@ -727,6 +877,7 @@ void Stan::cpaMerge() {
     contextConf["context-a"] = contextsFileName;
     contextConf["prediction-sets-count"] = QString::number(m_predictionsSetsCount);
     contextConf["contexts-count"] = QString::number(m_predictionsSetsCount);    
+    addSampleIndices(contextConf, 0);
     QJsonDocument contextDoc(contextConf);
     QString contextDocFilename = m_id;
     contextDocFilename.append(".json");
@@ -759,6 +910,7 @@ void Stan::cpaFinalize() {
     // Init
     try {
                 
+        PhaseTimer timer("init-module");
         QByteArray ba = m_param.toLocal8Bit();
         m_cpaEngine->init(m_platform, m_device, m_randomTracesCount, m_samplesPerTrace, m_predictionsCandidatesCount, ba.data());
         
@@ -781,6 +933,7 @@ void Stan::cpaFinalize() {
     // Open context file
     try {
         
+        PhaseTimer timer("open-files");
         ba = m_contextA.toLocal8Bit();    
         ctxFile = openInFile(ba.data());
         
@@ -793,6 +946,7 @@ void Stan::cpaFinalize() {
     // Open output correlations file
     try {
         
+        PhaseTimer timer("open-files");
         ba = correlationsFileName.toLocal8Bit();    
         outputFile = openOutFile(ba.data());
         
@@ -802,6 +956,26 @@ void Stan::cpaFinalize() {
         return;
     }
     
+    // Open output pyramid file
+    std::fstream pyramidFile;
+    std::unique_ptr<SeriesPyramidWriter<double>> pyramidWriter;
+    
+    if(m_pyramid){
+        
+        try {
+            
+            PhaseTimer timer("open-files");
+            ba = QString(correlationsFileName).append(".pyr").toLocal8Bit();
+            pyramidFile = openOutFile(ba.data());
+            
+        } catch (std::exception & e) {
+            cerr << "Failed to open output pyramid file: " << e.what() << "\n";
+            emit finished();
+            return;
+        }
+        
+    }
+    
     Moments2DContext<double> context;    
     Matrix<double> correlations;
     
@@ -812,7 +986,10 @@ void Stan::cpaFinalize() {
         // Read the context from file
         try {
             
+            PhaseTimer timer("read-context");
+            const std::streamoff start = ctxFile.tellg();
             context = readContextFromFile<double>(ctxFile);
+            timer.addBytes(ctxFile.tellg() - start);
             
         } catch(std::exception & e) {
             cerr << "Failed to read from context-A file: " << e.what() << "\n";
@@ -823,6 +1000,8 @@ void Stan::cpaFinalize() {
         // Compute correlations
         try {
             
+            PhaseTimer timer("finalize-context");
+            timer.addElements((uint64_t) context.p1Width() * context.p2Width());
             correlations = m_cpaEngine->finalizeContext(context);
             
         } catch(std::exception & e){
@@ -833,13 +1012,30 @@ void Stan::cpaFinalize() {
         
         // Save the correlations to file
         try {
+            PhaseTimer timer("write-results");
             writeArrayToFile(outputFile, correlations);
+            timer.addBytes(correlations.size());
         } catch(std::exception & e) {
             cerr << "Failed to save a merged context to file: " << e.what() << "\n";
             emit finished();
             return;
         }       
         
+        // Summarize the correlation traces into the pyramid
+        if(m_pyramid){
+            
+            try {
+                PhaseTimer timer("write-pyramid");
+                if(!pyramidWriter) pyramidWriter.reset(new SeriesPyramidWriter<double>(pyramidFile, correlations.cols()));
+                pyramidWriter->writeSeries(correlations.data(), correlations.rows());
+            } catch(std::exception & e) {
+                cerr << "Failed to save the pyramid to file: " << e.what() << "\n";
+                emit finished();
+                return;
+            }
+            
+        }
+        
         CoutProgress::get().update(i);
     }
     
@@ -849,6 +1045,8 @@ void Stan::cpaFinalize() {
     try {
         closeFile(outputFile);
         closeFile(ctxFile);        
+        if(pyramidWriter) pyramidWriter->close();
+        if(m_pyramid) closeFile(pyramidFile);
         m_cpaEngine->deInit();
         
     } catch(std::exception & e){
@@ -866,6 +1064,7 @@ void Stan::cpaFinalize() {
     correlConf["prediction-candidates-count"] = QString::number(correlations.rows());
     correlConf["correlations-candidates-count"] = QString::number(correlations.rows());
     correlConf["samples-per-trace"] = QString::number(correlations.cols());
+    addSampleIndices(correlConf, correlations.cols());
     QJsonDocument correlDoc(correlConf);
     QString contextDocFilename = m_id;
     contextDocFilename.append(".json");
@@ -884,6 +1083,34 @@ void Stan::cpaFinalize() {
 
 void Stan::tTestCreate() {
     
+    QTextStream cerr(stderr);
+    
+    size_t sampleSize;
+    
+    // Both power traces files must contain the same type of samples
+    try {
+        
+        sampleSize = getSampleSize(m_randomTraces);
+        if(getSampleSize(m_constantTraces) != sampleSize)
+            throw std::runtime_error("random and constant power traces files contain different types of samples (int8 vs. int16)");
+        
+    } catch (std::exception & e) {
+        cerr << "Invalid power traces files: " << e.what() << "\n";
+        emit finished();
+        return;
+    }
+    
+    if(sampleSize == sizeof(int8_t)){
+        tTestCreateTyped<int8_t>();
+    } else {
+        tTestCreateTyped<int16_t>();
+    }
+    
+}
+
+template <class T>
+void Stan::tTestCreateTyped() {
+    
     QTextStream cout(stdout);
     QTextStream cerr(stderr);
     cout << "Creating new t-test context...\n";
@@ -898,6 +1125,7 @@ void Stan::tTestCreate() {
     // Init
     try {
                 
+        PhaseTimer timer("init-module");
         QByteArray ba = m_param.toLocal8Bit();
         m_tTestEngine->init(m_platform, m_device, m_randomTracesCount, m_constantTracesCount, m_samplesPerTrace, ba.data());
         
@@ -917,12 +1145,13 @@ void Stan::tTestCreate() {
     std::fstream randomTracesFile;
     std::fstream constTracesFile;
         
-    PowerTraces<int16_t> randomTraces;        
-    PowerTraces<int16_t> constTraces;    
+    PowerTraces<T> randomTraces;        
+    PowerTraces<T> constTraces;    
             
     // Open random traces file
     try {
         
+        PhaseTimer timer("open-files");
         ba = m_randomTraces.toLocal8Bit();    
         randomTracesFile = openInFile(ba.data());
         
@@ -935,6 +1164,7 @@ void Stan::tTestCreate() {
     // Open constant traces file
     try {
         
+        PhaseTimer timer("open-files");
         ba = m_constantTraces.toLocal8Bit();
         constTracesFile = openInFile(ba.data());
         
@@ -959,7 +1189,10 @@ void Stan::tTestCreate() {
     // Load random traces
     try {
         
-        fillArrayFromFile(randomTracesFile, randomTraces);                
+        PhaseTimer timer("read-traces");
+        fillTracesFromFile(randomTracesFile, randomTraces);                
+        timer.addBytes(randomTraces.size());
+        timer.addTraces(randomTraces.noOfTraces());
         closeFile(randomTracesFile);        
         
     } catch (std::exception & e) {
@@ -971,7 +1204,10 @@ void Stan::tTestCreate() {
     // Load constant traces
     try {
         
-        fillArrayFromFile(constTracesFile, constTraces);                
+        PhaseTimer timer("read-traces");
+        fillTracesFromFile(constTracesFile, constTraces);                
+        timer.addBytes(constTraces.size());
+        timer.addTraces(constTraces.noOfTraces());
         closeFile(constTracesFile);        
         
     } catch (std::exception & e) {
@@ -983,6 +1219,7 @@ void Stan::tTestCreate() {
     // Open output file
     try{
         
+        PhaseTimer timer("open-files");
         ba = contextsFileName.toLocal8Bit();    
         contextsFile = openOutFile(ba.data());
         
@@ -999,6 +1236,9 @@ void Stan::tTestCreate() {
     // Run the computation
     try {
             
+        PhaseTimer timer("create-context");
+        timer.addTraces(randomTraces.noOfTraces() + constTraces.noOfTraces());
+        timer.addElements((uint64_t) (randomTraces.noOfTraces() + constTraces.noOfTraces()) * randomTraces.samplesPerTrace());
         context = m_tTestEngine->createContext(randomTraces, constTraces);
         
     } catch(std::exception & e){
@@ -1012,7 +1252,10 @@ void Stan::tTestCreate() {
     // Save context to file
     try {
         
+        PhaseTimer timer("write-context");
+        const std::streamoff start = contextsFile.tellp();
         writeContextToFile(contextsFile, context);
+        timer.addBytes(contextsFile.tellp() - start);
         closeFile(contextsFile);
         
     } catch (std::exception & e) {
@@ -1035,6 +1278,7 @@ void Stan::tTestCreate() {
     // Flush config to json file
     QJsonObject contextConf;
     contextConf["context-a"] = contextsFileName; 
+    addSampleIndices(contextConf, 0);
     QJsonDocument contextDoc(contextConf);
     QString contextDocFilename = m_id;
     contextDocFilename.append(".json");
@@ -1066,6 +1310,7 @@ void Stan::tTestMerge() {
     // Init
     try {
                 
+        PhaseTimer timer("init-module");
         QByteArray ba = m_param.toLocal8Bit();
         m_tTestEngine->init(m_platform, m_device, m_randomTracesCount, m_constantTracesCount, m_samplesPerTrace, ba.data());
         
@@ -1088,6 +1333,7 @@ void Stan::tTestMerge() {
     // Open first context file
     try {
         
+        PhaseTimer timer("open-files");
         ba = m_contextA.toLocal8Bit();    
         firstCtxFile = openInFile(ba.data());
         
@@ -1100,6 +1346,7 @@ void Stan::tTestMerge() {
     // Open second context file
     try {
         
+        PhaseTimer timer("open-files");
         ba = m_contextB.toLocal8Bit();    
         secondCtxFile = openInFile(ba.data());
         
@@ -1114,7 +1361,10 @@ void Stan::tTestMerge() {
     
     // Read context from first file
     try {
+        PhaseTimer timer("read-context");
+        const std::streamoff start = firstCtxFile.tellg();
         firstContext = readContextFromFile<double>(firstCtxFile);
+        timer.addBytes(firstCtxFile.tellg() - start);
         closeFile(firstCtxFile);
     } catch(std::exception & e) {
         cerr << "Failed to read from context-A file: " << e.what() << "\n";
@@ -1124,7 +1374,10 @@ void Stan::tTestMerge() {
     
     // Read context from second file
     try {
+        PhaseTimer timer("read-context");
+        const std::streamoff start = secondCtxFile.tellg();
         secondContext = readContextFromFile<double>(secondCtxFile);
+        timer.addBytes(secondCtxFile.tellg() - start);
         closeFile(secondCtxFile);
     } catch(std::exception & e) {
         cerr << "Failed to read from context-B file: " << e.what() << "\n";
@@ -1135,6 +1388,7 @@ void Stan::tTestMerge() {
     // Open output context file
     try {
         
+        PhaseTimer timer("open-files");
         ba = contextsFileName.toLocal8Bit();    
         outputFile = openOutFile(ba.data());
         
@@ -1148,6 +1402,8 @@ void Stan::tTestMerge() {
     // Merge contexts
     try {
         
+        PhaseTimer timer("merge-contexts");
+        timer.addElements(firstContext.p1Width());
         m_tTestEngine->mergeContexts(firstContext, secondContext);
         
     } catch(std::exception & e){
@@ -1160,7 +1416,10 @@ void Stan::tTestMerge() {
     
     // Save the merged context to file
     try {
+        PhaseTimer timer("write-context");
+        const std::streamoff start = outputFile.tellp();
         writeContextToFile(outputFile, firstContext);
+        timer.addBytes(outputFile.tellp() - start);
         closeFile(outputFile);
     } catch(std::exception & e) {
         cerr << "Failed to save a merged context to file: " << e.what() << "\n";
@@ -1182,6 +1441,7 @@ void Stan::tTestMerge() {
     // Flush config to json file
     QJsonObject contextConf;
     contextConf["context-a"] = contextsFileName; 
+    addSampleIndices(contextConf, 0);
     QJsonDocument contextDoc(contextConf);
     QString contextDocFilename = m_id;
     contextDocFilename.append(".json");
@@ -1213,6 +1473,7 @@ void Stan::tTestFinalize() {
     // Init
     try {
                 
+        PhaseTimer timer("init-module");
         QByteArray ba = m_param.toLocal8Bit();
         m_tTestEngine->init(m_platform, m_device, m_randomTracesCount, m_constantTracesCount, m_samplesPerTrace, ba.data());
         
@@ -1237,6 +1498,7 @@ void Stan::tTestFinalize() {
     // Open context file
     try {
         
+        PhaseTimer timer("open-files");
         ba = m_contextA.toLocal8Bit();    
         ctxFile = openInFile(ba.data());
         
@@ -1249,7 +1511,10 @@ void Stan::tTestFinalize() {
     // Read the context from file
     try {
         
+        PhaseTimer timer("read-context");
+        const std::streamoff start = ctxFile.tellg();
         context = readContextFromFile<double>(ctxFile);
+        timer.addBytes(ctxFile.tellg() - start);
         closeFile(ctxFile);
         
     } catch(std::exception & e) {
@@ -1261,6 +1526,7 @@ void Stan::tTestFinalize() {
     // Open output tvals file
     try {
         
+        PhaseTimer timer("open-files");
         ba = tValsFileName.toLocal8Bit();    
         outputFile = openOutFile(ba.data());
         
@@ -1274,6 +1540,8 @@ void Stan::tTestFinalize() {
     // Compute tvals
     try {
         
+        PhaseTimer timer("finalize-context");
+        timer.addElements(context.p1Width());
         tVals = m_tTestEngine->finalizeContext(context);
         
     } catch(std::exception & e){
@@ -1286,7 +1554,9 @@ void Stan::tTestFinalize() {
     
     // Save the tvals to file
     try {
+        PhaseTimer timer("write-results");
         writeArrayToFile(outputFile, tVals);
+        timer.addBytes(tVals.size());
         closeFile(outputFile);
     } catch(std::exception & e) {
         cerr << "Failed to save a merged context to file: " << e.what() << "\n";
@@ -1294,6 +1564,29 @@ void Stan::tTestFinalize() {
         return;
     }       
     
+    // Summarize the t-values and the degrees of freedom into the pyramid
+    if(m_pyramid){
+        
+        try {
+            
+            PhaseTimer timer("write-pyramid");
+            ba = QString(tValsFileName).append(".pyr").toLocal8Bit();
+            std::fstream pyramidFile = openOutFile(ba.data());
+            
+            SeriesPyramidWriter<double> pyramidWriter(pyramidFile, tVals.cols());
+            pyramidWriter.writeSeries(tVals.data(), tVals.rows());
+            pyramidWriter.close();
+            
+            closeFile(pyramidFile);
+            
+        } catch(std::exception & e) {
+            cerr << "Failed to save the pyramid to file: " << e.what() << "\n";
+            emit finished();
+            return;
+        }
+        
+    }
+    
     // deInit
     try {
                 
@@ -1309,6 +1602,7 @@ void Stan::tTestFinalize() {
     QJsonObject tvalsConf;
     tvalsConf["t-values"] = tValsFileName; 
     tvalsConf["samples-per-trace"] = QString::number(tVals.cols());
+    addSampleIndices(tvalsConf, tVals.cols());
     QJsonDocument tvalsDoc(tvalsConf);
     QString tvalsDocFilename = m_id;
     tvalsDocFilename.append(".json");
@@ -1323,4 +1617,3 @@ void Stan::tTestFinalize() {
     
     emit finished();
 }
-    
@@ -0,0 +1,109 @@
+/*
+*  SICAK - SIde-Channel Analysis toolKit
+*  Copyright (C) 2018-2019 Petr Socha, FIT, CTU in Prague
+*
+*  This program is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation, either version 3 of the License, or
+*  (at your option) any later version.
+*
+*  This program is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/**
+* \file synt.h
+*
+* \brief SICAK SYNThetic traces generator text-based UI
+*
+*
+* \author Petr Socha
+* \version 1.0
+*/
+
+#ifndef SYNT_H
+#define SYNT_H
+
+#include <QObject>
+#include <QCommandLineParser>
+#include <fstream>
+#include "synthesizer.hpp"
+
+/**
+* \class Synt
+* \ingroup Sicak
+*
+* \brief Class providing text-based UI front-end to the synthetic power traces generator: generates the power traces, plaintext, ciphertext and power predictions files
+* of an AES-128 with a known key, along with a json configuration file for stan
+*
+*/
+class Synt: public QObject {
+  
+Q_OBJECT
+
+public:
+    
+    enum CommandLineParseResult {
+        CommandLineTaskPlanned,
+        CommandLineNOP,
+        CommandLineError,
+        CommandLineVersionRequested,
+        CommandLineHelpRequested
+    };
+    
+    Synt(QObject *parent = 0) : QObject(parent), m_id(""), m_function(""), m_tracesN(0), m_constTracesM(0), m_samples(0), m_sampleType("int16"), m_compress(false), m_predictions(true), m_model(Synthesizer::Model::HW), m_snr(1.0), m_gain(200), m_leak(100), m_spacing(10), m_order(0), m_jitter(0), m_seed(0), m_threads(1) {}
+    
+    /// Parse parameters from the command line and configuration files and plan tasks for event loop accordingly
+    CommandLineParseResult parseCommandLineParams(QCommandLineParser & parser);    
+
+protected:
+    
+    /// Generates the power traces with samples of type T
+    template <class T>
+    void generateTyped();
+    
+    /// Generates 'count' power traces starting with the first-th one, in parallel, and writes them in order. Plaintexts, ciphertexts and predictions are written when the files are given
+    template <class T>
+    void generateTraces(const Synthesizer & synthesizer, size_t first, size_t count, const uint8_t * constPlaintext, std::fstream & tracesFile, std::fstream * plaintextFile, std::fstream * ciphertextFile, std::fstream * predictionsFile);
+    
+    QString m_id;
+    QString m_function;
+    
+    size_t m_tracesN;
+    size_t m_constTracesM;
+    size_t m_samples;
+    QString m_sampleType;
+    bool m_compress;
+    bool m_predictions;
+    
+    /// Simulation parameters
+    Synthesizer::Model m_model;
+    double m_snr;
+    int m_gain;
+    size_t m_leak;
+    size_t m_spacing;
+    size_t m_order;
+    size_t m_jitter;
+    uint8_t m_key[16];
+    uint64_t m_seed;
+    
+    /// Number of generating threads
+    size_t m_threads;
+    
+public slots:
+    
+    /// Generate the power traces and the related files
+    void generate();
+    
+signals:
+    
+    void finished();
+    
+};
+
+#endif /* SYNT_H */
@@ -0,0 +1,224 @@
+/*
+*  SICAK - SIde-Channel Analysis toolKit
+*  Copyright (C) 2018-2019 Petr Socha, FIT, CTU in Prague
+*
+*  This program is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation, either version 3 of the License, or
+*  (at your option) any later version.
+*
+*  This program is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/**
+* \file synthesizer.hpp
+*
+* \brief Synthesis of AES-128 power traces with a known key, used by the SICAK SYNThetic traces generator
+*
+*
+* \author Petr Socha
+* \version 1.0
+*/
+
+#ifndef SYNTHESIZER_H
+#define SYNTHESIZER_H
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include "aes128.hpp"
+#include "tracesimulation.hpp"
+#include "exceptions.hpp"
+
+/// Maximum masking order
+#define SYNTHESIZER_MAX_ORDER 7
+
+/**
+* \class Synthesizer
+* \ingroup Sicak
+*
+* \brief Synthesizes power traces of an AES-128 encryption with a known key. A power trace consists of a periodic base waveform, leakage of the first round S-box outputs,
+* Gaussian noise and a random time shift (misalignment), see TraceSimulation.
+*
+* With masking order d, every S-box output is split into d+1 Boolean shares, each leaking in its own sample: any d leaking samples are independent of the S-box output.
+* The leaking samples follow one another by 'spacing' samples, the shares of all the 16 bytes are leaked before the next share.
+*
+* Every power trace is determined just by the seed and the number of the power trace, so that the power traces may be synthesized in parallel, in any order,
+* with the same results.
+*
+*/
+class Synthesizer {
+
+public:
+
+    /// Leakage model
+    enum class Model {
+        HW, //< Hamming weight of the S-box output
+        HD, //< Hamming distance of the S-box input and output
+        ID  //< S-box output itself
+    };
+
+    /// Constructor. SNR is the ratio of the leakage variance and the noise variance in a leaking sample
+    Synthesizer(size_t samplesPerTrace, Model model, const uint8_t * key, double snr, int gain = 200, size_t leak = 100, size_t spacing = 10, size_t order = 0, size_t jitter = 0, uint64_t seed = 0)
+        : m_samples(samplesPerTrace), m_model(model), m_snr(snr), m_gain(gain), m_leak(leak), m_spacing(spacing), m_order(order), m_jitter(jitter), m_seed(seed) {
+
+        if(!m_samples) throw InvalidInputException("Invalid number of samples per trace");
+        if(!(m_snr > 0)) throw InvalidInputException("Invalid SNR, must be positive");
+        if(!m_gain) throw InvalidInputException("Invalid leakage gain, must be non-zero");
+        if(m_order > SYNTHESIZER_MAX_ORDER) throw InvalidInputException("Invalid masking order, at most 7 is supported");
+
+        std::memcpy(m_key, key, 16);
+        m_aes.setKey(m_key);
+
+        for(int value = 0; value < 256; value++){
+            int weight = 0;
+            for(int bit = 0; bit < 8; bit++) weight += (value >> bit) & 1;
+            m_hw[value] = (uint8_t) weight;
+        }
+
+        // Base waveform and noise, noise level given by the SNR
+        m_simulation.prepare(m_samples, m_jitter, std::fabs((double) m_gain) * std::sqrt(leakageVariance() / m_snr));
+
+        // Power predictions of the unmasked leakage, for every plaintext byte and key candidate
+        const uint8_t * sbox = Aes128::sbox();
+
+        m_predictions.resize(256 * 256);
+
+        for(int data = 0; data < 256; data++){
+            for(int candidate = 0; candidate < 256; candidate++){
+                uint8_t in = (uint8_t) (data ^ candidate);
+                m_predictions[data * 256 + candidate] = (uint8_t) leakage(in, sbox[in]);
+            }
+        }
+
+    }
+
+    /// Synthesizes the trace-th power trace, T is either int16_t or int8_t. When constPlaintext is nullptr, the plaintext is random. Stores the plaintext and the ciphertext
+    template <class T>
+    void synthesize(size_t trace, const uint8_t * constPlaintext, T * samples, uint8_t * plaintext, uint8_t * ciphertext) const {
+
+        // Random numbers of the power trace, determined by the seed and the number of the power trace
+        uint64_t state = TraceSimulation::splitMix(m_seed + 0x9E3779B97F4A7C15ULL * (trace + 1));
+
+        if(constPlaintext != nullptr){
+            std::memcpy(plaintext, constPlaintext, 16);
+        } else {
+            TraceSimulation::randomBytes(state, plaintext, 16);
+        }
+
+        uint8_t sboxOut[16];
+        m_aes.encrypt(plaintext, ciphertext, sboxOut);
+
+        // Boolean shares of the S-box inputs and outputs, the last share completes the value
+        uint8_t inShares[16 * (SYNTHESIZER_MAX_ORDER + 1)];
+        uint8_t outShares[16 * (SYNTHESIZER_MAX_ORDER + 1)];
+
+        for(size_t i = 0; i < 16; i++){
+            inShares[16 * m_order + i] = plaintext[i] ^ m_key[i];
+            outShares[16 * m_order + i] = sboxOut[i];
+        }
+
+        if(m_order){
+            TraceSimulation::randomBytes(state, inShares, 16 * m_order);
+            TraceSimulation::randomBytes(state, outShares, 16 * m_order);
+            for(size_t share = 0; share < m_order; share++){
+                for(size_t i = 0; i < 16; i++){
+                    inShares[16 * m_order + i] ^= inShares[16 * share + i];
+                    outShares[16 * m_order + i] ^= outShares[16 * share + i];
+                }
+            }
+        }
+
+        size_t shift = m_jitter ? TraceSimulation::random(state) % (2 * m_jitter + 1) : 0;
+        uint64_t noiseKey = TraceSimulation::random(state);
+
+        // Leakage of the shares
+        int leakages[16 * (SYNTHESIZER_MAX_ORDER + 1)];
+
+        for(size_t i = 0; i < 16 * (m_order + 1); i++){
+            leakages[i] = m_gain * leakage(inShares[i], outShares[i]);
+        }
+
+        m_simulation.synthesize(samples, shift, noiseKey, leakages, 16 * (m_order + 1), m_leak, m_spacing);
+
+    }
+
+    /// Returns the 256 power predictions of the unmasked leakage, one for every key candidate, given the plaintext byte
+    const uint8_t * predictions(uint8_t plaintextByte) const {
+        return m_predictions.data() + 256 * plaintextByte;
+    }
+
+    /// Returns the standard deviation of the noise, in 16-bit LSBs
+    double getNoise() const { return m_simulation.getNoise(); }
+
+    /// Returns the number of the last sample leaking a share, regardless of the time shift
+    size_t getLastLeakingSample() const { return m_leak + (16 * (m_order + 1) - 1) * m_spacing; }
+
+protected:
+
+    /// Returns the leakage of the S-box input and output
+    int leakage(uint8_t in, uint8_t out) const {
+
+        if(m_model == Model::ID) return out;
+        if(m_model == Model::HD) return m_hw[in ^ out];
+        return m_hw[out];
+
+    }
+
+    /// Returns the variance of the leakage of a single leaking sample
+    double leakageVariance() const {
+
+        const uint8_t * sbox = Aes128::sbox();
+        double sum = 0, sumSq = 0;
+
+        // Shares of the masked implementation are uniform and independent, unmasked S-box inputs are uniform
+        for(int in = 0; in < 256; in++){
+            for(int out = 0; out < 256; out++){
+                if(!m_order && out != sbox[in]) continue;
+                double value = leakage((uint8_t) in, (uint8_t) out);
+                sum += value;
+                sumSq += value * value;
+            }
+        }
+
+        double count = m_order ? 65536.0 : 256.0;
+        double mean = sum / count;
+
+        return sumSq / count - mean * mean;
+
+    }
+
+    size_t m_samples;
+    Model m_model;
+    double m_snr;
+    /// Leakage of a single unit of the model, in 16-bit LSBs
+    int m_gain;
+    /// First sample leaking a share
+    size_t m_leak;
+    /// Distance of the consecutive leaking samples
+    size_t m_spacing;
+    /// Masking order
+    size_t m_order;
+    /// Maximum random time shift of a power trace, in samples
+    size_t m_jitter;
+    uint64_t m_seed;
+
+    uint8_t m_key[16];
+    Aes128 m_aes;
+    uint8_t m_hw[256];
+
+    /// Base waveform and noise
+    TraceSimulation m_simulation;
+    /// Power predictions, 256 for every plaintext byte
+    std::vector<uint8_t> m_predictions;
+
+};
+
+#endif /* SYNTHESIZER_H */
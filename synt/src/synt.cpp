@@ -0,0 +1,520 @@
+/*
+*  SICAK - SIde-Channel Analysis toolKit
+*  Copyright (C) 2018-2019 Petr Socha, FIT, CTU in Prague
+*
+*  This program is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation, either version 3 of the License, or
+*  (at your option) any later version.
+*
+*  This program is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/**
+* \file synt.cpp
+*
+* \brief SICAK SYNThetic traces generator text-based UI
+*
+*
+* \author Petr Socha
+* \version 1.0
+*/
+
+#include <QtGlobal>
+#include <QCoreApplication>
+#include <QTextStream>
+#include <QCommandLineParser>
+#include <QJsonObject>
+#include <QJsonDocument>
+#include <QSaveFile>
+#include <QDateTime>
+#include <QTimer>
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "configloader.hpp"
+#include "global_calls.hpp"
+#include "filehandling.hpp"
+#include "asyncwriter.hpp"
+#include "synt.h"
+
+/// Approximate size of the power traces synthesized at once by a single thread, in bytes
+#define SYNT_CHUNK_SIZE 4194304
+/// Maximum number of power traces synthesized at once by a single thread
+#define SYNT_CHUNK_TRACES 1024
+
+
+Synt::CommandLineParseResult Synt::parseCommandLineParams(QCommandLineParser & parser) {
+
+    QTextStream cout(stdout);
+    QTextStream cerr(stderr);
+
+    // Function options
+
+    const QCommandLineOption idOption({"I", "id"}, "The ID string will be used in output files' filenames. Default value is current datetime.", "string");
+    parser.addOption(idOption);
+
+    const QCommandLineOption functionOption({"F", "function"}, "Select a function: generate random data power traces, plaintexts, ciphertexts and power predictions for a 'cpa', or random and constant data power traces for a 'ttest'.", "cpa|ttest");
+    parser.addOption(functionOption);
+
+    // Output options
+
+    const QCommandLineOption randTracesNOption({"n", "random-traces-count"}, "Number of random data power traces to generate.", "positive integer");
+    parser.addOption(randTracesNOption);
+
+    const QCommandLineOption constTracesMOption({"m", "constant-traces-count"}, "Number of constant data power traces to generate, 'ttest' function only.", "positive integer");
+    parser.addOption(constTracesMOption);
+
+    const QCommandLineOption samplesOption({"s", "samples-per-trace"}, "Number of samples per trace.", "positive integer");
+    parser.addOption(samplesOption);
+
+    const QCommandLineOption sampleTypeOption("sample-type", "Type of the generated samples: int16 (default) or int8.", "int8|int16");
+    parser.addOption(sampleTypeOption);
+
+    const QCommandLineOption compressOption("compress", "Store the power traces into the compressed container.");
+    parser.addOption(compressOption);
+
+    const QCommandLineOption noPredictionsOption("no-predictions", "Do not generate the power predictions, 'cpa' function only.");
+    parser.addOption(noPredictionsOption);
+
+    // Simulation options
+
+    const QCommandLineOption modelOption("model", "Leakage model of the first round S-box: 'hw' Hamming weight of the output (default), 'hd' Hamming distance of the input and output, or 'id' the output itself.", "hw|hd|id");
+    parser.addOption(modelOption);
+
+    const QCommandLineOption snrOption("snr", "Signal to noise ratio: variance of the leakage over variance of the noise, in a leaking sample. Default is 1.", "positive number", "1");
+    parser.addOption(snrOption);
+
+    const QCommandLineOption gainOption("gain", "Leakage of a single unit of the leakage model, in 16-bit LSBs. Default is 200.", "integer", "200");
+    parser.addOption(gainOption);
+
+    const QCommandLineOption leakOption("leak", "First leaking sample. Default is 100.", "integer", "100");
+    parser.addOption(leakOption);
+
+    const QCommandLineOption spacingOption("spacing", "Number of samples between the consecutive leaking samples. Default is 10.", "integer", "10");
+    parser.addOption(spacingOption);
+
+    const QCommandLineOption orderOption("order", "Masking order: every S-box input and output is split into order+1 shares leaking in separate samples. Default is 0 (unmasked).", "integer", "0");
+    parser.addOption(orderOption);
+
+    const QCommandLineOption jitterOption("jitter", "Misalignment: maximum random time shift of a power trace, in samples. Default is 0.", "integer", "0");
+    parser.addOption(jitterOption);
+
+    const QCommandLineOption keyOption("key", "AES-128 key, 32 hex digits. Default is 00112233445566778899AABBCCDDEEFF.", "hex");
+    parser.addOption(keyOption);
+
+    const QCommandLineOption seedOption("seed", "Seed of the generator: the same seed and parameters generate the same data. Default is 0.", "integer", "0");
+    parser.addOption(seedOption);
+
+    const QCommandLineOption threadsOption("threads", "Number of generating threads. Default is the number of CPU cores.", "positive integer");
+    parser.addOption(threadsOption);
+
+    parser.addPositionalArgument("config", "JSON configuration file(s).");
+
+    const QCommandLineOption helpOption = parser.addHelpOption();
+    const QCommandLineOption versionOption = parser.addVersionOption();
+
+    if (!parser.parse(QCoreApplication::arguments()))
+        return CommandLineError;
+
+    if (parser.isSet(versionOption)) return CommandLineVersionRequested;
+    if (parser.isSet(helpOption)) return CommandLineHelpRequested;
+
+    ConfigLoader cfg(parser);
+
+    if(!cfg.isSet(functionOption)) return CommandLineNOP;
+
+    m_id = (cfg.isSet(idOption)) ? (cfg.getParam(idOption)) : ((QDateTime::currentDateTime()).toString("ddMMyy-HHmmss"));
+    m_function = cfg.getParam(functionOption);
+
+    if(m_function != "cpa" && m_function != "ttest"){
+        cerr << "Invalid function: -F, use either cpa or ttest\n";
+        return CommandLineError;
+    }
+
+    if(!cfg.isSet(randTracesNOption) || !cfg.isSet(samplesOption) || (m_function == "ttest" && !cfg.isSet(constTracesMOption))){
+        cerr << "Some of the generator parameters missing: -n, -s are required, and -m for the ttest function\n";
+        return CommandLineError;
+    }
+
+    bool ok, allOk = true;
+
+    m_tracesN = cfg.getParam(randTracesNOption).toULongLong(&ok); allOk = allOk && ok && m_tracesN > 0;
+    m_constTracesM = (m_function == "ttest") ? cfg.getParam(constTracesMOption).toULongLong(&ok) : 0; allOk = allOk && ok && (m_function != "ttest" || m_constTracesM > 0);
+    m_samples = cfg.getParam(samplesOption).toULongLong(&ok); allOk = allOk && ok && m_samples > 0;
+
+    if(!allOk){
+        cerr << "Invalid number of power traces or samples per trace: -n, -m, -s\n";
+        return CommandLineError;
+    }
+
+    m_sampleType = (cfg.isSet(sampleTypeOption)) ? (cfg.getParam(sampleTypeOption)) : "int16";
+
+    if(m_sampleType != "int8" && m_sampleType != "int16"){
+        cerr << "Invalid sample type: --sample-type, use either int8 or int16\n";
+        return CommandLineError;
+    }
+
+    m_compress = cfg.isSet(compressOption);
+    m_predictions = !cfg.isSet(noPredictionsOption);
+
+    QString model = (cfg.isSet(modelOption)) ? (cfg.getParam(modelOption)) : "hw";
+
+    if(model == "hw") m_model = Synthesizer::Model::HW;
+    else if(model == "hd") m_model = Synthesizer::Model::HD;
+    else if(model == "id") m_model = Synthesizer::Model::ID;
+    else {
+        cerr << "Invalid leakage model: --model, use either hw, hd or id\n";
+        return CommandLineError;
+    }
+
+    m_snr = (cfg.isSet(snrOption)) ? cfg.getParam(snrOption).toDouble(&ok) : 1.0; allOk = allOk && ok && m_snr > 0;
+    m_gain = (cfg.isSet(gainOption)) ? cfg.getParam(gainOption).toInt(&ok) : 200; allOk = allOk && ok && m_gain != 0;
+    m_leak = (cfg.isSet(leakOption)) ? cfg.getParam(leakOption).toULongLong(&ok) : 100; allOk = allOk && ok;
+    m_spacing = (cfg.isSet(spacingOption)) ? cfg.getParam(spacingOption).toULongLong(&ok) : 10; allOk = allOk && ok;
+    m_order = (cfg.isSet(orderOption)) ? cfg.getParam(orderOption).toULongLong(&ok) : 0; allOk = allOk && ok && m_order <= SYNTHESIZER_MAX_ORDER;
+    m_jitter = (cfg.isSet(jitterOption)) ? cfg.getParam(jitterOption).toULongLong(&ok) : 0; allOk = allOk && ok;
+    m_seed = (cfg.isSet(seedOption)) ? cfg.getParam(seedOption).toULongLong(&ok) : 0; allOk = allOk && ok;
+
+    if(!allOk){
+        cerr << "Invalid simulation parameter: --snr, --gain, --leak, --spacing, --order (at most 7), --jitter or --seed\n";
+        return CommandLineError;
+    }
+
+    // Default key of the measurement scenarios
+    uint8_t defaultKey[16] = { 0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88, 0x99, 0xAA, 0xBB, 0xCC, 0xDD, 0xEE, 0xFF };
+    std::memcpy(m_key, defaultKey, 16);
+
+    if(cfg.isSet(keyOption)){
+
+        QString key = cfg.getParam(keyOption);
+
+        if(key.size() != 32) allOk = false;
+
+        for(int byte = 0; allOk && byte < 16; byte++){
+            m_key[byte] = (uint8_t) key.mid(2 * byte, 2).toUInt(&ok, 16);
+            allOk = ok;
+        }
+
+        if(!allOk){
+            cerr << "Invalid key: --key, 32 hex digits expected\n";
+            return CommandLineError;
+        }
+
+    }
+
+    m_threads = std::thread::hardware_concurrency();
+    if(cfg.isSet(threadsOption)) m_threads = cfg.getParam(threadsOption).toULongLong(&ok);
+    if(!m_threads) m_threads = 1;
+
+    QTimer::singleShot(0, this, SLOT(generate()));
+        return CommandLineTaskPlanned;
+
+}
+
+void Synt::generate(){
+
+    QTextStream cout(stdout);
+    cout << "Generating power traces...\n";
+    cout.flush();
+
+    if(m_sampleType == "int8"){
+        generateTyped<int8_t>();
+    } else {
+        generateTyped<int16_t>();
+    }
+
+}
+
+template <class T>
+void Synt::generateTyped(){
+
+    QTextStream cout(stdout);
+    QTextStream cerr(stderr);
+
+    bool cpa = (m_function == "cpa");
+
+    Synthesizer * synthesizer;
+
+    // Prepare the waveform, the noise and the predictions
+    try {
+
+        synthesizer = new Synthesizer(m_samples, m_model, m_key, m_snr, m_gain, m_leak, m_spacing, m_order, m_jitter, m_seed);
+
+    } catch (std::exception & e) {
+        cerr << "Failed to initialize the generator: " << e.what() << "\n";
+        emit finished();
+        return;
+    }
+
+    QString keyHex;
+    for(int byte = 0; byte < 16; byte++) keyHex.append(QString("%1").arg((uint) m_key[byte], 2, 16, QChar('0')).toUpper());
+
+    cout << QString("Key is %1, noise standard deviation is %2 LSB, seed is %3\n").arg(keyHex).arg(synthesizer->getNoise()).arg(m_seed);
+
+    if(synthesizer->getLastLeakingSample() + m_jitter >= m_samples){
+        cout << "[!] Some of the leaking samples fall outside of the power traces, increase -s or decrease --leak, --spacing\n";
+    }
+
+    cout.flush();
+
+    QString tracesFilename = "random-traces-";
+    tracesFilename.append(m_id);
+    tracesFilename.append(m_compress ? ".ctr" : ".bin");
+    QString constTracesFilename = "constant-traces-";
+    constTracesFilename.append(m_id);
+    constTracesFilename.append(m_compress ? ".ctr" : ".bin");
+    QString plaintextFilename = "plaintext-";
+    plaintextFilename.append(m_id);
+    plaintextFilename.append(".bin");
+    QString ciphertextFilename = "ciphertext-";
+    ciphertextFilename.append(m_id);
+    ciphertextFilename.append(".bin");
+    QString predictionsFilename = "predictions-";
+    predictionsFilename.append(m_id);
+    predictionsFilename.append(".16prd");
+
+    std::fstream tracesFile, constTracesFile, plaintextFile, ciphertextFile, predictionsFile;
+    QByteArray ba;
+
+    try {
+
+        // Open files
+        ba = tracesFilename.toLocal8Bit();
+        tracesFile = openOutFile(ba.data());
+        ba = plaintextFilename.toLocal8Bit();
+        plaintextFile = openOutFile(ba.data());
+        ba = ciphertextFilename.toLocal8Bit();
+        ciphertextFile = openOutFile(ba.data());
+
+        if(cpa && m_predictions){
+            ba = predictionsFilename.toLocal8Bit();
+            predictionsFile = openOutFile(ba.data());
+        }
+
+        if(!cpa){
+            ba = constTracesFilename.toLocal8Bit();
+            constTracesFile = openOutFile(ba.data());
+        }
+
+        CoutProgress::get().start(m_tracesN + m_constTracesM);
+
+        // Generate
+        generateTraces<T>(*synthesizer, 0, m_tracesN, nullptr, tracesFile, &plaintextFile, &ciphertextFile, (cpa && m_predictions) ? &predictionsFile : nullptr);
+
+        if(!cpa){
+            // Constant plaintext of the measurement scenarios
+            uint8_t constPlaintext[16] = { 0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88, 0x99, 0xAA, 0xBB, 0xCC, 0xDD, 0xEE, 0xFF };
+            generateTraces<T>(*synthesizer, m_tracesN, m_constTracesM, constPlaintext, constTracesFile, nullptr, nullptr, nullptr);
+        }
+
+        CoutProgress::get().finish();
+
+        // Close files
+        closeFile(tracesFile);
+        closeFile(plaintextFile);
+        closeFile(ciphertextFile);
+        if(cpa && m_predictions) closeFile(predictionsFile);
+        if(!cpa) closeFile(constTracesFile);
+
+    } catch (std::exception & e) {
+        cerr << "\nFailed to generate the power traces: " << e.what() << "\n";
+        delete synthesizer;
+        emit finished();
+        return;
+    }
+
+    delete synthesizer;
+
+    // Flush config to json file, ready to be used by stan
+    QJsonObject tracesConf;
+    tracesConf["random-traces"] = tracesFilename;
+    tracesConf["random-traces-count"] = QString::number(m_tracesN);
+    tracesConf["samples-per-trace"] = QString::number(m_samples);
+    tracesConf["sample-type"] = m_sampleType;
+    tracesConf["blocks"] = plaintextFilename;
+    tracesConf["blocks-count"] = QString::number(m_tracesN);
+    tracesConf["blocks-length"] = QString::number(16);
+    tracesConf["ciphertext"] = ciphertextFilename;
+    tracesConf["key"] = keyHex;
+
+    if(cpa && m_predictions){
+        tracesConf["predictions"] = predictionsFilename;
+        tracesConf["prediction-sets-count"] = QString::number(16);
+        tracesConf["prediction-candidates-count"] = QString::number(256);
+    }
+
+    if(!cpa){
+        tracesConf["constant-traces"] = constTracesFilename;
+        tracesConf["constant-traces-count"] = QString::number(m_constTracesM);
+    }
+
+    QJsonDocument tracesDoc(tracesConf);
+    QString tracesDocFilename = m_id;
+    tracesDocFilename.append(".json");
+    QSaveFile tracesDocFile(tracesDocFilename);
+    if(tracesDocFile.open(QIODevice::WriteOnly)){
+        tracesDocFile.write(tracesDoc.toJson());
+        tracesDocFile.commit();
+    }
+
+    cout << QString("Generated %1 random data power traces, %2 samples per trace, saved to '%3',\nrandom plaintext blocks were saved to '%4', related ciphertext blocks were saved to '%5'.\n").arg(m_tracesN).arg(m_samples).arg(tracesFilename).arg(plaintextFilename).arg(ciphertextFilename);
+    if(cpa && m_predictions) cout << QString("16 power prediction sets, each containing 256 power predictions for each of the random plaintext blocks, were saved to '%1'.\n").arg(predictionsFilename);
+    if(!cpa) cout << QString("Generated %1 constant data power traces, saved to '%2'.\n").arg(m_constTracesM).arg(constTracesFilename);
+    cout << QString("Configuration was saved to '%1'.\n").arg(tracesDocFilename);
+
+    emit finished();
+}
+
+template <class T>
+void Synt::generateTraces(const Synthesizer & synthesizer, size_t first, size_t count, const uint8_t * constPlaintext, std::fstream & tracesFile, std::fstream * plaintextFile, std::fstream * ciphertextFile, std::fstream * predictionsFile){
+
+    // Power traces are synthesized in chunks by the worker threads, the calling thread writes the chunks in order
+    struct Chunk {
+        std::vector<T> traces;
+        std::vector<uint8_t> plaintext;
+        std::vector<uint8_t> ciphertext;
+        /// 16 prediction sets, each 256 predictions for every power trace of the chunk
+        std::vector<uint8_t> predictions;
+        bool ready;
+    };
+
+    size_t chunkTraces = SYNT_CHUNK_SIZE / (m_samples * sizeof(T));
+    if(chunkTraces > SYNT_CHUNK_TRACES) chunkTraces = SYNT_CHUNK_TRACES;
+    if(chunkTraces < 1) chunkTraces = 1;
+
+    size_t chunks = (count + chunkTraces - 1) / chunkTraces;
+
+    // Every worker may be synthesizing a chunk, while another one waits to be written
+    std::vector<Chunk> ring(2 * m_threads);
+    for(Chunk & chunk : ring) chunk.ready = false;
+
+    std::atomic<size_t> nextChunk(0);
+    std::mutex mutex;
+    std::condition_variable cond;
+    size_t written = 0;
+    bool failed = false;
+    std::string error;
+
+    auto fail = [&](const char * what){
+        std::lock_guard<std::mutex> lock(mutex);
+        if(error.empty()) error = what;
+        failed = true;
+        cond.notify_all();
+    };
+
+    auto work = [&](){
+
+        for(;;){
+
+            size_t chunk = nextChunk++;
+            if(chunk >= chunks) return;
+
+            Chunk & slot = ring[chunk % ring.size()];
+
+            {
+                // Wait for the slot to be written
+                std::unique_lock<std::mutex> lock(mutex);
+                cond.wait(lock, [&]{ return failed || chunk < written + ring.size(); });
+                if(failed) return;
+            }
+
+            try {
+
+                size_t traces = (chunk == chunks - 1) ? count - chunk * chunkTraces : chunkTraces;
+
+                slot.traces.resize(traces * m_samples);
+                slot.plaintext.resize(traces * 16);
+                slot.ciphertext.resize(traces * 16);
+                if(predictionsFile != nullptr) slot.predictions.resize(16 * traces * 256);
+
+                for(size_t trace = 0; trace < traces; trace++){
+
+                    synthesizer.synthesize<T>(first + chunk * chunkTraces + trace, constPlaintext, &(slot.traces[trace * m_samples]), &(slot.plaintext[trace * 16]), &(slot.ciphertext[trace * 16]));
+
+                    if(predictionsFile != nullptr){
+                        for(size_t byte = 0; byte < 16; byte++){
+                            std::memcpy(&(slot.predictions[(byte * traces + trace) * 256]), synthesizer.predictions(slot.plaintext[trace * 16 + byte]), 256);
+                        }
+                    }
+
+                }
+
+            } catch (std::exception & e) {
+                fail(e.what());
+                return;
+            }
+
+            std::lock_guard<std::mutex> lock(mutex);
+            slot.ready = true;
+            cond.notify_all();
+
+        }
+
+    };
+
+    std::vector<std::thread> workers;
+    for(size_t i = 0; i < m_threads; i++) workers.emplace_back(work);
+
+    TracesFileWriter<T> tracesWriter(tracesFile, m_samples, m_compress);
+
+    for(size_t chunk = 0; chunk < chunks; chunk++){
+
+        Chunk & slot = ring[chunk % ring.size()];
+
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            cond.wait(lock, [&]{ return failed || slot.ready; });
+            if(failed) break;
+        }
+
+        try {
+
+            size_t traces = slot.plaintext.size() / 16;
+
+            tracesWriter.write(slot.traces.data(), traces);
+            if(plaintextFile != nullptr) writeArrayToFile(*plaintextFile, slot.plaintext.data(), slot.plaintext.size());
+            if(ciphertextFile != nullptr) writeArrayToFile(*ciphertextFile, slot.ciphertext.data(), slot.ciphertext.size());
+
+            if(predictionsFile != nullptr){
+                // Prediction sets are stored one after another, every set holds the predictions for all the power traces
+                for(size_t byte = 0; byte < 16; byte++){
+                    predictionsFile->seekp((byte * count + chunk * chunkTraces) * 256);
+                    writeArrayToFile(*predictionsFile, &(slot.predictions[byte * traces * 256]), traces * 256);
+                }
+            }
+
+        } catch (std::exception & e) {
+            fail(e.what());
+            break;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            slot.ready = false;
+            written = chunk + 1;
+            cond.notify_all();
+        }
+
+        CoutProgress::get().update(first + chunk * chunkTraces);
+
+    }
+
+    for(std::thread & worker : workers) worker.join();
+
+    if(!error.empty()) throw RuntimeException(error.c_str());
+
+    tracesWriter.close();
+
+}
@@ -0,0 +1,35 @@
+!include( ../sicak.pri ) {
+  error( "Couldn't find the sicak.pri file!" )
+}
+
+unix { 
+    # enable more agressive optimization, the synthesis needs to get vectorized
+    QMAKE_CXXFLAGS_RELEASE -= -O2
+    QMAKE_LFLAGS_RELEASE -= -O2
+    
+    QMAKE_CXXFLAGS_RELEASE += -O3
+    QMAKE_LFLAGS_RELEASE += -O3
+}
+
+INCLUDEPATH    += ./include \
+                  ../plugins/common \
+                  ../plugins/measurement/common
+CONFIG += console
+QT -= gui
+
+HEADERS += include/synt.h \
+           include/synthesizer.hpp
+SOURCES    = src/main.cpp \
+             src/synt.cpp
+
+TARGET     = synt
+QMAKE_PROJECT_NAME = synt
+
+DESTDIR    = ./bin
+
+# install
+target.path = ../INSTALL
+INSTALLS += target
+
+CONFIG += install_ok  # Do not cargo-cult this!
+ 
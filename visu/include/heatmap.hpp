@@ -0,0 +1,124 @@
+/*
+*  SICAK - SIde-Channel Analysis toolKit
+*  Copyright (C) 2018-2019 Petr Socha, FIT, CTU in Prague
+*
+*  This program is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation, either version 3 of the License, or
+*  (at your option) any later version.
+*
+*  This program is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/**
+* \file heatmap.hpp
+*
+* \brief Rasterization of correlation matrices or t-values into heatmaps, used by the SICAK VISUalisation
+*
+*
+* \author Petr Socha
+* \version 1.0
+*/
+
+#ifndef HEATMAP_H
+#define HEATMAP_H
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include "seriespyramid.hpp"
+
+/// Returns the one of the values with the larger magnitude, a NaN loses
+inline float maxAbs(float a, float b) {
+    return (std::fabs(b) > std::fabs(a) || a != a) ? b : a;
+}
+
+/// Returns the extreme of the larger magnitude (signed), given the minimum and the maximum of some values. NaN when there were NaNs only, see minMaxOfRange
+inline float maxAbsOfMinMax(float min, float max) {
+
+    if(!(min <= max)) return std::numeric_limits<float>::quiet_NaN();
+
+    return (max >= -min) ? max : min;
+
+}
+
+/// Returns the value of the largest magnitude (signed) among 'len' values, see minMaxOfRange. NaNs are skipped
+inline float maxAbsOfRange(const float * values, size_t len) {
+
+    float min, max;
+    minMaxOfRange(values, len, min, max);
+
+    return maxAbsOfMinMax(min, max);
+
+}
+
+/// Downsamples the values to 'columns' pixel columns, column c being the value of the largest magnitude among the samples [first[c]..last[c]). Columns without samples are NaN
+inline void heatmapColumns(const float * values, const size_t * first, const size_t * last, size_t columns, float * out) {
+
+    for(size_t c = 0; c < columns; c++) out[c] = maxAbsOfRange(values + first[c], last[c] - first[c]);
+
+}
+
+/**
+* \brief Downsamples the series to 'columns' pixel columns using the series pyramid, see heatmapColumns. The columns are summarized from the coarsest level having a pyramid bucket per column at least,
+* regardless of the number of samples. Returns false when a column has less samples than a bucket of the finest level of the pyramid, the samples themselves are to be downsampled then.
+*/
+inline bool pyramidHeatmapColumns(const SeriesPyramid & pyramid, size_t series, const size_t * first, const size_t * last, size_t columns, float * out) {
+
+    size_t narrowest = std::numeric_limits<size_t>::max();
+    for(size_t c = 0; c < columns; c++){
+        if(last[c] > first[c] && last[c] - first[c] < narrowest) narrowest = last[c] - first[c];
+    }
+
+    if(narrowest < pyramid.bucketSamples(0)) return false;
+
+    const size_t level = pyramid.levelOf(narrowest);
+
+    for(size_t c = 0; c < columns; c++){
+
+        if(last[c] <= first[c]){
+            out[c] = std::numeric_limits<float>::quiet_NaN();
+            continue;
+        }
+
+        float min, max;
+        pyramid.minMax(series, level, first[c], last[c], min, max);
+
+        out[c] = maxAbsOfMinMax(min, max);
+
+    }
+
+    return true;
+
+}
+
+/// Returns the color (0xAARRGGBB) of the value in a diverging color map: -scale blue, zero white, +scale red. NaN is grey
+inline uint32_t heatmapColor(float value, float scale) {
+
+    if(value != value) return 0xff808080;
+
+    float t = (scale > 0) ? value / scale : 0.0f;
+    t = (t > 1.0f) ? 1.0f : ((t < -1.0f) ? -1.0f : t);
+
+    // White towards red (178, 24, 43) or blue (33, 102, 172)
+    const float a = std::fabs(t);
+    const float r = (t > 0) ? 178.0f : 33.0f;
+    const float g = (t > 0) ? 24.0f : 102.0f;
+    const float b = (t > 0) ? 43.0f : 172.0f;
+
+    const uint32_t red = (uint32_t) (255.0f + (r - 255.0f) * a + 0.5f);
+    const uint32_t green = (uint32_t) (255.0f + (g - 255.0f) * a + 0.5f);
+    const uint32_t blue = (uint32_t) (255.0f + (b - 255.0f) * a + 0.5f);
+
+    return 0xff000000 | (red << 16) | (green << 8) | blue;
+
+}
+
+#endif /* HEATMAP_H */
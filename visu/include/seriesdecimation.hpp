@@ -0,0 +1,171 @@
+/*
+*  SICAK - SIde-Channel Analysis toolKit
+*  Copyright (C) 2018-2019 Petr Socha, FIT, CTU in Prague
+*
+*  This program is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU General Public License as published by
+*  the Free Software Foundation, either version 3 of the License, or
+*  (at your option) any later version.
+*
+*  This program is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU General Public License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/**
+* \file seriesdecimation.hpp
+*
+* \brief Min/max decimation of long series for plotting, used by the SICAK VISUalisation
+*
+*
+* \author Petr Socha
+* \version 1.0
+*/
+
+#ifndef SERIESDECIMATION_H
+#define SERIESDECIMATION_H
+
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <vector>
+#include "seriespyramid.hpp"
+
+/// Number of samples the extremes are searched in at once
+#define SERIESDECIMATION_BLOCK 64
+
+/**
+* \brief Selects the samples of values[first..last) to be plotted: the minimum and the maximum of every one of 'buckets' buckets, in their original order.
+* A line thru the selected samples covers the same pixels as a line thru all the samples, when there is a bucket per pixel column.
+* When there are no more than 2 samples per bucket, all the samples are selected. The indices of the selected samples are stored into 'selected'.
+*/
+inline void minMaxDecimate(const float * values, size_t first, size_t last, size_t buckets, std::vector<size_t> & selected) {
+
+    selected.clear();
+
+    if(last <= first) return;
+
+    const size_t len = last - first;
+
+    if(!buckets || len <= 2 * buckets){
+        for(size_t i = first; i < last; i++) selected.push_back(i);
+        return;
+    }
+
+    for(size_t bucket = 0; bucket < buckets; bucket++){
+
+        const size_t bucketFirst = first + (len * bucket) / buckets;
+        const size_t bucketLast = first + (len * (bucket + 1)) / buckets;
+
+        // Extremes of the blocks of the bucket, vectorized, then the positions within the blocks holding them
+        const float inf = std::numeric_limits<float>::infinity();
+        float min = inf, max = -inf;
+        size_t minBlock = bucketFirst, maxBlock = bucketFirst;
+
+        for(size_t block = bucketFirst; block < bucketLast; block += SERIESDECIMATION_BLOCK){
+
+            const size_t blockLen = (bucketLast - block < SERIESDECIMATION_BLOCK) ? bucketLast - block : SERIESDECIMATION_BLOCK;
+            float blockMin, blockMax;
+            minMaxOfRange(values + block, blockLen, blockMin, blockMax);
+
+            if(blockMin < min){
+                min = blockMin;
+                minBlock = block;
+            }
+            if(blockMax > max){
+                max = blockMax;
+                maxBlock = block;
+            }
+
+        }
+
+        size_t minAt = bucketLast, maxAt = bucketLast;
+        for(size_t i = minBlock; i < bucketLast; i++) if(values[i] == min){ minAt = i; break; }
+        for(size_t i = maxBlock; i < bucketLast; i++) if(values[i] == max){ maxAt = i; break; }
+
+        // All NaNs
+        if(minAt == bucketLast || maxAt == bucketLast){
+            selected.push_back(bucketFirst);
+            continue;
+        }
+
+        if(minAt == maxAt){
+            selected.push_back(minAt);
+        } else if(minAt < maxAt){
+            selected.push_back(minAt);
+            selected.push_back(maxAt);
+        } else {
+            selected.push_back(maxAt);
+            selected.push_back(minAt);
+        }
+
+    }
+
+}
+
+/// A point of a decimated series, the position is in samples
+struct DecimatedPoint {
+    double position;
+    float value;
+};
+
+/**
+* \brief Decimates the samples [first..last) of the series to the minimum and the maximum of every one of 'buckets' buckets, placed in the middle of the bucket, using the series pyramid.
+* The buckets are summarized from the coarsest level having at least a pyramid bucket per bucket, so that just a few pyramid buckets are read per bucket, regardless of the range.
+* Returns false when there are less samples per bucket than per a bucket of the finest level of the pyramid, the samples themselves are to be decimated then.
+*/
+inline bool pyramidDecimate(const SeriesPyramid & pyramid, size_t series, size_t first, size_t last, size_t buckets, std::vector<DecimatedPoint> & points) {
+
+    points.clear();
+
+    if(last <= first || !buckets) return false;
+
+    const size_t len = last - first;
+    const size_t samplesPerBucket = len / buckets;
+
+    if(samplesPerBucket < pyramid.bucketSamples(0)) return false;
+
+    const size_t level = pyramid.levelOf(samplesPerBucket);
+
+    bool hasPrevious = false;
+    float previous = 0;
+
+    for(size_t bucket = 0; bucket < buckets; bucket++){
+
+        const size_t bucketFirst = first + (len * bucket) / buckets;
+        const size_t bucketLast = first + (len * (bucket + 1)) / buckets;
+
+        float min, max;
+        pyramid.minMax(series, level, bucketFirst, bucketLast, min, max);
+
+        // NaNs only
+        if(!(min <= max)) continue;
+
+        const double position = 0.5 * (bucketFirst + bucketLast - 1);
+
+        if(min == max){
+            points.push_back({position, min});
+            previous = min;
+        } else if(hasPrevious && std::fabs(previous - max) < std::fabs(previous - min)){ // the line continues from the nearer extreme
+            points.push_back({position, max});
+            points.push_back({position, min});
+            previous = min;
+        } else {
+            points.push_back({position, min});
+            points.push_back({position, max});
+            previous = max;
+        }
+
+        hasPrevious = true;
+
+    }
+
+    return true;
+
+}
+
+#endif /* SERIESDECIMATION_H */
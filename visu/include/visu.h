@@ -31,14 +31,19 @@
 
 #include <QObject>
 #include <QCommandLineParser>
+#include <QFile>
 #include <QtCharts/QChartView>
 #include <QtCharts/QLineSeries>
 #include <QtCharts/QValueAxis>
+#include <QGraphicsPixmapItem>
+#include <memory>
+#include <vector>
 
 QT_CHARTS_USE_NAMESPACE
 
 #include "blockprocess.h"
 #include "tracesprocess.h"
+#include "seriespyramid.hpp"
 
 /**
 * \class Visu
@@ -72,7 +77,34 @@ public:
         QString color;
     };
     
-    Visu(QObject *parent = 0) : QObject(parent), m_display(false), m_save(false), m_filepath(""), m_width(800), m_height(400), m_title(""), m_tracesSet(false), m_traces(""), m_tracesN(0), m_tracesRangeSet(false), m_tracesRange(0), m_tValsSet(false), m_tValues(""), m_correlationsSet(false), m_correlations(""), m_correlationsSetsQ(0), m_correlationsCandidatesK(0), m_samplesPerTrace(0), m_samplesRangeSet(false), m_samplesRange(0.0f), m_plotTVals(false), m_tValsColor("auto"), m_chart(nullptr), m_axisX(nullptr), m_axisYtraces(nullptr), m_axisYcorrs(nullptr), m_axisYtvals(nullptr) {}
+    /// Location of the values of a series in a file
+    struct SeriesFile {
+        QString path;
+        size_t offset;      //< position of the first value in bytes, in a raw file
+        size_t valueSize;   //< 1 or 2 for int8 or int16 power samples, 8 for doubles
+        bool compressed;    //< compressed power traces container, holding the power trace 'trace'
+        size_t trace;
+        double scale;       //< values are multiplied by the scale when plotted
+    };
+    
+    /// A plotted series along with all its values, the series holds only the decimated ones. A series summarized by a pyramid keeps no values, they are read from the file when zoomed in beyond the pyramid
+    struct DecimatedSeries {
+        QLineSeries * series;
+        std::vector<float> values;
+        const SeriesPyramid * pyramid;
+        size_t pyramidSeries;
+        SeriesFile file;
+    };
+    
+    /// A row of the heatmap along with all its values. A row summarized by a pyramid keeps no values, they are read from the file when zoomed in beyond the pyramid
+    struct HeatmapRow {
+        std::vector<float> values;
+        const SeriesPyramid * pyramid;
+        size_t pyramidSeries;
+        SeriesFile file;
+    };
+    
+    Visu(QObject *parent = 0) : QObject(parent), m_display(false), m_save(false), m_filepath(""), m_width(800), m_height(400), m_title(""), m_tracesSet(false), m_traces(""), m_tracesN(0), m_sampleType("int16"), m_tracesRangeSet(false), m_tracesRange(0), m_tValsSet(false), m_tValues(""), m_correlationsSet(false), m_correlations(""), m_correlationsSetsQ(0), m_correlationsCandidatesK(0), m_samplesPerTrace(0), m_samplesRangeSet(false), m_samplesRange(0.0f), m_originalSamplesPerTrace(0), m_plotTVals(false), m_tValsColor("auto"), m_chart(nullptr), m_axisX(nullptr), m_axisYtraces(nullptr), m_axisYcorrs(nullptr), m_axisYtvals(nullptr), m_sampleInterval(1.0), m_pyramid(false), m_heatmap(false), m_heatmapScale(0.0f), m_axisYrows(nullptr), m_heatmapItem(nullptr) {}
     
     /// Parse parameters from the command line and configuration files
     CommandLineParseResult parseCommandLineParams(QCommandLineParser & parser);    
@@ -90,6 +122,7 @@ protected:
     bool m_tracesSet;
     QString m_traces;
     size_t m_tracesN;
+    QString m_sampleType;
     bool m_tracesRangeSet;
     double m_tracesRange;
     
@@ -104,6 +137,9 @@ protected:
     size_t m_samplesPerTrace;
     bool m_samplesRangeSet;
     double m_samplesRange;
+    /// Original positions of the samples, e.g. of the points of interest selected by the poi plug-in module, empty when not set
+    std::vector<size_t> m_sampleIndices;
+    size_t m_originalSamplesPerTrace;
     
     // Series arguments
     bool m_plotTVals;
@@ -119,6 +155,48 @@ protected:
     QValueAxis * m_axisYcorrs;
     QValueAxis * m_axisYtvals;
     
+    // Series values, decimated to the plot width
+    std::vector<DecimatedSeries> m_decimatedSeries;
+    double m_sampleInterval;
+    
+    // Series pyramids, memory-mapped from the sidecar files
+    bool m_pyramid;
+    std::vector<std::unique_ptr<SeriesPyramid>> m_pyramids;
+    
+    // Heatmap of the correlation traces or t-values, rasterized to the plot area
+    bool m_heatmap;
+    std::vector<HeatmapRow> m_heatmapRows;
+    float m_heatmapScale;
+    QValueAxis * m_axisYrows;
+    QGraphicsPixmapItem * m_heatmapItem;
+    
+    /// Returns the position of the (fractional) sample on the samples axis, the original position when the sample indices are set
+    double sampleToAxis(double sample) const;
+    /// Returns the sample at the position on the samples axis, fractional, or the first sample at or beyond the position when the sample indices are set
+    double axisToSample(double position) const;
+    /// Returns the sample nearest to the position on the samples axis; when the sample indices are set, -1 unless a sample lies at the nearest original position
+    double nearestSample(double position) const;
+    /// Adds a series to the chart, its values are plotted decimated
+    void addDecimatedSeries(QLineSeries * series, std::vector<float> & values);
+    /// Adds a series summarized by the pyramid to the chart, its values are read from the file only when zoomed in beyond the pyramid
+    void addPyramidSeries(QLineSeries * series, const SeriesPyramid * pyramid, size_t pyramidSeries, const SeriesFile & file);
+    /// Returns the pyramid of the file holding at least 'noOfSeries' series, memory-mapped from its sidecar file, or nullptr. With --pyramid, missing or outdated sidecar file gets created first
+    const SeriesPyramid * openPyramid(const QString & file, size_t noOfSeries, size_t valueSize);
+    /// Creates the pyramid sidecar file of the first 'noOfSeries' series of the file, in a single pass
+    template <class T>
+    void createPyramid(const QString & file, const QString & pyramidFile, size_t noOfSeries);
+    /// Reads the values [first..last) of the series from the file, scaled
+    void readSeriesFile(const SeriesFile & file, size_t first, size_t last, std::vector<float> & values) const;
+    /// Reads the values of type T, see readSeriesFile
+    template <class T>
+    void readSeriesFileTyped(const SeriesFile & file, size_t first, size_t last, std::vector<float> & values) const;
+    /// Sets the series to the min/max decimated values within the samples axis range, 'buckets' being the plot width in pixels
+    void decimateSeries(double from, double to, size_t buckets);
+    /// Creates the heatmap of the correlation traces or t-values, a row per series, instead of plotting the series
+    bool createHeatmap();
+    /// Rasterizes the heatmap rows within the axes ranges into the plot area, the samples of a pixel being downsampled to the value of the largest magnitude
+    void rasterizeHeatmap();
+    
 public slots:
     
     /// Creates a chart based on the parameters set by parseCommandLineParams
@@ -130,6 +208,10 @@ public slots:
     bool shouldDisplay() const { return m_display; }
     bool shouldSave() const { return m_save; }
     QChartView * getChartView() const;
+    /// Decimates the series again from all the values, when the samples axis range changes (zoom)
+    void samplesRangeChanged(qreal min, qreal max);
+    /// Rasterizes the heatmap again, when the plot area or the axes ranges change (resize, zoom)
+    void heatmapChanged();
     
 signals:
     
@@ -34,12 +34,22 @@
 #include <QtCharts/QLineSeries>
 #include <QtCharts/QValueAxis>
 #include <QSvgGenerator>
+#include <QFileInfo>
+#include <QImage>
+#include <QPen>
+#include <algorithm>
+#include <cmath>
+#include <future>
+#include <limits>
+#include <vector>
 
 QT_CHARTS_USE_NAMESPACE
 
 #include "configloader.hpp"
 #include "global_calls.hpp"
 #include "filehandling.hpp"
+#include "seriesdecimation.hpp"
+#include "heatmap.hpp"
 #include "visu.h"
 
 
@@ -64,12 +74,15 @@ Visu::CommandLineParseResult Visu::parseCommandLineParams(QCommandLineParser & p
     const QCommandLineOption titleOption({"T", "title"}, "Chart title", "string");
     parser.addOption(titleOption);    
     
-    const QCommandLineOption tracesOption({"t", "traces"}, "File containing -n traces, each of which containing -s samples (int16).", "filepath");
+    const QCommandLineOption tracesOption({"t", "traces"}, "File containing -n traces, each of which containing -s samples (int16 or int8, see --sample-type; raw or compressed container).", "filepath");
     parser.addOption(tracesOption);    
     
     const QCommandLineOption tracesNOption({"n", "traces-count"}, "Number of power traces in -t file.", "positive integer");
     parser.addOption(tracesNOption);    
     
+    const QCommandLineOption sampleTypeOption("sample-type", "Type of samples in raw power traces files: int16 (default) or int8. Compressed power traces files declare the sample type themselves.", "int8|int16");
+    parser.addOption(sampleTypeOption);    
+    
     const QCommandLineOption tracesRangeOption({"r", "traces-real-range"}, "Maximum positive value of a power sample in mV, e.g. 2000 for range -2V to +2V.", "positive integer");
     parser.addOption(tracesRangeOption);        
         
@@ -90,10 +103,22 @@ Visu::CommandLineParseResult Visu::parseCommandLineParams(QCommandLineParser & p
     
     const QCommandLineOption sampleRangeOption({"b", "samples-real-range"}, "Time of a single power/correlation trace. Given sampling period T and -s samples, this value would be T*(s-1).", "float number");
     parser.addOption(sampleRangeOption);
+    
+    const QCommandLineOption sampleIndicesOption("sample-indices", "Original positions of the -s samples, comma separated in ascending order, e.g. of the points of interest selected by the poi plug-in module. The samples are plotted at their original positions.", "list");
+    parser.addOption(sampleIndicesOption);
+    
+    const QCommandLineOption originalSamplesOption("original-samples-per-trace", "Number of samples per trace before the samples were selected, see --sample-indices. Default is the last index plus one.", "positive integer");
+    parser.addOption(originalSamplesOption);
+    
+    const QCommandLineOption pyramidOption("pyramid", "Create the min/max pyramid sidecar files (<file>.pyr) of the -t, -c and -a files, unless they are up to date. Up to date pyramids are always used, so that the files are plotted and zoomed without being read whole.");
+    parser.addOption(pyramidOption);
+    
+    const QCommandLineOption heatmapOption("heatmap", "Plot the correlation traces or the t-values as rows of a heatmap, colored by the value of the largest magnitude within each pixel, instead of plotting them as lines.");
+    parser.addOption(heatmapOption);
 
     parser.addPositionalArgument("config", "JSON configuration file(s) with Options.");    
                                       
-    parser.addPositionalArgument("series", "Time series to plot: e.g. \"t,25,blue\" plots 26th power trace from traces file, \"c,0,255,red\" plots 255th correlation trace from the 1st correlation matrix, \"c,0,all,#bbbbbb\" plots all of them, \"v,pink\" plots t-values from t-values file. Color is optional, otherwise automatically selected.");
+    parser.addPositionalArgument("series", "Time series to plot: e.g. \"t,25,blue\" plots 26th power trace from traces file, \"c,0,255,red\" plots 255th correlation trace from the 1st correlation matrix, \"c,0,all,#bbbbbb\" plots all of them, \"c,all,all\" plots all the correlation traces, \"v,pink\" plots t-values from t-values file. Color is optional, otherwise automatically selected.");
     
     const QCommandLineOption helpOption = parser.addHelpOption();
     const QCommandLineOption versionOption = parser.addVersionOption();        
@@ -136,7 +161,13 @@ Visu::CommandLineParseResult Visu::parseCommandLineParams(QCommandLineParser & p
         }
         
         m_tracesN = cfg.getParam(tracesNOption).toLongLong();
-        m_samplesPerTrace = cfg.getParam(samplesOption).toLongLong();                                                
+        m_samplesPerTrace = cfg.getParam(samplesOption).toLongLong();
+        m_sampleType = (cfg.isSet(sampleTypeOption)) ? cfg.getParam(sampleTypeOption) : "int16";
+        
+        if(m_sampleType != "int8" && m_sampleType != "int16"){
+            cerr << "Invalid sample type: --sample-type, use either int8 or int16\n";
+            return CommandLineError;
+        }                                                
             
     }        
     
@@ -174,8 +205,31 @@ Visu::CommandLineParseResult Visu::parseCommandLineParams(QCommandLineParser & p
     
     m_tracesRangeSet = cfg.isSet(tracesRangeOption) ? true : false;
     m_tracesRange = m_tracesRangeSet ? (cfg.getParam(tracesRangeOption).toDouble() / 1000.0) : (double)32768.0;         
+    if(cfg.isSet(sampleIndicesOption)){
+        
+        bool ok;
+        m_sampleIndices = cfg.getIndicesParam(sampleIndicesOption, ok);
+        
+        for(size_t i = 1; i < m_sampleIndices.size(); i++) ok = ok && m_sampleIndices[i] > m_sampleIndices[i - 1];
+        
+        m_originalSamplesPerTrace = (cfg.isSet(originalSamplesOption)) ? cfg.getParam(originalSamplesOption).toULongLong() : m_sampleIndices.back() + 1;
+        
+        if(!ok || m_originalSamplesPerTrace <= m_sampleIndices.back()){
+            cerr << "Invalid sample indices: --sample-indices, use ascending sample positions below --original-samples-per-trace\n";
+            return CommandLineError;
+        }
+        
+        if(m_sampleIndices.size() != m_samplesPerTrace){
+            cerr << "Number of the sample indices (--sample-indices) does not match the number of samples per trace (-s)\n";
+            return CommandLineError;
+        }
+        
+    }
+    
     m_samplesRangeSet = cfg.isSet(sampleRangeOption) ? true : false;
-    m_samplesRange = m_samplesRangeSet ? cfg.getParam(sampleRangeOption).toDouble() : (double)m_samplesPerTrace;
+    m_samplesRange = m_samplesRangeSet ? cfg.getParam(sampleRangeOption).toDouble() : (double)(m_sampleIndices.empty() ? m_samplesPerTrace : m_originalSamplesPerTrace);
+    m_pyramid = cfg.isSet(pyramidOption) ? true : false;
+    m_heatmap = cfg.isSet(heatmapOption) ? true : false;
     
     // parse series arguments
     const QStringList positionalArguments = parser.positionalArguments();
@@ -227,36 +281,50 @@ Visu::CommandLineParseResult Visu::parseCommandLineParams(QCommandLineParser & p
             
             CorrelationTraceSeries corrTraceStr;
             
-            corrTraceStr.matrixNo = params[1].toLongLong();      
+            size_t firstMatrix = 0;
+            size_t lastMatrix = m_correlationsSetsQ;
             
-            if(corrTraceStr.matrixNo >= m_correlationsSetsQ){
-                cerr << "Number of correlation matrix out of range\n";
-                return CommandLineError;
-            }                        
+            if(params[1].compare("all")){
+                
+                firstMatrix = params[1].toLongLong();
+                lastMatrix = firstMatrix + 1;
+            
+                if(firstMatrix >= m_correlationsSetsQ){
+                    cerr << "Number of correlation matrix out of range\n";
+                    return CommandLineError;
+                }                        
+                
+            }
             
             corrTraceStr.color = (params.size() >= 4) ? params[3] : "auto";
             
-            if(!(params[2].compare("all"))){
+            for(size_t matrix = firstMatrix; matrix < lastMatrix; matrix++){
                 
-                for(size_t candidate = 0; candidate < m_correlationsCandidatesK; candidate++){
-                 
-                    corrTraceStr.candidateNo = candidate;
+                corrTraceStr.matrixNo = matrix;
+            
+                if(!(params[2].compare("all"))){
                     
-                    m_correlationTracesToPlot.append(corrTraceStr);
+                    for(size_t candidate = 0; candidate < m_correlationsCandidatesK; candidate++){
+                     
+                        corrTraceStr.candidateNo = candidate;
+                        
+                        m_correlationTracesToPlot.append(corrTraceStr);
+                        
+                    }
                     
-                }
-                
-            } else {
+                } else {
+                    
+                    corrTraceStr.candidateNo = params[2].toLongLong();
                 
-                corrTraceStr.candidateNo = params[2].toLongLong();
-            
-                if(corrTraceStr.candidateNo >= m_correlationsCandidatesK){
-                    cerr << "Number of key candidate out of range\n";
-                    return CommandLineError;
+                    if(corrTraceStr.candidateNo >= m_correlationsCandidatesK){
+                        cerr << "Number of key candidate out of range\n";
+                        return CommandLineError;
+                    }
+                    
+                    m_correlationTracesToPlot.append(corrTraceStr);
+                    
                 }
                 
-                m_correlationTracesToPlot.append(corrTraceStr);
-                
             }
             
             
@@ -281,6 +349,11 @@ Visu::CommandLineParseResult Visu::parseCommandLineParams(QCommandLineParser & p
         return CommandLineNOP;
     }
     
+    if(m_heatmap && (m_powerTracesToPlot.size() || (m_plotTVals && m_correlationTracesToPlot.size()))){
+        cerr << "Heatmap plots either the correlation traces, or the t-values: --heatmap\n";
+        return CommandLineError;
+    }
+    
     return CommandLineProcessChart;
                     
 }
@@ -306,6 +379,10 @@ bool Visu::createChart(){
     m_axisX->setLabelFormat("%g");
     m_axisX->setRange(0, m_samplesRange);
     m_chart->addAxis(m_axisX, Qt::AlignBottom);    
+    
+    m_sampleInterval = m_samplesRange / (double)(m_sampleIndices.empty() ? m_samplesPerTrace : m_originalSamplesPerTrace);
+    
+    if(m_heatmap) return createHeatmap();
  
     // Voltage/ADV axis
     if(m_powerTracesToPlot.size()) {
@@ -361,7 +438,7 @@ bool Visu::createChart(){
         
     }
     
-    double sampleInterval = m_samplesRange / (double)m_samplesPerTrace;
+    m_decimatedSeries.clear();
         
     // Power traces to plot
     if(m_powerTracesToPlot.size()) {
@@ -378,34 +455,100 @@ bool Visu::createChart(){
             return false;
         }
         
-        Vector<int16_t> powerTrace;        
+        // Compressed power traces files declare the sample type, raw ones rely on --sample-type
+        size_t sampleSize = getDeclaredSampleSize(tracesFile);
+        if(!sampleSize) sampleSize = (m_sampleType == "int8") ? sizeof(int8_t) : sizeof(int16_t);
+        const bool int8Samples = (sampleSize == sizeof(int8_t));
+        const double fullScale = int8Samples ? 128.0 : 32768.0;
+        
         double max = -m_tracesRange;
         double min = m_tracesRange;
         
-        foreach (const PowerTraceSeries & serie, m_powerTracesToPlot) {
-                    
+        // Power traces summarized by the pyramid are not loaded
+        const SeriesPyramid * pyramid = openPyramid(m_traces, m_tracesN, sampleSize);
+        
+        SeriesFile file;
+        file.path = m_traces;
+        file.valueSize = sampleSize;
+        file.compressed = isCompressedTracesFile(tracesFile);
+        file.scale = m_tracesRange / fullScale;
+        
+        // Other power traces are loaded at once, each of them once, in the order of the file
+        std::vector<size_t> traces;
+        std::vector<int16_t> powerTraces;
+        std::vector<int8_t> powerTraces8;
+        
+        if(!pyramid) {
+            
+            foreach (const PowerTraceSeries & serie, m_powerTracesToPlot) {
+                traces.push_back(serie.traceNo);
+            }
+            
+            std::sort(traces.begin(), traces.end());
+            traces.erase(std::unique(traces.begin(), traces.end()), traces.end());
+            
             try {
-                powerTrace = loadPowerTraceFromFile<int16_t>(tracesFile, m_samplesPerTrace, serie.traceNo);
+                QByteArray ba = m_traces.toLocal8Bit();
+                if(int8Samples){
+                    powerTraces8.resize(traces.size() * m_samplesPerTrace);
+                    loadPowerTracesFromFile<int8_t>(ba.data(), m_samplesPerTrace, traces, powerTraces8.data());
+                } else {
+                    powerTraces.resize(traces.size() * m_samplesPerTrace);
+                    loadPowerTracesFromFile<int16_t>(ba.data(), m_samplesPerTrace, traces, powerTraces.data());
+                }
             } catch (std::exception & e) {
-                cerr << "Failed to read the power trace: " << e.what() << "\n";
+                cerr << "Failed to read the power traces: " << e.what() << "\n";
                 return false;
-            }                        
+            }
+            
+        }
+        
+        foreach (const PowerTraceSeries & serie, m_powerTracesToPlot) {
+            
+            if(pyramid) {
+                
+                file.offset = sampleSize * m_samplesPerTrace * serie.traceNo;
+                file.trace = serie.traceNo;
+                
+                const SeriesPyramidBucket & summary = pyramid->summary(serie.traceNo);
+                if(summary.max * file.scale > max) max = summary.max * file.scale;
+                if(summary.min * file.scale < min) min = summary.min * file.scale;
+                
+                QLineSeries * series = new QLineSeries();
+                
+                if(serie.color.compare("auto") != 0) {
+                    series->setColor(serie.color);
+                }
+                
+                addPyramidSeries(series, pyramid, serie.traceNo, file);
+                series->attachAxis(m_axisX);
+                series->attachAxis(m_axisYtraces);
+                
+                continue;
+                
+            }
+                    
+            const size_t loaded = std::lower_bound(traces.begin(), traces.end(), serie.traceNo) - traces.begin();
+            const int16_t * powerTrace = powerTraces.data() + loaded * m_samplesPerTrace;
+            const int8_t * powerTrace8 = powerTraces8.data() + loaded * m_samplesPerTrace;
             
             QLineSeries * series = new QLineSeries();
+            std::vector<float> values(m_samplesPerTrace);
             
             for(size_t i = 0; i < m_samplesPerTrace; i++) {                
                 // normalize samples to 0..1, recompute for set range
-                double val = ((powerTrace(i)+32768.0f)/(2.0f*32768.0f))* (2.0*m_tracesRange) - (m_tracesRange);
+                double sample = int8Samples ? powerTrace8[i] : powerTrace[i];
+                double val = ((sample+fullScale)/(2.0*fullScale))* (2.0*m_tracesRange) - (m_tracesRange);
                 if(val > max) max = val;
                 if(val < min) min = val;
-                series->append(i*sampleInterval, val); 
+                values[i] = (float) val;
             }
                 
             if(serie.color.compare("auto") != 0) {
                 series->setColor(serie.color);
             }                
             
-            m_chart->addSeries(series);   
+            addDecimatedSeries(series, values);
             series->attachAxis(m_axisX);
             series->attachAxis(m_axisYtraces);            
             
@@ -432,32 +575,85 @@ bool Visu::createChart(){
             return false;
         }
         
-        Vector<double> correlationTrace;        
         double max = -1.0;
         double min = 1.0;
-    
-        foreach (const CorrelationTraceSeries & serie, m_correlationTracesToPlot) {
+        
+        // Correlation traces summarized by the pyramid are not loaded
+        const SeriesPyramid * pyramid = openPyramid(m_correlations, m_correlationsSetsQ * m_correlationsCandidatesK, sizeof(double));
+        
+        SeriesFile file;
+        file.path = m_correlations;
+        file.valueSize = sizeof(double);
+        file.compressed = false;
+        file.trace = 0;
+        file.scale = 1.0;
+        
+        // Other correlation traces are loaded at once, each of them once, in the order of the file
+        std::vector<std::pair<size_t, size_t>> traces;
+        std::vector<double> correlationTraces;
+        
+        if(!pyramid) {
+            
+            foreach (const CorrelationTraceSeries & serie, m_correlationTracesToPlot) {
+                traces.push_back(std::make_pair(serie.matrixNo, serie.candidateNo));
+            }
+            
+            std::sort(traces.begin(), traces.end());
+            traces.erase(std::unique(traces.begin(), traces.end()), traces.end());
             
             try {
-                correlationTrace = loadCorrelationTraceFromFile<double>(corrsFile, m_samplesPerTrace, m_correlationsCandidatesK, serie.matrixNo, serie.candidateNo);
+                QByteArray ba = m_correlations.toLocal8Bit();
+                correlationTraces.resize(traces.size() * m_samplesPerTrace);
+                loadCorrelationTracesFromFile<double>(ba.data(), m_samplesPerTrace, m_correlationsCandidatesK, traces, correlationTraces.data());
             } catch (std::exception & e) {
-                cerr << "Failed to read the correlation trace: " << e.what() << "\n";
+                cerr << "Failed to read the correlation traces: " << e.what() << "\n";
                 return false;
             }
             
+        }
+    
+        foreach (const CorrelationTraceSeries & serie, m_correlationTracesToPlot) {
+            
+            if(pyramid) {
+                
+                const size_t pyramidSeries = serie.matrixNo * m_correlationsCandidatesK + serie.candidateNo;
+                file.offset = sizeof(double) * m_samplesPerTrace * pyramidSeries;
+                
+                const SeriesPyramidBucket & summary = pyramid->summary(pyramidSeries);
+                if(summary.max > max) max = summary.max;
+                if(summary.min < min) min = summary.min;
+                
+                QLineSeries * series = new QLineSeries();
+                
+                if(serie.color.compare("auto") != 0) {
+                    series->setColor(serie.color);
+                }
+                
+                addPyramidSeries(series, pyramid, pyramidSeries, file);
+                series->attachAxis(m_axisX);
+                series->attachAxis(m_axisYcorrs);
+                
+                continue;
+                
+            }
+            
+            const size_t loaded = std::lower_bound(traces.begin(), traces.end(), std::make_pair(serie.matrixNo, serie.candidateNo)) - traces.begin();
+            const double * correlationTrace = correlationTraces.data() + loaded * m_samplesPerTrace;
+            
             QLineSeries * series = new QLineSeries();
+            std::vector<float> values(m_samplesPerTrace);
             
             for(size_t i = 0; i < m_samplesPerTrace; i++) {  
-                if(correlationTrace(i) > max) max = correlationTrace(i);
-                if(correlationTrace(i) < min) min = correlationTrace(i);
-                series->append(i*sampleInterval, correlationTrace(i)); 
+                if(correlationTrace[i] > max) max = correlationTrace[i];
+                if(correlationTrace[i] < min) min = correlationTrace[i];
+                values[i] = (float) correlationTrace[i];
             }
                 
             if(serie.color.compare("auto") != 0) {
                 series->setColor(serie.color);
             }
                 
-            m_chart->addSeries(series);
+            addDecimatedSeries(series, values);
             series->attachAxis(m_axisX);
             series->attachAxis(m_axisYcorrs);       
             
@@ -485,37 +681,717 @@ bool Visu::createChart(){
         }
         
         Vector<double> tValsTrace;
-        
-        try {
-            tValsTrace = loadTValuesFromFile<double>(tValsFile, m_samplesPerTrace);
-        } catch (std::exception & e) {
-            cerr << "Failed to read the t-values trace: " << e.what() << "\n";
-            return false;
-        }
-        
+        double max = -std::numeric_limits<double>::infinity();
+        double min = std::numeric_limits<double>::infinity();
         QLineSeries * series = new QLineSeries();
         
-        for(size_t i = 0; i < m_samplesPerTrace; i++) {                
-            series->append(i*sampleInterval, tValsTrace(i)); 
-        }
-            
         if(m_tValsColor.compare("auto") != 0) {
             series->setColor(m_tValsColor);
         }
+        
+        // t-values summarized by the pyramid are not loaded
+        const SeriesPyramid * pyramid = openPyramid(m_tValues, 1, sizeof(double));
+        
+        if(pyramid) {
+            
+            SeriesFile file;
+            file.path = m_tValues;
+            file.offset = 0;
+            file.valueSize = sizeof(double);
+            file.compressed = false;
+            file.trace = 0;
+            file.scale = 1.0;
+            
+            max = pyramid->summary(0).max;
+            min = pyramid->summary(0).min;
+            
+            addPyramidSeries(series, pyramid, 0, file);
+            
+        } else {
+        
+            try {
+                tValsTrace = loadTValuesFromFile<double>(tValsFile, m_samplesPerTrace);
+            } catch (std::exception & e) {
+                cerr << "Failed to read the t-values trace: " << e.what() << "\n";
+                return false;
+            }
             
-        m_chart->addSeries(series);
+            std::vector<float> values(m_samplesPerTrace);
+            
+            for(size_t i = 0; i < m_samplesPerTrace; i++) {                
+                if(tValsTrace(i) > max) max = tValsTrace(i);
+                if(tValsTrace(i) < min) min = tValsTrace(i);
+                values[i] = (float) tValsTrace(i);
+            }
+            
+            addDecimatedSeries(series, values);
+            
+        }
+        
         series->attachAxis(m_axisX);
         series->attachAxis(m_axisYtvals);
         
+        // The series get their points once decimated, the range is set unless the axis is shared with the power traces
+        if(m_axisYtvals != m_axisYtraces && min <= max) m_axisYtvals->setRange(min, max);
         m_axisYtvals->applyNiceNumbers();
         
         closeFile(tValsFile);
     }        
     
+    // Plot at most two points per pixel column, redo on zoom
+    decimateSeries(0, m_samplesRange, m_width);
+    connect(m_axisX, SIGNAL(rangeChanged(qreal, qreal)), this, SLOT(samplesRangeChanged(qreal, qreal)));
+    
+    return true;
+    
+}
+
+double Visu::sampleToAxis(double sample) const {
+    
+    if(m_sampleIndices.empty()) return sample * m_sampleInterval;
+    
+    // Fractional samples, e.g. of the decimated points, lie between the original positions
+    const size_t lower = (sample > 0) ? (size_t) sample : 0;
+    if(lower + 1 >= m_sampleIndices.size()) return m_sampleIndices.back() * m_sampleInterval;
+    
+    const double fraction = sample - lower;
+    
+    return (m_sampleIndices[lower] + fraction * (m_sampleIndices[lower + 1] - m_sampleIndices[lower])) * m_sampleInterval;
+    
+}
+
+double Visu::axisToSample(double position) const {
+    
+    if(m_sampleIndices.empty()) return position / m_sampleInterval;
+    
+    const double original = std::ceil(position / m_sampleInterval);
+    if(original <= 0) return 0;
+    
+    return (double) (std::lower_bound(m_sampleIndices.begin(), m_sampleIndices.end(), (size_t) original) - m_sampleIndices.begin());
+    
+}
+
+double Visu::nearestSample(double position) const {
+    
+    const double nearest = std::floor(position / m_sampleInterval + 0.5);
+    
+    if(m_sampleIndices.empty() || nearest < 0) return nearest;
+    
+    // Just a selected sample at the nearest original position
+    std::vector<size_t>::const_iterator it = std::lower_bound(m_sampleIndices.begin(), m_sampleIndices.end(), (size_t) nearest);
+    
+    return (it != m_sampleIndices.end() && *it == (size_t) nearest) ? (double) (it - m_sampleIndices.begin()) : -1.0;
+    
+}
+
+void Visu::addDecimatedSeries(QLineSeries * series, std::vector<float> & values) {
+    
+    m_chart->addSeries(series);
+    
+    DecimatedSeries decimated;
+    decimated.series = series;
+    decimated.values.swap(values);
+    decimated.pyramid = nullptr;
+    decimated.pyramidSeries = 0;
+    m_decimatedSeries.push_back(std::move(decimated));
+    
+}
+
+void Visu::addPyramidSeries(QLineSeries * series, const SeriesPyramid * pyramid, size_t pyramidSeries, const SeriesFile & file) {
+    
+    m_chart->addSeries(series);
+    
+    DecimatedSeries decimated;
+    decimated.series = series;
+    decimated.pyramid = pyramid;
+    decimated.pyramidSeries = pyramidSeries;
+    decimated.file = file;
+    m_decimatedSeries.push_back(std::move(decimated));
+    
+}
+
+void Visu::decimateSeries(double from, double to, size_t buckets) {
+    
+    // Samples within the range, and a sample beyond on both sides, so that the lines reach the edges of the plot
+    const double firstSample = std::floor(axisToSample(from)) - 1;
+    const double lastSample = std::ceil(axisToSample(to)) + 2;
+    const size_t first = (firstSample > 0) ? (size_t) firstSample : 0;
+    const size_t last = (lastSample < (double) m_samplesPerTrace) ? (size_t) lastSample : m_samplesPerTrace;
+    
+    const long long noOfSeries = m_decimatedSeries.size();
+    std::vector<QVector<QPointF>> points(noOfSeries);
+    std::string error;
+    
+    // Series are decimated in parallel, but only the GUI thread may touch them
+    #pragma omp parallel
+    {
+        
+        std::vector<size_t> selected;
+        std::vector<DecimatedPoint> decimatedPoints;
+        std::vector<float> range;
+        
+        #pragma omp for schedule(dynamic)
+        for(long long s = 0; s < noOfSeries; s++){
+            
+            DecimatedSeries & decimated = m_decimatedSeries[s];
+            
+            if(decimated.values.empty() && decimated.pyramid != nullptr){
+                
+                try {
+                    
+                    const float scale = (float) decimated.file.scale;
+                    
+                    if(pyramidDecimate(*decimated.pyramid, decimated.pyramidSeries, first, last, buckets, decimatedPoints)){
+                        
+                        points[s].reserve(decimatedPoints.size());
+                        for(size_t i = 0; i < decimatedPoints.size(); i++) points[s].append(QPointF(sampleToAxis(decimatedPoints[i].position), decimatedPoints[i].value * scale));
+                        continue;
+                        
+                    }
+                    
+                    // Zoomed in beyond the pyramid: just the range is read from a raw file, while a compressed power trace is decoded whole and kept
+                    if(!decimated.file.compressed){
+                        
+                        readSeriesFile(decimated.file, first, last, range);
+                        minMaxDecimate(range.data(), 0, range.size(), buckets, selected);
+                        
+                        points[s].reserve(selected.size());
+                        for(size_t i = 0; i < selected.size(); i++) points[s].append(QPointF(sampleToAxis(first + selected[i]), range[selected[i]]));
+                        continue;
+                        
+                    }
+                    
+                    readSeriesFile(decimated.file, 0, m_samplesPerTrace, decimated.values);
+                    
+                } catch (std::exception & e) {
+                    #pragma omp critical
+                    {
+                        if(error.empty()) error = e.what();
+                    }
+                    continue;
+                }
+                
+            }
+            
+            const std::vector<float> & values = decimated.values;
+            minMaxDecimate(values.data(), first, last, buckets, selected);
+            
+            points[s].reserve(selected.size());
+            for(size_t i = 0; i < selected.size(); i++) points[s].append(QPointF(sampleToAxis(selected[i]), values[selected[i]]));
+            
+        }
+        
+    }
+    
+    if(!error.empty()){
+        QTextStream cerr(stderr);
+        cerr << "Failed to read the series from the file: " << error.c_str() << "\n";
+    }
+    
+    for(long long s = 0; s < noOfSeries; s++) m_decimatedSeries[s].series->replace(points[s]);
+    
+}
+
+bool Visu::createHeatmap() {
+    
+    QTextStream cerr(stderr);
+    
+    m_heatmapRows.clear();
+    
+    const bool correlations = (m_correlationTracesToPlot.size() > 0);
+    const QString & path = correlations ? m_correlations : m_tValues;
+    const size_t noOfSeries = correlations ? m_correlationsSetsQ * m_correlationsCandidatesK : 1;
+    
+    // Rows summarized by the pyramid are not loaded
+    const SeriesPyramid * pyramid = openPyramid(path, noOfSeries, sizeof(double));
+    
+    SeriesFile file;
+    file.path = path;
+    file.valueSize = sizeof(double);
+    file.compressed = false;
+    file.trace = 0;
+    file.scale = 1.0;
+    
+    // A row per correlation trace, in the order of the series arguments, or a single row of t-values
+    std::vector<size_t> rowSeries;
+    
+    if(correlations) {
+        foreach (const CorrelationTraceSeries & serie, m_correlationTracesToPlot) {
+            rowSeries.push_back(serie.matrixNo * m_correlationsCandidatesK + serie.candidateNo);
+        }
+    } else {
+        rowSeries.push_back(0);
+    }
+    
+    // Other rows are loaded at once, each of them once, in the order of the file
+    std::vector<size_t> series;
+    std::vector<double> loaded;
+    
+    if(!pyramid) {
+        
+        series = rowSeries;
+        std::sort(series.begin(), series.end());
+        series.erase(std::unique(series.begin(), series.end()), series.end());
+        
+        try {
+            
+            QByteArray ba = path.toLocal8Bit();
+            loaded.resize(series.size() * m_samplesPerTrace);
+            
+            if(correlations) {
+                
+                std::vector<std::pair<size_t, size_t>> traces;
+                for(size_t i = 0; i < series.size(); i++) traces.push_back(std::make_pair(series[i] / m_correlationsCandidatesK, series[i] % m_correlationsCandidatesK));
+                
+                loadCorrelationTracesFromFile<double>(ba.data(), m_samplesPerTrace, m_correlationsCandidatesK, traces, loaded.data());
+                
+            } else {
+                
+                std::fstream tValsFile = openInFile(ba.data());
+                Vector<double> tValsTrace = loadTValuesFromFile<double>(tValsFile, m_samplesPerTrace);
+                closeFile(tValsFile);
+                
+                for(size_t i = 0; i < m_samplesPerTrace; i++) loaded[i] = tValsTrace(i);
+                
+            }
+            
+        } catch (std::exception & e) {
+            cerr << "Failed to read the " << (correlations ? "correlation traces" : "t-values trace") << ": " << e.what() << "\n";
+            return false;
+        }
+        
+    }
+    
+    // Colors are scaled symmetrically by the value of the largest magnitude among all the rows
+    float scale = 0;
+    
+    for(size_t r = 0; r < rowSeries.size(); r++) {
+        
+        HeatmapRow row;
+        row.pyramid = pyramid;
+        row.pyramidSeries = rowSeries[r];
+        row.file = file;
+        row.file.offset = sizeof(double) * m_samplesPerTrace * rowSeries[r];
+        
+        if(pyramid) {
+            
+            const SeriesPyramidBucket & summary = pyramid->summary(rowSeries[r]);
+            scale = std::max(scale, std::max(std::fabs(summary.min), std::fabs(summary.max)));
+            
+        } else {
+            
+            const size_t s = std::lower_bound(series.begin(), series.end(), rowSeries[r]) - series.begin();
+            const double * values = loaded.data() + s * m_samplesPerTrace;
+            
+            row.values.resize(m_samplesPerTrace);
+            for(size_t i = 0; i < m_samplesPerTrace; i++) row.values[i] = (float) values[i];
+            
+            const float extreme = std::fabs(maxAbsOfRange(row.values.data(), m_samplesPerTrace));
+            if(extreme > scale) scale = extreme;
+            
+        }
+        
+        m_heatmapRows.push_back(std::move(row));
+        
+    }
+    
+    m_heatmapScale = scale;
+    
+    // Rows axis, the first row at the bottom
+    m_axisYrows = new QValueAxis();
+    m_axisYrows->setTitleText(QString("%1, colors -%2 to +%2").arg(correlations ? "Correlation traces" : "t-values").arg(scale, 0, 'g', 4));
+    m_axisYrows->setLabelFormat("%g");
+    m_chart->addAxis(m_axisYrows, Qt::AlignLeft);
+    
+    m_axisX->setGridLineVisible(false);
+    m_axisYrows->setGridLineVisible(false);
+    
+    // An invisible series spanning the heatmap, so that the chart zooms the axes
+    QLineSeries * frame = new QLineSeries();
+    frame->append(0, 0);
+    frame->append(m_samplesRange, m_heatmapRows.size());
+    frame->setPen(QPen(Qt::NoPen));
+    m_chart->addSeries(frame);
+    frame->attachAxis(m_axisX);
+    frame->attachAxis(m_axisYrows);
+    
+    m_axisX->setRange(0, m_samplesRange);
+    m_axisYrows->setRange(0, m_heatmapRows.size());
+    
+    // Above the plot area background, below the axes
+    m_heatmapItem = new QGraphicsPixmapItem(m_chart);
+    m_heatmapItem->setZValue(0.5);
+    
+    // Rasterized whenever the plot area gets laid out, and again on zoom
+    connect(m_chart, SIGNAL(plotAreaChanged(QRectF)), this, SLOT(heatmapChanged()));
+    connect(m_axisX, SIGNAL(rangeChanged(qreal, qreal)), this, SLOT(heatmapChanged()));
+    connect(m_axisYrows, SIGNAL(rangeChanged(qreal, qreal)), this, SLOT(heatmapChanged()));
+    
     return true;
     
 }
 
+void Visu::rasterizeHeatmap() {
+    
+    const QRectF plotArea = m_chart->plotArea();
+    const long long width = (long long) std::ceil(plotArea.width());
+    const long long height = (long long) std::ceil(plotArea.height());
+    
+    if(width <= 0 || height <= 0 || m_heatmapRows.empty()) return;
+    
+    // Samples of each pixel column, or the nearest sample when zoomed in to less than a sample per pixel. Columns beyond the samples stay empty
+    const double from = m_axisX->min();
+    const double columnWidth = (m_axisX->max() - m_axisX->min()) / width;
+    const double samples = (double) m_samplesPerTrace;
+    
+    std::vector<size_t> first(width), last(width);
+    size_t rangeFirst = m_samplesPerTrace, rangeLast = 0;
+    
+    for(long long c = 0; c < width; c++){
+        
+        const double a = std::min(std::max(std::ceil(axisToSample(from + c * columnWidth)), 0.0), samples);
+        const double b = std::min(std::max(std::ceil(axisToSample(from + (c + 1) * columnWidth)), 0.0), samples);
+        const double nearest = nearestSample(from + (c + 0.5) * columnWidth);
+        
+        if(b > a) {
+            first[c] = (size_t) a;
+            last[c] = (size_t) b;
+        } else if(nearest >= 0 && nearest < samples) {
+            first[c] = (size_t) nearest;
+            last[c] = first[c] + 1;
+        } else {
+            first[c] = last[c] = 0;
+        }
+        
+        if(last[c] > first[c]){
+            rangeFirst = std::min(rangeFirst, first[c]);
+            rangeLast = std::max(rangeLast, last[c]);
+        }
+        
+    }
+    
+    // Column samples relative to the range, read from the file when zoomed in beyond the pyramid
+    std::vector<size_t> rangeColumnFirst(width), rangeColumnLast(width);
+    for(long long c = 0; c < width; c++){
+        rangeColumnFirst[c] = (last[c] > first[c]) ? first[c] - rangeFirst : 0;
+        rangeColumnLast[c] = (last[c] > first[c]) ? last[c] - rangeFirst : 0;
+    }
+    
+    // Rows of each pixel row, or the nearest row when zoomed in to less than a row per pixel, the top pixel row showing the last rows
+    const double rowsTop = m_axisYrows->max();
+    const double pixelRows = (m_axisYrows->max() - m_axisYrows->min()) / height;
+    const double rows = (double) m_heatmapRows.size();
+    
+    std::vector<size_t> rowFirst(height), rowLast(height);
+    size_t visibleFirst = m_heatmapRows.size(), visibleLast = 0;
+    
+    for(long long y = 0; y < height; y++){
+        
+        const double a = std::min(std::max(std::floor(rowsTop - (y + 1) * pixelRows), 0.0), rows);
+        const double b = std::min(std::max(std::ceil(rowsTop - y * pixelRows), 0.0), rows);
+        const double nearest = std::floor(rowsTop - (y + 0.5) * pixelRows);
+        
+        if(b > a) {
+            rowFirst[y] = (size_t) a;
+            rowLast[y] = (size_t) b;
+        } else if(nearest >= 0 && nearest < rows) {
+            rowFirst[y] = (size_t) nearest;
+            rowLast[y] = rowFirst[y] + 1;
+        } else {
+            rowFirst[y] = rowLast[y] = 0;
+        }
+        
+        if(rowLast[y] > rowFirst[y]){
+            visibleFirst = std::min(visibleFirst, rowFirst[y]);
+            visibleLast = std::max(visibleLast, rowLast[y]);
+        }
+        
+    }
+    
+    // Visible rows are downsampled to the pixel columns in parallel
+    const long long noOfRows = (visibleLast > visibleFirst) ? visibleLast - visibleFirst : 0;
+    std::vector<float> columns(noOfRows * width);
+    std::string error;
+    
+    #pragma omp parallel
+    {
+        
+        std::vector<float> range;
+        
+        #pragma omp for schedule(dynamic)
+        for(long long r = 0; r < noOfRows; r++){
+            
+            HeatmapRow & row = m_heatmapRows[visibleFirst + r];
+            float * out = columns.data() + r * width;
+            
+            if(!row.values.empty()) {
+                heatmapColumns(row.values.data(), first.data(), last.data(), width, out);
+                continue;
+            }
+            
+            if(pyramidHeatmapColumns(*row.pyramid, row.pyramidSeries, first.data(), last.data(), width, out)) continue;
+            
+            try {
+                
+                readSeriesFile(row.file, rangeFirst, rangeLast, range);
+                heatmapColumns(range.data(), rangeColumnFirst.data(), rangeColumnLast.data(), width, out);
+                
+            } catch (std::exception & e) {
+                #pragma omp critical
+                {
+                    if(error.empty()) error = e.what();
+                }
+                for(long long c = 0; c < width; c++) out[c] = std::numeric_limits<float>::quiet_NaN();
+            }
+            
+        }
+        
+    }
+    
+    if(!error.empty()){
+        QTextStream cerr(stderr);
+        cerr << "Failed to read the series from the file: " << error.c_str() << "\n";
+    }
+    
+    // Pixel rows are merged from their rows and colored in parallel, straight into the image lines
+    QImage image(width, height, QImage::Format_RGB32);
+    uchar * bits = image.bits();
+    const long long bytesPerLine = image.bytesPerLine();
+    const float scale = m_heatmapScale;
+    
+    #pragma omp parallel
+    {
+        
+        std::vector<float> merged(width);
+        
+        #pragma omp for schedule(static)
+        for(long long y = 0; y < height; y++){
+            
+            std::fill(merged.begin(), merged.end(), std::numeric_limits<float>::quiet_NaN());
+            
+            for(size_t r = rowFirst[y]; r < rowLast[y]; r++){
+                const float * rowColumns = columns.data() + (r - visibleFirst) * width;
+                for(long long c = 0; c < width; c++) merged[c] = maxAbs(merged[c], rowColumns[c]);
+            }
+            
+            uint32_t * line = reinterpret_cast<uint32_t *>(bits + y * bytesPerLine);
+            for(long long c = 0; c < width; c++) line[c] = heatmapColor(merged[c], scale);
+            
+        }
+        
+    }
+    
+    m_heatmapItem->setPixmap(QPixmap::fromImage(image));
+    m_heatmapItem->setPos(plotArea.topLeft());
+    
+}
+
+void Visu::heatmapChanged() {
+    
+    rasterizeHeatmap();
+    
+}
+
+const SeriesPyramid * Visu::openPyramid(const QString & file, size_t noOfSeries, size_t valueSize) {
+    
+    QTextStream cout(stdout);
+    QTextStream cerr(stderr);
+    
+    const QString pyramidFile = file + ".pyr";
+    const QFileInfo fileInfo(file);
+    QFileInfo pyramidInfo(pyramidFile);
+    
+    bool upToDate = pyramidInfo.exists() && pyramidInfo.lastModified() >= fileInfo.lastModified();
+    
+    if(!upToDate && m_pyramid){
+        
+        cout << QString("Creating pyramid '%1'...\n").arg(pyramidFile);
+        cout.flush();
+        
+        try {
+            
+            if(valueSize == sizeof(int8_t)) createPyramid<int8_t>(file, pyramidFile, noOfSeries);
+            else if(valueSize == sizeof(int16_t)) createPyramid<int16_t>(file, pyramidFile, noOfSeries);
+            else createPyramid<double>(file, pyramidFile, noOfSeries);
+            
+        } catch (std::exception & e) {
+            cerr << "Failed to create the pyramid: " << e.what() << "\n";
+            QFile::remove(pyramidFile);
+            return nullptr;
+        }
+        
+        upToDate = true;
+        
+    } else if(!upToDate && pyramidInfo.exists()) {
+        cerr << QString("Pyramid '%1' is older than '%2', ignored. Use --pyramid to update it.\n").arg(pyramidFile).arg(file);
+    }
+    
+    if(!upToDate) return nullptr;
+    
+    // The mapping lives as long as the file, i.e. as long as this object
+    QFile * mappedFile = new QFile(pyramidFile, this);
+    uchar * data = mappedFile->open(QIODevice::ReadOnly) ? mappedFile->map(0, mappedFile->size()) : nullptr;
+    
+    if(data == nullptr){
+        cerr << QString("Failed to map pyramid '%1', ignored.\n").arg(pyramidFile);
+        delete mappedFile;
+        return nullptr;
+    }
+    
+    try {
+        
+        std::unique_ptr<SeriesPyramid> pyramid(new SeriesPyramid(data, mappedFile->size()));
+        
+        if(pyramid->samplesPerSeries() != m_samplesPerTrace || pyramid->noOfSeries() < noOfSeries) throw RuntimeException("Number of samples or series mismatch");
+        
+        m_pyramids.push_back(std::move(pyramid));
+        
+    } catch (std::exception & e) {
+        cerr << QString("Invalid pyramid '%1', ignored: ").arg(pyramidFile) << e.what() << "\n";
+        delete mappedFile;
+        return nullptr;
+    }
+    
+    return m_pyramids.back().get();
+    
+}
+
+/// Decodes power traces from the compressed container
+template <class T>
+static void readCompressedTraces(CompressedTracesReader<T> & reader, size_t firstTrace, size_t noOfTraces, T * buffer) {
+    reader.readTraces(firstTrace, noOfTraces, buffer);
+}
+
+/// The compressed container holds int8 or int16 samples only, never the doubles of the results
+static void readCompressedTraces(CompressedTracesReader<double> &, size_t, size_t, double *) {
+    throw RuntimeException("Compressed power traces container holds int8 or int16 samples only");
+}
+
+template <class T>
+void Visu::createPyramid(const QString & file, const QString & pyramidFile, size_t noOfSeries) {
+    
+    QByteArray ba = file.toLocal8Bit();
+    std::fstream inFile = openInFile(ba.data());
+    
+    ba = pyramidFile.toLocal8Bit();
+    std::fstream outFile = openOutFile(ba.data());
+    
+    std::unique_ptr<CompressedTracesReader<T>> compressed;
+    
+    if(isCompressedTracesFile(inFile)){
+        compressed.reset(new CompressedTracesReader<T>(inFile));
+        if(compressed->samplesPerTrace() != m_samplesPerTrace) throw RuntimeException("Could not read the power traces from the file. Number of samples per trace mismatch.");
+    }
+    
+    // Batches of series of about 64 MB, the next batch is read while the pyramids of the current one are computed
+    const size_t samples = m_samplesPerTrace;
+    const size_t batch = (64 * 1024 * 1024 / (samples * sizeof(T))) ? 64 * 1024 * 1024 / (samples * sizeof(T)) : 1;
+    
+    std::vector<T> current(batch * samples);
+    std::vector<T> next(batch * samples);
+    
+    auto readBatch = [&](std::vector<T> & buffer, size_t firstSeries) -> size_t {
+        
+        const size_t n = (noOfSeries - firstSeries < batch) ? noOfSeries - firstSeries : batch;
+        
+        if(compressed){
+            readCompressedTraces(*compressed, firstSeries, n, buffer.data());
+        } else {
+            inFile.read(reinterpret_cast<char *>(buffer.data()), n * samples * sizeof(T));
+            if(inFile.fail()) throw RuntimeException("Could not read the data from the file. Not enough data?");
+        }
+        
+        return n;
+        
+    };
+    
+    SeriesPyramidWriter<T> writer(outFile, samples);
+    
+    CoutProgress::get().start(noOfSeries);
+    
+    std::future<size_t> reading = std::async(std::launch::async, readBatch, std::ref(next), 0);
+    
+    for(size_t firstSeries = 0; firstSeries < noOfSeries; ){
+        
+        const size_t n = reading.get();
+        std::swap(current, next);
+        
+        if(firstSeries + n < noOfSeries) reading = std::async(std::launch::async, readBatch, std::ref(next), firstSeries + n);
+        
+        writer.writeSeries(current.data(), n);
+        
+        firstSeries += n;
+        CoutProgress::get().update(firstSeries);
+        
+    }
+    
+    writer.close();
+    
+    CoutProgress::get().finish();
+    
+    closeFile(outFile);
+    closeFile(inFile);
+    
+}
+
+void Visu::readSeriesFile(const SeriesFile & file, size_t first, size_t last, std::vector<float> & values) const {
+    
+    if(file.valueSize == sizeof(int8_t)) readSeriesFileTyped<int8_t>(file, first, last, values);
+    else if(file.valueSize == sizeof(int16_t)) readSeriesFileTyped<int16_t>(file, first, last, values);
+    else readSeriesFileTyped<double>(file, first, last, values);
+    
+}
+
+template <class T>
+void Visu::readSeriesFileTyped(const SeriesFile & file, size_t first, size_t last, std::vector<float> & values) const {
+    
+    QByteArray ba = file.path.toLocal8Bit();
+    std::fstream fs = openInFile(ba.data());
+    
+    std::vector<T> raw;
+    
+    if(file.compressed){
+        
+        // Power traces in the compressed container are decoded whole
+        CompressedTracesReader<T> reader(fs);
+        
+        if(reader.samplesPerTrace() != m_samplesPerTrace)
+            throw RuntimeException("Could not read the power trace from the file. Number of samples per trace mismatch.");
+        
+        raw.resize(m_samplesPerTrace);
+        readCompressedTraces(reader, file.trace, 1, raw.data());
+        raw.erase(raw.begin() + last, raw.end());
+        raw.erase(raw.begin(), raw.begin() + first);
+        
+    } else {
+        
+        fs.seekg(file.offset + sizeof(T) * first);
+        
+        if(fs.fail())
+            throw RuntimeException("Could not skip offset. Not enough data?");
+        
+        raw.resize(last - first);
+        fs.read(reinterpret_cast<char *>(raw.data()), raw.size() * sizeof(T));
+        
+        if(fs.fail())
+            throw RuntimeException("Could not read the data from the file. Not enough data?");
+        
+    }
+    
+    closeFile(fs);
+    
+    values.resize(raw.size());
+    for(size_t i = 0; i < raw.size(); i++) values[i] = (float) (raw[i] * file.scale);
+    
+}
+
+void Visu::samplesRangeChanged(qreal min, qreal max) {
+    
+    const qreal plotWidth = m_chart->plotArea().width();
+    decimateSeries(min, max, (plotWidth > 0) ? (size_t) plotWidth : m_width);
+    
+}
+
 bool Visu::saveChart() const {
     
     if(!m_save) return true;
@@ -554,6 +1430,7 @@ QChartView * Visu::getChartView() const {
  
     QChartView * chartView = new QChartView(m_chart);
     chartView->setRenderHint(QPainter::Antialiasing);
+    chartView->setRubberBand(QChartView::HorizontalRubberBand); // zoom in by selecting a range, zoom out by the right click
     
     return chartView;
     
@@ -2,12 +2,33 @@
   error( "Couldn't find the sicak.pri file!" )
 }
 
+#
+# OpenMP library is a dependency
+#
+
+win32 {
+    QMAKE_CXXFLAGS_RELEASE += /openmp
+}
+unix { 
+    QMAKE_CXXFLAGS_RELEASE += -fopenmp
+    QMAKE_LFLAGS_RELEASE += -fopenmp
+    
+    # enable more agressive optimization, the series decimation needs to get vectorized
+    QMAKE_CXXFLAGS_RELEASE -= -O2
+    QMAKE_LFLAGS_RELEASE -= -O2
+    
+    QMAKE_CXXFLAGS_RELEASE += -O3
+    QMAKE_LFLAGS_RELEASE += -O3
+}
+
 INCLUDEPATH    += ./include
 QT += gui charts widgets svg
 CONFIG += console
 
 
-HEADERS += include/visu.h
+HEADERS += include/visu.h \
+           include/seriesdecimation.hpp \
+           include/heatmap.hpp
 SOURCES    = src/main.cpp \
              src/visu.cpp
 